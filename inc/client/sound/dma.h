@@ -41,6 +41,7 @@ typedef struct snddmaAPI_s {
     void (*BeginPainting)(void);
     void (*Submit)(void);
     void (*Activate)(qboolean active);
+    qboolean threaded;  // BeginPainting and Submit may be called from any thread
 } snddmaAPI_t;
 
 void WAVE_FillAPI(snddmaAPI_t *api);
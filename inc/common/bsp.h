@@ -283,10 +283,19 @@ typedef struct bsp_s {
     msurfedge_t     *surfedges;
 #endif
 
+	// derived visibility data, shared by all users of the map
+	size_t          vis_matrix_size;
 	char            *pvs_matrix;
 	char            *pvs2_matrix;
+	char            *phs_matrix;
 	qboolean        pvs_patched;
 
+	// load statistics reported by `bsplist'
+	unsigned        load_msec;
+	unsigned        pvs_msec;
+	unsigned        pvs2_msec;
+	unsigned        phs_msec;
+
 	// WARNING: the 'name' string is actually longer than this, and the bsp_t structure is allocated larger than sizeof(bsp_t) in BSP_Load
     char            name[1];
 } bsp_t;
@@ -315,6 +324,9 @@ mmodel_t *BSP_InlineModel(bsp_t *bsp, const char *name);
 char* BSP_GetPvs(bsp_t *bsp, int cluster);
 char* BSP_GetPvs2(bsp_t *bsp, int cluster);
 
+void BSP_BuildPhsMatrix(bsp_t *bsp);
+void BSP_BuildPvs2Matrix(bsp_t *bsp);
+
 qboolean BSP_SavePatchedPVS(bsp_t *bsp);
 
 void BSP_Init(void);
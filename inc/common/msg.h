@@ -77,12 +77,46 @@ typedef enum {
     MSG_ES_REMOVE       = (1 << 7)
 } msgEsFlags_t;
 
+// decoded svc_temp_entity, svc_muzzleflash and svc_sound payloads
+typedef struct {
+    int type;
+    vec3_t pos1;
+    vec3_t pos2;
+    vec3_t offset;
+    vec3_t dir;
+    int count;
+    int color;
+    int entity1;
+    int entity2;
+    int time;
+} tent_params_t;
+
+typedef struct {
+    int entity;
+    int weapon;
+    int silenced;
+} mz_params_t;
+
+typedef struct {
+    int     flags;
+    int     index;
+    int     entity;
+    int     channel;
+    vec3_t  pos;
+    float   volume;
+    float   attenuation;
+    float   timeofs;
+} snd_params_t;
+
 extern sizebuf_t    msg_write;
 extern byte         msg_write_buffer[MAX_MSGLEN];
 
 extern sizebuf_t    msg_read;
 extern byte         msg_read_buffer[MAX_MSGLEN];
 
+// upper bound on the size of a single MSG_WriteDeltaEntity update
+#define MAX_ENTITY_DELTA    64
+
 extern const entity_packed_t    nullEntityState;
 extern const player_packed_t    nullPlayerState;
 extern const usercmd_t          nullUserCmd;
@@ -140,9 +174,14 @@ void    MSG_ReadDeltaUsercmd_Hacked(const usercmd_t *from, usercmd_t *to);
 void    MSG_ReadDeltaUsercmd_Enhanced(const usercmd_t *from, usercmd_t *to, int version);
 int     MSG_ParseEntityBits(int *bits);
 void    MSG_ParseDeltaEntity(const entity_state_t *from, entity_state_t *to, int number, int bits, msgEsFlags_t flags);
+int     MSG_ReadEntityBits(int *bits, byte **cursor);
+void    MSG_ReadDeltaEntity(byte *cursor, const entity_state_t *from, entity_state_t *to, int number, int bits, msgEsFlags_t flags);
 #if USE_CLIENT
 void    MSG_ParseDeltaPlayerstate_Default(const player_state_t *from, player_state_t *to, int flags);
 void    MSG_ParseDeltaPlayerstate_Enhanced(const player_state_t *from, player_state_t *to, int flags, int extraflags);
+void    MSG_ParseTempEntity(tent_params_t *te);
+void    MSG_ParseMuzzleFlash(mz_params_t *mz, int mask);
+void    MSG_ParseStartSound(snd_params_t *snd);
 #endif
 void    MSG_ParseDeltaPlayerstate_Packet(const player_state_t *from, player_state_t *to, int flags);
 
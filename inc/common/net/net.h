@@ -259,6 +259,7 @@ void        NET_UpdateStream(netstream_t *s);
 ioentry_t   *NET_AddFd(qsocket_t fd);
 void        NET_RemoveFd(qsocket_t fd);
 int         NET_Sleep(int msec);
+int         NET_SleepUntil(unsigned deadline);
 #if USE_AC_SERVER
 int         NET_Sleepv(int msec, ...);
 #endif
@@ -267,5 +268,6 @@ extern cvar_t       *net_ip;
 extern cvar_t       *net_port;
 
 extern netadr_t     net_from;
+extern unsigned     net_rcvtime;
 
 #endif // NET_H
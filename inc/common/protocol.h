@@ -99,6 +99,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define MVD_MAGIC               MakeRawLong('M','V','D','2')
 
+// keyframe index written next to local MVD recordings
+#define MVD_INDEX_MAGIC         MakeRawLong('M','V','D','X')
+#define MVD_INDEX_VERSION       1
+
 //
 // server to client
 //
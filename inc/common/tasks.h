@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2026 Quake II RTX contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "shared/list.h"
+
+//
+// tasks.c -- worker thread pool
+//
+// Task functions run concurrently with each other and may not call
+// Com_Error, print or allocate memory without holding the task lock.
+// Background tasks also run concurrently with the main thread, so they
+// may not do any of that at all.
+//
+
+#define MAX_WORKERS     16
+
+typedef void (*taskfunc_t)(void *data, int index);
+
+typedef enum {
+    TASK_IDLE,
+    TASK_QUEUED,
+    TASK_RUNNING
+} taskstate_t;
+
+// background task, must stay allocated until it is complete
+typedef struct {
+    list_t      entry;
+    taskfunc_t  func;
+    void        *data;
+    taskstate_t state;
+} task_t;
+
+void    Com_InitTasks(void);
+void    Com_ShutdownTasks(void);
+
+// calls func(data, i) for each i in [0, count) and waits for completion
+void    Com_ParallelFor(taskfunc_t func, void *data, int count);
+
+// queues func(data, 0) to run on a worker and returns immediately.
+// runs it on the calling thread if there are no workers.
+void    Com_QueueTask(task_t *task, taskfunc_t func, void *data);
+
+// returns qtrue once the task has finished
+qboolean Com_TaskDone(task_t *task);
+
+// waits for the task to finish, running it here if no worker took it yet
+void    Com_WaitTask(task_t *task);
+
+// serializes access to non thread safe subsystems from task functions
+void    Com_TaskLock(void);
+void    Com_TaskUnlock(void);
+
+int     Com_NumWorkers(void);
+
+#endif // TASKS_H
@@ -47,6 +47,11 @@ void Com_PlayerToEntityState(const player_state_t *ps, entity_state_t *es);
 unsigned Com_HashString(const char *s, unsigned size);
 unsigned Com_HashStringLen(const char *s, size_t len, unsigned size);
 
+void Com_ClearConfigstrings(const char **table);
+void Com_CopyConfigstrings(const char **dst, const char **src);
+const char *Com_ConfigstringSlot(const char **table, int index);
+qboolean Com_SetConfigstring(const char **table, int index, const char *s, size_t len);
+
 size_t Com_FormatTime(char *buffer, size_t size, time_t t);
 size_t Com_FormatTimeLong(char *buffer, size_t size, time_t t);
 size_t Com_TimeDiff(char *buffer, size_t size, time_t *p, time_t now);
@@ -40,6 +40,7 @@ typedef enum {
     TAG_MVD,
     TAG_SOUND,
     TAG_CMODEL,
+    TAG_STRING,
 
     TAG_MAX
 } memtag_t;
@@ -54,6 +55,7 @@ void    Z_FreeTags(memtag_t tag);
 void    Z_LeakTest(memtag_t tag);
 void    Z_Check(void);
 void    Z_Stats_f(void);
+void    Z_GetAllocStats(size_t *count, size_t *bytes);
 
 void    Z_TagReserve(size_t size, memtag_t tag);
 void    *Z_ReservedAlloc(size_t size) q_malloc;
@@ -63,4 +65,10 @@ char    *Z_ReservedCopyString(const char *in) q_malloc;
 // may return pointer to static memory
 char    *Z_CvarCopyString(const char *in);
 
+// shared refcounted copies, equal strings get equal pointers
+const char  *Z_InternString(const char *in);
+const char  *Z_InternStringLen(const char *in, size_t len);
+const char  *Z_RetainString(const char *in);
+void        Z_ReleaseString(const char *in);
+
 #endif // ZONE_H
@@ -112,6 +112,7 @@ void IMG_FreeAll(void);
 void IMG_Init(void);
 void IMG_Shutdown(void);
 void IMG_GetPalette(void);
+void IMG_RunScreenshots(void);
 
 image_t *IMG_ForHandle(qhandle_t h);
 
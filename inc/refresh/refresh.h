@@ -287,5 +287,6 @@ void R_RegisterFunctionsGL();
 #if REF_VKPT
 void R_RegisterFunctionsRTX();
 #endif
+void R_RegisterFunctionsNull(void);
 
 #endif // REFRESH_H
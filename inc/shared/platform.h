@@ -83,6 +83,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define Q_STATBUF           struct stat
 #endif
 
+// SSE2 is always available on x86_64, and on x86 when the compiler targets it
+#if (defined __SSE2__) || (defined _M_X64) || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define USE_SSE2    1
+#else
+#define USE_SSE2    0
+#endif
+
 #ifndef F_OK
 #define F_OK    0
 #define X_OK    1
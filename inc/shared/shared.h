@@ -510,6 +510,7 @@ int SortStricmp(const void *p1, const void *p2);
 size_t COM_strclr(char *s);
 
 // buffer safe operations
+size_t Q_strnlen(const char *s, size_t maxlen);
 size_t Q_strlcpy(char *dst, const char *src, size_t size);
 size_t Q_strlcat(char *dst, const char *src, size_t size);
 
@@ -1458,6 +1459,8 @@ ROGUE - VERSIONS
     ((cs) >= CS_STATUSBAR && (cs) < CS_AIRACCEL ? \
       MAX_QPATH * (CS_AIRACCEL - (cs)) : MAX_QPATH)
 
+#define CS_MAXSIZE  CS_SIZE(CS_STATUSBAR)
+
 
 //==============================================
 
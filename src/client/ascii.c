@@ -29,7 +29,7 @@ STAT PROGRAMS TO TEXT
 #define TH_WIDTH    80
 #define TH_HEIGHT   40
 
-static void TH_DrawString(char *dst, int x, int y, char *src, size_t len)
+static void TH_DrawString(char *dst, int x, int y, const char *src, size_t len)
 {
     int c;
 
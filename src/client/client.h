@@ -199,6 +199,23 @@ typedef struct client_state_s {
     centity_t       *solidEntities[MAX_PACKET_ENTITIES];
     int             numSolidEntities;
 
+    // absolute bounds of solid entities, and their indices sorted by
+    // solidMins[i][0] for sweep and prune during prediction
+    vec3_t          solidMins[MAX_PACKET_ENTITIES];
+    vec3_t          solidMaxs[MAX_PACKET_ENTITIES];
+    short           solidOrder[MAX_PACKET_ENTITIES];
+    unsigned        solidSequence;      // bumped each time the list is rebuilt
+
+    // last state predicted from the current frame, reused while it remains
+    // valid so that only new commands have to be simulated
+    pmove_state_t   predicted_base;     // state prediction started from
+    pmoveParams_t   predicted_pmp;
+    unsigned        predicted_seq;      // solidSequence at that time
+    unsigned        predicted_ack;      // last acknowledged command
+    unsigned        predicted_cmd;      // last command predicted
+    pmove_state_t   predicted_state;    // state after predicted_cmd
+    vec3_t          predicted_viewangles;
+
     entity_state_t  baselines[MAX_EDICTS];
 
     entity_state_t  entityStates[MAX_PARSE_ENTITIES];
@@ -285,8 +302,8 @@ typedef struct client_state_s {
     int         framediv;       // BASE_FRAMETIME/frametime
 #endif
 
-    char        baseconfigstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
-    char        configstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
+    const char  *baseconfigstrings[MAX_CONFIGSTRINGS];  // interned
+    const char  *configstrings[MAX_CONFIGSTRINGS];      // interned
     char        mapname[MAX_QPATH]; // short format - q2dm1, etc
 
 #if USE_AUTOREPLY
@@ -371,6 +388,21 @@ typedef struct {
     char        path[1];
 } dlqueue_t;
 
+// timedemo subsystem timers, nested ones are included in their parent
+typedef enum {
+    TD_PARSE,       // demo parsing (includes delta)
+    TD_DELTA,       // frame delta processing
+    TD_PREDICT,     // movement prediction
+    TD_SCREEN,      // screen update (includes entities and refresh)
+    TD_ENTITIES,    // packet entities
+    TD_TENTS,       // temporary entities
+    TD_PARTICLES,   // particles
+    TD_REFRESH,     // renderer frame
+    TD_SOUND,       // sound update
+
+    TD_MAX
+} tdsection_t;
+
 typedef struct client_static_s {
     connstate_t state;
     keydest_t   key_dest;
@@ -454,6 +486,10 @@ typedef struct client_static_s {
         qhandle_t   recording;
         unsigned    time_start;
         unsigned    time_frames;
+        qboolean    timing;             // timedemo subsystem timers running
+        uint64_t    time_usec[TD_MAX];  // time spent in each subsystem
+        size_t      time_allocs;        // zone allocation counters at start
+        size_t      time_bytes;
         int         last_server_frame;  // number of server frame the last svc_frame was written
         int         frames_written;     // number of frames written to demo file
         int         frames_dropped;     // number of svc_frames that didn't fit
@@ -464,10 +500,13 @@ typedef struct client_static_s {
         int         file_offset;
         int         file_percent;
         sizebuf_t   buffer;
-        list_t      snapshots;
+        struct demosnap_s   **snapshots;    // sorted by frame number
+        int         numsnapshots;
+        char        path[MAX_OSPATH];   // demo being played back
         qboolean    paused;
         qboolean    seeking;
         qboolean    eof;
+        qboolean    indexing;           // building index, not playing
     } demo;
 
 #if USE_CLIENT_GTV
@@ -656,36 +695,6 @@ void CL_SendCmd(void);
 // parse.c
 //
 
-typedef struct {
-    int type;
-    vec3_t pos1;
-    vec3_t pos2;
-    vec3_t offset;
-    vec3_t dir;
-    int count;
-    int color;
-    int entity1;
-    int entity2;
-    int time;
-} tent_params_t;
-
-typedef struct {
-    int entity;
-    int weapon;
-    int silenced;
-} mz_params_t;
-
-typedef struct {
-    int     flags;
-    int     index;
-    int     entity;
-    int     channel;
-    vec3_t  pos;
-    float   volume;
-    float   attenuation;
-    float   timeofs;
-} snd_params_t;
-
 extern tent_params_t    te;
 extern mz_params_t      mz;
 extern snd_params_t     snd;
@@ -765,6 +774,7 @@ void CL_InitTEnts(void);
 //
 // predict.c
 //
+void CL_SortSolidEntities(void);
 void CL_PredictAngles(void);
 void CL_PredictMovement(void);
 void CL_CheckPredictionError(void);
@@ -778,8 +788,6 @@ void CL_CheckPredictionError(void);
 #define INSTANT_PARTICLE    -10000.0
 
 typedef struct cparticle_s {
-    struct cparticle_s    *next;
-
     float   time;
 
     vec3_t  org;
@@ -832,6 +840,7 @@ void CL_ParticleEffect2(vec3_t org, vec3_t dir, int color, int count);
 cparticle_t *CL_AllocParticle(void);
 void CL_RunParticles(void);
 void CL_AddParticles(void);
+void CL_TimeParticles_f(void);
 #if USE_DLIGHTS
 cdlight_t *CL_AllocDlight(int key);
 void CL_RunDLights(void);
@@ -892,6 +901,17 @@ void CL_FirstDemoFrame(void);
 void CL_Stop_f(void);
 demoInfo_t *CL_GetDemoInfo(const char *path, demoInfo_t *info);
 
+static inline uint64_t CL_TimeDemoBegin(void)
+{
+    return cls.demo.timing ? Sys_Microseconds() : 0;
+}
+
+static inline void CL_TimeDemoEnd(tdsection_t section, uint64_t start)
+{
+    if (cls.demo.timing)
+        cls.demo.time_usec[section] += Sys_Microseconds() - start;
+}
+
 
 //
 // locs.c
@@ -22,11 +22,23 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define CON_TIMES       16
 #define CON_TIMES_MASK  (CON_TIMES - 1)
 
-#define CON_TOTALLINES          1024    // total lines in console scrollback
-#define CON_TOTALLINES_MASK     (CON_TOTALLINES - 1)
+// scrollback is a ring of variable length lines, indexed by line number.
+// lines are wrapped to the screen width only when drawn.
+#define CON_TEXTSIZE    0x100000    // bytes of text in scrollback
+#define CON_TEXTMASK    (CON_TEXTSIZE - 1)
+
+#define CON_MAXLINES    0x10000     // total lines in console scrollback
+#define CON_LINESMASK   (CON_MAXLINES - 1)
+
+#define CON_MAXLINE     1024    // longer lines are broken up
 
 #define CON_LINEWIDTH   100     // fixed width, do not need more
 
+typedef struct {
+    unsigned    start;      // offset of the first char in text ring
+    int         color;
+} conline_t;
+
 typedef enum {
     CHAT_NONE,
     CHAT_DEFAULT,
@@ -43,10 +55,14 @@ typedef enum {
 typedef struct console_s {
     qboolean    initialized;
 
-    char    text[CON_TOTALLINES][CON_LINEWIDTH];
-    int     current;        // line where next message will be printed
-    int     x;              // offset in current line for next print
-    int     display;        // bottom of console displays this line
+    char        text[CON_TEXTSIZE];
+    conline_t   lines[CON_MAXLINES];
+    unsigned    head;       // offset in text ring for next print
+    unsigned    first;      // oldest line still in scrollback
+    unsigned    current;    // line where next message will be printed
+    unsigned    display;    // bottom of console displays this line
+    int         displayrow; // number of wrapped rows of display line
+                            // hidden below the bottom
     int     color;
     int     newline;
 
@@ -73,6 +89,9 @@ typedef struct console_s {
     char *remotePassword;
 
     load_state_t loadstate;
+
+    char        findtext[MAX_STRING_CHARS];
+    unsigned    findline;   // line of the last match
 } console_t;
 
 static console_t    con;
@@ -91,6 +110,121 @@ static cvar_t   *con_history;
 
 // ============================================================================
 
+static inline conline_t *Con_Line(unsigned line)
+{
+    return &con.lines[line & CON_LINESMASK];
+}
+
+static size_t Con_LineLength(unsigned line)
+{
+    unsigned end;
+
+    if (line == con.current)
+        end = con.head;
+    else
+        end = Con_Line(line + 1)->start;
+
+    return end - Con_Line(line)->start;
+}
+
+// copies line text out of the ring, buffer must hold CON_MAXLINE + 1 chars
+static size_t Con_CopyLine(unsigned line, char *buffer)
+{
+    unsigned start = Con_Line(line)->start & CON_TEXTMASK;
+    size_t len = Con_LineLength(line);
+    size_t n = min(len, CON_TEXTSIZE - start);
+
+    memcpy(buffer, con.text + start, n);
+    memcpy(buffer + n, con.text, len - n);
+    buffer[len] = 0;
+
+    return len;
+}
+
+/*
+================
+Con_WrapLine
+
+Splits line text into rows of at most `width' chars, breaking before words
+that don't fit. Fills in row start offsets and returns number of rows.
+================
+*/
+static int Con_WrapLine(const char *text, int len, int width, int *rows)
+{
+    int i, x, l, numrows;
+
+    rows[0] = 0;
+    numrows = 1;
+
+    for (i = 0, x = 0; i < len; i++, x++) {
+        // word wrap
+        if (x && text[i] > 32 && text[i - 1] <= 32) {
+            for (l = 1; i + l < len && text[i + l] > 32; l++)
+                ;
+            if (l <= width && x + l > width) {
+                rows[numrows++] = i;
+                x = 0;
+                continue;
+            }
+        }
+
+        if (x == width) {
+            rows[numrows++] = i;
+            x = 0;
+        }
+    }
+
+    return numrows;
+}
+
+static int Con_WrapWidth(void)
+{
+    return max(con.linewidth - 1, 1);
+}
+
+static int Con_NumRows(unsigned line)
+{
+    char text[CON_MAXLINE + 1];
+    int rows[CON_MAXLINE + 1];
+    size_t len;
+
+    len = Con_CopyLine(line, text);
+    return Con_WrapLine(text, len, Con_WrapWidth(), rows);
+}
+
+/*
+================
+Con_Scroll
+
+Moves display position by the given number of wrapped rows,
+positive values scroll back.
+================
+*/
+static void Con_Scroll(int rows)
+{
+    int numrows = Con_NumRows(con.display);
+
+    con.displayrow = min(con.displayrow, numrows - 1) + rows;
+
+    while (con.displayrow >= numrows && con.display != con.first) {
+        con.displayrow -= numrows;
+        numrows = Con_NumRows(--con.display);
+    }
+
+    while (con.displayrow < 0 && con.display != con.current) {
+        numrows = Con_NumRows(++con.display);
+        con.displayrow += numrows;
+    }
+
+    clamp(con.displayrow, 0, numrows - 1);
+}
+
+static void Con_ScrollBottom(void)
+{
+    con.display = con.current;
+    con.displayrow = 0;
+}
+
 /*
 ================
 Con_SkipNotify
@@ -213,8 +347,9 @@ Con_Clear_f
 */
 static void Con_Clear_f(void)
 {
-    memset(con.text, 0, sizeof(con.text));
-    con.display = con.current;
+    con.head = Con_Line(con.current)->start;
+    con.first = con.current;
+    Con_ScrollBottom();
 }
 
 static void Con_Dump_c(genctx_t *ctx, int argnum)
@@ -233,9 +368,9 @@ Save the console contents out to a file
 */
 static void Con_Dump_f(void)
 {
-    int     l;
-    char    *line;
-    qhandle_t f;
+    unsigned    l;
+    char        line[CON_MAXLINE + 1];
+    qhandle_t   f;
     char    name[MAX_OSPATH];
 
     if (Cmd_Argc() != 2) {
@@ -250,16 +385,19 @@ static void Con_Dump_f(void)
     }
 
     // skip empty lines
-    for (l = con.current - CON_TOTALLINES + 1; l <= con.current; l++) {
-        if (con.text[l & CON_TOTALLINES_MASK][0]) {
+    for (l = con.first; l != con.current; l++) {
+        if (Con_LineLength(l)) {
             break;
         }
     }
 
     // write the remaining lines
-    for (; l <= con.current; l++) {
-        line = con.text[l & CON_TOTALLINES_MASK];
-        FS_FPrintf(f, "%s\n", line + 1);
+    while (1) {
+        Con_CopyLine(l, line);
+        FS_FPrintf(f, "%s\n", line);
+        if (l++ == con.current) {
+            break;
+        }
     }
 
     FS_FCloseFile(f);
@@ -281,6 +419,62 @@ void Con_ClearNotify_f(void)
         con.times[i] = 0;
 }
 
+/*
+================
+Con_Find_f
+
+Scrolls back to the previous line containing given text. Repeating the
+search continues from the last match.
+================
+*/
+static void Con_Find_f(void)
+{
+    char        text[CON_MAXLINE + 1];
+    char        *s;
+    unsigned    line;
+
+    if (Cmd_Argc() < 2) {
+        if (!con.findtext[0]) {
+            Com_Printf("Usage: %s <text>\n", Cmd_Argv(0));
+            return;
+        }
+        s = con.findtext;
+    } else {
+        s = Cmd_ArgsFrom(1);
+    }
+
+    if (s != con.findtext && strcmp(s, con.findtext)) {
+        Q_strlcpy(con.findtext, s, sizeof(con.findtext));
+        con.findline = con.display;
+        // skip the echoed command itself
+        if (con.findline == con.current && con.findline != con.first) {
+            con.findline--;
+        }
+    } else if (con.findline - con.first > con.current - con.first) {
+        con.findline = con.current;    // scrolled out of buffer
+    } else if (con.findline != con.first) {
+        con.findline--;
+    } else {
+        goto notfound;
+    }
+
+    for (line = con.findline; ; line--) {
+        Con_CopyLine(line, text);
+        if (Q_stristr(text, con.findtext)) {
+            con.findline = con.display = line;
+            con.displayrow = 0;
+            return;
+        }
+        if (line == con.first) {
+            break;
+        }
+    }
+
+    con.findline = con.first;
+notfound:
+    Com_Printf("No more matches for \"%s\".\n", con.findtext);
+}
+
 /*
 ================
 Con_MessageMode_f
@@ -390,13 +584,9 @@ Make sure at least one line is visible if console is backscrolled.
 */
 static void Con_CheckTop(void)
 {
-    int top = con.current - CON_TOTALLINES + 1;
-
-    if (top < 1) {
-        top = 1;
-    }
-    if (con.display < top) {
-        con.display = top;
+    if (con.display - con.first > con.current - con.first) {
+        con.display = con.first;
+        con.displayrow = 0;
     }
 }
 
@@ -424,6 +614,7 @@ static const cmdreg_t c_console[] = {
     { "clear", Con_Clear_f },
     { "clearnotify", Con_ClearNotify_f },
     { "condump", Con_Dump_f, Con_Dump_c },
+    { "confind", Con_Find_f },
 
     { NULL }
 };
@@ -468,8 +659,7 @@ void Con_Init(void)
     con.linewidth = -1;
     con.scale = 1;
     con.color = COLOR_NONE;
-    con.text[0][0] = COLOR_NONE;
-    con.x = 1;
+    con.lines[0].color = COLOR_NONE;
 
     Con_CheckResize();
 
@@ -498,14 +688,13 @@ void Con_Shutdown(void)
 
 static void Con_CarriageRet(void)
 {
-    char *p;
+    conline_t *line = Con_Line(con.current);
 
-    p = con.text[con.current & CON_TOTALLINES_MASK];
-    memset(p, 0, sizeof(con.text[0]));
+    // overwrite current line text
+    con.head = line->start;
 
     // add color from last line
-    con.x = 0;
-    p[con.x++] = con.color;
+    line->color = con.color;
 
     // update time for transparent overlay
     if (!con.skipNotify) {
@@ -515,19 +704,41 @@ static void Con_CarriageRet(void)
 
 static void Con_Linefeed(void)
 {
-    if (con.display == con.current)
+    if (con.display == con.current && !con.displayrow)
         con.display++;
     con.current++;
 
+    // drop the oldest line if index is full
+    if (con.current - con.first == CON_MAXLINES)
+        con.first++;
+
+    Con_Line(con.current)->start = con.head;
     Con_CarriageRet();
 
     if (con_scroll->integer & 2) {
-        con.display = con.current;
+        Con_ScrollBottom();
     } else {
         Con_CheckTop();
     }
 }
 
+// appends text to the current line, len must not exceed space left in line
+static void Con_AddText(const char *txt, size_t len)
+{
+    unsigned start = con.head & CON_TEXTMASK;
+    size_t n = min(len, CON_TEXTSIZE - start);
+
+    // drop the oldest lines if text ring is full
+    while (con.head + len - Con_Line(con.first)->start > CON_TEXTSIZE) {
+        con.first++;
+    }
+    Con_CheckTop();
+
+    memcpy(con.text + start, txt, n);
+    memcpy(con.text, txt + n, len - n);
+    con.head += len;
+}
+
 void Con_SetColor(color_index_t color)
 {
     con.color = color;
@@ -556,8 +767,8 @@ If no console is visible, the text will appear at the top of the game window
 */
 void Con_Print(const char *txt)
 {
-    char *p;
-    int l;
+    const char *p;
+    size_t len, space;
 
     if (!con.initialized)
         return;
@@ -572,31 +783,27 @@ void Con_Print(const char *txt)
             con.newline = 0;
         }
 
-        // count word length
-        for (p = (char *)txt; *p > 32; p++)
-            ;
-        l = p - txt;
-
-        // word wrap
-        if (l < con.linewidth && con.x + l > con.linewidth) {
-            Con_Linefeed();
+        if (*txt == '\r' || *txt == '\n') {
+            con.newline = *txt++;
+            continue;
         }
 
-        switch (*txt) {
-        case '\r':
-        case '\n':
-            con.newline = *txt;
-            break;
-        default:    // display character and advance
-            if (con.x == con.linewidth) {
+        // copy the whole run of text up to line end
+        for (p = txt; *p && *p != '\r' && *p != '\n'; p++)
+            ;
+        len = p - txt;
+
+        while (len) {
+            space = CON_MAXLINE - Con_LineLength(con.current);
+            if (!space) {
                 Con_Linefeed();
+                continue;
             }
-            p = con.text[con.current & CON_TOTALLINES_MASK];
-            p[con.x++] = *txt;
-            break;
+            space = min(space, len);
+            Con_AddText(txt, space);
+            txt += space;
+            len -= space;
         }
-
-        txt++;
     }
 }
 
@@ -662,10 +869,9 @@ DRAWING
 ==============================================================================
 */
 
-static int Con_DrawLine(int v, int line, float alpha)
+static int Con_DrawLine(int v, unsigned line, const char *text, int len, float alpha)
 {
-    char *p = con.text[line & CON_TOTALLINES_MASK];
-    color_index_t c = *p;
+    color_index_t c = Con_Line(line)->color;
     color_t color;
     int flags = 0;
 
@@ -688,8 +894,7 @@ static int Con_DrawLine(int v, int line, float alpha)
         break;
     }
 
-    return R_DrawString(CHAR_WIDTH, v, flags, con.linewidth - 1, p + 1,
-                        con.charsetImage);
+    return R_DrawString(CHAR_WIDTH, v, flags, len, text, con.charsetImage);
 }
 
 #define CON_PRESTEP     (CHAR_HEIGHT * 3 + CHAR_HEIGHT / 4)
@@ -705,7 +910,10 @@ static void Con_DrawNotify(void)
 {
     int     v;
     char    *text;
-    int     i, j;
+    char    buffer[CON_MAXLINE + 1];
+    int     rows[CON_MAXLINE + 2];
+    unsigned    i;
+    int     j, k, len, numrows;
     unsigned    time;
     int     skip;
     float   alpha;
@@ -726,10 +934,12 @@ static void Con_DrawNotify(void)
         j = CON_TIMES;
     }
 
+    if (j > (int)(con.current - con.first + 1)) {
+        j = con.current - con.first + 1;
+    }
+
     v = 0;
-    for (i = con.current - j + 1; i <= con.current; i++) {
-        if (i < 0)
-            continue;
+    for (i = con.current - j + 1; i - con.first <= con.current - con.first; i++) {
         time = con.times[i & CON_TIMES_MASK];
         if (time == 0)
             continue;
@@ -741,9 +951,13 @@ static void Con_DrawNotify(void)
             alpha = 1;  // don't fade
         }
 
-        Con_DrawLine(v, i, alpha);
-
-        v += CHAR_HEIGHT;
+        len = Con_CopyLine(i, buffer);
+        numrows = Con_WrapLine(buffer, len, Con_WrapWidth(), rows);
+        rows[numrows] = len;
+        for (k = 0; k < numrows; k++) {
+            Con_DrawLine(v, i, buffer + rows[k], rows[k + 1] - rows[k], alpha);
+            v += CHAR_HEIGHT;
+        }
     }
 
     R_ClearColor();
@@ -774,11 +988,14 @@ Draws the console with the solid background
 */
 static void Con_DrawSolidConsole(void)
 {
-    int             i, x, y;
+    int             i, j, x, y;
     int             rows;
-    char            *text;
+    const char      *text;
     int             row;
-    char            buffer[CON_LINEWIDTH];
+    unsigned        line;
+    char            buffer[CON_MAXLINE + 1];
+    int             starts[CON_MAXLINE + 2];
+    int             len, numrows, skip;
     int             vislines;
     float           alpha;
     int             widths[2];
@@ -807,7 +1024,7 @@ static void Con_DrawSolidConsole(void)
     rows = y / CHAR_HEIGHT + 1;     // rows of text to draw
 
 // draw arrows to show the buffer is backscrolled
-    if (con.display != con.current) {
+    if (con.display != con.current || con.displayrow) {
         R_SetColor(U32_RED);
         for (i = 1; i < con.linewidth / 2; i += 4) {
             R_DrawChar(i * CHAR_WIDTH, y, 0, '^', con.charsetImage);
@@ -817,23 +1034,28 @@ static void Con_DrawSolidConsole(void)
         rows--;
     }
 
-// draw from the bottom up
+// draw from the bottom up, wrapping only visible lines
     R_ClearColor();
-    row = con.display;
+    line = con.display;
+    skip = con.displayrow;
     widths[0] = widths[1] = 0;
-    for (i = 0; i < rows; i++) {
-        if (row < 0)
-            break;
-        if (con.current - row > CON_TOTALLINES - 1)
-            break;      // past scrollback wrap point
+    for (i = 0; i < rows; line--) {
+        len = Con_CopyLine(line, buffer);
+        numrows = Con_WrapLine(buffer, len, Con_WrapWidth(), starts);
+        starts[numrows] = len;
+
+        for (j = numrows - 1 - min(skip, numrows - 1); j >= 0 && i < rows; j--, i++) {
+            x = Con_DrawLine(y, line, buffer + starts[j], starts[j + 1] - starts[j], 1);
+            if (i < 2) {
+                widths[i] = x;
+            }
 
-        x = Con_DrawLine(y, row, 1);
-        if (i < 2) {
-            widths[i] = x;
+            y -= CHAR_HEIGHT;
         }
 
-        y -= CHAR_HEIGHT;
-        row--;
+        if (line == con.first)
+            break;      // past scrollback wrap point
+        skip = 0;
     }
 
     R_ClearColor();
@@ -1184,34 +1406,31 @@ void Key_Console(int key)
 
     if (key == K_PGUP || key == K_MWHEELUP) {
         if (Key_IsDown(K_CTRL)) {
-            con.display -= 6;
+            Con_Scroll(6);
         } else {
-            con.display -= 2;
+            Con_Scroll(2);
         }
-        Con_CheckTop();
         return;
     }
 
     if (key == K_PGDN || key == K_MWHEELDOWN) {
         if (Key_IsDown(K_CTRL)) {
-            con.display += 6;
+            Con_Scroll(-6);
         } else {
-            con.display += 2;
-        }
-        if (con.display > con.current) {
-            con.display = con.current;
+            Con_Scroll(-2);
         }
         return;
     }
 
     if (key == K_HOME && Key_IsDown(K_CTRL)) {
-        con.display = 1;
-        Con_CheckTop();
+        con.display = con.first;
+        con.displayrow = CON_MAXLINE;
+        Con_Scroll(0);
         return;
     }
 
     if (key == K_END && Key_IsDown(K_CTRL)) {
-        con.display = con.current;
+        Con_ScrollBottom();
         return;
     }
 
@@ -1222,7 +1441,7 @@ void Key_Console(int key)
 
 scroll:
     if (con_scroll->integer & 1) {
-        con.display = con.current;
+        Con_ScrollBottom();
     }
 }
 
@@ -320,7 +320,7 @@ static void CL_Record_f(void)
     size_t  len;
     entity_state_t  *ent;
     entity_packed_t pack;
-    char            *s;
+    const char      *s;
     qhandle_t       f;
     unsigned        mode = FS_MODE_WRITE;
     size_t          size = Cvar_ClampInteger(
@@ -405,7 +405,7 @@ static void CL_Record_f(void)
 
     // configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        s = cl.configstrings[i];
+        s = Com_ConfigstringSlot(cl.configstrings, i);
         if (!*s)
             continue;
 
@@ -455,7 +455,7 @@ static void resume_record(void)
 {
     int i, j, index;
     size_t len;
-    char *s;
+    const char *s;
 
     // write dirty configstrings
     for (i = 0; i < CS_BITMAP_LONGS; i++) {
@@ -467,7 +467,7 @@ static void resume_record(void)
             if (!Q_IsBitSet(cl.dcs, index))
                 continue;
 
-            s = cl.configstrings[index];
+            s = Com_ConfigstringSlot(cl.configstrings, index);
 
             len = strlen(s);
             if (len > MAX_QPATH)
@@ -685,6 +685,8 @@ static int parse_next_message(int wait)
     return 0;
 }
 
+static qboolean demo_index_pending;
+
 /*
 ====================
 CL_PlayDemo_f
@@ -714,6 +716,12 @@ static void CL_PlayDemo_f(void)
         return;
     }
 
+    if (type == 1 && demo_index_pending) {
+        Com_Printf("Indexing of MVD demos is not supported.\n");
+        FS_FCloseFile(f);
+        return;
+    }
+
     if (type == 1) {
 #if USE_MVD_CLIENT
         Cbuf_InsertText(&cmd_buffer, va("mvdplay --replace @@ \"/%s\"\n", name));
@@ -730,6 +738,8 @@ static void CL_PlayDemo_f(void)
     CL_Disconnect(ERR_RECONNECT);
 
     cls.demo.playback = f;
+    cls.demo.indexing = demo_index_pending;
+    Q_strlcpy(cls.demo.path, name, sizeof(cls.demo.path));
     cls.state = ca_connected;
     Q_strlcpy(cls.servername, COM_SkipPath(name), sizeof(cls.servername));
     cls.serverAddress.type = NA_LOOPBACK;
@@ -747,6 +757,21 @@ static void CL_PlayDemo_f(void)
     }
 }
 
+/*
+====================
+CL_DemoIndex_f
+
+Loads the demo without playing it and writes snapshots for the entire demo
+into index file.
+====================
+*/
+static void CL_DemoIndex_f(void)
+{
+    demo_index_pending = qtrue;
+    CL_PlayDemo_f();
+    demo_index_pending = qfalse;
+}
+
 static void CL_Demo_c(genctx_t *ctx, int argnum)
 {
     if (argnum == 1) {
@@ -754,14 +779,51 @@ static void CL_Demo_c(genctx_t *ctx, int argnum)
     }
 }
 
-typedef struct {
-    list_t entry;
+typedef struct demosnap_s {
     int framenum;
     off_t filepos;
     size_t msglen;
     byte data[1];
 } demosnap_t;
 
+#define DEMO_INDEX_MAGIC    MakeRawLong('D','I','D','X')
+#define DEMO_INDEX_VERSION  1
+
+static demosnap_t *alloc_snapshot(int framenum, off_t filepos, size_t msglen)
+{
+    demosnap_t *snap;
+
+    snap = Z_Malloc(sizeof(*snap) + msglen - 1);
+    snap->framenum = framenum;
+    snap->filepos = filepos;
+    snap->msglen = msglen;
+
+    if (!(cls.demo.numsnapshots & 63)) {
+        cls.demo.snapshots = Z_Realloc(cls.demo.snapshots,
+            sizeof(cls.demo.snapshots[0]) * (cls.demo.numsnapshots + 64));
+    }
+    cls.demo.snapshots[cls.demo.numsnapshots++] = snap;
+
+    return snap;
+}
+
+static size_t free_snapshots(void)
+{
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < cls.demo.numsnapshots; i++) {
+        total += cls.demo.snapshots[i]->msglen;
+        Z_Free(cls.demo.snapshots[i]);
+    }
+
+    Z_Free(cls.demo.snapshots);
+    cls.demo.snapshots = NULL;
+    cls.demo.numsnapshots = 0;
+
+    return total;
+}
+
 /*
 ====================
 CL_EmitDemoSnapshot
@@ -774,15 +836,20 @@ void CL_EmitDemoSnapshot(void)
 {
     demosnap_t *snap;
     off_t pos;
-    char *from, *to;
+    const char *to;
     size_t len;
     server_frame_t *lastframe, *frame;
     int i, j, lastnum;
 
-    if (cl_demosnaps->integer <= 0)
-        return;
+    int interval = cl_demosnaps->integer;
+
+    if (interval <= 0) {
+        if (!cls.demo.indexing)
+            return;
+        interval = 10;
+    }
 
-    if (cls.demo.frames_read < cls.demo.last_snapshot + cl_demosnaps->integer * 10)
+    if (cls.demo.frames_read < cls.demo.last_snapshot + interval * 10)
         return;
 
     if (!cl.frame.valid)
@@ -814,15 +881,11 @@ void CL_EmitDemoSnapshot(void)
 
     // write configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        from = cl.baseconfigstrings[i];
-        to = cl.configstrings[i];
-
-        if (!strcmp(from, to))
+        if (cl.baseconfigstrings[i] == cl.configstrings[i])
             continue;
 
+        to = Com_ConfigstringSlot(cl.configstrings, i);
         len = strlen(to);
-        if (len > MAX_QPATH)
-            len = MAX_QPATH;
 
         MSG_WriteByte(svc_configstring);
         MSG_WriteShort(i);
@@ -834,12 +897,8 @@ void CL_EmitDemoSnapshot(void)
     MSG_WriteByte(svc_layout);
     MSG_WriteString(cl.layout);
 
-    snap = Z_Malloc(sizeof(*snap) + msg_write.cursize - 1);
-    snap->framenum = cls.demo.frames_read;
-    snap->filepos = pos;
-    snap->msglen = msg_write.cursize;
+    snap = alloc_snapshot(cls.demo.frames_read, pos, msg_write.cursize);
     memcpy(snap->data, msg_write.data, msg_write.cursize);
-    List_Append(&cls.demo.snapshots, &snap->entry);
 
     Com_DPrintf("[%d] snaplen %"PRIz"\n", cls.demo.frames_read, msg_write.cursize);
 
@@ -848,22 +907,178 @@ void CL_EmitDemoSnapshot(void)
     cls.demo.last_snapshot = cls.demo.frames_read;
 }
 
+// returns the last snapshot at or before the given frame, or the first one
 static demosnap_t *find_snapshot(int framenum)
 {
-    demosnap_t *snap, *prev;
+    int lo, hi, mid;
 
-    if (LIST_EMPTY(&cls.demo.snapshots))
+    if (!cls.demo.numsnapshots)
         return NULL;
 
-    prev = LIST_FIRST(demosnap_t, &cls.demo.snapshots, entry);
+    lo = 0;
+    hi = cls.demo.numsnapshots - 1;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (cls.demo.snapshots[mid]->framenum > framenum)
+            hi = mid - 1;
+        else
+            lo = mid;
+    }
 
-    LIST_FOR_EACH(demosnap_t, snap, &cls.demo.snapshots, entry) {
-        if (snap->framenum > framenum)
-            break;
-        prev = snap;
+    return cls.demo.snapshots[lo];
+}
+
+/*
+====================
+Demo index
+
+Snapshots can be saved into a sidecar file next to the demo, so that seeking
+into parts of the demo that were not played yet costs one snapshot parse
+instead of parsing everything in between. The index is only used if the
+demo file size and offset of the first frame still match.
+====================
+*/
+
+static void get_index_path(char *buffer, size_t size)
+{
+    Q_concat(buffer, size, cls.demo.path, ".idx", NULL);
+}
+
+static qboolean read_index_long(qhandle_t f, uint32_t *v)
+{
+    if (FS_Read(v, 4, f) != 4)
+        return qfalse;
+
+    *v = LittleLong(*v);
+    return qtrue;
+}
+
+static void load_demo_index(void)
+{
+    char path[MAX_OSPATH + 4];
+    uint32_t header[5], framenum, filepos, msglen;
+    demosnap_t *snap;
+    qhandle_t f;
+    int i, last;
+
+    get_index_path(path, sizeof(path));
+    FS_FOpenFile(path, &f, FS_MODE_READ);
+    if (!f)
+        return;
+
+    for (i = 0; i < 5; i++) {
+        if (!read_index_long(f, &header[i]))
+            goto fail;
+    }
+
+    if (header[0] != LittleLong(DEMO_INDEX_MAGIC) || header[1] != DEMO_INDEX_VERSION)
+        goto fail;
+
+    if (header[2] != cls.demo.file_size || header[3] != cls.demo.file_offset) {
+        Com_DPrintf("%s doesn't match demo, ignored\n", path);
+        goto done;
+    }
+
+    last = INT_MIN;
+    for (i = 0; i < header[4]; i++) {
+        if (!read_index_long(f, &framenum) ||
+            !read_index_long(f, &filepos) ||
+            !read_index_long(f, &msglen))
+            goto fail;
+
+        if ((int)framenum <= last || msglen > MAX_MSGLEN ||
+            filepos < cls.demo.file_offset ||
+            filepos > cls.demo.file_offset + cls.demo.file_size)
+            goto fail;
+
+        snap = alloc_snapshot(framenum, filepos, msglen);
+        if (FS_Read(snap->data, msglen, f) != msglen)
+            goto fail;
+
+        last = framenum;
+    }
+
+    // don't emit snapshots already covered by index
+    if (cls.demo.numsnapshots)
+        cls.demo.last_snapshot = last;
+
+    Com_DPrintf("Loaded %d snapshots from %s\n", cls.demo.numsnapshots, path);
+    goto done;
+
+fail:
+    Com_WPrintf("%s is corrupted, ignored\n", path);
+    free_snapshots();
+done:
+    FS_FCloseFile(f);
+}
+
+static qboolean write_index_long(qhandle_t f, uint32_t v)
+{
+    v = LittleLong(v);
+    return FS_Write(&v, 4, f) == 4;
+}
+
+static qboolean write_demo_index(void)
+{
+    char path[MAX_OSPATH + 4];
+    demosnap_t *snap;
+    qhandle_t f;
+    qboolean ok;
+    int i;
+
+    get_index_path(path, sizeof(path));
+    FS_FOpenFile(path, &f, FS_MODE_WRITE);
+    if (!f) {
+        Com_EPrintf("Couldn't open %s for writing\n", path);
+        return qfalse;
+    }
+
+    ok = write_index_long(f, DEMO_INDEX_MAGIC) &&
+         write_index_long(f, DEMO_INDEX_VERSION) &&
+         write_index_long(f, cls.demo.file_size) &&
+         write_index_long(f, cls.demo.file_offset) &&
+         write_index_long(f, cls.demo.numsnapshots);
+
+    for (i = 0; ok && i < cls.demo.numsnapshots; i++) {
+        snap = cls.demo.snapshots[i];
+        ok = write_index_long(f, snap->framenum) &&
+             write_index_long(f, snap->filepos) &&
+             write_index_long(f, snap->msglen) &&
+             FS_Write(snap->data, snap->msglen, f) == snap->msglen;
+    }
+
+    FS_FCloseFile(f);
+
+    if (!ok) {
+        Com_EPrintf("Couldn't write %s\n", path);
+        return qfalse;
+    }
+
+    Com_Printf("Wrote %s (%d snapshots, %d frames).\n", path,
+               cls.demo.numsnapshots, cls.demo.frames_read);
+    return qtrue;
+}
+
+// reads the entire demo in seek mode, then saves all snapshots
+static void build_demo_index(void)
+{
+    int ret;
+
+    cls.demo.seeking = qtrue;
+
+    while ((ret = read_next_message(cls.demo.playback)) > 0) {
+        CL_SeekDemoMessage();
+        CL_EmitDemoSnapshot();
     }
 
-    return prev;
+    cls.demo.seeking = qfalse;
+
+    if (ret == 0)
+        write_demo_index();
+    else
+        Com_EPrintf("Couldn't read %s: %s\n", cls.demo.path, Q_ErrorString(ret));
+
+    CL_Disconnect(ERR_RECONNECT);
 }
 
 /*
@@ -880,7 +1095,7 @@ void CL_FirstDemoFrame(void)
     Com_DPrintf("[%d] first frame\n", cl.frame.number);
 
     // save base configstrings
-    memcpy(cl.baseconfigstrings, cl.configstrings, sizeof(cl.baseconfigstrings));
+    Com_CopyConfigstrings(cl.baseconfigstrings, cl.configstrings);
 
     // obtain file length and offset of the second frame
     len = FS_Length(cls.demo.playback);
@@ -894,17 +1109,24 @@ void CL_FirstDemoFrame(void)
     if (com_timedemo->integer) {
         cls.demo.time_frames = 0;
         cls.demo.time_start = Sys_Milliseconds();
+        cls.demo.timing = qtrue;
+        memset(cls.demo.time_usec, 0, sizeof(cls.demo.time_usec));
+        Z_GetAllocStats(&cls.demo.time_allocs, &cls.demo.time_bytes);
     }
 
     // force initial snapshot
     cls.demo.last_snapshot = INT_MIN;
+
+    if (cls.demo.file_size && !cls.demo.indexing)
+        load_demo_index();
 }
 
 static void CL_Seek_f(void)
 {
     demosnap_t *snap;
     int i, j, ret, index, frames, dest, prev;
-    char *from, *to;
+    const char *from;
+    char *to;
 
     if (Cmd_Argc() < 2) {
         Com_Printf("Usage: %s [+-]<timespec>\n", Cmd_Argv(0));
@@ -965,9 +1187,12 @@ static void CL_Seek_f(void)
 
     Com_DPrintf("[%d] seeking to %d\n", cls.demo.frames_read, dest);
 
-    // seek to the previous most recent snapshot
+    // seek to the previous most recent snapshot, unless current position
+    // is already closer to destination
     if (frames < 0 || cls.demo.last_snapshot > cls.demo.frames_read) {
         snap = find_snapshot(dest);
+        if (snap && frames > 0 && snap->framenum <= cls.demo.frames_read)
+            snap = NULL;
 
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->framenum);
@@ -983,13 +1208,12 @@ static void CL_Seek_f(void)
             // reset configstrings
             for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
                 from = cl.baseconfigstrings[i];
-                to = cl.configstrings[i];
-
-                if (!strcmp(from, to))
+                if (from == cl.configstrings[i])
                     continue;
 
                 Q_SetBit(cl.dcs, i);
-                strcpy(to, from);
+                Z_ReleaseString(cl.configstrings[i]);
+                cl.configstrings[i] = Z_RetainString(from);
             }
 
             SZ_Init(&msg_read, snap->data, snap->msglen);
@@ -1176,9 +1400,32 @@ fail:
 
 // =========================================================================
 
+static void print_timedemo_stats(float sec)
+{
+    static const char names[TD_MAX][12] = {
+        "parse", " delta", "predict", "screen", " entities", " tents",
+        " particles", " refresh", "sound"
+    };
+    size_t allocs, bytes;
+    float frames = cls.demo.time_frames;
+    int i;
+
+    Com_Printf("subsystem    ms/frame      %%\n");
+    for (i = 0; i < TD_MAX; i++) {
+        float ms = cls.demo.time_usec[i] * 0.001f;
+        Com_Printf("%-12s %8.4f %6.2f\n", names[i],
+                   ms / frames, ms * 0.1f / sec);
+    }
+
+    Z_GetAllocStats(&allocs, &bytes);
+    allocs -= cls.demo.time_allocs;
+    bytes -= cls.demo.time_bytes;
+    Com_Printf("%"PRIz" allocations, %"PRIz" bytes: %.2f allocations/frame\n",
+               allocs, bytes, allocs / frames);
+}
+
 void CL_CleanupDemos(void)
 {
-    demosnap_t *snap, *next;
     size_t total;
 
     if (cls.demo.recording) {
@@ -1197,22 +1444,16 @@ void CL_CleanupDemos(void)
 
                 Com_Printf("%u frames, %3.1f seconds: %f fps\n",
                            cls.demo.time_frames, sec, fps);
+                print_timedemo_stats(sec);
             }
         }
     }
 
-    total = 0;
-    LIST_FOR_EACH_SAFE(demosnap_t, snap, next, &cls.demo.snapshots, entry) {
-        total += snap->msglen;
-        Z_Free(snap);
-    }
-
+    total = free_snapshots();
     if (total)
         Com_DPrintf("Freed %"PRIz" bytes of snaps\n", total);
 
     memset(&cls.demo, 0, sizeof(cls.demo));
-
-    List_Init(&cls.demo.snapshots);
 }
 
 /*
@@ -1231,6 +1472,11 @@ void CL_DemoFrame(int msec)
         return;
     }
 
+    if (cls.demo.indexing) {
+        build_demo_index();
+        return;
+    }
+
     if (com_timedemo->integer) {
         parse_next_message(0);
         cl.time = cl.servertime;
@@ -1261,6 +1507,7 @@ static const cmdreg_t c_demo[] = {
     { "stop", CL_Stop_f },
     { "suspend", CL_Suspend_f },
     { "seek", CL_Seek_f },
+    { "demoindex", CL_DemoIndex_f, CL_Demo_c },
 
     { NULL }
 };
@@ -1277,7 +1524,6 @@ void CL_InitDemos(void)
     cl_demowait = Cvar_Get("cl_demowait", "0", 0);
 
     Cmd_Register(c_demo);
-    List_Init(&cls.demo.snapshots);
 }
 
 
@@ -665,7 +665,8 @@ done:
 
 static void check_player(const char *name)
 {
-    char fn[MAX_QPATH], model[MAX_QPATH], skin[MAX_QPATH], *p;
+    char fn[MAX_QPATH], model[MAX_QPATH], skin[MAX_QPATH];
+    const char *p;
     size_t len;
     int i, j;
 
@@ -734,7 +735,8 @@ Runs precache check and dispatches downloads.
 */
 void CL_RequestNextDownload(void)
 {
-    char fn[MAX_QPATH], *name;
+    char fn[MAX_QPATH];
+    const char *name;
     size_t len;
     int i;
 
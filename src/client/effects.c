@@ -20,6 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "client.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 static void CL_LogoutEffect(vec3_t org, int type);
 
 static vec3_t avelocities[NUMVERTEXNORMALS];
@@ -831,13 +835,32 @@ void CL_MuzzleFlash2(void)
 
 PARTICLE MANAGEMENT
 
+Effects fill in cparticle_t structures from a staging buffer. Staged
+particles are moved into a structure of arrays pool when the frame is
+built, and the pool is kept in order of allocation so that particles are
+drawn newest first, same as with the old linked list.
+
 ==============================================================
 */
 
-static cparticle_t  *active_particles, *free_particles;
-
-static cparticle_t  particles[MAX_PARTICLES];
-static const int    cl_numparticles = MAX_PARTICLES;
+typedef struct {
+    float   time[MAX_PARTICLES];
+    float   org[3][MAX_PARTICLES];
+    float   vel[3][MAX_PARTICLES];
+    float   accel[3][MAX_PARTICLES];
+    float   alpha[MAX_PARTICLES];
+    float   alphavel[MAX_PARTICLES];
+    int     color[MAX_PARTICLES];
+    color_t rgba[MAX_PARTICLES];
+    float   brightness[MAX_PARTICLES];
+    byte    keep[MAX_PARTICLES];
+    int     numparticles;
+} particlepool_t;
+
+static particlepool_t   pool;
+
+static cparticle_t  staged_particles[MAX_PARTICLES];
+static int          num_staged;
 
 extern uint32_t d_8to24table[256];
 
@@ -852,28 +875,16 @@ void FX_Init(void)
 
 static void CL_ClearParticles(void)
 {
-    int     i;
-
-    free_particles = &particles[0];
-    active_particles = NULL;
-
-    for (i = 0; i < cl_numparticles; i++)
-        particles[i].next = &particles[i + 1];
-    particles[cl_numparticles - 1].next = NULL;
+    pool.numparticles = 0;
+    num_staged = 0;
 }
 
 cparticle_t *CL_AllocParticle(void)
 {
-    cparticle_t *p;
-
-    if (!free_particles)
+    if (pool.numparticles + num_staged >= MAX_PARTICLES)
         return NULL;
-    p = free_particles;
-    free_particles = p->next;
-    p->next = active_particles;
-    active_particles = p;
 
-    return p;
+    return &staged_particles[num_staged++];
 }
 
 /*
@@ -1990,80 +2001,239 @@ void CL_TeleportParticles(vec3_t org)
 extern int          r_numparticles;
 extern particle_t   r_particles[MAX_PARTICLES];
 
+// moves particles spawned since the last frame into the pool
+static void CL_CommitParticles(void)
+{
+    cparticle_t *p;
+    int         i, j, n;
+
+    for (i = 0, n = pool.numparticles; i < num_staged; i++, n++) {
+        p = &staged_particles[i];
+        pool.time[n] = p->time;
+        for (j = 0; j < 3; j++) {
+            pool.org[j][n] = p->org[j];
+            pool.vel[j][n] = p->vel[j];
+            pool.accel[j][n] = p->accel[j];
+        }
+        pool.alpha[n] = p->alpha;
+        pool.alphavel[n] = p->alphavel;
+        pool.color[n] = p->color;
+        pool.rgba[n] = p->rgba;
+        pool.brightness[n] = p->brightness;
+    }
+
+    pool.numparticles = n;
+    num_staged = 0;
+}
+
+// removes particles that were not kept, starting from index first,
+// without changing the order of the remaining ones
+static void CL_CompactParticles(int first)
+{
+    int i, j, n;
+
+    for (i = first, n = 0; i < pool.numparticles; i++) {
+        if (!pool.keep[i])
+            continue;
+        if (i != n) {
+            pool.time[n] = pool.time[i];
+            for (j = 0; j < 3; j++) {
+                pool.org[j][n] = pool.org[j][i];
+                pool.vel[j][n] = pool.vel[j][i];
+                pool.accel[j][n] = pool.accel[j][i];
+            }
+            pool.alpha[n] = pool.alpha[i];
+            pool.alphavel[n] = pool.alphavel[i];
+            pool.color[n] = pool.color[i];
+            pool.rgba[n] = pool.rgba[i];
+            pool.brightness[n] = pool.brightness[i];
+        }
+        n++;
+    }
+
+    pool.numparticles = n;
+}
+
+// evaluates particles [i, i + 4) at the current time, returns mask of
+// particles that haven't faded out yet. MAX_PARTICLES is a multiple of 4,
+// so the last group never reads past the end of the pool.
+static int CL_EvalParticles(int i, float *alpha, float (*origin)[4])
+{
+#if USE_SSE2
+    const __m128d   scale = _mm_set1_pd(0.001);
+    __m128          d, t, t2, a, av, instant, alive, o;
+    int             j;
+
+    // scale in double precision, same as the scalar version
+    d = _mm_sub_ps(_mm_set1_ps(cl.time), _mm_loadu_ps(&pool.time[i]));
+    t = _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(d), scale)),
+                      _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(d, d)), scale)));
+
+    // instant particles don't move or fade
+    av = _mm_loadu_ps(&pool.alphavel[i]);
+    instant = _mm_cmpeq_ps(av, _mm_set1_ps(INSTANT_PARTICLE));
+    t = _mm_andnot_ps(instant, t);
+
+    a = _mm_add_ps(_mm_loadu_ps(&pool.alpha[i]), _mm_mul_ps(t, av));
+    alive = _mm_or_ps(instant, _mm_cmpnle_ps(a, _mm_setzero_ps()));
+    _mm_storeu_ps(alpha, a);
+
+    t2 = _mm_mul_ps(t, t);
+    for (j = 0; j < 3; j++) {
+        o = _mm_add_ps(_mm_loadu_ps(&pool.org[j][i]),
+                       _mm_mul_ps(_mm_loadu_ps(&pool.vel[j][i]), t));
+        o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(&pool.accel[j][i]), t2));
+        _mm_storeu_ps(origin[j], o);
+    }
+
+    return _mm_movemask_ps(alive);
+#else
+    float   time, time2;
+    int     j, k, mask = 0;
+
+    for (j = 0; j < 4; j++) {
+        k = i + j;
+
+        if (pool.alphavel[k] != INSTANT_PARTICLE) {
+            time = (cl.time - pool.time[k]) * 0.001;
+            alpha[j] = pool.alpha[k] + time * pool.alphavel[k];
+            if (!(alpha[j] <= 0))
+                mask |= 1 << j;
+        } else {
+            time = 0;
+            alpha[j] = pool.alpha[k];
+            mask |= 1 << j;
+        }
+
+        time2 = time * time;
+
+        origin[0][j] = pool.org[0][k] + pool.vel[0][k] * time + pool.accel[0][k] * time2;
+        origin[1][j] = pool.org[1][k] + pool.vel[1][k] * time + pool.accel[1][k] * time2;
+        origin[2][j] = pool.org[2][k] + pool.vel[2][k] * time + pool.accel[2][k] * time2;
+    }
+
+    return mask;
+#endif
+}
+
+static void CL_EmitParticle(int k, float alpha, float (*origin)[4], int j)
+{
+    particle_t  *part = &r_particles[r_numparticles++];
+
+    if (alpha > 1.0)
+        alpha = 1;
+
+    part->origin[0] = origin[0][j];
+    part->origin[1] = origin[1][j];
+    part->origin[2] = origin[2][j];
+
+    part->color = pool.color[k];
+    if (part->color == -1) {
+        part->rgba.u8[0] = pool.rgba[k].u8[0];
+        part->rgba.u8[1] = pool.rgba[k].u8[1];
+        part->rgba.u8[2] = pool.rgba[k].u8[2];
+        part->rgba.u8[3] = pool.rgba[k].u8[3] * alpha;
+    }
+
+    part->brightness = pool.brightness[k];
+    part->alpha = alpha;
+    part->radius = 0.f;
+
+    // instant particles are drawn only once
+    if (pool.alphavel[k] == INSTANT_PARTICLE) {
+        pool.alphavel[k] = 0.0;
+        pool.alpha[k] = 0.0;
+    }
+}
+
 /*
 ===============
 CL_AddParticles
+
+Goes from the newest particle to the oldest one. If the renderer runs out
+of room, the oldest particles are dropped.
 ===============
 */
 void CL_AddParticles(void)
 {
-    cparticle_t     *p, *next;
-    float           alpha;
-    float           time = 0, time2;
-    int             color;
-    cparticle_t     *active, *tail;
-    particle_t      *part;
-
-    active = NULL;
-    tail = NULL;
-
-    for (p = active_particles; p; p = next) {
-        next = p->next;
-
-        if (p->alphavel != INSTANT_PARTICLE) {
-            time = (cl.time - p->time) * 0.001;
-            alpha = p->alpha + time * p->alphavel;
-            if (alpha <= 0) {
-                // faded out
-                p->next = free_particles;
-                free_particles = p;
-                continue;
-            }
-        } else {
-            alpha = p->alpha;
-        }
+    float   alpha[4], origin[3][4];
+    int     i, j, k, n, mask;
+
+    CL_CommitParticles();
 
+    for (i = (pool.numparticles - 1) & ~3; i >= 0; i -= 4) {
         if (r_numparticles >= MAX_PARTICLES)
             break;
-        part = &r_particles[r_numparticles++];
-
-        p->next = NULL;
-        if (!tail)
-            active = tail = p;
-        else {
-            tail->next = p;
-            tail = p;
+
+        mask = CL_EvalParticles(i, alpha, origin);
+        n = min(pool.numparticles - i, 4);
+
+        for (j = n - 1; j >= 0; j--) {
+            k = i + j;
+            pool.keep[k] = 0;
+            if (!(mask & (1 << j)))
+                continue;   // faded out
+            if (r_numparticles >= MAX_PARTICLES)
+                continue;
+            CL_EmitParticle(k, alpha[j], origin, j);
+            pool.keep[k] = 1;
         }
+    }
 
-        if (alpha > 1.0)
-            alpha = 1;
-        color = p->color;
+    CL_CompactParticles(i + 4);
+}
 
-        time2 = time * time;
+/*
+===============
+CL_TimeParticles_f
 
-        part->origin[0] = p->org[0] + p->vel[0] * time + p->accel[0] * time2;
-        part->origin[1] = p->org[1] + p->vel[1] * time + p->accel[1] * time2;
-        part->origin[2] = p->org[2] + p->vel[2] * time + p->accel[2] * time2;
+Fills the pool with explosion storms every frame and times building of
+the particle list.
+===============
+*/
+void CL_TimeParticles_f(void)
+{
+    static void (*const storms[])(vec3_t) = {
+        CL_BFGExplosionParticles,
+        CL_ExplosionParticles,
+        CL_BigTeleportParticles,
+    };
+    int         i, j, frames, saved_time;
+    uint64_t    start, total = 0;
+    uint64_t    count = 0;
+    vec3_t      org;
+
+    frames = 128;
+    if (Cmd_Argc() > 1) {
+        frames = atoi(Cmd_Argv(1));
+        clamp(frames, 1, 100000);
+    }
 
-        if (color == -1) {
-            part->rgba.u8[0] = p->rgba.u8[0];
-            part->rgba.u8[1] = p->rgba.u8[1];
-            part->rgba.u8[2] = p->rgba.u8[2];
-            part->rgba.u8[3] = p->rgba.u8[3] * alpha;
-        }
+    saved_time = cl.time;
+    VectorCopy(cl.refdef.vieworg, org);
+    CL_ClearParticles();
 
-        part->color = color;
-		part->brightness = p->brightness;
-		part->alpha = alpha;
-		part->radius = 0.f;
+    for (i = 0; i < frames; i++) {
+        cl.time += 16;
 
-        if (p->alphavel == INSTANT_PARTICLE) {
-            p->alphavel = 0.0;
-            p->alpha = 0.0;
-        }
+        // top the pool up, limit the number of tries in case
+        // cl_particle_num_factor is 0
+        for (j = 0; j < 256 && pool.numparticles + num_staged < MAX_PARTICLES; j++)
+            storms[j % q_countof(storms)](org);
+
+        r_numparticles = 0;
+        start = Sys_Microseconds();
+        CL_AddParticles();
+        total += Sys_Microseconds() - start;
+        count += r_numparticles;
     }
-	
-    active_particles = active;
+
+    r_numparticles = 0;
+    cl.time = saved_time;
+    CL_ClearParticles();
+
+    Com_Printf("%d frames, %"PRIu64" particles per frame, %.3f ms per frame\n",
+               frames, count / frames, total * 0.001 / frames);
 }
 
 
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "client.h"
 #include "refresh/models.h"
+#include "common/tasks.h"
 
 extern qhandle_t cl_mod_powerscreen;
 extern qhandle_t cl_mod_laser;
@@ -394,6 +395,8 @@ void CL_DeltaFrame(void)
         entity_event(state->number);
     }
 
+    CL_SortSolidEntities();
+
     if (cls.demo.recording && !cls.demo.paused && !cls.demo.seeking && CL_FRAMESYNC) {
         CL_EmitDemoFrame();
     }
@@ -502,6 +505,190 @@ static int adjust_shell_fx(int renderfx)
 	return renderfx;
 }
 
+/*
+==========================================================================
+
+Packet entities are added in two passes. The first one interpolates every
+entity into a contiguous array of refresh entities, and is split between
+worker threads. It only reads client state and writes its own slot (and
+animation state of its own centity_t). The second pass runs serially in
+entity order and does everything that touches shared state: adding
+entities and dlights to the view, spawning particle trails, calling
+rand() and registering skins. Output thus doesn't depend on thread count.
+
+==========================================================================
+*/
+
+typedef struct {
+    entity_t        ent;
+    unsigned int    effects, renderfx;
+} lerpentity_t;
+
+#define LERP_BATCH  32
+
+static lerpentity_t cl_lerpentities[MAX_EDICTS];
+
+static void CL_LerpPacketEntity(lerpentity_t *le, const entity_state_t *s1,
+                                float autorotate, int autoanim)
+{
+    entity_t        *ent = &le->ent;
+    centity_t       *cent = &cl_entities[s1->number];
+    unsigned int    effects, renderfx;
+
+    memset(ent, 0, sizeof(*ent));
+    ent->id = cent->id + RESERVED_ENTITIY_COUNT;
+
+    effects = s1->effects;
+    renderfx = s1->renderfx;
+
+    // set frame
+    if (effects & EF_ANIM01)
+        ent->frame = autoanim & 1;
+    else if (effects & EF_ANIM23)
+        ent->frame = 2 + (autoanim & 1);
+    else if (effects & EF_ANIM_ALL)
+        ent->frame = autoanim;
+    else if (effects & EF_ANIM_ALLFAST)
+        ent->frame = cl.time / 100;
+    else
+        ent->frame = s1->frame;
+
+    // quad and pent can do different things on client
+    if (effects & EF_PENT) {
+        effects &= ~EF_PENT;
+        effects |= EF_COLOR_SHELL;
+        renderfx |= RF_SHELL_RED;
+    }
+
+    if (effects & EF_QUAD) {
+        effects &= ~EF_QUAD;
+        effects |= EF_COLOR_SHELL;
+        renderfx |= RF_SHELL_BLUE;
+    }
+
+    if (effects & EF_DOUBLE) {
+        effects &= ~EF_DOUBLE;
+        effects |= EF_COLOR_SHELL;
+        renderfx |= RF_SHELL_DOUBLE;
+    }
+
+    if (effects & EF_HALF_DAMAGE) {
+        effects &= ~EF_HALF_DAMAGE;
+        effects |= EF_COLOR_SHELL;
+        renderfx |= RF_SHELL_HALF_DAM;
+    }
+
+    // optionally remove the glowing effect
+    if (cl_noglow->integer)
+        renderfx &= ~RF_GLOW;
+
+    ent->oldframe = cent->prev.frame;
+    ent->backlerp = 1.0 - cl.lerpfrac;
+
+    if (renderfx & RF_FRAMELERP) {
+        // step origin discretely, because the frames
+        // do the animation properly
+        VectorCopy(cent->current.origin, ent->origin);
+        VectorCopy(cent->current.old_origin, ent->oldorigin);  // FIXME
+    } else if (renderfx & RF_BEAM) {
+        // interpolate start and end points for beams
+        LerpVector(cent->prev.origin, cent->current.origin,
+                   cl.lerpfrac, ent->origin);
+        LerpVector(cent->prev.old_origin, cent->current.old_origin,
+                   cl.lerpfrac, ent->oldorigin);
+    } else {
+        if (s1->number == cl.frame.clientNum + 1) {
+            // use predicted origin
+            VectorCopy(cl.playerEntityOrigin, ent->origin);
+            VectorCopy(cl.playerEntityOrigin, ent->oldorigin);
+        } else {
+            // interpolate origin
+            LerpVector(cent->prev.origin, cent->current.origin,
+                       cl.lerpfrac, ent->origin);
+            VectorCopy(ent->origin, ent->oldorigin);
+        }
+
+#if USE_FPS
+        // run alias model animation
+        if (cent->prev_frame != s1->frame) {
+            int delta = cl.time - cent->anim_start;
+            float frac;
+
+            if (delta > BASE_FRAMETIME) {
+#ifdef _DEBUG
+                Com_TaskLock();
+                Com_DDPrintf("[%d] anim end %d: %d --> %d\n",
+                             cl.time, s1->number,
+                             cent->prev_frame, s1->frame);
+                Com_TaskUnlock();
+#endif
+                cent->prev_frame = s1->frame;
+                frac = 1;
+            } else if (delta > 0) {
+                frac = delta * BASE_1_FRAMETIME;
+#ifdef _DEBUG
+                Com_TaskLock();
+                Com_DDPrintf("[%d] anim run %d: %d --> %d [%f]\n",
+                             cl.time, s1->number,
+                             cent->prev_frame, s1->frame,
+                             frac);
+                Com_TaskUnlock();
+#endif
+            } else {
+                frac = 0;
+            }
+
+            ent->oldframe = cent->prev_frame;
+            ent->backlerp = 1.0 - frac;
+        }
+#endif
+    }
+
+    // calculate angles
+    if (effects & EF_ROTATE) {  // some bonus items auto-rotate
+        ent->angles[0] = 0;
+        ent->angles[1] = autorotate;
+        ent->angles[2] = 0;
+    } else if (effects & EF_SPINNINGLIGHTS) {
+        ent->angles[0] = 0;
+        ent->angles[1] = anglemod(cl.time / 2) + s1->angles[1];
+        ent->angles[2] = 180;
+    } else if (s1->number == cl.frame.clientNum + 1) {
+        VectorCopy(cl.playerEntityAngles, ent->angles);     // use predicted angles
+    } else { // interpolate angles
+        LerpAngles(cent->prev.angles, cent->current.angles,
+                   cl.lerpfrac, ent->angles);
+
+        // mimic original ref_gl "leaning" bug (uuugly!)
+        if (s1->modelindex == 255 && cl_rollhack->integer) {
+            ent->angles[ROLL] = -ent->angles[ROLL];
+        }
+    }
+
+    le->effects = effects;
+    le->renderfx = renderfx;
+}
+
+static void lerp_entities_task(void *data, int index)
+{
+    int     pnum = index * LERP_BATCH;
+    int     last = min(pnum + LERP_BATCH, cl.frame.numEntities);
+    float   autorotate;
+    int     autoanim;
+
+    // bonus items rotate at a fixed rate
+    autorotate = anglemod(cl.time * 0.1f);
+
+    // brush models can auto animate their frames
+    autoanim = 2 * cl.time / 1000;
+
+    for (; pnum < last; pnum++) {
+        CL_LerpPacketEntity(&cl_lerpentities[pnum],
+                            &cl.entityStates[(cl.frame.firstEntity + pnum) & PARSE_ENTITIES_MASK],
+                            autorotate, autoanim);
+    }
+}
+
 /*
 ===============
 CL_AddPacketEntities
@@ -512,126 +699,26 @@ static void CL_AddPacketEntities(void)
 {
     entity_t            ent;
     entity_state_t      *s1;
-    float               autorotate;
+    lerpentity_t        *le;
     int                 i;
     int                 pnum;
     centity_t           *cent;
-    int                 autoanim;
     clientinfo_t        *ci;
     unsigned int        effects, renderfx;
 
-    // bonus items rotate at a fixed rate
-    autorotate = anglemod(cl.time * 0.1f);
-
-    // brush models can auto animate their frames
-    autoanim = 2 * cl.time / 1000;
-
-    memset(&ent, 0, sizeof(ent));
+    Com_ParallelFor(lerp_entities_task, NULL,
+                    (cl.frame.numEntities + LERP_BATCH - 1) / LERP_BATCH);
 
     for (pnum = 0; pnum < cl.frame.numEntities; pnum++) {
         i = (cl.frame.firstEntity + pnum) & PARSE_ENTITIES_MASK;
         s1 = &cl.entityStates[i];
 
         cent = &cl_entities[s1->number];
-        ent.id = cent->id + RESERVED_ENTITIY_COUNT;
-
-        effects = s1->effects;
-        renderfx = s1->renderfx;
-
-        // set frame
-        if (effects & EF_ANIM01)
-            ent.frame = autoanim & 1;
-        else if (effects & EF_ANIM23)
-            ent.frame = 2 + (autoanim & 1);
-        else if (effects & EF_ANIM_ALL)
-            ent.frame = autoanim;
-        else if (effects & EF_ANIM_ALLFAST)
-            ent.frame = cl.time / 100;
-        else
-            ent.frame = s1->frame;
-
-        // quad and pent can do different things on client
-        if (effects & EF_PENT) {
-            effects &= ~EF_PENT;
-            effects |= EF_COLOR_SHELL;
-            renderfx |= RF_SHELL_RED;
-        }
-
-        if (effects & EF_QUAD) {
-            effects &= ~EF_QUAD;
-            effects |= EF_COLOR_SHELL;
-            renderfx |= RF_SHELL_BLUE;
-        }
-
-        if (effects & EF_DOUBLE) {
-            effects &= ~EF_DOUBLE;
-            effects |= EF_COLOR_SHELL;
-            renderfx |= RF_SHELL_DOUBLE;
-        }
-
-        if (effects & EF_HALF_DAMAGE) {
-            effects &= ~EF_HALF_DAMAGE;
-            effects |= EF_COLOR_SHELL;
-            renderfx |= RF_SHELL_HALF_DAM;
-        }
 
-        // optionally remove the glowing effect
-        if (cl_noglow->integer)
-            renderfx &= ~RF_GLOW;
-
-        ent.oldframe = cent->prev.frame;
-        ent.backlerp = 1.0 - cl.lerpfrac;
-
-        if (renderfx & RF_FRAMELERP) {
-            // step origin discretely, because the frames
-            // do the animation properly
-            VectorCopy(cent->current.origin, ent.origin);
-            VectorCopy(cent->current.old_origin, ent.oldorigin);  // FIXME
-        } else if (renderfx & RF_BEAM) {
-            // interpolate start and end points for beams
-            LerpVector(cent->prev.origin, cent->current.origin,
-                       cl.lerpfrac, ent.origin);
-            LerpVector(cent->prev.old_origin, cent->current.old_origin,
-                       cl.lerpfrac, ent.oldorigin);
-        } else {
-            if (s1->number == cl.frame.clientNum + 1) {
-                // use predicted origin
-                VectorCopy(cl.playerEntityOrigin, ent.origin);
-                VectorCopy(cl.playerEntityOrigin, ent.oldorigin);
-            } else {
-                // interpolate origin
-                LerpVector(cent->prev.origin, cent->current.origin,
-                           cl.lerpfrac, ent.origin);
-                VectorCopy(ent.origin, ent.oldorigin);
-            }
-
-#if USE_FPS
-            // run alias model animation
-            if (cent->prev_frame != s1->frame) {
-                int delta = cl.time - cent->anim_start;
-                float frac;
-
-                if (delta > BASE_FRAMETIME) {
-                    Com_DDPrintf("[%d] anim end %d: %d --> %d\n",
-                                 cl.time, s1->number,
-                                 cent->prev_frame, s1->frame);
-                    cent->prev_frame = s1->frame;
-                    frac = 1;
-                } else if (delta > 0) {
-                    frac = delta * BASE_1_FRAMETIME;
-                    Com_DDPrintf("[%d] anim run %d: %d --> %d [%f]\n",
-                                 cl.time, s1->number,
-                                 cent->prev_frame, s1->frame,
-                                 frac);
-                } else {
-                    frac = 0;
-                }
-
-                ent.oldframe = cent->prev_frame;
-                ent.backlerp = 1.0 - frac;
-            }
-#endif
-        }
+        le = &cl_lerpentities[pnum];
+        ent = le->ent;
+        effects = le->effects;
+        renderfx = le->renderfx;
 
         if ((effects & EF_GIB) && !cl_gibs->integer) {
             goto skip;
@@ -683,32 +770,14 @@ static void CL_AddPacketEntities(void)
         else
             ent.flags = renderfx;
 
-        // calculate angles
-        if (effects & EF_ROTATE) {  // some bonus items auto-rotate
-            ent.angles[0] = 0;
-            ent.angles[1] = autorotate;
-            ent.angles[2] = 0;
-        } else if (effects & EF_SPINNINGLIGHTS) {
+        // spinning lights follow the model angles
+        if ((effects & EF_SPINNINGLIGHTS) && !(effects & EF_ROTATE)) {
             vec3_t forward;
             vec3_t start;
 
-            ent.angles[0] = 0;
-            ent.angles[1] = anglemod(cl.time / 2) + s1->angles[1];
-            ent.angles[2] = 180;
-
             AngleVectors(ent.angles, forward, NULL, NULL);
             VectorMA(ent.origin, 64, forward, start);
             V_AddLight(start, 100, 1, 0, 0);
-        } else if (s1->number == cl.frame.clientNum + 1) {
-            VectorCopy(cl.playerEntityAngles, ent.angles);      // use predicted angles
-        } else { // interpolate angles
-            LerpAngles(cent->prev.angles, cent->current.angles,
-                       cl.lerpfrac, ent.angles);
-
-            // mimic original ref_gl "leaning" bug (uuugly!)
-            if (s1->modelindex == 255 && cl_rollhack->integer) {
-                ent.angles[ROLL] = -ent.angles[ROLL];
-            }
         }
 
         int base_entity_flags = 0;
@@ -1377,11 +1446,22 @@ Emits all entities, particles, and lights to the refresh
 */
 void CL_AddEntities(void)
 {
+    uint64_t td;
+
     CL_CalcViewValues();
     CL_FinishViewValues();
+
+    td = CL_TimeDemoBegin();
     CL_AddPacketEntities();
+    CL_TimeDemoEnd(TD_ENTITIES, td);
+
+    td = CL_TimeDemoBegin();
     CL_AddTEnts();
+    CL_TimeDemoEnd(TD_TENTS, td);
+
+    td = CL_TimeDemoBegin();
     CL_AddParticles();
+    CL_TimeDemoEnd(TD_PARTICLES, td);
 #if USE_DLIGHTS
     CL_AddDLights();
 #endif
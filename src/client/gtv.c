@@ -52,7 +52,7 @@ static void build_gamestate(void)
 
 static void emit_gamestate(void)
 {
-    char        *string;
+    const char  *string;
     int         i, j;
     entity_packed_t *es;
     size_t      length;
@@ -68,7 +68,7 @@ static void emit_gamestate(void)
 
     // send configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        string = cl.configstrings[i];
+        string = Com_ConfigstringSlot(cl.configstrings, i);
         if (!string[0]) {
             continue;
         }
@@ -708,8 +708,12 @@ void CL_ClearState(void)
 
     // wipe the entire cl structure
     BSP_Free(cl.bsp);
+    Com_ClearConfigstrings(cl.baseconfigstrings);
+    Com_ClearConfigstrings(cl.configstrings);
     memset(&cl, 0, sizeof(cl));
     memset(&cl_entities, 0, sizeof(cl_entities));
+    Com_ClearConfigstrings(cl.baseconfigstrings);
+    Com_ClearConfigstrings(cl.configstrings);
 
     if (cls.state > ca_connected) {
         cls.state = ca_connected;
@@ -1092,7 +1096,7 @@ static void CL_Changing_f(void)
 
     cls.state = ca_connected;   // not active anymore, but not disconnected
     cl.mapname[0] = 0;
-    cl.configstrings[CS_NAME][0] = 0;
+    Com_SetConfigstring(cl.configstrings, CS_NAME, "", 0);
 
     CL_CheckForPause();
 
@@ -1229,7 +1233,7 @@ Load or download any custom player skins and models
 static void CL_Skins_f(void)
 {
     int i;
-    char *s;
+    const char *s;
     clientinfo_t *ci;
 
     if (cls.state < ca_loading) {
@@ -1256,7 +1260,7 @@ static void CL_Skins_f(void)
 static void cl_noskins_changed(cvar_t *self)
 {
     int i;
-    char *s;
+    const char *s;
     clientinfo_t *ci;
 
     if (cls.state < ca_loading) {
@@ -3204,6 +3208,7 @@ CL_Frame
 unsigned CL_Frame(unsigned msec)
 {
     qboolean phys_frame, ref_frame;
+    uint64_t td;
 
     time_after_ref = time_before_ref = 0;
 
@@ -3288,8 +3293,11 @@ unsigned CL_Frame(unsigned msec)
     }
 
     // read next demo frame
-    if (cls.demo.playback)
+    if (cls.demo.playback) {
+        td = CL_TimeDemoBegin();
         CL_DemoFrame(main_extra);
+        CL_TimeDemoEnd(TD_PARSE, td);
+    }
 
     // calculate local time
     if (cls.state == ca_active && !sv_paused->integer)
@@ -3324,7 +3332,9 @@ unsigned CL_Frame(unsigned msec)
     CL_SendCmd();
 
     // predict all unacknowledged movements
+    td = CL_TimeDemoBegin();
     CL_PredictMovement();
+    CL_TimeDemoEnd(TD_PREDICT, td);
 
     Con_RunConsole();
 
@@ -3335,7 +3345,9 @@ unsigned CL_Frame(unsigned msec)
         if (host_speeds->integer)
             time_before_ref = Sys_Milliseconds();
 
+        td = CL_TimeDemoBegin();
         SCR_UpdateScreen();
+        CL_TimeDemoEnd(TD_SCREEN, td);
 
         if (host_speeds->integer)
             time_after_ref = Sys_Milliseconds();
@@ -3345,7 +3357,9 @@ unsigned CL_Frame(unsigned msec)
 
 run_fx:
         // update audio after the 3D view was drawn
+        td = CL_TimeDemoBegin();
         S_Update();
+        CL_TimeDemoEnd(TD_SOUND, td);
 
         // advance local effects for next frame
 #if USE_DLIGHTS
@@ -3426,6 +3440,9 @@ void CL_Init(void)
     // start with full screen console
     cls.key_dest = KEY_CONSOLE;
 
+    Com_ClearConfigstrings(cl.baseconfigstrings);
+    Com_ClearConfigstrings(cl.configstrings);
+
 #ifdef _WIN32
     CL_InitRefresh();
     S_Init();   // sound must be initialized after window is created
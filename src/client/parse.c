@@ -30,7 +30,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 static inline void CL_ParseDeltaEntity(server_frame_t  *frame,
                                        int             newnum,
                                        entity_state_t  *old,
-                                       int             bits)
+                                       int             bits,
+                                       byte            *cursor)
 {
     entity_state_t    *state;
 
@@ -50,7 +51,8 @@ static inline void CL_ParseDeltaEntity(server_frame_t  *frame,
     }
 #endif
 
-    MSG_ParseDeltaEntity(old, state, newnum, bits, cl.esFlags);
+    // decode straight into the ring
+    MSG_ReadDeltaEntity(cursor, old, state, newnum, bits, cl.esFlags);
 
     // shuffle previous origin to old
     if (!(bits & U_OLDORIGIN) && !(state->renderfx & RF_BEAM))
@@ -64,6 +66,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
     int            bits;
     entity_state_t    *oldstate;
     int            oldindex, oldnum;
+    byte           *cursor;
     int i;
 
     frame->firstEntity = cl.numEntityStates;
@@ -85,7 +88,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
     }
 
     while (1) {
-        newnum = MSG_ParseEntityBits(&bits);
+        newnum = MSG_ReadEntityBits(&bits, &cursor);
         if (newnum < 0 || newnum >= MAX_EDICTS) {
             Com_Error(ERR_DROP, "%s: bad number: %d", __func__, newnum);
         }
@@ -101,7 +104,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
         while (oldnum < newnum) {
             // one or more entities from the old packet are unchanged
             SHOWNET(3, "   unchanged: %i\n", oldnum);
-            CL_ParseDeltaEntity(frame, oldnum, oldstate, 0);
+            CL_ParseDeltaEntity(frame, oldnum, oldstate, 0, NULL);
 
             oldindex++;
 
@@ -139,7 +142,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
         if (oldnum == newnum) {
             // delta from previous state
             SHOWNET(2, "   delta: %i ", newnum);
-            CL_ParseDeltaEntity(frame, newnum, oldstate, bits);
+            CL_ParseDeltaEntity(frame, newnum, oldstate, bits, cursor);
             if (!bits) {
                 SHOWNET(2, "\n");
             }
@@ -159,7 +162,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
         if (oldnum > newnum) {
             // delta from baseline
             SHOWNET(2, "   baseline: %i ", newnum);
-            CL_ParseDeltaEntity(frame, newnum, &cl.baselines[newnum], bits);
+            CL_ParseDeltaEntity(frame, newnum, &cl.baselines[newnum], bits, cursor);
             if (!bits) {
                 SHOWNET(2, "\n");
             }
@@ -172,7 +175,7 @@ static void CL_ParsePacketEntities(server_frame_t *oldframe,
     while (oldnum != 99999) {
         // one or more entities from the old packet are unchanged
         SHOWNET(3, "   unchanged: %i\n", oldnum);
-        CL_ParseDeltaEntity(frame, oldnum, oldstate, 0);
+        CL_ParseDeltaEntity(frame, oldnum, oldstate, 0, NULL);
 
         oldindex++;
 
@@ -393,8 +396,11 @@ static void CL_ParseFrame(int extrabits)
 
     cls.demo.frames_read++;
 
-    if (!cls.demo.seeking)
+    if (!cls.demo.seeking) {
+        uint64_t td = CL_TimeDemoBegin();
         CL_DeltaFrame();
+        CL_TimeDemoEnd(TD_DELTA, td);
+    }
 }
 
 /*
@@ -408,13 +414,12 @@ static void CL_ParseFrame(int extrabits)
 static void CL_ParseConfigstring(int index)
 {
     size_t  len, maxlen;
-    char    *s;
+    char    s[CS_MAXSIZE];
 
     if (index < 0 || index >= MAX_CONFIGSTRINGS) {
         Com_Error(ERR_DROP, "%s: bad index: %d", __func__, index);
     }
 
-    s = cl.configstrings[index];
     maxlen = CS_SIZE(index);
     len = MSG_ReadString(s, maxlen);
 
@@ -426,6 +431,11 @@ static void CL_ParseConfigstring(int index)
             __func__, index, len, maxlen - 1);
     }
 
+    // nothing to do if the string didn't change
+    if (!Com_SetConfigstring(cl.configstrings, index, s, len)) {
+        return;
+    }
+
     if (cls.demo.seeking) {
         Q_SetBit(cl.dcs, index);
         return;
@@ -658,192 +668,17 @@ snd_params_t    snd;
 
 static void CL_ParseTEntPacket(void)
 {
-    te.type = MSG_ReadByte();
-
-    switch (te.type) {
-    case TE_BLOOD:
-    case TE_GUNSHOT:
-    case TE_SPARKS:
-    case TE_BULLET_SPARKS:
-    case TE_SCREEN_SPARKS:
-    case TE_SHIELD_SPARKS:
-    case TE_SHOTGUN:
-    case TE_BLASTER:
-    case TE_GREENBLOOD:
-    case TE_BLASTER2:
-	case TE_FLECHETTE:
-    case TE_HEATBEAM_SPARKS:
-    case TE_HEATBEAM_STEAM:
-    case TE_MOREBLOOD:
-    case TE_ELECTRIC_SPARKS:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        break;
-
-    case TE_SPLASH:
-    case TE_LASER_SPARKS:
-    case TE_WELDING_SPARKS:
-    case TE_TUNNEL_SPARKS:
-        te.count = MSG_ReadByte();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        te.color = MSG_ReadByte();
-        break;
-
-    case TE_BLUEHYPERBLASTER:
-    case TE_RAILTRAIL:
-    case TE_BUBBLETRAIL:
-    case TE_DEBUGTRAIL:
-    case TE_BUBBLETRAIL2:
-    case TE_BFG_LASER:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_GRENADE_EXPLOSION:
-    case TE_GRENADE_EXPLOSION_WATER:
-    case TE_EXPLOSION2:
-    case TE_PLASMA_EXPLOSION:
-    case TE_ROCKET_EXPLOSION:
-    case TE_ROCKET_EXPLOSION_WATER:
-    case TE_EXPLOSION1:
-    case TE_EXPLOSION1_NP:
-    case TE_EXPLOSION1_BIG:
-    case TE_BFG_EXPLOSION:
-    case TE_BFG_BIGEXPLOSION:
-    case TE_BOSSTPORT:
-    case TE_PLAIN_EXPLOSION:
-    case TE_CHAINFIST_SMOKE:
-    case TE_TRACKER_EXPLOSION:
-    case TE_TELEPORT_EFFECT:
-    case TE_DBALL_GOAL:
-    case TE_WIDOWSPLASH:
-    case TE_NUKEBLAST:
-        MSG_ReadPos(te.pos1);
-        break;
-
-    case TE_PARASITE_ATTACK:
-    case TE_MEDIC_CABLE_ATTACK:
-    case TE_HEATBEAM:
-    case TE_MONSTER_HEATBEAM:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_GRAPPLE_CABLE:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        MSG_ReadPos(te.offset);
-        break;
-
-    case TE_LIGHTNING:
-        te.entity1 = MSG_ReadShort();
-        te.entity2 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_FLASHLIGHT:
-        MSG_ReadPos(te.pos1);
-        te.entity1 = MSG_ReadShort();
-        break;
-
-    case TE_FORCEWALL:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        te.color = MSG_ReadByte();
-        break;
-
-    case TE_STEAM:
-        te.entity1 = MSG_ReadShort();
-        te.count = MSG_ReadByte();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        te.color = MSG_ReadByte();
-        te.entity2 = MSG_ReadShort();
-        if (te.entity1 != -1) {
-            te.time = MSG_ReadLong();
-        }
-        break;
-
-    case TE_WIDOWBEAMOUT:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        break;
-
-    case TE_FLARE:
-        te.entity1 = MSG_ReadShort();
-        te.count = MSG_ReadByte();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        break;
-
-    default:
-        Com_Error(ERR_DROP, "%s: bad type", __func__);
-    }
+    MSG_ParseTempEntity(&te);
 }
 
 static void CL_ParseMuzzleFlashPacket(int mask)
 {
-    int entity, weapon;
-
-    entity = MSG_ReadShort();
-    if (entity < 1 || entity >= MAX_EDICTS)
-        Com_Error(ERR_DROP, "%s: bad entity", __func__);
-
-    weapon = MSG_ReadByte();
-    mz.silenced = weapon & mask;
-    mz.weapon = weapon & ~mask;
-    mz.entity = entity;
+    MSG_ParseMuzzleFlash(&mz, mask);
 }
 
 static void CL_ParseStartSoundPacket(void)
 {
-    int flags, channel, entity;
-
-    flags = MSG_ReadByte();
-    if ((flags & (SND_ENT | SND_POS)) == 0)
-        Com_Error(ERR_DROP, "%s: neither SND_ENT nor SND_POS set", __func__);
-
-    snd.index = MSG_ReadByte();
-    if (snd.index == -1)
-        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
-
-    if (flags & SND_VOLUME)
-        snd.volume = MSG_ReadByte() / 255.0f;
-    else
-        snd.volume = DEFAULT_SOUND_PACKET_VOLUME;
-
-    if (flags & SND_ATTENUATION)
-        snd.attenuation = MSG_ReadByte() / 64.0f;
-    else
-        snd.attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
-
-    if (flags & SND_OFFSET)
-        snd.timeofs = MSG_ReadByte() / 1000.0f;
-    else
-        snd.timeofs = 0;
-
-    if (flags & SND_ENT) {
-        // entity relative
-        channel = MSG_ReadShort();
-        entity = channel >> 3;
-        if (entity < 0 || entity >= MAX_EDICTS)
-            Com_Error(ERR_DROP, "%s: bad entity: %d", __func__, entity);
-        snd.entity = entity;
-        snd.channel = channel & 7;
-    } else {
-        snd.entity = 0;
-        snd.channel = 0;
-    }
-
-    // positioned in space
-    if (flags & SND_POS)
-        MSG_ReadPos(snd.pos);
-
-    snd.flags = flags;
+    MSG_ParseStartSound(&snd);
 
     SHOWNET(2, "    %s\n", cl.configstrings[CS_SOUNDS + snd.index]);
 }
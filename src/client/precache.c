@@ -203,7 +203,7 @@ CL_RegisterSounds
 void CL_RegisterSounds(void)
 {
     int i;
-    char    *s;
+    const char *s;
 
     S_BeginRegistration();
     CL_RegisterTEntSounds();
@@ -226,7 +226,7 @@ Registers main BSP file and inline models
 void CL_RegisterBspModels(void)
 {
     qerror_t ret;
-    char *name;
+    const char *name;
     int i;
 
     ret = BSP_Load(cl.configstrings[CS_MODELS + 1], &cl.bsp);
@@ -269,7 +269,7 @@ Builds a list of visual weapon models
 void CL_RegisterVWepModels(void)
 {
     int         i;
-    char        *name;
+    const char  *name;
 
     cl.numWeaponModels = 1;
     strcpy(cl.weaponModels[0], "weapon.md2");
@@ -333,7 +333,7 @@ Call before entering a new level, or after changing dlls
 void CL_PrepRefresh(void)
 {
     int         i;
-    char        *name;
+    const char  *name;
 
     if (!cls.ref_initialized)
         return;
@@ -71,6 +71,74 @@ void CL_CheckPredictionError(void)
     VectorScale(delta, 0.125f, cl.prediction_error);
 }
 
+/*
+====================
+CL_SortSolidEntities
+
+Calculates absolute bounds of solid entities and sorts them along the X
+axis, so that traces only need to clip against entities they can touch.
+Called each time the solid entity list is rebuilt.
+====================
+*/
+static int solidcmp(const void *p1, const void *p2)
+{
+    int a = *(const short *)p1;
+    int b = *(const short *)p2;
+
+    if (cl.solidMins[a][0] < cl.solidMins[b][0])
+        return -1;
+    if (cl.solidMins[a][0] > cl.solidMins[b][0])
+        return 1;
+    return a - b;
+}
+
+void CL_SortSolidEntities(void)
+{
+    int         i, j;
+    centity_t   *ent;
+    mmodel_t    *cmodel;
+    vec_t       radius;
+
+    for (i = 0; i < cl.numSolidEntities; i++) {
+        ent = cl.solidEntities[i];
+
+        if (ent->current.solid == PACKED_BSP) {
+            cmodel = cl.model_clip[ent->current.modelindex];
+            if (!cmodel) {
+                // never clipped against, keep it out of the way
+                VectorSet(cl.solidMins[i], 99999, 99999, 99999);
+                VectorSet(cl.solidMaxs[i], -99999, -99999, -99999);
+            } else if (ent->current.angles[0] || ent->current.angles[1] || ent->current.angles[2]) {
+                // expand for rotation
+                radius = RadiusFromBounds(cmodel->mins, cmodel->maxs);
+                for (j = 0; j < 3; j++) {
+                    cl.solidMins[i][j] = ent->current.origin[j] - radius;
+                    cl.solidMaxs[i][j] = ent->current.origin[j] + radius;
+                }
+            } else {
+                VectorAdd(ent->current.origin, cmodel->mins, cl.solidMins[i]);
+                VectorAdd(ent->current.origin, cmodel->maxs, cl.solidMaxs[i]);
+            }
+        } else {
+            VectorAdd(ent->current.origin, ent->mins, cl.solidMins[i]);
+            VectorAdd(ent->current.origin, ent->maxs, cl.solidMaxs[i]);
+        }
+
+        // because movement is clipped an epsilon away from an actual edge,
+        // the bounds are expanded by 1 unit, like the server does
+        for (j = 0; j < 3; j++) {
+            cl.solidMins[i][j] -= 1;
+            cl.solidMaxs[i][j] += 1;
+        }
+
+        cl.solidOrder[i] = i;
+    }
+
+    qsort(cl.solidOrder, cl.numSolidEntities, sizeof(cl.solidOrder[0]), solidcmp);
+
+    cl.solidSequence++;
+}
+
 /*
 ====================
 CL_ClipMoveToEntities
@@ -79,13 +147,52 @@ CL_ClipMoveToEntities
 */
 static void CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, trace_t *tr)
 {
-    int         i;
+    static byte touched[MAX_PACKET_ENTITIES];
+    int         i, k, first, last;
+    vec3_t      boxmins, boxmaxs;
     trace_t     trace;
     mnode_t     *headnode;
     centity_t   *ent;
     mmodel_t    *cmodel;
 
-    for (i = 0; i < cl.numSolidEntities; i++) {
+    // bounds of the entire move
+    for (i = 0; i < 3; i++) {
+        if (end[i] > start[i]) {
+            boxmins[i] = start[i] + mins[i] - 1;
+            boxmaxs[i] = end[i] + maxs[i] + 1;
+        } else {
+            boxmins[i] = end[i] + mins[i] - 1;
+            boxmaxs[i] = start[i] + maxs[i] + 1;
+        }
+    }
+
+    // sweep along X axis, collect entities the move overlaps
+    first = cl.numSolidEntities;
+    last = -1;
+    for (k = 0; k < cl.numSolidEntities; k++) {
+        i = cl.solidOrder[k];
+        if (cl.solidMins[i][0] > boxmaxs[0])
+            break;
+        if (cl.solidMaxs[i][0] < boxmins[0])
+            continue;
+        if (cl.solidMins[i][1] > boxmaxs[1] || cl.solidMaxs[i][1] < boxmins[1])
+            continue;
+        if (cl.solidMins[i][2] > boxmaxs[2] || cl.solidMaxs[i][2] < boxmins[2])
+            continue;
+        touched[i] = 1;
+        first = min(first, i);
+        last = max(last, i);
+    }
+
+    // clip in list order, so that ties are resolved like before
+    for (i = first; i <= last; i++) {
+        if (!touched[i])
+            continue;
+        touched[i] = 0;
+
+        if (tr->allsolid)
+            continue;   // still need to clear the rest of marks
+
         ent = cl.solidEntities[i];
 
         if (ent->current.solid == PACKED_BSP) {
@@ -98,9 +205,6 @@ static void CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t
             headnode = CM_HeadnodeForBox(ent->mins, ent->maxs);
         }
 
-        if (tr->allsolid)
-            return;
-
         CM_TransformedBoxTrace(&trace, start, end,
                                mins, maxs, headnode,  MASK_PLAYERSOLID,
                                ent->current.origin, ent->current.angles);
@@ -145,6 +249,11 @@ static int CL_PointContents(vec3_t point)
         if (ent->current.solid != PACKED_BSP) // special value for bmodel
             continue;
 
+        if (point[0] < cl.solidMins[i][0] || point[0] > cl.solidMaxs[i][0] ||
+            point[1] < cl.solidMins[i][1] || point[1] > cl.solidMaxs[i][1] ||
+            point[2] < cl.solidMins[i][2] || point[2] > cl.solidMaxs[i][2])
+            continue;
+
         cmodel = cl.model_clip[ent->current.modelindex];
         if (!cmodel)
             continue;
@@ -172,9 +281,20 @@ void CL_PredictAngles(void)
     cl.predicted_angles[2] = cl.viewangles[2] + SHORT2ANGLE(cl.frame.ps.pmove.delta_angles[2]);
 }
 
+static qboolean pmove_state_equal(const pmove_state_t *a, const pmove_state_t *b)
+{
+    return a->pm_type == b->pm_type &&
+        VectorCompare(a->origin, b->origin) &&
+        VectorCompare(a->velocity, b->velocity) &&
+        a->pm_flags == b->pm_flags &&
+        a->pm_time == b->pm_time &&
+        a->gravity == b->gravity &&
+        VectorCompare(a->delta_angles, b->delta_angles);
+}
+
 void CL_PredictMovement(void)
 {
-    unsigned    ack, current, frame;
+    unsigned    ack, current, frame, first, i;
     pmove_t     pm;
     int         step, oldz;
 
@@ -223,13 +343,37 @@ void CL_PredictMovement(void)
     VectorCopy(cl.delta_angles, pm.s.delta_angles);
 #endif
 
+    // commands are never modified once sent, so if prediction starts from
+    // the same state in the same world as last time, pick up where it ended
+    if (cl.predicted_ack == ack && cl.predicted_seq == cl.solidSequence &&
+        cl.predicted_cmd > ack && cl.predicted_cmd <= current &&
+        pmove_state_equal(&cl.predicted_base, &pm.s) &&
+        !memcmp(&cl.predicted_pmp, &cl.pmp, sizeof(cl.pmp))) {
+        pm.s = cl.predicted_state;
+        VectorCopy(cl.predicted_viewangles, pm.viewangles);
+        first = cl.predicted_cmd;
+    } else {
+        cl.predicted_base = pm.s;
+        cl.predicted_pmp = cl.pmp;
+        cl.predicted_seq = cl.solidSequence;
+        cl.predicted_ack = ack;
+        cl.predicted_cmd = ack;
+        first = ack;
+    }
+
     // run frames
-    while (++ack <= current) {
-        pm.cmd = cl.cmds[ack & CMD_MASK];
+    for (i = first + 1; i <= current; i++) {
+        pm.cmd = cl.cmds[i & CMD_MASK];
         Pmove(&pm, &cl.pmp);
 
         // save for debug checking
-        VectorCopy(pm.s.origin, cl.predicted_origins[ack & CMD_MASK]);
+        VectorCopy(pm.s.origin, cl.predicted_origins[i & CMD_MASK]);
+    }
+
+    if (current != ack) {
+        cl.predicted_cmd = current;
+        cl.predicted_state = pm.s;
+        VectorCopy(pm.viewangles, cl.predicted_viewangles);
     }
 
     // run pending cmd
@@ -28,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 // Console variables that we need to access from this module
 cvar_t      *vid_rtx;
+cvar_t      *vid_null;
 cvar_t      *vid_geometry;
 cvar_t      *vid_modelist;
 cvar_t      *vid_fullscreen;
@@ -240,6 +241,11 @@ void CL_RunRefresh(void)
 
     VID_PumpEvents();
 
+    if (vid_null->integer) {
+        // nothing to change mode of
+        mode_changed = 0;
+    }
+
     if (mode_changed) {
         if (mode_changed & MODE_FULLSCREEN) {
             VID_SetMode();
@@ -302,7 +308,12 @@ void CL_InitRefresh(void)
 
     Com_SetLastError(NULL);
 
-    modelist = VID_GetDefaultModeList();
+    // null renderer doesn't touch the video subsystem at all
+    vid_null = Cvar_Get("vid_null", "0", CVAR_REFRESH);
+    if (vid_null->integer)
+        modelist = Z_CopyString(VID_MODELIST);
+    else
+        modelist = VID_GetDefaultModeList();
     if (!modelist) {
         Com_Error(ERR_FATAL, "Couldn't initialize refresh: %s", Com_GetLastError());
     }
@@ -332,6 +343,9 @@ void CL_InitRefresh(void)
 
     Com_SetLastError(NULL);
 
+	if (vid_null->integer)
+		R_RegisterFunctionsNull();
+	else
 #if REF_GL && REF_VKPT
 	if (vid_rtx->integer)
 		R_RegisterFunctionsRTX();
@@ -351,6 +365,11 @@ void CL_InitRefresh(void)
 
     cls.ref_initialized = qtrue;
 
+    // there is no window to receive focus events
+    if (vid_null->integer) {
+        CL_Activate(ACT_ACTIVATED);
+    }
+
     vid_geometry->changed = vid_geometry_changed;
     vid_fullscreen->changed = vid_fullscreen_changed;
     vid_modelist->changed = vid_modelist_changed;
@@ -1331,6 +1331,7 @@ static void scr_scale_changed(cvar_t *self)
 
 static const cmdreg_t scr_cmds[] = {
     { "timerefresh", SCR_TimeRefresh_f },
+    { "timeparticles", CL_TimeParticles_f },
     { "sizeup", SCR_SizeUp_f },
     { "sizedown", SCR_SizeDown_f },
     { "sky", SCR_Sky_f },
@@ -1638,7 +1639,7 @@ static void SCR_ExecuteLayoutString(const char *s)
     char    buffer[MAX_QPATH];
     int     x, y;
     int     value;
-    char    *token;
+    const char *token;
     int     width;
     int     index;
     clientinfo_t    *ci;
@@ -2190,6 +2191,9 @@ void SCR_UpdateScreen(void)
 
     R_EndFrame();
 
+    // report finished screenshots, dump frames
+    IMG_RunScreenshots();
+
     recursive--;
 }
 
@@ -23,10 +23,13 @@ dma_t       dma;
 
 cvar_t      *s_khz;
 cvar_t      *s_testsound;
+cvar_t      *s_resample;
+cvar_t      *s_resamplecache;
 #if USE_DSOUND
 static cvar_t       *s_direct;
 #endif
 static cvar_t       *s_mixahead;
+static cvar_t       *s_mixthread;
 
 static snddmaAPI_t snddma;
 
@@ -48,6 +51,9 @@ qboolean DMA_Init(void)
     s_khz = Cvar_Get("s_khz", "44", CVAR_ARCHIVE | CVAR_SOUND);
     s_mixahead = Cvar_Get("s_mixahead", "0.1", CVAR_ARCHIVE);
     s_testsound = Cvar_Get("s_testsound", "0", 0);
+    s_mixthread = Cvar_Get("s_mixthread", "0", CVAR_SOUND);
+    s_resample = Cvar_Get("s_resample", "1", CVAR_ARCHIVE | CVAR_SOUND);
+    s_resamplecache = Cvar_Get("s_resamplecache", "1", 0);
 
 #if USE_DSOUND
     s_direct = Cvar_Get("s_direct", "1", CVAR_SOUND);
@@ -69,6 +75,11 @@ qboolean DMA_Init(void)
 
     S_InitScaletable();
 
+    // mixer thread needs a driver that can be locked from any thread
+    if (s_mixthread->integer && !snddma.threaded)
+        Com_WPrintf("Mixer thread is not supported by this sound driver\n");
+    S_InitMixer(s_mixthread->integer && snddma.threaded);
+
     s_numchannels = MAX_CHANNELS;
 
     Com_Printf("sound sampling rate: %i\n", dma.speed);
@@ -78,6 +89,7 @@ qboolean DMA_Init(void)
 
 void DMA_Shutdown(void)
 {
+    S_ShutdownMixer();
     snddma.Shutdown();
     s_numchannels = 0;
 }
@@ -119,13 +131,15 @@ void DMA_ClearBuffer(void)
     else
         clear = 0;
 
+    S_FlushMixer();
+
     snddma.BeginPainting();
     if (dma.buffer)
         memset(dma.buffer, clear, dma.samples * dma.samplebits / 8);
     snddma.Submit();
 }
 
-static int DMA_GetTime(void)
+static int DMA_GetTime(int samplepos)
 {
     static  int     buffers;
     static  int     oldsamplepos;
@@ -133,7 +147,7 @@ static int DMA_GetTime(void)
 
 // it is possible to miscount buffers if it has wrapped twice between
 // calls to S_Update.  Oh well.
-    if (dma.samplepos < oldsamplepos) {
+    if (samplepos < oldsamplepos) {
         buffers++;                  // buffer wrapped
         if (paintedtime > 0x40000000) {
             // time to chop things off to avoid 32 bit limits
@@ -142,9 +156,22 @@ static int DMA_GetTime(void)
             S_StopAllSounds();
         }
     }
-    oldsamplepos = dma.samplepos;
+    oldsamplepos = samplepos;
+
+    return buffers * fullsamples + samplepos / dma.channels;
+}
 
-    return buffers * fullsamples + dma.samplepos / dma.channels;
+// called by the mixer thread around writes to the DMA buffer
+void DMA_BeginPainting(void)
+{
+    if (snddma.threaded)
+        snddma.BeginPainting();
+}
+
+void DMA_Submit(void)
+{
+    if (snddma.threaded)
+        snddma.Submit();
 }
 
 void DMA_Update(void)
@@ -157,8 +184,14 @@ void DMA_Update(void)
     if (!dma.buffer)
         return;
 
+    soundtime = dma.samplepos;
+
+    // mixer thread locks the buffer by itself
+    if (S_MixerThreaded())
+        snddma.Submit();
+
 // Updates DMA time
-    soundtime = DMA_GetTime();
+    soundtime = DMA_GetTime(soundtime);
 
 // check to make sure that we haven't overshot
     if (paintedtime < soundtime) {
@@ -179,7 +212,8 @@ void DMA_Update(void)
 
     S_PaintChannels(endtime);
 
-    snddma.Submit();
+    if (!S_MixerThreaded())
+        snddma.Submit();
 }
 
 
@@ -54,6 +54,7 @@ static int          num_sfx;
 playsound_t s_playsounds[MAX_PLAYSOUNDS];
 playsound_t s_freeplays;
 playsound_t s_pendingplays;
+static playsound_t  s_loadingplays;     // waiting for background loads
 
 cvar_t      *s_volume;
 cvar_t      *s_ambient;
@@ -115,6 +116,8 @@ static void S_SoundList_f(void)
         } else {
             if (sfx->name[0] == '*')
                 Com_Printf("  placeholder : %s\n", sfx->name);
+            else if (sfx->async)
+                Com_Printf("  loading     : %s\n", sfx->name);
             else
                 Com_Printf("  not loaded  : %s (%s)\n",
                            sfx->name, Q_ErrorString(sfx->error));
@@ -127,6 +130,9 @@ static const cmdreg_t c_sound[] = {
     { "stopsound", S_StopAllSounds },
     { "soundlist", S_SoundList_f },
     { "soundinfo", S_SoundInfo_f },
+#if USE_SNDDMA
+    { "timeresample", S_TimeResample_f },
+#endif
 
     { NULL }
 };
@@ -228,6 +234,8 @@ void S_FreeAllSounds(void)
     int     i;
     sfx_t   *sfx;
 
+    S_FinishLoads(qtrue);
+
     // free all sounds
     for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
         if (!sfx->name[0])
@@ -430,7 +438,7 @@ qhandle_t S_RegisterSound(const char *name)
     }
 
     if (!s_registering) {
-        S_LoadSound(sfx);
+        S_QueueLoad(sfx);
     }
 
     return (sfx - known_sfx) + 1;
@@ -472,7 +480,7 @@ static sfx_t *S_RegisterSexedSound(int entnum, const char *base)
     sfx = S_FindName(buffer, len);
 
     // see if it exists
-    if (sfx && !sfx->truename && !s_registering && !S_LoadSound(sfx)) {
+    if (sfx && !sfx->truename && !s_registering && !S_QueueLoad(sfx)) {
         // no, revert to the male sound in the pak0.pak
         len = Q_concat(buffer, MAX_QPATH,
                        "sound/player/male/", base + 1, NULL);
@@ -530,6 +538,9 @@ void S_EndRegistration(void)
 
     S_RegisterSexedSounds();
 
+    // registration loads everything at once
+    S_FinishLoads(qtrue);
+
     // clear playsound list, so we don't free sfx still present there
     S_StopAllSounds();
 
@@ -557,11 +568,7 @@ void S_EndRegistration(void)
     }
 
     // load everything in
-    for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
-        if (!sfx->name[0])
-            continue;
-        S_LoadSound(sfx);
-    }
+    S_LoadSounds(known_sfx, num_sfx);
 
     s_registering = qfalse;
 }
@@ -772,9 +779,10 @@ void S_IssuePlaysound(playsound_t *ps)
         return;
     }
 
-    sc = S_LoadSound(ps->sfx);
+    // sounds are loaded before they are queued, don't hit the disk from here
+    sc = ps->sfx->cache;
     if (!sc) {
-        Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
+        Com_DPrintf("S_IssuePlaysound: %s not loaded\n", ps->sfx->name);
         S_FreePlaysound(ps);
         return;
     }
@@ -812,6 +820,54 @@ void S_IssuePlaysound(playsound_t *ps)
 // Start a sound effect
 // =======================================================================
 
+static void S_QueuePlaysound(playsound_t *ps)
+{
+    playsound_t *sort;
+
+    // sort into the pending sound list
+    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
+        ;
+
+    ps->next = sort;
+    ps->prev = sort->prev;
+
+    ps->next->prev = ps;
+    ps->prev->next = ps;
+}
+
+#if USE_SNDDMA
+/*
+====================
+S_StartLoadedPlaysounds
+
+Playsounds of sounds that were still loading start as soon as the data
+is ready, or are dropped if loading failed.
+====================
+*/
+static void S_StartLoadedPlaysounds(void)
+{
+    playsound_t *ps, *next;
+
+    for (ps = s_loadingplays.next; ps != &s_loadingplays; ps = next) {
+        next = ps->next;
+        if (ps->sfx->async)
+            continue;
+
+        if (!ps->sfx->cache) {
+            S_FreePlaysound(ps);
+            continue;
+        }
+
+        ps->prev->next = ps->next;
+        ps->next->prev = ps->prev;
+
+        if (ps->begin < paintedtime)
+            ps->begin = paintedtime;
+        S_QueuePlaysound(ps);
+    }
+}
+#endif
+
 /*
 ====================
 S_StartSound
@@ -823,8 +879,7 @@ Entchannel 0 will never override a playing sound
 */
 void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSfx, float vol, float attenuation, float timeofs)
 {
-    sfxcache_t  *sc;
-    playsound_t *ps, *sort;
+    playsound_t *ps;
     sfx_t       *sfx;
 
     if (!s_started)
@@ -842,9 +897,8 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
             return;
     }
 
-    // make sure the sound is loaded
-    sc = S_LoadSound(sfx);
-    if (!sc)
+    // make sure the sound is loaded or loading, it is silent until ready
+    if (!S_QueueLoad(sfx))
         return;     // couldn't load the sound's data
 
     // make the playsound_t
@@ -875,15 +929,16 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
         ps->begin = DMA_DriftBeginofs(timeofs);
 #endif
 
-    // sort into the pending sound list
-    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
-        ;
+    if (sfx->async) {
+        ps->next = &s_loadingplays;
+        ps->prev = s_loadingplays.prev;
 
-    ps->next = sort;
-    ps->prev = sort->prev;
+        ps->next->prev = ps;
+        ps->prev->next = ps;
+        return;
+    }
 
-    ps->next->prev = ps;
-    ps->prev->next = ps;
+    S_QueuePlaysound(ps);
 }
 
 void S_ParseStartSound(void)
@@ -940,6 +995,7 @@ void S_StopAllSounds(void)
     memset(s_playsounds, 0, sizeof(s_playsounds));
     s_freeplays.next = s_freeplays.prev = &s_freeplays;
     s_pendingplays.next = s_pendingplays.prev = &s_pendingplays;
+    s_loadingplays.next = s_loadingplays.prev = &s_loadingplays;
 
     for (i = 0; i < MAX_PLAYSOUNDS; i++) {
         s_playsounds[i].prev = &s_freeplays;
@@ -1139,6 +1195,10 @@ void S_Update(void)
         }
     }
 
+    // start sounds that finished loading
+    S_FinishLoads(qfalse);
+    S_StartLoadedPlaysounds();
+
     // add loopsounds
     S_AddLoopSounds();
 
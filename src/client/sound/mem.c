@@ -18,75 +18,387 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // snd_mem.c: sound caching
 
 #include "sound.h"
+#include "common/mdfour.h"
+#include "common/tasks.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
 
 wavinfo_t s_info;
 
 #if USE_SNDDMA
 /*
-================
-ResampleSfx
-================
+===============================================================================
+
+Sample rate conversion
+
+===============================================================================
 */
-static sfxcache_t *ResampleSfx(sfx_t *sfx)
+
+// windowed sinc filter, evaluated at RESAMPLE_PHASES sub-sample positions
+#define RESAMPLE_TAPS       16      // must be a multiple of 4
+#define RESAMPLE_PHASES     128
+
+typedef float filterbank_t[RESAMPLE_PHASES][RESAMPLE_TAPS];
+
+static void BuildFilterBank(filterbank_t bank, double cutoff)
 {
-    int         outcount;
-    int         srcsample;
-    float       stepscale;
-    int         i;
-    int         samplefrac, fracstep;
-    sfxcache_t  *sc;
+    double x, y, h, t, w, sum;
+    int p, j;
 
-    stepscale = (float)s_info.rate / dma.speed;      // this is usually 0.5, 1, or 2
+    for (p = 0; p < RESAMPLE_PHASES; p++) {
+        sum = 0;
+        for (j = 0; j < RESAMPLE_TAPS; j++) {
+            // distance from the output position to this source sample
+            x = j - (RESAMPLE_TAPS / 2 - 1) - (double)p / RESAMPLE_PHASES;
+            y = x * cutoff * M_PI;
+            h = fabs(y) < 1e-9 ? 1 : sin(y) / y;
+            // blackman window
+            t = x / (RESAMPLE_TAPS / 2);
+            if (fabs(t) < 1)
+                w = 0.42 + 0.5 * cos(M_PI * t) + 0.08 * cos(2 * M_PI * t);
+            else
+                w = 0;
+            bank[p][j] = h * w;
+            sum += h * w;
+        }
+        // unity gain at DC for every phase
+        for (j = 0; j < RESAMPLE_TAPS; j++) {
+            bank[p][j] /= sum;
+        }
+    }
+}
 
-    outcount = s_info.samples / stepscale;
-    if (!outcount) {
-        Com_DPrintf("%s resampled to zero length\n", s_info.name);
-        sfx->error = Q_ERR_TOO_FEW;
-        return NULL;
+static inline float FilterSample(const float *x, const float *h)
+{
+    float sum = 0;
+    int i;
+
+#if USE_SSE2
+    if (s_mixsimd) {
+        __m128 acc = _mm_mul_ps(_mm_loadu_ps(x), _mm_loadu_ps(h));
+
+        for (i = 4; i < RESAMPLE_TAPS; i += 4) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+        }
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        return _mm_cvtss_f32(acc);
     }
+#endif
 
-    sc = sfx->cache = S_Malloc(outcount * s_info.width + sizeof(sfxcache_t) - 1);
+    for (i = 0; i < RESAMPLE_TAPS; i++) {
+        sum += x[i] * h[i];
+    }
+    return sum;
+}
 
-    sc->length = outcount;
-    sc->loopstart = s_info.loopstart == -1 ? -1 : s_info.loopstart / stepscale;
-    sc->width = s_info.width;
+static float GetSampleFloat(const wavinfo_t *info, int i)
+{
+    if (info->width == 1)
+        return info->data[i] - 128;
+    return (int16_t)LittleShortMem(&info->data[i * 2]);
+}
+
+static void ResampleSinc(const wavinfo_t *info, float stepscale, byte *out, int outcount, float *src)
+{
+    filterbank_t    bank;
+    double          pos;
+    float           val;
+    int             i, j, k, phase;
+
+    BuildFilterBank(bank, stepscale > 1 ? 1.0 / stepscale : 1.0);
+
+    // convert to float with silence around, looping sounds continue
+    // into the loop so that there is no click at the loop point
+    for (i = 0; i < RESAMPLE_TAPS; i++) {
+        src[i] = 0;
+    }
+    for (i = 0; i < info->samples; i++) {
+        src[RESAMPLE_TAPS + i] = GetSampleFloat(info, i);
+    }
+    for (i = 0, k = info->loopstart; i < RESAMPLE_TAPS * 2; i++) {
+        if (k >= 0 && k < info->samples)
+            src[RESAMPLE_TAPS + info->samples + i] = src[RESAMPLE_TAPS + k++];
+        else
+            src[RESAMPLE_TAPS + info->samples + i] = 0;
+    }
+
+    for (i = 0; i < outcount; i++) {
+        pos = (double)i * stepscale;
+        j = (int)pos;
+        phase = (int)((pos - j) * RESAMPLE_PHASES + 0.5);
+        if (phase == RESAMPLE_PHASES) {
+            phase = 0;
+            j++;
+        }
+
+        val = FilterSample(src + RESAMPLE_TAPS / 2 + 1 + j, bank[phase]);
+        k = Q_rint(val);
+        if (info->width == 1) {
+            clamp(k, -128, 127);
+            out[i] = k + 128;
+        } else {
+            clamp(k, -32768, 32767);
+            ((int16_t *)out)[i] = k;
+        }
+    }
+}
+
+static void ResampleNearest(const wavinfo_t *info, float stepscale, byte *out, int outcount)
+{
+    int i, srcsample, samplefrac, fracstep;
+
+    samplefrac = 0;
+    fracstep = stepscale * 256;
+    if (info->width == 1) {
+        for (i = 0; i < outcount; i++) {
+            srcsample = samplefrac >> 8;
+            samplefrac += fracstep;
+            out[i] = info->data[srcsample];
+        }
+    } else {
+        for (i = 0; i < outcount; i++) {
+            srcsample = samplefrac >> 8;
+            samplefrac += fracstep;
+            ((uint16_t *)out)[i] = LittleShort(((uint16_t *)info->data)[srcsample]);
+        }
+    }
+}
+
+// returns number of samples at the given rate
+static int ResampleLength(const wavinfo_t *info, int speed)
+{
+    float stepscale = (float)info->rate / speed;      // this is usually 0.5, 1, or 2
+
+    return info->samples / stepscale;
+}
+
+// returns number of floats ResampleData needs for scratch space
+static size_t ResampleScratch(const wavinfo_t *info, int speed, int quality)
+{
+    if (info->rate == speed || quality <= 0)
+        return 0;
+
+    return info->samples + RESAMPLE_TAPS * 3;
+}
+
+// resamples into out, which must hold ResampleLength() samples.
+// quality 0 picks the nearest source sample, 1 filters.
+// doesn't allocate, safe to call from background tasks.
+static void ResampleData(const wavinfo_t *info, int speed, int quality, byte *out, float *src)
+{
+    float   stepscale = (float)info->rate / speed;
+    int     outcount = info->samples / stepscale;
 
-// resample / decimate to the current source rate
-//Com_Printf("%s: %f, %d\n",sfx->name,stepscale,sc->width);
     if (stepscale == 1) {
 // fast special case
-        if (sc->width == 1) {
-            memcpy(sc->data, s_info.data, outcount);
+        if (info->width == 1) {
+            memcpy(out, info->data, outcount);
         } else {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-            memcpy(sc->data, s_info.data, outcount << 1);
+            memcpy(out, info->data, outcount << 1);
 #else
+            int i;
+
             for (i = 0; i < outcount; i++) {
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[i]);
+                ((uint16_t *)out)[i] = LittleShort(((uint16_t *)info->data)[i]);
             }
 #endif
         }
+    } else if (quality > 0) {
+        ResampleSinc(info, stepscale, out, outcount, src);
     } else {
-// general case
-        samplefrac = 0;
-        fracstep = stepscale * 256;
-        if (sc->width == 1) {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                sc->data[i] = s_info.data[srcsample];
-            }
-        } else {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[srcsample]);
-            }
-        }
+        ResampleNearest(info, stepscale, out, outcount);
     }
+}
+
+/*
+================
+AllocSfxCache
+
+Safe to call from task functions.
+================
+*/
+static sfxcache_t *AllocSfxCache(sfx_t *sfx, const wavinfo_t *info)
+{
+    int         outcount;
+    sfxcache_t  *sc;
 
+    outcount = ResampleLength(info, dma.speed);
+    if (!outcount) {
+        Com_TaskLock();
+        Com_DPrintf("%s resampled to zero length\n", info->name);
+        Com_TaskUnlock();
+        sfx->error = Q_ERR_TOO_FEW;
+        return NULL;
+    }
+
+    Com_TaskLock();
+    sc = S_Malloc(outcount * info->width + sizeof(sfxcache_t) - 1);
+    Com_TaskUnlock();
+
+    sc->length = outcount;
+    sc->loopstart = info->loopstart == -1 ? -1 :
+        info->loopstart / ((float)info->rate / dma.speed);
+    sc->width = info->width;
+
+    return sc;
+}
+
+/*
+================
+ResampleSfx
+
+Safe to call from task functions.
+================
+*/
+static sfxcache_t *ResampleSfx(sfx_t *sfx, const wavinfo_t *info)
+{
+    sfxcache_t  *sc;
+    size_t      scratch;
+    float       *src;
+
+    sc = AllocSfxCache(sfx, info);
+    if (!sc)
+        return NULL;
+
+    scratch = ResampleScratch(info, dma.speed, s_resample->integer);
+    src = NULL;
+    if (scratch) {
+        Com_TaskLock();
+        src = S_Malloc(scratch * sizeof(*src));
+        Com_TaskUnlock();
+    }
+
+    ResampleData(info, dma.speed, s_resample->integer, sc->data, src);
+
+    if (src) {
+        Com_TaskLock();
+        Z_Free(src);
+        Com_TaskUnlock();
+    }
+
+    sfx->cache = sc;
+    return sc;
+}
+
+/*
+===============================================================================
+
+Resampled sound cache
+
+Filtered sounds are saved under soundcache/ in the game directory, keyed
+by checksum and length of the source file and by output rate, so that
+the filter only runs the first time a sound is used at a given rate.
+Files are in native byte order, foreign files fail the ident check.
+
+===============================================================================
+*/
+
+#define SFXCACHE_IDENT      MakeRawLong('S', 'F', 'X', 'C')
+#define SFXCACHE_VERSION    1
+
+typedef struct {
+    uint32_t    ident;
+    uint32_t    version;
+    uint32_t    checksum;
+    uint32_t    srclength;
+    int32_t     speed;
+    int32_t     width;
+    int32_t     length;
+    int32_t     loopstart;
+} sfxcachefile_t;
+
+static size_t SfxCachePath(char *buffer, size_t size, uint32_t checksum, size_t srclength)
+{
+    return Q_snprintf(buffer, size, "soundcache/%08x%08x-%d.sfx",
+                      checksum, (uint32_t)srclength, dma.speed);
+}
+
+static sfxcache_t *ReadSfxCache(sfx_t *sfx, uint32_t checksum, size_t srclength)
+{
+    char            path[MAX_QPATH];
+    sfxcachefile_t  header;
+    sfxcache_t      *sc;
+    qhandle_t       f;
+    size_t          size;
+
+    if (SfxCachePath(path, sizeof(path), checksum, srclength) >= sizeof(path))
+        return NULL;
+
+    FS_FOpenFile(path, &f, FS_MODE_READ | FS_TYPE_REAL | FS_PATH_GAME);
+    if (!f)
+        return NULL;
+
+    sc = NULL;
+    if (FS_Read(&header, sizeof(header), f) != sizeof(header))
+        goto fail;
+    if (header.ident != SFXCACHE_IDENT || header.version != SFXCACHE_VERSION)
+        goto fail;
+    if (header.checksum != checksum || header.srclength != (uint32_t)srclength)
+        goto fail;
+    if (header.speed != dma.speed)
+        goto fail;
+    if (header.width != 1 && header.width != 2)
+        goto fail;
+    if (header.length < 1 || header.length > MAX_LOADFILE / header.width)
+        goto fail;
+    if (header.loopstart < -1 || header.loopstart > header.length)
+        goto fail;
+
+    size = header.length * header.width;
+    sc = S_Malloc(size + sizeof(sfxcache_t) - 1);
+    sc->length = header.length;
+    sc->loopstart = header.loopstart;
+    sc->width = header.width;
+    if (FS_Read(sc->data, size, f) != size) {
+        Z_Free(sc);
+        sc = NULL;
+        goto fail;
+    }
+
+    sfx->cache = sc;
+
+fail:
+    FS_FCloseFile(f);
     return sc;
 }
+
+static void WriteSfxCache(const sfxcache_t *sc, uint32_t checksum, size_t srclength)
+{
+    char            path[MAX_QPATH];
+    sfxcachefile_t  header;
+    qhandle_t       f;
+    size_t          size;
+
+    if (SfxCachePath(path, sizeof(path), checksum, srclength) >= sizeof(path))
+        return;
+
+    FS_FOpenFile(path, &f, FS_MODE_WRITE);
+    if (!f) {
+        Com_DPrintf("Couldn't write %s\n", path);
+        return;
+    }
+
+    header.ident = SFXCACHE_IDENT;
+    header.version = SFXCACHE_VERSION;
+    header.checksum = checksum;
+    header.srclength = srclength;
+    header.speed = dma.speed;
+    header.width = sc->width;
+    header.length = sc->length;
+    header.loopstart = sc->loopstart;
+
+    size = sc->length * sc->width;
+    if (FS_Write(&header, sizeof(header), f) != sizeof(header) ||
+        FS_Write(sc->data, size, f) != size) {
+        Com_DPrintf("Couldn't write %s\n", path);
+    }
+
+    FS_FCloseFile(f);
+}
 #endif
 
 /*
@@ -97,64 +409,68 @@ WAV loading
 ===============================================================================
 */
 
-static byte     *data_p;
-static byte     *iff_end;
-static byte     *iff_data;
-static uint32_t iff_chunk_len;
+// parser state is kept on the stack so that several sounds can be
+// loaded at once by worker threads
+typedef struct {
+    byte        *data_p;
+    byte        *iff_end;
+    byte        *iff_data;
+    uint32_t    iff_chunk_len;
+} iffparse_t;
 
-static int GetLittleShort(void)
+static int GetLittleShort(iffparse_t *p)
 {
     int val;
 
-    if (data_p + 2 > iff_end) {
+    if (p->data_p + 2 > p->iff_end) {
         return -1;
     }
 
-    val = LittleShortMem(data_p);
-    data_p += 2;
+    val = LittleShortMem(p->data_p);
+    p->data_p += 2;
     return val;
 }
 
-static int GetLittleLong(void)
+static int GetLittleLong(iffparse_t *p)
 {
     int val;
 
-    if (data_p + 4 > iff_end) {
+    if (p->data_p + 4 > p->iff_end) {
         return -1;
     }
 
-    val = LittleLongMem(data_p);
-    data_p += 4;
+    val = LittleLongMem(p->data_p);
+    p->data_p += 4;
     return val;
 }
 
-static void FindNextChunk(uint32_t search)
+static void FindNextChunk(iffparse_t *p, uint32_t search)
 {
     uint32_t chunk, len;
     size_t remaining;
 
-    while (data_p + 8 < iff_end) {
-        chunk = RawLongMem(data_p); data_p += 4;
-        len = LittleLongMem(data_p); data_p += 4;
-        remaining = (size_t)(iff_end - data_p);
+    while (p->data_p + 8 < p->iff_end) {
+        chunk = RawLongMem(p->data_p); p->data_p += 4;
+        len = LittleLongMem(p->data_p); p->data_p += 4;
+        remaining = (size_t)(p->iff_end - p->data_p);
         if (len > remaining) {
             len = remaining;
         }
         if (chunk == search) {
-            iff_chunk_len = len;
+            p->iff_chunk_len = len;
             return;
         }
-        data_p += (len + 1) & ~1;
+        p->data_p += (len + 1) & ~1;
     }
 
     // didn't find the chunk
-    data_p = NULL;
+    p->data_p = NULL;
 }
 
-static void FindChunk(uint32_t search)
+static void FindChunk(iffparse_t *p, uint32_t search)
 {
-    data_p = iff_data;
-    FindNextChunk(search);
+    p->data_p = p->iff_data;
+    FindNextChunk(p, search);
 }
 
 #define TAG_RIFF    MakeRawLong('R', 'I', 'F', 'F')
@@ -165,121 +481,118 @@ static void FindChunk(uint32_t search)
 #define TAG_MARK    MakeRawLong('M', 'A', 'R', 'K')
 #define TAG_data    MakeRawLong('d', 'a', 't', 'a')
 
-static qboolean GetWavinfo(void)
+// returns NULL on success, or a description of what is wrong with the file
+static const char *GetWavinfo(wavinfo_t *info, byte *data, size_t len)
 {
+    iffparse_t p;
     int format;
     int samples, width;
     uint32_t chunk;
 
+    p.iff_data = data;
+    p.iff_end = data + len;
+
 // find "RIFF" chunk
-    FindChunk(TAG_RIFF);
-    if (!data_p) {
-        Com_DPrintf("%s has missing/invalid RIFF chunk\n", s_info.name);
-        return qfalse;
+    FindChunk(&p, TAG_RIFF);
+    if (!p.data_p) {
+        return "missing/invalid RIFF chunk";
     }
-    chunk = GetLittleLong();
+    chunk = GetLittleLong(&p);
     if (chunk != TAG_WAVE) {
-        Com_DPrintf("%s has missing/invalid WAVE chunk\n", s_info.name);
-        return qfalse;
+        return "missing/invalid WAVE chunk";
     }
 
-    iff_data = data_p;
+    p.iff_data = p.data_p;
 
 // get "fmt " chunk
-    FindChunk(TAG_fmt);
-    if (!data_p) {
-        Com_DPrintf("%s has missing/invalid fmt chunk\n", s_info.name);
-        return qfalse;
+    FindChunk(&p, TAG_fmt);
+    if (!p.data_p) {
+        return "missing/invalid fmt chunk";
     }
-    format = GetLittleShort();
+    format = GetLittleShort(&p);
     if (format != 1) {
-        Com_DPrintf("%s has non-Microsoft PCM format\n", s_info.name);
-        return qfalse;
+        return "non-Microsoft PCM format";
     }
 
-    format = GetLittleShort();
+    format = GetLittleShort(&p);
     if (format != 1) {
-        Com_DPrintf("%s has bad number of channels\n", s_info.name);
-        return qfalse;
+        return "bad number of channels";
     }
 
-    s_info.rate = GetLittleLong();
-    if (s_info.rate < 8000 || s_info.rate > 48000) {
-        Com_DPrintf("%s has bad rate\n", s_info.name);
-        return qfalse;
+    info->rate = GetLittleLong(&p);
+    if (info->rate < 8000 || info->rate > 48000) {
+        return "bad rate";
     }
 
-    data_p += 4 + 2;
+    p.data_p += 4 + 2;
 
-    width = GetLittleShort();
+    width = GetLittleShort(&p);
     switch (width) {
     case 8:
-        s_info.width = 1;
+        info->width = 1;
         break;
     case 16:
-        s_info.width = 2;
+        info->width = 2;
         break;
     default:
-        Com_DPrintf("%s has bad width\n", s_info.name);
-        return qfalse;
+        return "bad width";
     }
 
 // get cue chunk
-    FindChunk(TAG_cue);
-    if (data_p) {
-        data_p += 24;
-        s_info.loopstart = GetLittleLong();
-        if (s_info.loopstart < 0 || s_info.loopstart > INT_MAX) {
-            Com_DPrintf("%s has bad loop start\n", s_info.name);
-            return qfalse;
+    FindChunk(&p, TAG_cue);
+    if (p.data_p) {
+        p.data_p += 24;
+        info->loopstart = GetLittleLong(&p);
+        if (info->loopstart < 0 || info->loopstart > INT_MAX) {
+            return "bad loop start";
         }
 
-        FindNextChunk(TAG_LIST);
-        if (data_p) {
-            data_p += 20;
-            chunk = GetLittleLong();
+        FindNextChunk(&p, TAG_LIST);
+        if (p.data_p) {
+            p.data_p += 20;
+            chunk = GetLittleLong(&p);
             if (chunk == TAG_MARK) {
                 // this is not a proper parse, but it works with cooledit...
-                data_p += 16;
-                samples = GetLittleLong();    // samples in loop
-                if (samples < 0 || samples > INT_MAX - s_info.loopstart) {
-                    Com_DPrintf("%s has bad loop length\n", s_info.name);
-                    return qfalse;
+                p.data_p += 16;
+                samples = GetLittleLong(&p);    // samples in loop
+                if (samples < 0 || samples > INT_MAX - info->loopstart) {
+                    return "bad loop length";
                 }
-                s_info.samples = s_info.loopstart + samples;
+                info->samples = info->loopstart + samples;
             }
         }
     } else {
-        s_info.loopstart = -1;
+        info->loopstart = -1;
     }
 
 // find data chunk
-    FindChunk(TAG_data);
-    if (!data_p) {
-        Com_DPrintf("%s has missing/invalid data chunk\n", s_info.name);
-        return qfalse;
+    FindChunk(&p, TAG_data);
+    if (!p.data_p) {
+        return "missing/invalid data chunk";
     }
 
-    samples = iff_chunk_len / s_info.width;
+    samples = p.iff_chunk_len / info->width;
     if (!samples) {
-        Com_DPrintf("%s has zero length\n", s_info.name);
-        return qfalse;
+        return "zero length";
     }
 
-    if (s_info.samples) {
-        if (samples < s_info.samples) {
-            Com_DPrintf("%s has bad loop length\n", s_info.name);
-            return qfalse;
+    if (info->samples) {
+        if (samples < info->samples) {
+            return "bad loop length";
         }
     } else {
-        s_info.samples = samples;
+        info->samples = samples;
     }
 
-    s_info.data = data_p;
+    info->data = p.data_p;
 
-    return qtrue;
+    return NULL;
 }
 
+#if USE_SNDDMA
+static void WaitAsyncLoad(sfx_t *s);
+#endif
+
 /*
 ==============
 S_LoadSound
@@ -291,6 +604,7 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     sfxcache_t  *sc;
     ssize_t     len;
     char        *name;
+    const char  *err;
 
     if (s->name[0] == '*')
         return NULL;
@@ -304,6 +618,16 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     if (s->error)
         return NULL;
 
+#if USE_SNDDMA
+    if (s_started == SS_DMA) {
+        if (s->async)
+            WaitAsyncLoad(s);
+        else
+            S_LoadSounds(s, 1);
+        return s->cache;
+    }
+#endif
+
 // load it in
     if (s->truename)
         name = s->truename;
@@ -319,9 +643,9 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     memset(&s_info, 0, sizeof(s_info));
     s_info.name = name;
 
-    iff_data = data;
-    iff_end = data + len;
-    if (!GetWavinfo()) {
+    err = GetWavinfo(&s_info, data, len);
+    if (err) {
+        Com_DPrintf("%s has %s\n", name, err);
         s->error = Q_ERR_INVALID_FORMAT;
         goto fail;
     }
@@ -331,13 +655,387 @@ sfxcache_t *S_LoadSound(sfx_t *s)
         sc = AL_UploadSfx(s);
 #endif
 
-#if USE_SNDDMA
-    if (s_started == SS_DMA)
-        sc = ResampleSfx(s);
-#endif
-
 fail:
     FS_FreeFile(data);
     return sc;
 }
 
+#if USE_SNDDMA
+
+// number of files held in memory at once while loading
+#define MAX_LOAD_BATCH  64
+
+typedef struct {
+    sfx_t       *sfx;
+    char        *name;
+    byte        *data;
+    ssize_t     len;
+    wavinfo_t   info;
+    uint32_t    checksum;
+    qboolean    cacheable;
+    qboolean    missed;
+} sfxload_t;
+
+static void ParseSfxTask(void *data, int index)
+{
+    sfxload_t   *load = (sfxload_t *)data + index;
+    const char  *err;
+
+    memset(&load->info, 0, sizeof(load->info));
+    load->info.name = load->name;
+
+    err = GetWavinfo(&load->info, load->data, load->len);
+    if (err) {
+        Com_TaskLock();
+        Com_DPrintf("%s has %s\n", load->name, err);
+        Com_TaskUnlock();
+        load->sfx->error = Q_ERR_INVALID_FORMAT;
+        return;
+    }
+
+    // only filtered sounds are worth caching
+    load->cacheable = s_resample->integer > 0 && s_resamplecache->integer &&
+                      load->info.rate != dma.speed;
+    if (load->cacheable)
+        load->checksum = Com_BlockChecksum(load->data, load->len);
+}
+
+static void ResampleSfxTask(void *data, int index)
+{
+    sfxload_t   *load = (sfxload_t *)data + index;
+
+    if (load->sfx->error || load->sfx->cache)
+        return;
+
+    ResampleSfx(load->sfx, &load->info);
+}
+
+static void LoadSfxBatch(sfxload_t *batch, int count)
+{
+    sfxload_t   *load;
+    int         i;
+
+    Com_ParallelFor(ParseSfxTask, batch, count);
+
+    for (i = 0, load = batch; i < count; i++, load++) {
+        load->missed = load->cacheable && !load->sfx->error &&
+            !ReadSfxCache(load->sfx, load->checksum, load->len);
+    }
+
+    Com_ParallelFor(ResampleSfxTask, batch, count);
+
+    for (i = 0, load = batch; i < count; i++, load++) {
+        if (load->missed && load->sfx->cache)
+            WriteSfxCache(load->sfx->cache, load->checksum, load->len);
+        FS_FreeFile(load->data);
+    }
+}
+
+/*
+===============================================================================
+
+Background loading
+
+Sounds that were not precached are loaded while the game goes on. Files
+are read and parsed on the main thread, and only resampling is queued to
+a worker, into buffers allocated up front. The sound stays silent until
+S_FinishLoads publishes the result.
+
+===============================================================================
+*/
+
+typedef struct sfxasync_s {
+    list_t      entry;
+    task_t      task;
+    sfxload_t   load;
+    sfxcache_t  *sc;
+    float       *src;       // filter scratch space
+    int         quality;
+} sfxasync_t;
+
+static LIST_DECL(s_asyncloads);
+
+static void ResampleAsyncTask(void *data, int index)
+{
+    sfxasync_t  *as = data;
+
+    ResampleData(&as->load.info, dma.speed, as->quality, as->sc->data, as->src);
+}
+
+static void FinishAsyncLoad(sfxasync_t *as)
+{
+    sfxload_t   *load = &as->load;
+
+    List_Remove(&as->entry);
+    load->sfx->async = NULL;
+    load->sfx->cache = as->sc;
+
+    if (load->missed)
+        WriteSfxCache(as->sc, load->checksum, load->len);
+
+    Z_Free(as->src);
+    FS_FreeFile(load->data);
+    Z_Free(as);
+}
+
+static void WaitAsyncLoad(sfx_t *s)
+{
+    sfxasync_t  *as = s->async;
+
+    Com_WaitTask(&as->task);
+    FinishAsyncLoad(as);
+}
+
+static qboolean QueueAsyncLoad(sfx_t *s)
+{
+    sfxasync_t  *as;
+    sfxload_t   *load;
+    size_t      scratch;
+
+    as = Z_TagMallocz(sizeof(*as), TAG_SOUND);
+    load = &as->load;
+    load->sfx = s;
+    load->name = s->truename ? s->truename : s->name;
+    load->len = FS_LoadFile(load->name, (void **)&load->data);
+    if (!load->data) {
+        s->error = load->len;
+        Z_Free(as);
+        return qfalse;
+    }
+
+    ParseSfxTask(load, 0);
+    if (!s->error) {
+        load->missed = load->cacheable &&
+            !ReadSfxCache(s, load->checksum, load->len);
+    }
+    if (s->error || s->cache)
+        goto done;
+
+    as->sc = AllocSfxCache(s, &load->info);
+    if (!as->sc)
+        goto done;
+
+    as->quality = s_resample->integer;
+    scratch = ResampleScratch(&load->info, dma.speed, as->quality);
+    if (scratch)
+        as->src = S_Malloc(scratch * sizeof(*as->src));
+
+    s->async = as;
+    List_Append(&s_asyncloads, &as->entry);
+    Com_QueueTask(&as->task, ResampleAsyncTask, as);
+    return qtrue;
+
+done:
+    FS_FreeFile(load->data);
+    Z_Free(as);
+    return s->cache != NULL;
+}
+#endif
+
+/*
+==============
+S_LoadSounds
+
+Loads everything that is not yet in memory. Files are read on the main
+thread, parsing and resampling are spread over the worker threads.
+==============
+*/
+void S_LoadSounds(sfx_t *sfx, int count)
+{
+#if USE_SNDDMA
+    sfxload_t   batch[MAX_LOAD_BATCH], *load;
+    int         numload;
+#endif
+    int         i;
+
+#if USE_SNDDMA
+    if (s_started == SS_DMA) {
+        numload = 0;
+        for (i = 0; i < count; i++, sfx++) {
+            if (!sfx->name[0] || sfx->name[0] == '*')
+                continue;
+            if (sfx->cache || sfx->error)
+                continue;
+
+            load = &batch[numload];
+            load->sfx = sfx;
+            load->name = sfx->truename ? sfx->truename : sfx->name;
+            load->len = FS_LoadFile(load->name, (void **)&load->data);
+            if (!load->data) {
+                sfx->error = load->len;
+                continue;
+            }
+
+            if (++numload == MAX_LOAD_BATCH) {
+                LoadSfxBatch(batch, numload);
+                numload = 0;
+            }
+        }
+        LoadSfxBatch(batch, numload);
+        return;
+    }
+#endif
+
+    // OpenAL buffers must be created on the main thread
+    for (i = 0; i < count; i++, sfx++) {
+        if (sfx->name[0])
+            S_LoadSound(sfx);
+    }
+}
+
+/*
+==============
+S_QueueLoad
+
+Starts loading the sound if it is not in memory yet. Missing and broken
+files are detected right away, the data may still be pending when this
+returns qtrue. OpenAL sounds are loaded synchronously.
+==============
+*/
+qboolean S_QueueLoad(sfx_t *s)
+{
+    if (s->name[0] == '*')
+        return qfalse;
+    if (s->cache)
+        return qtrue;
+    if (s->error)
+        return qfalse;
+
+#if USE_SNDDMA
+    if (s_started == SS_DMA) {
+        if (s->async)
+            return qtrue;
+        return QueueAsyncLoad(s);
+    }
+#endif
+
+    return S_LoadSound(s) != NULL;
+}
+
+/*
+==============
+S_FinishLoads
+
+Publishes sounds that finished loading in the background. If wait is set,
+blocks until all pending loads are done.
+==============
+*/
+void S_FinishLoads(qboolean wait)
+{
+#if USE_SNDDMA
+    sfxasync_t  *as, *next;
+
+    LIST_FOR_EACH_SAFE(sfxasync_t, as, next, &s_asyncloads, entry) {
+        if (wait)
+            Com_WaitTask(&as->task);
+        else if (!Com_TaskDone(&as->task))
+            continue;
+        FinishAsyncLoad(as);
+    }
+#endif
+}
+
+#if USE_SNDDMA
+static void TimeResample(const char *what, wavinfo_t *infos, int count, int speed, int quality, byte *out)
+{
+    uint64_t    start, total;
+    size_t      scratch;
+    float       *src;
+    int         i;
+
+    total = 0;
+    for (i = 0; i < count; i++) {
+        scratch = ResampleScratch(&infos[i], speed, quality);
+        src = scratch ? Z_Malloc(scratch * sizeof(*src)) : NULL;
+
+        start = Sys_Microseconds();
+        ResampleData(&infos[i], speed, quality, out, src);
+        total += Sys_Microseconds() - start;
+
+        Z_Free(src);
+    }
+
+    Com_Printf("%-16s %8.3f ms\n", what, total * 1e-3);
+}
+
+/*
+==============
+S_TimeResample_f
+
+Converts every sound in the game to the given rate with each resampler
+and prints total time spent. File loading is not counted.
+==============
+*/
+void S_TimeResample_f(void)
+{
+    void        **list;
+    byte        **files, *out;
+    wavinfo_t   *infos;
+    int         i, count, numinfos, speed, maxlength;
+    ssize_t     len;
+    uint64_t    insamples, outsamples;
+#if USE_SSE2
+    qboolean    simd = s_mixsimd;
+#endif
+
+    speed = dma.speed ? dma.speed : 44100;
+    if (Cmd_Argc() > 1) {
+        speed = atoi(Cmd_Argv(1));
+        clamp(speed, 8000, 48000);
+    }
+
+    list = FS_ListFiles(NULL, "sound/*.wav;players/*.wav", FS_SEARCH_BYFILTER, &count);
+    if (!list) {
+        Com_Printf("No sounds found.\n");
+        return;
+    }
+
+    files = Z_Malloc(count * sizeof(*files));
+    infos = Z_Malloc(count * sizeof(*infos));
+    numinfos = maxlength = 0;
+    insamples = outsamples = 0;
+
+    for (i = 0; i < count; i++) {
+        len = FS_LoadFile(list[i], (void **)&files[numinfos]);
+        if (!files[numinfos])
+            continue;
+
+        memset(&infos[numinfos], 0, sizeof(infos[0]));
+        infos[numinfos].name = list[i];
+        if (GetWavinfo(&infos[numinfos], files[numinfos], len)) {
+            FS_FreeFile(files[numinfos]);
+            continue;
+        }
+
+        len = ResampleLength(&infos[numinfos], speed) * infos[numinfos].width;
+        maxlength = max(maxlength, len);
+        insamples += infos[numinfos].samples;
+        outsamples += ResampleLength(&infos[numinfos], speed);
+        numinfos++;
+    }
+
+    Com_Printf("%d sounds, %"PRIu64" samples resampled to %"PRIu64" at %d Hz\n",
+               numinfos, insamples, outsamples, speed);
+
+    out = Z_Malloc(maxlength + 1);
+
+    TimeResample("nearest", infos, numinfos, speed, 0, out);
+#if USE_SSE2
+    s_mixsimd = qfalse;
+    TimeResample("sinc (scalar)", infos, numinfos, speed, 1, out);
+    s_mixsimd = qtrue;
+    TimeResample("sinc (sse2)", infos, numinfos, speed, 1, out);
+    s_mixsimd = simd;
+#else
+    TimeResample("sinc", infos, numinfos, speed, 1, out);
+#endif
+
+    Z_Free(out);
+    for (i = 0; i < numinfos; i++) {
+        FS_FreeFile(files[i]);
+    }
+    Z_Free(files);
+    Z_Free(infos);
+    FS_FreeList(list);
+}
+#endif
@@ -16,22 +16,245 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 // snd_mix.c -- portable code to mix sounds for snd_dma.c
+//
+// S_PaintChannels decides what gets mixed where and turns it into a list
+// of mix commands. Commands are either executed right away, or handed to
+// the mixer thread through a lock free queue. Either way the same kernels
+// produce the same output.
 
 #include "sound.h"
 
-#define    PAINTBUFFER_SIZE    2048
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <SDL_atomic.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+#define PAINTBUFFER_SIZE    2048
+
+#define MIX_QUEUE_SIZE      1024    // must be a power of two
+#define MIX_QUEUE_MASK      (MIX_QUEUE_SIZE - 1)
+
+#define MIX_RAW_SLOTS       4       // must be a power of two
+
+typedef enum {
+    MIX_PAINT8,     // data is 8 bit sfx, volumes include (j - 128) scale
+    MIX_PAINT16,    // data is 16 bit sfx, volumes are shifted down by 8
+    MIX_RAW,        // data is samplepair_t
+    MIX_TRANSFER    // offset is paintedtime, count is number of samples
+} mixop_t;
+
+typedef struct {
+    mixop_t     op;
+    int         offset;     // into paint buffer
+    int         count;
+    int         leftvol;
+    int         rightvol;
+    const void  *data;
+} mixcmd_t;
 
-static int snd_scaletable[32][256];
 static int snd_vol;
 
+static samplepair_t paintbuffer[PAINTBUFFER_SIZE];
+
 samplepair_t s_rawsamples[S_MAX_RAW_SAMPLES];
 int          s_rawend = 0;
 
-static void WriteLinearBlast(int16_t *out, samplepair_t *samp, int count)
+#if USE_SSE2
+qboolean     s_mixsimd = qtrue;
+#endif
+
+static SDL_Thread   *mix_thread;
+static SDL_sem      *mix_wake;
+static SDL_atomic_t mix_quit;
+
+static mixcmd_t     mix_queue[MIX_QUEUE_SIZE];
+static SDL_atomic_t mix_head;   // written by main thread
+static SDL_atomic_t mix_tail;   // written by mixer thread
+
+// raw samples are copied, main thread overwrites s_rawsamples ahead of
+// its own paintedtime, which can be ahead of the mixer thread
+static samplepair_t mix_rawslots[MIX_RAW_SLOTS][PAINTBUFFER_SIZE];
+static SDL_atomic_t mix_rawhead;
+static SDL_atomic_t mix_rawtail;
+
+/*
+===============================================================================
+
+MIX KERNELS
+
+===============================================================================
+*/
+
+#if USE_SSE2
+
+// SSE2 has no 32 bit multiply, build it from two 32x32->64 multiplies.
+// Low 32 bits of the product don't depend on signedness.
+static inline __m128i mul_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// adds 4 left and 4 right samples to the paint buffer
+static inline void paint_pairs(samplepair_t *samp, __m128i left, __m128i right)
+{
+    __m128i *p = (__m128i *)samp;
+
+    _mm_storeu_si128(p + 0, _mm_add_epi32(_mm_loadu_si128(p + 0), _mm_unpacklo_epi32(left, right)));
+    _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), _mm_unpackhi_epi32(left, right)));
+}
+
+static int Paint8_SSE2(samplepair_t *samp, const uint8_t *sfx, int count, int leftvol, int rightvol)
+{
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i lvol = _mm_set1_epi32(leftvol);
+    const __m128i rvol = _mm_set1_epi32(rightvol);
+    __m128i data, lo, hi;
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8, samp += 8, sfx += 8) {
+        data = _mm_loadl_epi64((const __m128i *)sfx);
+        data = _mm_sub_epi16(_mm_unpacklo_epi8(data, _mm_setzero_si128()), bias);
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(data, data), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(data, data), 16);
+        paint_pairs(samp + 0, mul_epi32(lo, lvol), mul_epi32(lo, rvol));
+        paint_pairs(samp + 4, mul_epi32(hi, lvol), mul_epi32(hi, rvol));
+    }
+
+    return i;
+}
+
+static int Paint16_SSE2(samplepair_t *samp, const int16_t *sfx, int count, int leftvol, int rightvol)
+{
+    const __m128i lvol = _mm_set1_epi32(leftvol);
+    const __m128i rvol = _mm_set1_epi32(rightvol);
+    __m128i data, lo, hi;
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8, samp += 8, sfx += 8) {
+        data = _mm_loadu_si128((const __m128i *)sfx);
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(data, data), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(data, data), 16);
+        paint_pairs(samp + 0, _mm_srai_epi32(mul_epi32(lo, lvol), 8),
+                              _mm_srai_epi32(mul_epi32(lo, rvol), 8));
+        paint_pairs(samp + 4, _mm_srai_epi32(mul_epi32(hi, lvol), 8),
+                              _mm_srai_epi32(mul_epi32(hi, rvol), 8));
+    }
+
+    return i;
+}
+
+static int AddRaw_SSE2(samplepair_t *samp, const samplepair_t *raw, int count)
+{
+    __m128i *p = (__m128i *)samp;
+    const __m128i *r = (const __m128i *)raw;
+    int i;
+
+    for (i = 0; i + 2 <= count; i += 2, p++, r++)
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_loadu_si128(r)));
+
+    return i;
+}
+
+// saturating packs do the clamping
+static int WriteLinearBlast_SSE2(int16_t *out, const samplepair_t *samp, int count)
+{
+    const __m128i *p = (const __m128i *)samp;
+    __m128i a, b, c, d;
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8, p += 4, out += 16) {
+        a = _mm_srai_epi32(_mm_loadu_si128(p + 0), 8);
+        b = _mm_srai_epi32(_mm_loadu_si128(p + 1), 8);
+        c = _mm_srai_epi32(_mm_loadu_si128(p + 2), 8);
+        d = _mm_srai_epi32(_mm_loadu_si128(p + 3), 8);
+        _mm_storeu_si128((__m128i *)out + 0, _mm_packs_epi32(a, b));
+        _mm_storeu_si128((__m128i *)out + 1, _mm_packs_epi32(c, d));
+    }
+
+    return i;
+}
+
+#endif // USE_SSE2
+
+static void Paint8(samplepair_t *samp, const uint8_t *sfx, int count, int leftvol, int rightvol)
+{
+    int data;
+    int i = 0;
+
+#if USE_SSE2
+    if (s_mixsimd) {
+        i = Paint8_SSE2(samp, sfx, count, leftvol, rightvol);
+        samp += i;
+        sfx += i;
+    }
+#endif
+
+    for (; i < count; i++, samp++) {
+        data = *sfx++ - 128;
+        samp->left += data * leftvol;
+        samp->right += data * rightvol;
+    }
+}
+
+static void Paint16(samplepair_t *samp, const int16_t *sfx, int count, int leftvol, int rightvol)
+{
+    int data;
+    int i = 0;
+
+#if USE_SSE2
+    if (s_mixsimd) {
+        i = Paint16_SSE2(samp, sfx, count, leftvol, rightvol);
+        samp += i;
+        sfx += i;
+    }
+#endif
+
+    for (; i < count; i++, samp++) {
+        data = *sfx++;
+        samp->left += (data * leftvol) >> 8;
+        samp->right += (data * rightvol) >> 8;
+    }
+}
+
+static void AddRaw(samplepair_t *samp, const samplepair_t *raw, int count)
+{
+    int i = 0;
+
+#if USE_SSE2
+    if (s_mixsimd) {
+        i = AddRaw_SSE2(samp, raw, count);
+        samp += i;
+        raw += i;
+    }
+#endif
+
+    for (; i < count; i++, samp++, raw++) {
+        samp->left += raw->left;
+        samp->right += raw->right;
+    }
+}
+
+static void WriteLinearBlast(int16_t *out, const samplepair_t *samp, int count)
 {
-    int i, val;
+    int i = 0, val;
+
+#if USE_SSE2
+    if (s_mixsimd) {
+        i = WriteLinearBlast_SSE2(out, samp, count);
+        samp += i;
+        out += i * 2;
+    }
+#endif
 
-    for (i = 0; i < count; i++, samp++, out += 2) {
+    for (; i < count; i++, samp++, out += 2) {
         val = samp->left >> 8;
         out[0] = clamp(val, INT16_MIN, INT16_MAX);
 
@@ -40,14 +263,14 @@ static void WriteLinearBlast(int16_t *out, samplepair_t *samp, int count)
     }
 }
 
-static void TransferStereo16(samplepair_t *samp, int endtime)
+static void TransferStereo16(const samplepair_t *samp, int starttime, int endtime)
 {
     int lpos;
     int ltime;
     int16_t *out;
     int count;
 
-    for (ltime = paintedtime; ltime < endtime;) {
+    for (ltime = starttime; ltime < endtime;) {
         // handle recirculating buffer issues
         lpos = ltime & ((dma.samples >> 1) - 1);
 
@@ -65,17 +288,18 @@ static void TransferStereo16(samplepair_t *samp, int endtime)
     }
 }
 
-static void TransferStereo(samplepair_t *samp, int endtime)
+static void TransferStereo(const samplepair_t *samp, int starttime, int endtime)
 {
     int out_idx, out_mask;
     int count;
-    int *p, val;
+    const int *p;
+    int val;
     int step;
 
-    p = (int *)samp;
-    count = (endtime - paintedtime) * dma.channels;
+    p = (const int *)samp;
+    count = (endtime - starttime) * dma.channels;
     out_mask = dma.samples - 1;
-    out_idx = paintedtime * dma.channels & out_mask;
+    out_idx = starttime * dma.channels & out_mask;
     step = 3 - dma.channels;
 
     if (dma.samplebits == 16) {
@@ -99,23 +323,44 @@ static void TransferStereo(samplepair_t *samp, int endtime)
     }
 }
 
-static void TransferPaintBuffer(samplepair_t *samp, int endtime)
+static void TransferPaintBuffer(samplepair_t *samp, int starttime, int endtime)
 {
     if (s_testsound->integer) {
         int i;
 
         // write a fixed sine wave
-        for (i = paintedtime; i < endtime; i++) {
-            samp[i].left = samp[i].right = sin(i * 0.1) * 20000 * 256;
+        for (i = starttime; i < endtime; i++) {
+            samp[i - starttime].left = samp[i - starttime].right = sin(i * 0.1) * 20000 * 256;
         }
     }
 
     if (dma.samplebits == 16 && dma.channels == 2) {
         // optimized case
-        TransferStereo16(samp, endtime);
+        TransferStereo16(samp, starttime, endtime);
     } else {
         // general case
-        TransferStereo(samp, endtime);
+        TransferStereo(samp, starttime, endtime);
+    }
+}
+
+static void S_RunMixCommand(const mixcmd_t *cmd)
+{
+    switch (cmd->op) {
+    case MIX_PAINT8:
+        Paint8(&paintbuffer[cmd->offset], cmd->data, cmd->count, cmd->leftvol, cmd->rightvol);
+        break;
+    case MIX_PAINT16:
+        Paint16(&paintbuffer[cmd->offset], cmd->data, cmd->count, cmd->leftvol, cmd->rightvol);
+        break;
+    case MIX_RAW:
+        AddRaw(&paintbuffer[cmd->offset], cmd->data, cmd->count);
+        break;
+    case MIX_TRANSFER:
+        if (dma.buffer)
+            TransferPaintBuffer(paintbuffer, cmd->offset, cmd->offset + cmd->count);
+        // clear the paint buffer for the next block
+        memset(paintbuffer, 0, cmd->count * sizeof(samplepair_t));
+        break;
     }
 }
 
@@ -123,68 +368,219 @@ static void TransferPaintBuffer(samplepair_t *samp, int endtime)
 /*
 ===============================================================================
 
-CHANNEL MIXING
+MIXER THREAD
 
 ===============================================================================
 */
 
-static void Paint8(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+static int S_MixerThread(void *arg)
 {
-    int data;
-    int *lscale, *rscale;
-    uint8_t *sfx;
-    int i;
+    mixcmd_t *cmd;
+    int head, tail;
 
-    if (ch->leftvol > 255)
-        ch->leftvol = 255;
-    if (ch->rightvol > 255)
-        ch->rightvol = 255;
+    while (1) {
+        SDL_SemWait(mix_wake);
+        if (SDL_AtomicGet(&mix_quit))
+            break;
 
-    lscale = snd_scaletable[ch->leftvol >> 3];
-    rscale = snd_scaletable[ch->rightvol >> 3];
-    sfx = (uint8_t *)sc->data + ch->pos;
+        head = SDL_AtomicGet(&mix_head);
+        for (tail = SDL_AtomicGet(&mix_tail); tail != head; tail++) {
+            cmd = &mix_queue[tail & MIX_QUEUE_MASK];
+            if (cmd->op == MIX_TRANSFER) {
+                DMA_BeginPainting();
+                S_RunMixCommand(cmd);
+                DMA_Submit();
+            } else {
+                S_RunMixCommand(cmd);
+            }
+            if (cmd->op == MIX_RAW)
+                SDL_AtomicAdd(&mix_rawtail, 1);
+            SDL_AtomicSet(&mix_tail, tail + 1);
+        }
+    }
 
-    for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        samp->left += lscale[data];
-        samp->right += rscale[data];
+    return 0;
+}
+
+static void S_QueueMixCommand(mixcmd_t *cmd)
+{
+    int head, slot;
+
+    if (cmd->op == MIX_RAW) {
+        while (SDL_AtomicGet(&mix_rawhead) - SDL_AtomicGet(&mix_rawtail) >= MIX_RAW_SLOTS) {
+            SDL_SemPost(mix_wake);
+            SDL_Delay(1);
+        }
+        slot = SDL_AtomicGet(&mix_rawhead) & (MIX_RAW_SLOTS - 1);
+        memcpy(mix_rawslots[slot], cmd->data, cmd->count * sizeof(samplepair_t));
+        cmd->data = mix_rawslots[slot];
+        SDL_AtomicAdd(&mix_rawhead, 1);
     }
 
-    ch->pos += count;
+    head = SDL_AtomicGet(&mix_head);
+    while (head - SDL_AtomicGet(&mix_tail) >= MIX_QUEUE_SIZE) {
+        SDL_SemPost(mix_wake);
+        SDL_Delay(1);
+    }
+
+    mix_queue[head & MIX_QUEUE_MASK] = *cmd;
+    SDL_AtomicSet(&mix_head, head + 1);
+
+    // start mixing once the whole block is queued
+    if (cmd->op == MIX_TRANSFER)
+        SDL_SemPost(mix_wake);
 }
 
-static void Paint16(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+static void S_MixCommand(mixcmd_t *cmd)
 {
-    int data;
-    int left, right;
-    int leftvol, rightvol;
-    int16_t *sfx;
-    int i;
+    if (cmd->count <= 0)
+        return;
 
-    leftvol = ch->leftvol * snd_vol;
-    rightvol = ch->rightvol * snd_vol;
-    sfx = (int16_t *)sc->data + ch->pos;
+    if (mix_thread)
+        S_QueueMixCommand(cmd);
+    else
+        S_RunMixCommand(cmd);
+}
 
-    for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        left = (data * leftvol) >> 8;
-        right = (data * rightvol) >> 8;
-        samp->left += left;
-        samp->right += right;
+/*
+================
+S_FlushMixer
+
+Waits for the mixer thread to finish all queued commands. Must be called
+before freeing sounds or touching the DMA buffer directly.
+================
+*/
+void S_FlushMixer(void)
+{
+    if (!mix_thread)
+        return;
+
+    while (SDL_AtomicGet(&mix_tail) != SDL_AtomicGet(&mix_head)) {
+        SDL_SemPost(mix_wake);
+        SDL_Delay(1);
     }
+}
+
+qboolean S_MixerThreaded(void)
+{
+    return mix_thread != NULL;
+}
+
+void S_InitMixer(qboolean threaded)
+{
+    memset(paintbuffer, 0, sizeof(paintbuffer));
+
+    if (!threaded || mix_thread)
+        return;
+
+    SDL_AtomicSet(&mix_head, 0);
+    SDL_AtomicSet(&mix_tail, 0);
+    SDL_AtomicSet(&mix_rawhead, 0);
+    SDL_AtomicSet(&mix_rawtail, 0);
+    SDL_AtomicSet(&mix_quit, 0);
+
+    mix_wake = SDL_CreateSemaphore(0);
+    if (!mix_wake) {
+        Com_WPrintf("Couldn't create mixer semaphore: %s\n", SDL_GetError());
+        return;
+    }
+
+    mix_thread = SDL_CreateThread(S_MixerThread, "mixer", NULL);
+    if (!mix_thread) {
+        Com_WPrintf("Couldn't create mixer thread: %s\n", SDL_GetError());
+        SDL_DestroySemaphore(mix_wake);
+        mix_wake = NULL;
+        return;
+    }
+
+    Com_DPrintf("Started mixer thread\n");
+}
+
+void S_ShutdownMixer(void)
+{
+    if (!mix_thread)
+        return;
+
+    S_FlushMixer();
+
+    SDL_AtomicSet(&mix_quit, 1);
+    SDL_SemPost(mix_wake);
+    SDL_WaitThread(mix_thread, NULL);
+    SDL_DestroySemaphore(mix_wake);
+    mix_thread = NULL;
+    mix_wake = NULL;
+}
+
+
+/*
+===============================================================================
+
+CHANNEL MIXING
+
+===============================================================================
+*/
+
+static void S_PaintChannel(channel_t *ch, sfxcache_t *sc, int count, int offset)
+{
+    mixcmd_t cmd;
+
+    if (sc->width == 1) {
+        // 8 bit sounds have 32 volume levels
+        if (ch->leftvol > 255)
+            ch->leftvol = 255;
+        if (ch->rightvol > 255)
+            ch->rightvol = 255;
+
+        cmd.op = MIX_PAINT8;
+        cmd.leftvol = (ch->leftvol >> 3) * 8 * snd_vol;
+        cmd.rightvol = (ch->rightvol >> 3) * 8 * snd_vol;
+        cmd.data = (uint8_t *)sc->data + ch->pos;
+    } else {
+        cmd.op = MIX_PAINT16;
+        cmd.leftvol = ch->leftvol * snd_vol;
+        cmd.rightvol = ch->rightvol * snd_vol;
+        cmd.data = (int16_t *)sc->data + ch->pos;
+    }
+
+    cmd.offset = offset;
+    cmd.count = count;
+    S_MixCommand(&cmd);
 
     ch->pos += count;
 }
 
+static void S_PaintRawSamples(int end)
+{
+    mixcmd_t cmd;
+    int stop, pos, count;
+
+    if (s_rawend < paintedtime)
+        return;
+
+    // add from the streaming sound source, splitting at the ring wrap
+    stop = min(end, s_rawend);
+    cmd.op = MIX_RAW;
+    cmd.leftvol = cmd.rightvol = 0;
+    for (pos = paintedtime; pos < stop; pos += count) {
+        count = S_MAX_RAW_SAMPLES - (pos & (S_MAX_RAW_SAMPLES - 1));
+        if (count > stop - pos)
+            count = stop - pos;
+        cmd.offset = pos - paintedtime;
+        cmd.count = count;
+        cmd.data = &s_rawsamples[pos & (S_MAX_RAW_SAMPLES - 1)];
+        S_MixCommand(&cmd);
+    }
+}
+
 void S_PaintChannels(int endtime)
 {
-    samplepair_t paintbuffer[PAINTBUFFER_SIZE];
     int i;
     int end;
     channel_t *ch;
     sfxcache_t *sc;
     int ltime, count;
     playsound_t *ps;
+    mixcmd_t cmd;
 
     while (paintedtime < endtime) {
         // if paintbuffer is smaller than DMA buffer
@@ -207,9 +603,6 @@ void S_PaintChannels(int endtime)
             break;
         }
 
-        // clear the paint buffer
-        memset(paintbuffer, 0, (end - paintedtime) * sizeof(samplepair_t));
-
         // paint in the channels.
         ch = channels;
         for (i = 0; i < s_numchannels; i++, ch++) {
@@ -226,17 +619,13 @@ void S_PaintChannels(int endtime)
                 if (ch->end - ltime < count)
                     count = ch->end - ltime;
 
-                sc = S_LoadSound(ch->sfx);
+                // never load from the mixer, skip sounds that aren't ready
+                sc = ch->sfx->cache;
                 if (!sc)
                     break;
 
                 if (count > 0 && ch->sfx) {
-                    samplepair_t *samp = &paintbuffer[ltime - paintedtime];
-                    if (sc->width == 1)
-                        Paint8(ch, sc, count, samp);
-                    else
-                        Paint16(ch, sc, count, samp);
-
+                    S_PaintChannel(ch, sc, count, ltime - paintedtime);
                     ltime += count;
                 }
 
@@ -258,21 +647,16 @@ void S_PaintChannels(int endtime)
 
         }
 
-        if (s_rawend >= paintedtime)
-        {
-          /* add from the streaming sound source */
-          int stop = (end < s_rawend) ? end : s_rawend;
-
-          for (int i = paintedtime; i < stop; i++)
-          {
-            int s = i & (S_MAX_RAW_SAMPLES - 1);
-            paintbuffer[i - paintedtime].left += s_rawsamples[s].left;
-            paintbuffer[i - paintedtime].right += s_rawsamples[s].right;
-          }
-        }
+        S_PaintRawSamples(end);
 
         // transfer out according to DMA format
-        TransferPaintBuffer(paintbuffer, end);
+        cmd.op = MIX_TRANSFER;
+        cmd.offset = paintedtime;
+        cmd.count = end - paintedtime;
+        cmd.leftvol = cmd.rightvol = 0;
+        cmd.data = NULL;
+        S_MixCommand(&cmd);
+
         paintedtime = end;
     }
 }
@@ -280,17 +664,7 @@ void S_PaintChannels(int endtime)
 
 void S_InitScaletable(void)
 {
-    int        i, j;
-    int        scale;
-
     snd_vol = S_GetLinearVolume(s_volume->value) * 256;
-    for (i = 0; i < 32; i++) {
-        scale = i * 8 * snd_vol;
-        for (j = 0; j < 256; j++) {
-            snd_scaletable[i][j] = (j - 128) * scale;
-        }
-    }
-
     s_volume->modified = qfalse;
 }
 
@@ -47,6 +47,7 @@ typedef struct sfx_s {
     sfxcache_t  *cache;
     char        *truename;
     qerror_t    error;
+    struct sfxasync_s   *async; // background load in progress
 } sfx_t;
 
 // a playsound_t will be generated by each call to S_StartSound,
@@ -110,6 +111,8 @@ void DMA_Activate(void);
 int DMA_DriftBeginofs(float timeofs);
 void DMA_ClearBuffer(void);
 void DMA_Update(void);
+void DMA_BeginPainting(void);
+void DMA_Submit(void);
 #endif
 
 #if USE_OPENAL
@@ -161,6 +164,8 @@ extern cvar_t   *s_volume;
 #if USE_SNDDMA
 extern cvar_t   *s_khz;
 extern cvar_t   *s_testsound;
+extern cvar_t   *s_resample;
+extern cvar_t   *s_resamplecache;
 #endif
 extern cvar_t   *s_ambient;
 extern cvar_t   *s_show;
@@ -170,11 +175,24 @@ extern cvar_t   *s_show;
 
 sfx_t *S_SfxForHandle(qhandle_t hSfx);
 sfxcache_t *S_LoadSound(sfx_t *s);
+void S_LoadSounds(sfx_t *sfx, int count);
+qboolean S_QueueLoad(sfx_t *s);
+void S_FinishLoads(qboolean wait);
+#if USE_SNDDMA
+void S_TimeResample_f(void);
+#endif
 channel_t *S_PickChannel(int entnum, int entchannel);
 void S_IssuePlaysound(playsound_t *ps);
 void S_BuildSoundList(int *sounds);
 #if USE_SNDDMA
 void S_InitScaletable(void);
 void S_PaintChannels(int endtime);
+void S_InitMixer(qboolean threaded);
+void S_ShutdownMixer(void);
+void S_FlushMixer(void);
+qboolean S_MixerThreaded(void);
+#if USE_SSE2
+extern qboolean s_mixsimd;  // cleared by tests and benchmarks to select the scalar kernels
+#endif
 #endif
 
@@ -401,6 +401,8 @@ V_RenderView
 */
 void V_RenderView(void)
 {
+    uint64_t td;
+
     // an invalid frame will just use the exact previous refdef
     // we can't use the old frame if the video mode has changed, though...
     if (cl.frame.valid) {
@@ -486,7 +488,9 @@ void V_RenderView(void)
         qsort(cl.refdef.entities, cl.refdef.num_entities, sizeof(cl.refdef.entities[0]), entitycmpfnc);
     }
 
+    td = CL_TimeDemoBegin();
     R_RenderFrame(&cl.refdef);
+    CL_TimeDemoEnd(TD_REFRESH, td);
 #ifdef _DEBUG
     if (cl_stats->integer)
 #if USE_DLIGHTS
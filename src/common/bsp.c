@@ -31,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/utils.h"
 #include "common/mdfour.h"
 #include "system/hunk.h"
+#include "system/system.h"
 
 extern mtexinfo_t nulltexinfo;
 
@@ -802,13 +803,24 @@ static void BSP_List_f(void)
         return;
     }
 
-    Com_Printf("------------------\n");
+    Com_Printf("    hunk msec     pvs msec    pvs2 msec     phs msec name\n"
+               "-------- ---- ------- ---- ------- ---- ------- ---- ----\n");
     bytes = 0;
 
     LIST_FOR_EACH(bsp_t, bsp, &bsp_cache, entry) {
-        Com_Printf("%8"PRIz" : %s (%d refs)\n",
-                   bsp->hunk.mapped, bsp->name, bsp->refcount);
+        Com_Printf("%8"PRIz" %4u %7"PRIz" %4u %7"PRIz" %4u %7"PRIz" %4u %s (%d refs)\n",
+                   bsp->hunk.mapped, bsp->load_msec,
+                   bsp->pvs_matrix ? bsp->vis_matrix_size : 0, bsp->pvs_msec,
+                   bsp->pvs2_matrix ? bsp->vis_matrix_size : 0, bsp->pvs2_msec,
+                   bsp->phs_matrix ? bsp->vis_matrix_size : 0, bsp->phs_msec,
+                   bsp->name, bsp->refcount);
         bytes += bsp->hunk.mapped;
+        if (bsp->pvs_matrix)
+            bytes += bsp->vis_matrix_size;
+        if (bsp->pvs2_matrix)
+            bytes += bsp->vis_matrix_size;
+        if (bsp->phs_matrix)
+            bytes += bsp->vis_matrix_size;
     }
     Com_Printf("Total resident: %"PRIz"\n", bytes);
 }
@@ -938,12 +950,10 @@ void BSP_Free(bsp_t *bsp)
         Com_Error(ERR_FATAL, "%s: negative refcount", __func__);
     }
     if (--bsp->refcount == 0) {
-		if (bsp->pvs2_matrix)
-		{
-			// free the PVS2 matrix separately - it's not part of the hunk
-			Z_Free(bsp->pvs2_matrix);
-			bsp->pvs2_matrix = NULL;
-		}
+        // decompressed visibility is not part of the hunk
+        Z_Free(bsp->pvs_matrix);
+        Z_Free(bsp->pvs2_matrix);
+        Z_Free(bsp->phs_matrix);
 
         Hunk_Free(&bsp->hunk);
         List_Remove(&bsp->entry);
@@ -951,24 +961,104 @@ void BSP_Free(bsp_t *bsp)
     }
 }
 
+/*
+===============================================================================
+
+                    DERIVED VISIBILITY DATA
+
+Decompressed PVS, PHS and second order PVS matrices are built once per map
+and shared by everything holding a reference to the bsp_t: server and MVD
+collision models, client prediction and the renderer.
+
+===============================================================================
+*/
+
+static char *BSP_DecompressVisMatrix(bsp_t *bsp, int vis)
+{
+	// a typical map with 2K clusters will take half a megabyte of memory for the matrix
+	// allocate the matrix but don't set it in the BSP structure yet:
+	// we want BSP_ClusterVis to decompress the original data here, and not use the new empty matrix
+	char* matrix = Z_Mallocz(bsp->vis_matrix_size);
+
+	for (int cluster = 0; cluster < bsp->vis->numclusters; cluster++)
+	{
+		BSP_ClusterVis(bsp, (byte *)matrix + bsp->visrowsize * cluster, cluster, vis);
+	}
+
+	return matrix;
+}
+
 static void BSP_BuildPvsMatrix(bsp_t *bsp)
 {
-	if (!bsp->vis)
+	unsigned start;
+
+	if (!bsp->vis || bsp->pvs_matrix)
 		return;
 
-	// a typical map with 2K clusters will take half a megabyte of memory for the matrix
-	size_t matrix_size = bsp->visrowsize * bsp->vis->numclusters;
+	start = Sys_Milliseconds();
+	bsp->pvs_matrix = BSP_DecompressVisMatrix(bsp, DVIS_PVS);
+	bsp->pvs_msec = Sys_Milliseconds() - start;
+}
+
+/*
+==================
+BSP_BuildPhsMatrix
+
+Called by collision model users that do a lot of PHS queries (server and
+MVD client). Does nothing if the matrix was already built by another user.
+==================
+*/
+void BSP_BuildPhsMatrix(bsp_t *bsp)
+{
+	unsigned start;
+
+	if (!bsp->vis || bsp->phs_matrix)
+		return;
+
+	start = Sys_Milliseconds();
+	bsp->phs_matrix = BSP_DecompressVisMatrix(bsp, DVIS_PHS);
+	bsp->phs_msec = Sys_Milliseconds() - start;
+}
+
+/*
+==================
+BSP_BuildPvs2Matrix
+
+Second order PVS is the union of PVS of all clusters potentially visible
+from the given cluster. Built from the current (possibly patched) PVS
+matrix. Does nothing if the matrix was already built or loaded.
+==================
+*/
+void BSP_BuildPvs2Matrix(bsp_t *bsp)
+{
+	unsigned start;
+
+	if (!bsp->vis || !bsp->pvs_matrix || bsp->pvs2_matrix)
+		return;
+
+	start = Sys_Milliseconds();
+
+	char* pvs2_matrix = Z_Mallocz(bsp->vis_matrix_size);
 
-	// allocate the matrix but don't set it in the BSP structure yet: 
-	// we want BSP_CluterVis to use the old PVS data here, and not the new empty matrix
-	char* pvs_matrix = Z_Mallocz(matrix_size);
-	
 	for (int cluster = 0; cluster < bsp->vis->numclusters; cluster++)
 	{
-		BSP_ClusterVis(bsp, pvs_matrix + bsp->visrowsize * cluster, cluster, DVIS_PVS);
+		const byte* pvs = (byte *)BSP_GetPvs(bsp, cluster);
+		byte* dest_pvs = (byte *)pvs2_matrix + bsp->visrowsize * cluster;
+		memcpy(dest_pvs, pvs, bsp->visrowsize);
+
+		for (int vis_cluster = 0; vis_cluster < bsp->vis->numclusters; vis_cluster++)
+		{
+			if (!Q_IsBitSet(pvs, vis_cluster))
+				continue;
+
+			const byte* pvs2 = (byte *)BSP_GetPvs(bsp, vis_cluster);
+			for (int i = 0; i < bsp->visrowsize; i++)
+				dest_pvs[i] |= pvs2[i];
+		}
 	}
 
-	bsp->pvs_matrix = pvs_matrix;
+	bsp->pvs2_matrix = pvs2_matrix;
+	bsp->pvs2_msec = Sys_Milliseconds() - start;
 }
 
 char* BSP_GetPvs(bsp_t *bsp, int cluster)
@@ -1030,7 +1120,7 @@ static qboolean BSP_LoadPatchedPVS(bsp_t *bsp)
 	if (filebuf == 0)
 		return qfalse;
 
-	size_t matrix_size = bsp->visrowsize * bsp->vis->numclusters;
+	size_t matrix_size = bsp->vis_matrix_size;
 	if (filelen != matrix_size * 2)
 	{
 		FS_FreeFile(filebuf);
@@ -1061,7 +1151,7 @@ qboolean BSP_SavePatchedPVS(bsp_t *bsp)
 	if (!bsp->pvs2_matrix)
 		return qfalse;
 
-	size_t matrix_size = bsp->visrowsize * bsp->vis->numclusters;
+	size_t matrix_size = bsp->vis_matrix_size;
 	unsigned char* filebuf = Z_Malloc(matrix_size * 2);
 
 	memcpy(filebuf, bsp->pvs_matrix, matrix_size);
@@ -1095,6 +1185,7 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
     byte            *lumpdata[HEADER_LUMPS];
     size_t          lumpcount[HEADER_LUMPS];
     size_t          memsize;
+    unsigned        start;
 
     if (!name || !bsp_p)
         Com_Error(ERR_FATAL, "%s: NULL", __func__);
@@ -1111,6 +1202,8 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
         return Q_ERR_SUCCESS;
     }
 
+    start = Sys_Milliseconds();
+
     //
     // load the file
     //
@@ -1186,20 +1279,32 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
         goto fail1;
     }
 
-	if (!BSP_LoadPatchedPVS(bsp))
+    if (bsp->vis) {
+        bsp->vis_matrix_size = bsp->visrowsize * bsp->vis->numclusters;
+    }
+
+    Hunk_End(&bsp->hunk);
+
+    bsp->load_msec = Sys_Milliseconds() - start;
+
+	if (!bsp->vis)
 	{
-		if (dedicated->integer)
-			Com_WPrintf("WARNING: Pathced PVS file for %s unavailable. Some entities may disappear.\n"
-				"Load the map with the RTX renderer once to generate the patched PVS file.\n", bsp->name);
-		else
-			BSP_BuildPvsMatrix(bsp);
+		// nothing to decompress
 	}
-	else
+	else if (BSP_LoadPatchedPVS(bsp))
 	{
 		bsp->pvs_patched = qtrue;
 	}
+	else
+	{
+		if (dedicated->integer)
+			Com_WPrintf("WARNING: Pathced PVS file for %s unavailable. Some entities may disappear.\n"
+				"Load the map with the RTX renderer once to generate the patched PVS file.\n", bsp->name);
 
-    Hunk_End(&bsp->hunk);
+		// dedicated server queries PVS of every client each frame, so it
+		// benefits from the decompressed matrix as much as the renderer
+		BSP_BuildPvsMatrix(bsp);
+	}
 
     List_Append(&bsp_cache, &bsp->entry);
 
@@ -1371,6 +1476,12 @@ byte *BSP_ClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis)
 		return mask;
 	}
 
+	if (vis == DVIS_PHS && bsp->phs_matrix)
+	{
+		memcpy(mask, bsp->phs_matrix + bsp->visrowsize * cluster, bsp->visrowsize);
+		return mask;
+	}
+
     // decompress vis
     in_end = (byte *)bsp->vis + bsp->numvisibility;
     in = (byte *)bsp->vis + bsp->vis->bitofs[cluster][vis];
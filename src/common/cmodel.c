@@ -71,6 +71,9 @@ qerror_t CM_LoadMap(cm_t *cm, const char *name)
         return ret;
     }
 
+    // collision model users do PHS queries for every multicast and client
+    BSP_BuildPhsMatrix(cache);
+
     cm->cache = cache;
     cm->floodnums = Z_TagMallocz(sizeof(int) * cm->cache->numareas +
                                  sizeof(qboolean) * (cm->cache->lastareaportal + 1), TAG_CMODEL);
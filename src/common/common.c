@@ -40,6 +40,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/pmove.h"
 #include "common/prompt.h"
 #include "common/protocol.h"
+#include "common/tasks.h"
 #include "common/tests.h"
 #include "common/utils.h"
 #include "common/x86/fpu.h"
@@ -621,6 +622,7 @@ void Com_Quit(const char *reason, error_type_t type)
 
     SV_Shutdown(buffer, type);
     CL_Shutdown();
+    Com_ShutdownTasks();
     NET_Shutdown();
     logfile_close();
     FS_Shutdown();
@@ -1023,6 +1025,7 @@ void Qcommon_Init(int argc, char **argv)
     // The log file is opened during the execution of one of the config files above.
     Com_LPrintf(PRINT_NOTICE, "\nEngine version: " APPLICATION " " LONG_VERSION_STRING ", built on " __DATE__ "\n\n");
 
+    Com_InitTasks();
     Netchan_Init();
     NET_Init();
     BSP_Init();
@@ -1101,7 +1104,8 @@ void Qcommon_Frame(void)
 
     // sleep on network sockets when running a dedicated server
     // still do a select(), but don't sleep when running a client!
-    NET_Sleep(remaining);
+    // deadline is relative to the start of the last frame, not to now
+    NET_SleepUntil(com_eventTime + remaining);
 
     // calculate time spent running last frame and sleeping
     oldtime = com_eventTime;
@@ -133,6 +133,7 @@ typedef struct {
     packfile_t  *files;
     packfile_t  **file_hash;
     unsigned    hash_size;
+    packfile_t  **file_sorted;  // sorted by name for directory listing
     char        *names;
     char        *filename;
 } pack_t;
@@ -184,15 +185,21 @@ static int          fs_count_read;
 static int          fs_count_open;
 static int          fs_count_strcmp;
 static int          fs_count_strlwr;
+static int          fs_count_dirhit;
+static int          fs_count_dirmiss;
 #define FS_COUNT_READ       fs_count_read++
 #define FS_COUNT_OPEN       fs_count_open++
 #define FS_COUNT_STRCMP     fs_count_strcmp++
 #define FS_COUNT_STRLWR     fs_count_strlwr++
+#define FS_COUNT_DIRHIT     fs_count_dirhit++
+#define FS_COUNT_DIRMISS    fs_count_dirmiss++
 #else
 #define FS_COUNT_READ       (void)0
 #define FS_COUNT_OPEN       (void)0
 #define FS_COUNT_STRCMP     (void)0
 #define FS_COUNT_STRLWR     (void)0
+#define FS_COUNT_DIRHIT     (void)0
+#define FS_COUNT_DIRMISS    (void)0
 #endif
 
 #ifdef _DEBUG
@@ -841,6 +848,36 @@ static qerror_t get_fp_info(FILE *fp, file_info_t *info)
     return Q_ERR_SUCCESS;
 }
 
+/*
+============
+FS_FileInfo
+
+Returns size and times of the file being read. For files inside packs,
+times are those of the pack file.
+============
+*/
+qerror_t FS_FileInfo(qhandle_t f, file_info_t *info)
+{
+    file_t *file = file_for_handle(f);
+    qerror_t ret;
+
+    if (!file)
+        return Q_ERR_BADF;
+
+    if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
+        return Q_ERR_NOSYS;
+
+    if (!file->fp)
+        return Q_ERR_BADF;
+
+    ret = get_fp_info(file->fp, info);
+    if (ret)
+        return ret;
+
+    info->size = file->length;
+    return Q_ERR_SUCCESS;
+}
+
 static inline FILE *fopen_hack(const char *path, const char *mode)
 {
 #ifndef _GNU_SOURCE
@@ -2090,6 +2127,7 @@ static pack_t *pack_alloc(FILE *fp, filetype_t type, const char *name,
     pack = FS_Malloc(sizeof(pack_t) +
                      num_files * sizeof(packfile_t) +
                      hash_size * sizeof(packfile_t *) +
+                     num_files * sizeof(packfile_t *) +
                      len + names_len);
     pack->type = type;
     pack->refcount = 0;
@@ -2098,7 +2136,8 @@ static pack_t *pack_alloc(FILE *fp, filetype_t type, const char *name,
     pack->hash_size = hash_size;
     pack->files = (packfile_t *)(pack + 1);
     pack->file_hash = (packfile_t **)(pack->files + num_files);
-    pack->filename = (char *)(pack->file_hash + hash_size);
+    pack->file_sorted = pack->file_hash + hash_size;
+    pack->filename = (char *)(pack->file_sorted + num_files);
     pack->names = pack->filename + len;
     memcpy(pack->filename, name, len);
     memset(pack->file_hash, 0, hash_size * sizeof(packfile_t *));
@@ -2118,6 +2157,43 @@ static void pack_hash_file(pack_t *pack, packfile_t *file)
     pack->file_hash[hash] = file;
 }
 
+static int packfilecmp(const void *p1, const void *p2)
+{
+    packfile_t *f1 = *(packfile_t **)p1;
+    packfile_t *f2 = *(packfile_t **)p2;
+
+    return FS_pathcmp(f1->name, f2->name);
+}
+
+// sorts filenames so that files sharing any prefix form a contiguous range
+static void pack_sort_files(pack_t *pack)
+{
+    unsigned i;
+
+    for (i = 0; i < pack->num_files; i++) {
+        pack->file_sorted[i] = &pack->files[i];
+    }
+
+    qsort(pack->file_sorted, pack->num_files, sizeof(pack->file_sorted[0]), packfilecmp);
+}
+
+// returns index of the first sorted file beginning with `key'
+static unsigned pack_find_prefix(pack_t *pack, const char *key, size_t keylen)
+{
+    unsigned lo = 0, hi = pack->num_files, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (FS_pathcmpn(pack->file_sorted[mid]->name, key, keylen) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
 // Loads the header and directory, adding the files at the beginning
 // of the list so they override previous pack files.
 static pack_t *load_pak_file(const char *packfile)
@@ -2212,6 +2288,8 @@ static pack_t *load_pak_file(const char *packfile)
         file++;
     }
 
+    pack_sort_files(pack);
+
     FS_DPrintf("%s: %u files, %u hash\n",
                packfile, pack->num_files, pack->hash_size);
 
@@ -2468,6 +2546,8 @@ static pack_t *load_zip_file(const char *packfile)
         }
     }
 
+    pack_sort_files(pack);
+
     FS_DPrintf("%s: %u files, %u skipped, %u hash\n",
                packfile, pack->num_files, num_files_cd - pack->num_files, pack->hash_size);
 
@@ -2710,21 +2790,261 @@ static int alphacmp(const void *p1, const void *p2)
 
 /*
 =================
-FS_ListFiles
+Directory cache
+
+Listings of physical directories are kept between FS_ListFiles calls and
+revalidated by directory modification time. Directory mtime has one second
+resolution on some systems, so listings made within a second of the last
+change are not trusted and are read again next time. File sizes and times
+are those at listing time, writing to an existing file doesn't update them.
 =================
 */
-void **FS_ListFiles(const char *path,
-                    const char *filter,
-                    unsigned   flags,
-                    int        *count_p)
+
+#define DIR_CACHE_SIZE  32  // must be a power of 2
+
+typedef struct {
+    char        *path;
+    time_t      mtime;      // directory mtime when listed
+    time_t      listed;     // time of listing
+    int         numfiles;
+    int         numdirs;
+    file_info_t **files;    // files followed by subdirectories, sorted by name
+} dircache_t;
+
+static dircache_t   fs_dircache[DIR_CACHE_SIZE];
+static unsigned     fs_dircache_next;
+
+static void free_dir_cache(dircache_t *dc)
+{
+    int i;
+
+    for (i = 0; i < dc->numfiles + dc->numdirs; i++) {
+        Z_Free(dc->files[i]);
+    }
+    Z_Free(dc->files);
+    Z_Free(dc->path);
+    memset(dc, 0, sizeof(*dc));
+}
+
+static void free_all_dir_caches(void)
+{
+    int i;
+
+    for (i = 0; i < DIR_CACHE_SIZE; i++) {
+        free_dir_cache(&fs_dircache[i]);
+    }
+}
+
+static qboolean fill_dir_cache(dircache_t *dc, const char *path, time_t mtime)
+{
+    void **list;
+    time_t now;
+    int i, numfiles, count;
+
+    now = time(NULL);
+    list = FS_Malloc(sizeof(void *) * MAX_LISTED_FILES);
+
+    count = 0;
+    Sys_ListFiles_r(path, NULL, FS_SEARCH_EXTRAINFO, 0, &count, list, 0);
+    numfiles = count;
+    if (count < MAX_LISTED_FILES) {
+        Sys_ListFiles_r(path, NULL, FS_SEARCH_DIRSONLY | FS_SEARCH_EXTRAINFO, 0, &count, list, 0);
+    }
+
+    if (count >= MAX_LISTED_FILES) {
+        // too large to cache
+        for (i = 0; i < count; i++) {
+            Z_Free(list[i]);
+        }
+        Z_Free(list);
+        return qfalse;
+    }
+
+    dc->path = FS_CopyString(path);
+    dc->mtime = mtime;
+    dc->listed = now;
+    dc->numfiles = numfiles;
+    dc->numdirs = count - numfiles;
+    dc->files = (file_info_t **)FS_CopyList(list, count);
+    Z_Free(list);
+
+    qsort(dc->files, dc->numfiles, sizeof(dc->files[0]), infocmp);
+    qsort(dc->files + dc->numfiles, dc->numdirs, sizeof(dc->files[0]), infocmp);
+    return qtrue;
+}
+
+// returns index of the first sorted entry beginning with `key'
+static int dir_find_prefix(file_info_t **files, int count, const char *key, size_t keylen)
+{
+    int lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (FS_pathcmpn(files[mid]->name, key, keylen) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// merges two prefixes a name must begin with into the longer one.
+// returns its length, or -1 if no name can begin with both.
+static int merge_prefixes(char *key, const char *a, size_t alen, const char *b, size_t blen)
+{
+    if (alen < blen) {
+        return merge_prefixes(key, b, blen, a, alen);
+    }
+
+    if (alen >= MAX_OSPATH || FS_pathcmpn(a, b, blen)) {
+        return -1;
+    }
+
+    memmove(key, a, alen);
+    key[alen] = 0;
+    return alen;
+}
+
+// lists single directory from cache, following Sys_ListFiles_r conventions
+// for non-recursive searches. if prefix is given, only names that may begin
+// with it are listed. returns qfalse if directory can't be cached.
+static qboolean list_dir_cached(const char  *path,
+                                const char  *filter,
+                                unsigned    flags,
+                                size_t      baselen,
+                                const char  *prefix,
+                                int         *count_p,
+                                void        **files)
+{
+    Q_STATBUF st;
+    dircache_t *dc;
+    char fullpath[MAX_OSPATH], lead[MAX_OSPATH], key[MAX_OSPATH];
+    file_info_t **entries;
+    char *name;
+    int i, count, keylen;
+    size_t len, leadlen;
+
+    if (os_stat(path, &st) == -1 || !Q_ISDIR(st.st_mode)) {
+        return qtrue;   // nothing to list
+    }
+
+    for (i = 0, dc = fs_dircache; i < DIR_CACHE_SIZE; i++, dc++) {
+        if (dc->path && !strcmp(dc->path, path)) {
+            break;
+        }
+    }
+
+    if (i == DIR_CACHE_SIZE) {
+        dc = &fs_dircache[fs_dircache_next++ & (DIR_CACHE_SIZE - 1)];
+        free_dir_cache(dc);
+    } else if (dc->mtime != st.st_mtime || dc->listed <= dc->mtime + 1) {
+        free_dir_cache(dc);
+    }
+
+    if (dc->path) {
+        FS_COUNT_DIRHIT;
+    } else {
+        FS_COUNT_DIRMISS;
+        if (!fill_dir_cache(dc, path, st.st_mtime)) {
+            return qfalse;
+        }
+    }
+
+    if (flags & FS_SEARCH_DIRSONLY) {
+        entries = dc->files + dc->numfiles;
+        count = dc->numdirs;
+    } else {
+        entries = dc->files;
+        count = dc->numfiles;
+    }
+
+    // listed names are prefixed with the saved path, if any
+    keylen = 0;
+    leadlen = 0;
+    if (prefix) {
+        if (flags & FS_SEARCH_SAVEPATH) {
+            leadlen = Q_concat(lead, sizeof(lead), path + baselen, "/", NULL);
+            if (leadlen >= sizeof(lead)) {
+                return qtrue;
+            }
+        }
+        keylen = merge_prefixes(key, lead, leadlen, prefix, strlen(prefix));
+        if (keylen < 0) {
+            return qtrue;   // nothing can match
+        }
+        keylen -= leadlen;
+        i = dir_find_prefix(entries, count, key + leadlen, keylen);
+    } else {
+        i = 0;
+    }
+
+    for (; i < count; i++) {
+        if (keylen && FS_pathcmpn(entries[i]->name, key + leadlen, keylen)) {
+            break;  // past the end of range
+        }
+
+        // check filter
+        if (filter && !FS_ExtCmp(filter, entries[i]->name)) {
+            continue;
+        }
+
+        len = Q_concat(fullpath, sizeof(fullpath), path, "/", entries[i]->name, NULL);
+        if (len >= sizeof(fullpath)) {
+            continue;
+        }
+
+        // strip path
+        if (flags & FS_SEARCH_SAVEPATH) {
+            name = fullpath + baselen;
+        } else {
+            name = fullpath + len - strlen(entries[i]->name);
+        }
+
+        // strip extension
+        if (flags & FS_SEARCH_STRIPEXT) {
+            *COM_FileExtension(name) = 0;
+
+            if (!*name) {
+                continue;
+            }
+        }
+
+        // copy info off
+        if (flags & FS_SEARCH_EXTRAINFO) {
+            files[(*count_p)++] = FS_CopyInfo(name,
+                                              entries[i]->size,
+                                              entries[i]->ctime,
+                                              entries[i]->mtime);
+        } else {
+            files[(*count_p)++] = FS_CopyString(name);
+        }
+
+        if (*count_p >= MAX_LISTED_FILES) {
+            break;
+        }
+    }
+
+    return qtrue;
+}
+
+// lists files like FS_ListFiles. if prefix is given, names that can't begin
+// with it may be left out, but the caller still has to check the rest.
+static void **list_files(const char *path,
+                         const char *filter,
+                         unsigned   flags,
+                         const char *prefix,
+                         int        *count_p)
 {
     searchpath_t    *search;
     packfile_t      *file;
     void            *files[MAX_LISTED_FILES], *info;
-    int             i, j, count, total;
+    int             i, j, count, total, keylen;
     char            normalized[MAX_OSPATH], buffer[MAX_OSPATH];
+    char            dir[MAX_OSPATH], key[MAX_OSPATH];
     void            **list;
-    size_t          len, pathlen;
+    size_t          len, pathlen, dirlen, leadlen;
     char            *s, *p;
     int             valid;
 
@@ -2749,6 +3069,35 @@ void **FS_ListFiles(const char *path,
         goto fail;
     }
 
+    // pack files listed are under `path/' directory
+    dirlen = 0;
+    if (pathlen) {
+        dirlen = Q_concat(dir, sizeof(dir), path, "/", NULL);
+        if (dirlen >= sizeof(dir)) {
+            goto fail;
+        }
+    }
+
+    keylen = dirlen;
+    memcpy(key, dir, dirlen);
+
+    // where the listed part of the name starts is known unless the path
+    // is stripped, then the prefix narrows the range further
+    if (prefix && (flags & (FS_SEARCH_DIRSONLY | FS_SEARCH_SAVEPATH))) {
+        if (flags & (FS_SEARCH_DIRSONLY | FS_SEARCH_BYFILTER)) {
+            leadlen = dirlen;
+        } else {
+            leadlen = 0;
+        }
+        memcpy(buffer, dir, leadlen);
+        len = leadlen + Q_strlcpy(buffer + leadlen, prefix, sizeof(buffer) - leadlen);
+        if (len < sizeof(buffer)) {
+            keylen = merge_prefixes(key, dir, dirlen, buffer, len);
+        } else {
+            keylen = -1;
+        }
+    }
+
     for (search = fs_searchpaths; search; search = search->next) {
         if (flags & FS_PATH_MASK) {
             if ((flags & search->mode & FS_PATH_MASK) == 0) {
@@ -2760,21 +3109,26 @@ void **FS_ListFiles(const char *path,
                 continue; // don't search in paks
             }
 
-            for (i = 0; i < search->pack->num_files; i++) {
-                file = &search->pack->files[i];
+            // files beginning with the key are contiguous in sorted order
+            if (keylen < 0) {
+                continue;   // nothing can match
+            }
+            if (keylen) {
+                i = pack_find_prefix(search->pack, key, keylen);
+            } else {
+                i = 0;
+            }
+
+            for (; i < search->pack->num_files; i++) {
+                file = search->pack->file_sorted[i];
                 s = file->name;
 
+                if (keylen && FS_pathcmpn(s, key, keylen)) {
+                    break;      // past the end of range
+                }
+
                 // check path
                 if (pathlen) {
-                    if (file->namelen < pathlen) {
-                        continue;
-                    }
-                    if (FS_pathcmpn(s, path, pathlen)) {
-                        continue;
-                    }
-                    if (s[pathlen] != '/') {
-                        continue;   // matched prefix must be a directory
-                    }
                     if (flags & FS_SEARCH_BYFILTER) {
                         s += pathlen + 1;
                     }
@@ -2878,7 +3232,11 @@ void **FS_ListFiles(const char *path,
                 len += pathlen + 1;
             }
 
-            Sys_ListFiles_r(s, filter, flags, len, &count, files, 0);
+            // pattern search is recursive, it always goes to disk
+            if ((flags & FS_SEARCH_BYFILTER) ||
+                !list_dir_cached(s, filter, flags, len, prefix, &count, files)) {
+                Sys_ListFiles_r(s, filter, flags, len, &count, files, 0);
+            }
         }
 
         if (count >= MAX_LISTED_FILES) {
@@ -2931,6 +3289,19 @@ fail:
     return list;
 }
 
+/*
+=================
+FS_ListFiles
+=================
+*/
+void **FS_ListFiles(const char *path,
+                    const char *filter,
+                    unsigned   flags,
+                    int        *count_p)
+{
+    return list_files(path, filter, flags, NULL, count_p);
+}
+
 /*
 =================
 FS_FreeList
@@ -2957,7 +3328,7 @@ void FS_File_g(const char *path, const char *ext, unsigned flags, genctx_t *ctx)
     void **list;
     char *s;
 
-    list = FS_ListFiles(path, ext, flags, &numFiles);
+    list = list_files(path, ext, flags, ctx->partial, &numFiles);
     if (!list) {
         return;
     }
@@ -3296,6 +3667,7 @@ static void FS_Stats_f(void)
     Com_Printf("Total path comparsions: %d\n", fs_count_strcmp);
     Com_Printf("Total calls to open_from_disk: %d\n", fs_count_open);
     Com_Printf("Total mixed-case reopens: %d\n", fs_count_strlwr);
+    Com_Printf("Directory cache hits/misses: %d/%d\n", fs_count_dirhit, fs_count_dirmiss);
 
     if (!totalHashSize) {
         Com_Printf("No stats to display\n");
@@ -3557,6 +3929,8 @@ void FS_Restart(qboolean total)
 {
     Com_Printf("----- FS_Restart -----\n");
 
+    free_all_dir_caches();
+
     if (total) {
         // perform full reset
         free_all_paths();
@@ -3634,6 +4008,7 @@ void FS_Shutdown(void)
 
     // free search paths
     free_all_paths();
+    free_all_dir_caches();
 
 #if USE_ZLIB
     inflateEnd(&fs_zipstream.stream);
@@ -22,6 +22,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/sizebuf.h"
 #include "common/math.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 /*
 ==============================================================================
 
@@ -502,10 +506,56 @@ void MSG_PackEntity(entity_packed_t *out, const entity_state_t *in, qboolean sho
     out->event = in->event;
 }
 
+// bit N is set if byte N of entity_packed_t differs
+#define ES_DIFF(f) \
+    ((((uint64_t)1 << sizeof(((entity_packed_t *)0)->f)) - 1) << q_offsetof(entity_packed_t, f))
+
+/*
+=============
+MSG_EntityDiff
+
+Compares packed entities as raw bytes, which is valid because
+entity_packed_t has no padding and MSG_PackEntity sets every field.
+=============
+*/
+static inline uint64_t MSG_EntityDiff(const entity_packed_t *from,
+                                      const entity_packed_t *to)
+{
+    const byte *a = (const byte *)from;
+    const byte *b = (const byte *)to;
+    uint64_t equal = 0;
+    size_t i, ofs;
+
+#if USE_SSE2
+    // overlapping unaligned loads cover the whole structure without
+    // reading past its end
+    for (i = 0; i < sizeof(entity_packed_t); i += 16) {
+        ofs = min(i, sizeof(entity_packed_t) - 16);
+        equal |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                     _mm_loadu_si128((const __m128i *)(a + ofs)),
+                     _mm_loadu_si128((const __m128i *)(b + ofs)))) << ofs;
+    }
+#else
+    for (i = 0, ofs = 0; i < sizeof(entity_packed_t); i++) {
+        equal |= (uint64_t)(a[i] == b[i]) << i;
+    }
+    (void)ofs;
+#endif
+
+    return ~equal & (((uint64_t)1 << sizeof(entity_packed_t)) - 1);
+}
+
+#define WB(c)   (*p++ = (c))
+#define WS(c)   (p[0] = (c) & 0xff, p[1] = ((c) >> 8) & 0xff, p += 2)
+#define WL(c)   (p[0] = (c) & 0xff, p[1] = ((c) >> 8) & 0xff, \
+                 p[2] = ((c) >> 16) & 0xff, p[3] = ((c) >> 24) & 0xff, p += 4)
+
 void MSG_WriteDeltaEntity(const entity_packed_t *from,
                           const entity_packed_t *to,
                           msgEsFlags_t          flags)
 {
+    byte        buffer[MAX_ENTITY_DELTA], *p;
+    uint64_t    diff;
     uint32_t    bits, mask;
 
     if (!to) {
@@ -537,32 +587,28 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
     if (!from)
         from = &nullEntityState;
 
+    diff = MSG_EntityDiff(from, to);
+
 // send an update
     bits = 0;
 
     if (!(flags & MSG_ES_FIRSTPERSON)) {
-        if (to->origin[0] != from->origin[0])
+        if (diff & ES_DIFF(origin[0]))
             bits |= U_ORIGIN1;
-        if (to->origin[1] != from->origin[1])
+        if (diff & ES_DIFF(origin[1]))
             bits |= U_ORIGIN2;
-        if (to->origin[2] != from->origin[2])
+        if (diff & ES_DIFF(origin[2]))
             bits |= U_ORIGIN3;
 
-        if (flags & MSG_ES_SHORTANGLES) {
-            if (to->angles[0] != from->angles[0])
-                bits |= U_ANGLE1 | U_ANGLE16;
-            if (to->angles[1] != from->angles[1])
-                bits |= U_ANGLE2 | U_ANGLE16;
-            if (to->angles[2] != from->angles[2])
-                bits |= U_ANGLE3 | U_ANGLE16;
-        } else {
-            if (to->angles[0] != from->angles[0])
-                bits |= U_ANGLE1;
-            if (to->angles[1] != from->angles[1])
-                bits |= U_ANGLE2;
-            if (to->angles[2] != from->angles[2])
-                bits |= U_ANGLE3;
-        }
+        if (diff & ES_DIFF(angles[0]))
+            bits |= U_ANGLE1;
+        if (diff & ES_DIFF(angles[1]))
+            bits |= U_ANGLE2;
+        if (diff & ES_DIFF(angles[2]))
+            bits |= U_ANGLE3;
+
+        if ((flags & MSG_ES_SHORTANGLES) && (bits & (U_ANGLE1 | U_ANGLE2 | U_ANGLE3)))
+            bits |= U_ANGLE16;
 
         if (flags & MSG_ES_NEWENTITY) {
             if (to->old_origin[0] != from->origin[0] ||
@@ -577,7 +623,7 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
     else
         mask = 0xffff8000;  // don't confuse old clients
 
-    if (to->skinnum != from->skinnum) {
+    if (diff & ES_DIFF(skinnum)) {
         if (to->skinnum & mask)
             bits |= U_SKIN8 | U_SKIN16;
         else if (to->skinnum & 0x0000ff00)
@@ -586,14 +632,14 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
             bits |= U_SKIN8;
     }
 
-    if (to->frame != from->frame) {
+    if (diff & ES_DIFF(frame)) {
         if (to->frame & 0xff00)
             bits |= U_FRAME16;
         else
             bits |= U_FRAME8;
     }
 
-    if (to->effects != from->effects) {
+    if (diff & ES_DIFF(effects)) {
         if (to->effects & mask)
             bits |= U_EFFECTS8 | U_EFFECTS16;
         else if (to->effects & 0x0000ff00)
@@ -602,7 +648,7 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
             bits |= U_EFFECTS8;
     }
 
-    if (to->renderfx != from->renderfx) {
+    if (diff & ES_DIFF(renderfx)) {
         if (to->renderfx & mask)
             bits |= U_RENDERFX8 | U_RENDERFX16;
         else if (to->renderfx & 0x0000ff00)
@@ -611,32 +657,30 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
             bits |= U_RENDERFX8;
     }
 
-    if (to->solid != from->solid)
+    if (diff & ES_DIFF(solid))
         bits |= U_SOLID;
 
     // event is not delta compressed, just 0 compressed
     if (to->event)
         bits |= U_EVENT;
 
-    if (to->modelindex != from->modelindex)
+    if (diff & ES_DIFF(modelindex))
         bits |= U_MODEL;
-    if (to->modelindex2 != from->modelindex2)
+    if (diff & ES_DIFF(modelindex2))
         bits |= U_MODEL2;
-    if (to->modelindex3 != from->modelindex3)
+    if (diff & ES_DIFF(modelindex3))
         bits |= U_MODEL3;
-    if (to->modelindex4 != from->modelindex4)
+    if (diff & ES_DIFF(modelindex4))
         bits |= U_MODEL4;
 
-    if (to->sound != from->sound)
+    if (diff & ES_DIFF(sound))
         bits |= U_SOUND;
 
     if (to->renderfx & RF_FRAMELERP) {
         bits |= U_OLDORIGIN;
     } else if (to->renderfx & RF_BEAM) {
         if (flags & MSG_ES_BEAMORIGIN) {
-            if (to->old_origin[0] != from->old_origin[0] ||
-                to->old_origin[1] != from->old_origin[1] ||
-                to->old_origin[2] != from->old_origin[2])
+            if (diff & ES_DIFF(old_origin))
                 bits |= U_OLDORIGIN;
         } else {
             bits |= U_OLDORIGIN;
@@ -664,102 +708,111 @@ void MSG_WriteDeltaEntity(const entity_packed_t *from,
     else if (bits & 0x0000ff00)
         bits |= U_MOREBITS1;
 
-    MSG_WriteByte(bits & 255);
+    // encode into local buffer, then copy into message at once
+    p = buffer;
+
+    WB(bits & 255);
 
     if (bits & 0xff000000) {
-        MSG_WriteByte((bits >> 8) & 255);
-        MSG_WriteByte((bits >> 16) & 255);
-        MSG_WriteByte((bits >> 24) & 255);
+        WB((bits >> 8) & 255);
+        WB((bits >> 16) & 255);
+        WB((bits >> 24) & 255);
     } else if (bits & 0x00ff0000) {
-        MSG_WriteByte((bits >> 8) & 255);
-        MSG_WriteByte((bits >> 16) & 255);
+        WB((bits >> 8) & 255);
+        WB((bits >> 16) & 255);
     } else if (bits & 0x0000ff00) {
-        MSG_WriteByte((bits >> 8) & 255);
+        WB((bits >> 8) & 255);
     }
 
     //----------
 
     if (bits & U_NUMBER16)
-        MSG_WriteShort(to->number);
+        WS(to->number);
     else
-        MSG_WriteByte(to->number);
+        WB(to->number);
 
     if (bits & U_MODEL)
-        MSG_WriteByte(to->modelindex);
+        WB(to->modelindex);
     if (bits & U_MODEL2)
-        MSG_WriteByte(to->modelindex2);
+        WB(to->modelindex2);
     if (bits & U_MODEL3)
-        MSG_WriteByte(to->modelindex3);
+        WB(to->modelindex3);
     if (bits & U_MODEL4)
-        MSG_WriteByte(to->modelindex4);
+        WB(to->modelindex4);
 
     if (bits & U_FRAME8)
-        MSG_WriteByte(to->frame);
+        WB(to->frame & 255);
     else if (bits & U_FRAME16)
-        MSG_WriteShort(to->frame);
+        WS(to->frame);
 
     if ((bits & (U_SKIN8 | U_SKIN16)) == (U_SKIN8 | U_SKIN16))  //used for laser colors
-        MSG_WriteLong(to->skinnum);
+        WL(to->skinnum);
     else if (bits & U_SKIN8)
-        MSG_WriteByte(to->skinnum);
+        WB(to->skinnum & 255);
     else if (bits & U_SKIN16)
-        MSG_WriteShort(to->skinnum);
+        WS(to->skinnum);
 
     if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
-        MSG_WriteLong(to->effects);
+        WL(to->effects);
     else if (bits & U_EFFECTS8)
-        MSG_WriteByte(to->effects);
+        WB(to->effects & 255);
     else if (bits & U_EFFECTS16)
-        MSG_WriteShort(to->effects);
+        WS(to->effects);
 
     if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
-        MSG_WriteLong(to->renderfx);
+        WL(to->renderfx);
     else if (bits & U_RENDERFX8)
-        MSG_WriteByte(to->renderfx);
+        WB(to->renderfx & 255);
     else if (bits & U_RENDERFX16)
-        MSG_WriteShort(to->renderfx);
+        WS(to->renderfx);
 
     if (bits & U_ORIGIN1)
-        MSG_WriteShort(to->origin[0]);
+        WS(to->origin[0]);
     if (bits & U_ORIGIN2)
-        MSG_WriteShort(to->origin[1]);
+        WS(to->origin[1]);
     if (bits & U_ORIGIN3)
-        MSG_WriteShort(to->origin[2]);
+        WS(to->origin[2]);
 
     if ((flags & MSG_ES_SHORTANGLES) && (bits & U_ANGLE16)) {
         if (bits & U_ANGLE1)
-            MSG_WriteShort(to->angles[0]);
+            WS(to->angles[0]);
         if (bits & U_ANGLE2)
-            MSG_WriteShort(to->angles[1]);
+            WS(to->angles[1]);
         if (bits & U_ANGLE3)
-            MSG_WriteShort(to->angles[2]);
+            WS(to->angles[2]);
     } else {
         if (bits & U_ANGLE1)
-            MSG_WriteByte(to->angles[0] >> 8);
+            WB((to->angles[0] >> 8) & 255);
         if (bits & U_ANGLE2)
-            MSG_WriteByte(to->angles[1] >> 8);
+            WB((to->angles[1] >> 8) & 255);
         if (bits & U_ANGLE3)
-            MSG_WriteByte(to->angles[2] >> 8);
+            WB((to->angles[2] >> 8) & 255);
     }
 
     if (bits & U_OLDORIGIN) {
-        MSG_WriteShort(to->old_origin[0]);
-        MSG_WriteShort(to->old_origin[1]);
-        MSG_WriteShort(to->old_origin[2]);
+        WS(to->old_origin[0]);
+        WS(to->old_origin[1]);
+        WS(to->old_origin[2]);
     }
 
     if (bits & U_SOUND)
-        MSG_WriteByte(to->sound);
+        WB(to->sound);
     if (bits & U_EVENT)
-        MSG_WriteByte(to->event);
+        WB(to->event);
     if (bits & U_SOLID) {
         if (flags & MSG_ES_LONGSOLID)
-            MSG_WriteLong(to->solid);
+            WL(to->solid);
         else
-            MSG_WriteShort(to->solid);
+            WS(to->solid);
     }
+
+    MSG_WriteData(buffer, p - buffer);
 }
 
+#undef WB
+#undef WS
+#undef WL
+
 void MSG_PackPlayer(player_packed_t *out, const player_state_t *in)
 {
     int i;
@@ -1995,6 +2048,201 @@ void MSG_ParseDeltaEntity(const entity_state_t *from,
     }
 }
 
+/*
+==============================================================================
+
+            CURSOR BASED ENTITY PARSING
+
+Entity records make up most of the client's incoming traffic. Instead of
+checking bounds for every field, MSG_ReadEntityBits checks once that the
+largest possible record fits in the rest of the message and then hands out
+a cursor that header and fields are read through directly. Close to the end
+of message it returns a NULL cursor and parsing falls back to the checked
+readers, so that underflow behavior is exactly the same.
+
+==============================================================================
+*/
+
+// 4 bytes of bits, 2 bytes of number, 43 bytes of fields with every bit set
+#define MAX_ENTITY_RECORD   49
+
+#define CUR_BYTE(p)     (*(p)++)
+#define CUR_CHAR(p)     ((signed char)*(p)++)
+#define CUR_SHORT(p)    ((p) += 2, (signed short)LittleShortMem((p) - 2))
+#define CUR_WORD(p)     ((p) += 2, (unsigned short)LittleShortMem((p) - 2))
+#define CUR_LONG(p)     ((p) += 4, (int)LittleLongMem((p) - 4))
+
+static inline void MSG_SetCursor(byte *p)
+{
+    msg_read.readcount = p - msg_read.data;
+    msg_read.bitpos = msg_read.readcount << 3;
+}
+
+/*
+=================
+MSG_ReadEntityBits
+
+Same as MSG_ParseEntityBits. Sets cursor for the following
+MSG_ReadDeltaEntity call.
+=================
+*/
+int MSG_ReadEntityBits(int *bits, byte **cursor)
+{
+    byte    *p;
+    int     total, number;
+
+    if (msg_read.readcount + MAX_ENTITY_RECORD > msg_read.cursize) {
+        *cursor = NULL;
+        return MSG_ParseEntityBits(bits);
+    }
+
+    p = msg_read.data + msg_read.readcount;
+
+    total = CUR_BYTE(p);
+    if (total & U_MOREBITS1)
+        total |= CUR_BYTE(p) << 8;
+    if (total & U_MOREBITS2)
+        total |= CUR_BYTE(p) << 16;
+    if (total & U_MOREBITS3)
+        total |= (unsigned)CUR_BYTE(p) << 24;
+
+    if (total & U_NUMBER16)
+        number = CUR_SHORT(p);
+    else
+        number = CUR_BYTE(p);
+
+    MSG_SetCursor(p);
+
+    *bits = total;
+    *cursor = p;
+
+    return number;
+}
+
+/*
+==================
+MSG_ReadDeltaEntity
+
+Same as MSG_ParseDeltaEntity, reads fields through the cursor returned by
+MSG_ReadEntityBits, if any.
+==================
+*/
+void MSG_ReadDeltaEntity(byte *cursor,
+                         const entity_state_t *from,
+                         entity_state_t *to,
+                         int            number,
+                         int            bits,
+                         msgEsFlags_t   flags)
+{
+    byte    *p = cursor;
+
+    if (!p) {
+        MSG_ParseDeltaEntity(from, to, number, bits, flags);
+        return;
+    }
+
+    if (!to) {
+        Com_Error(ERR_DROP, "%s: NULL", __func__);
+    }
+
+    if (number < 1 || number >= MAX_EDICTS) {
+        Com_Error(ERR_DROP, "%s: bad entity number: %d", __func__, number);
+    }
+
+    // set everything to the state we are delta'ing from
+    if (!from) {
+        memset(to, 0, sizeof(*to));
+    } else if (to != from) {
+        memcpy(to, from, sizeof(*to));
+    }
+
+    to->number = number;
+    to->event = 0;
+
+    if (!bits) {
+        return;
+    }
+
+    if (bits & U_MODEL)
+        to->modelindex = CUR_BYTE(p);
+    if (bits & U_MODEL2)
+        to->modelindex2 = CUR_BYTE(p);
+    if (bits & U_MODEL3)
+        to->modelindex3 = CUR_BYTE(p);
+    if (bits & U_MODEL4)
+        to->modelindex4 = CUR_BYTE(p);
+
+    if (bits & U_FRAME8)
+        to->frame = CUR_BYTE(p);
+    if (bits & U_FRAME16)
+        to->frame = CUR_SHORT(p);
+
+    if ((bits & (U_SKIN8 | U_SKIN16)) == (U_SKIN8 | U_SKIN16))  //used for laser colors
+        to->skinnum = CUR_LONG(p);
+    else if (bits & U_SKIN8)
+        to->skinnum = CUR_BYTE(p);
+    else if (bits & U_SKIN16)
+        to->skinnum = CUR_WORD(p);
+
+    if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
+        to->effects = CUR_LONG(p);
+    else if (bits & U_EFFECTS8)
+        to->effects = CUR_BYTE(p);
+    else if (bits & U_EFFECTS16)
+        to->effects = CUR_WORD(p);
+
+    if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
+        to->renderfx = CUR_LONG(p);
+    else if (bits & U_RENDERFX8)
+        to->renderfx = CUR_BYTE(p);
+    else if (bits & U_RENDERFX16)
+        to->renderfx = CUR_WORD(p);
+
+    if (bits & U_ORIGIN1)
+        to->origin[0] = SHORT2COORD(CUR_SHORT(p));
+    if (bits & U_ORIGIN2)
+        to->origin[1] = SHORT2COORD(CUR_SHORT(p));
+    if (bits & U_ORIGIN3)
+        to->origin[2] = SHORT2COORD(CUR_SHORT(p));
+
+    if ((flags & MSG_ES_SHORTANGLES) && (bits & U_ANGLE16)) {
+        if (bits & U_ANGLE1)
+            to->angles[0] = SHORT2ANGLE(CUR_SHORT(p));
+        if (bits & U_ANGLE2)
+            to->angles[1] = SHORT2ANGLE(CUR_SHORT(p));
+        if (bits & U_ANGLE3)
+            to->angles[2] = SHORT2ANGLE(CUR_SHORT(p));
+    } else {
+        if (bits & U_ANGLE1)
+            to->angles[0] = BYTE2ANGLE(CUR_CHAR(p));
+        if (bits & U_ANGLE2)
+            to->angles[1] = BYTE2ANGLE(CUR_CHAR(p));
+        if (bits & U_ANGLE3)
+            to->angles[2] = BYTE2ANGLE(CUR_CHAR(p));
+    }
+
+    if (bits & U_OLDORIGIN) {
+        to->old_origin[0] = SHORT2COORD(CUR_SHORT(p));
+        to->old_origin[1] = SHORT2COORD(CUR_SHORT(p));
+        to->old_origin[2] = SHORT2COORD(CUR_SHORT(p));
+    }
+
+    if (bits & U_SOUND)
+        to->sound = CUR_BYTE(p);
+
+    if (bits & U_EVENT)
+        to->event = CUR_BYTE(p);
+
+    if (bits & U_SOLID) {
+        if (flags & MSG_ES_LONGSOLID)
+            to->solid = CUR_LONG(p);
+        else
+            to->solid = CUR_WORD(p);
+    }
+
+    MSG_SetCursor(p);
+}
+
 #endif // USE_CLIENT || USE_MVD_CLIENT
 
 #if USE_CLIENT
@@ -2243,6 +2491,211 @@ void MSG_ParseDeltaPlayerstate_Enhanced(const player_state_t    *from,
 
 }
 
+/*
+===================
+MSG_ParseTempEntity
+===================
+*/
+void MSG_ParseTempEntity(tent_params_t *te)
+{
+    te->type = MSG_ReadByte();
+
+    switch (te->type) {
+    case TE_BLOOD:
+    case TE_GUNSHOT:
+    case TE_SPARKS:
+    case TE_BULLET_SPARKS:
+    case TE_SCREEN_SPARKS:
+    case TE_SHIELD_SPARKS:
+    case TE_SHOTGUN:
+    case TE_BLASTER:
+    case TE_GREENBLOOD:
+    case TE_BLASTER2:
+    case TE_FLECHETTE:
+    case TE_HEATBEAM_SPARKS:
+    case TE_HEATBEAM_STEAM:
+    case TE_MOREBLOOD:
+    case TE_ELECTRIC_SPARKS:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        break;
+
+    case TE_SPLASH:
+    case TE_LASER_SPARKS:
+    case TE_WELDING_SPARKS:
+    case TE_TUNNEL_SPARKS:
+        te->count = MSG_ReadByte();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        te->color = MSG_ReadByte();
+        break;
+
+    case TE_BLUEHYPERBLASTER:
+    case TE_RAILTRAIL:
+    case TE_BUBBLETRAIL:
+    case TE_DEBUGTRAIL:
+    case TE_BUBBLETRAIL2:
+    case TE_BFG_LASER:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_GRENADE_EXPLOSION:
+    case TE_GRENADE_EXPLOSION_WATER:
+    case TE_EXPLOSION2:
+    case TE_PLASMA_EXPLOSION:
+    case TE_ROCKET_EXPLOSION:
+    case TE_ROCKET_EXPLOSION_WATER:
+    case TE_EXPLOSION1:
+    case TE_EXPLOSION1_NP:
+    case TE_EXPLOSION1_BIG:
+    case TE_BFG_EXPLOSION:
+    case TE_BFG_BIGEXPLOSION:
+    case TE_BOSSTPORT:
+    case TE_PLAIN_EXPLOSION:
+    case TE_CHAINFIST_SMOKE:
+    case TE_TRACKER_EXPLOSION:
+    case TE_TELEPORT_EFFECT:
+    case TE_DBALL_GOAL:
+    case TE_WIDOWSPLASH:
+    case TE_NUKEBLAST:
+        MSG_ReadPos(te->pos1);
+        break;
+
+    case TE_PARASITE_ATTACK:
+    case TE_MEDIC_CABLE_ATTACK:
+    case TE_HEATBEAM:
+    case TE_MONSTER_HEATBEAM:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_GRAPPLE_CABLE:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        MSG_ReadPos(te->offset);
+        break;
+
+    case TE_LIGHTNING:
+        te->entity1 = MSG_ReadShort();
+        te->entity2 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_FLASHLIGHT:
+        MSG_ReadPos(te->pos1);
+        te->entity1 = MSG_ReadShort();
+        break;
+
+    case TE_FORCEWALL:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        te->color = MSG_ReadByte();
+        break;
+
+    case TE_STEAM:
+        te->entity1 = MSG_ReadShort();
+        te->count = MSG_ReadByte();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        te->color = MSG_ReadByte();
+        te->entity2 = MSG_ReadShort();
+        if (te->entity1 != -1) {
+            te->time = MSG_ReadLong();
+        }
+        break;
+
+    case TE_WIDOWBEAMOUT:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        break;
+
+    case TE_FLARE:
+        te->entity1 = MSG_ReadShort();
+        te->count = MSG_ReadByte();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        break;
+
+    default:
+        Com_Error(ERR_DROP, "%s: bad type", __func__);
+    }
+}
+
+/*
+===================
+MSG_ParseMuzzleFlash
+===================
+*/
+void MSG_ParseMuzzleFlash(mz_params_t *mz, int mask)
+{
+    int entity, weapon;
+
+    entity = MSG_ReadShort();
+    if (entity < 1 || entity >= MAX_EDICTS)
+        Com_Error(ERR_DROP, "%s: bad entity", __func__);
+
+    weapon = MSG_ReadByte();
+    mz->silenced = weapon & mask;
+    mz->weapon = weapon & ~mask;
+    mz->entity = entity;
+}
+
+/*
+===================
+MSG_ParseStartSound
+===================
+*/
+void MSG_ParseStartSound(snd_params_t *snd)
+{
+    int flags, channel, entity;
+
+    flags = MSG_ReadByte();
+    if ((flags & (SND_ENT | SND_POS)) == 0)
+        Com_Error(ERR_DROP, "%s: neither SND_ENT nor SND_POS set", __func__);
+
+    snd->index = MSG_ReadByte();
+    if (snd->index == -1)
+        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+
+    if (flags & SND_VOLUME)
+        snd->volume = MSG_ReadByte() / 255.0f;
+    else
+        snd->volume = DEFAULT_SOUND_PACKET_VOLUME;
+
+    if (flags & SND_ATTENUATION)
+        snd->attenuation = MSG_ReadByte() / 64.0f;
+    else
+        snd->attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
+
+    if (flags & SND_OFFSET)
+        snd->timeofs = MSG_ReadByte() / 1000.0f;
+    else
+        snd->timeofs = 0;
+
+    if (flags & SND_ENT) {
+        // entity relative
+        channel = MSG_ReadShort();
+        entity = channel >> 3;
+        if (entity < 0 || entity >= MAX_EDICTS)
+            Com_Error(ERR_DROP, "%s: bad entity: %d", __func__, entity);
+        snd->entity = entity;
+        snd->channel = channel & 7;
+    } else {
+        snd->entity = 0;
+        snd->channel = 0;
+    }
+
+    // positioned in space
+    if (flags & SND_POS)
+        MSG_ReadPos(snd->pos);
+
+    snd->flags = flags;
+}
+
 #endif // USE_CLIENT
 
 #if USE_MVD_CLIENT
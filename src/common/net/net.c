@@ -58,7 +58,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #undef IP_RECVERR
 #undef IPV6_RECVERR
 #endif
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#define USE_EPOLL   1
 #endif // __linux__
+#if !USE_CLIENT
+#include <fcntl.h>
+#include <poll.h>
+#include <SDL_atomic.h>
+#include <SDL_thread.h>
+#define USE_NET_THREAD  1
+#endif // !USE_CLIENT
 #endif // !_WIN32
 
 // prevents infinite retry loops caused by broken TCP/IP stacks
@@ -88,6 +98,7 @@ cvar_t          *net_ip6;
 cvar_t          *net_port;
 
 netadr_t        net_from;
+unsigned        net_rcvtime;
 
 #if USE_CLIENT
 static cvar_t   *net_clientport;
@@ -129,6 +140,14 @@ static size_t       net_rate_sent;
 static size_t       net_rate_dn;
 static size_t       net_rate_up;
 
+// timed wakeup overshoot (frame-start jitter), in microseconds
+static unsigned     net_jitter_count;
+static uint64_t     net_jitter_total;
+static unsigned     net_jitter_peak;
+static unsigned     net_jitter_avg;
+static unsigned     net_jitter_max;
+static uint64_t     net_jitter_samples;
+
 // lifetime statistics
 static uint64_t     net_recv_errors;
 static uint64_t     net_send_errors;
@@ -140,6 +159,47 @@ static uint64_t     net_bytes_sent;
 static uint64_t     net_packets_rcvd;
 static uint64_t     net_packets_sent;
 
+#if USE_NET_THREAD
+
+// packets are handed between main and network threads through single
+// producer, single consumer rings. each side only writes its own index.
+#define NET_QUEUE_SIZE  256
+#define NET_QUEUE_MASK  (NET_QUEUE_SIZE - 1)
+
+typedef struct {
+    netadr_t        address;
+    unsigned        time;       // arrival time, in Sys_Milliseconds units
+    size_t          len;
+    byte            data[MAX_PACKETLEN];
+} netpacket_t;
+
+typedef struct {
+    netpacket_t     *packets;
+    SDL_atomic_t    head;       // written by producer
+    SDL_atomic_t    tail;       // written by consumer
+} netqueue_t;
+
+static cvar_t       *net_iothread;
+
+static SDL_Thread   *io_thread;
+static pid_t        io_thread_pid;
+static SDL_atomic_t io_quit;
+static netqueue_t   io_recv_queue;
+static netqueue_t   io_send_queue;
+static qsocket_t    io_sockets[2] = { -1, -1 };
+static SDL_atomic_t io_errors[2];   // socket needs attention of main thread
+static int          io_wake[2] = { -1, -1 };    // wakes network thread
+static int          main_wake[2] = { -1, -1 };  // wakes main thread
+static SDL_atomic_t io_wake_pending;
+static SDL_atomic_t main_wake_pending;
+static SDL_atomic_t io_send_errors;
+
+static uint64_t     net_queue_count;
+static uint64_t     net_queue_delay;
+static unsigned     net_queue_delay_max;
+
+#endif // USE_NET_THREAD
+
 //=============================================================================
 
 static size_t NET_NetadrToSockadr(const netadr_t *a, struct sockaddr_storage *s)
@@ -486,6 +546,12 @@ void NET_UpdateStats(void)
     net_rate_up = net_rate_sent / RATE_SECS;
     net_rate_sent = 0;
     net_rate_rcvd = 0;
+
+    net_jitter_avg = net_jitter_count ? net_jitter_total / net_jitter_count : 0;
+    net_jitter_max = net_jitter_peak;
+    net_jitter_count = 0;
+    net_jitter_total = 0;
+    net_jitter_peak = 0;
 }
 
 /*
@@ -525,6 +591,16 @@ static void NET_Stats_f(void)
 #endif
     Com_Printf("Current upload rate: %"PRIz" bytes/sec\n", net_rate_up);
     Com_Printf("Current download rate: %"PRIz" bytes/sec\n", net_rate_dn);
+    if (net_jitter_samples) {
+        Com_Printf("Frame-start jitter: %u usec avg, %u usec max (%"PRIu64" wakeups)\n",
+                   net_jitter_avg, net_jitter_max, net_jitter_samples);
+    }
+#if USE_NET_THREAD
+    if (net_queue_count) {
+        Com_Printf("Receive queue delay: %"PRIu64" msec avg, %u msec max (%"PRIu64" packets)\n",
+                   net_queue_delay / net_queue_count, net_queue_delay_max, net_queue_count);
+    }
+#endif
 }
 
 static size_t NET_UpRate_m(char *buffer, size_t size)
@@ -690,6 +766,10 @@ void NET_RemoveFd(qsocket_t fd)
 
     memset(e, 0, sizeof(*e));
 
+#if USE_EPOLL
+    os_epoll_remove(fd);
+#endif
+
     for (i = io_numfds - 1; i >= 0; i--) {
         e = &io_entries[i];
         if (e->inuse) {
@@ -766,6 +846,55 @@ int NET_Sleep(int msec)
     return ret;
 }
 
+/*
+=============
+NET_SleepUntil
+
+Sleeps until Sys_Milliseconds() reaches the given deadline or some file
+descriptor is ready. Deadline is absolute so that time spent running the
+frame is not added to the sleep. On Linux wakeup is driven by a timerfd
+armed exactly at the millisecond boundary, other platforms fall back to
+NET_Sleep. Overshoot of timed wakeups is accounted as frame-start jitter.
+=============
+*/
+int NET_SleepUntil(unsigned deadline)
+{
+    uint64_t now, target;
+    unsigned jitter;
+    int msec, ret;
+
+    now = Sys_Microseconds();
+
+#if USE_EPOLL
+    // Sys_Milliseconds is derived from the same monotonic clock
+    msec = (int)(deadline - (unsigned)(now / 1000));
+    target = (now / 1000 + msec) * 1000;
+    ret = os_epoll_wait(target, now);
+    if (ret == -1) {
+        Com_EPrintf("%s: %s\n", __func__, NET_ErrorString());
+        return ret;
+    }
+    if (ret == -2)
+#endif
+    {
+        msec = (int)(deadline - Sys_Milliseconds());
+        target = now + max(msec, 0) * 1000;
+        ret = NET_Sleep(max(msec, 0));
+    }
+
+    // only account wakeups caused by the timer
+    if (ret == 0 && msec > 0) {
+        now = Sys_Microseconds();
+        jitter = now > target ? now - target : 0;
+        net_jitter_count++;
+        net_jitter_total += jitter;
+        net_jitter_peak = max(net_jitter_peak, jitter);
+        net_jitter_samples++;
+    }
+
+    return ret;
+}
+
 #if USE_AC_SERVER
 
 /*
@@ -854,6 +983,8 @@ static void NET_GetUdpPackets(qsocket_t sock, void (*packet_cb)(void))
     if (!e->canread)
         return;
 
+    net_rcvtime = com_eventTime;
+
     while (1) {
         ret = os_udp_recv(sock, msg_read_buffer, MAX_PACKETLEN, &net_from);
         if (ret == NET_AGAIN) {
@@ -884,19 +1015,391 @@ static void NET_GetUdpPackets(qsocket_t sock, void (*packet_cb)(void))
     }
 }
 
+#if USE_NET_THREAD
+
+/*
+=============================================================================
+
+NETWORK THREAD
+
+Dedicated server can receive and send UDP packets on a separate thread, so
+that packets arriving during a long frame are timestamped precisely and
+don't overflow the socket buffer. The main thread processes them in order
+from NET_GetPackets. Errors that need ICMP processing are left to the main
+thread.
+
+=============================================================================
+*/
+
+static void wake_thread(SDL_atomic_t *pending, int fd)
+{
+    // only one wakeup in flight at a time
+    if (SDL_AtomicCAS(pending, 0, 1)) {
+        if (write(fd, "", 1) == -1 && errno != EAGAIN) {
+            Com_DPrintf("%s: %s\n", __func__, strerror(errno));
+        }
+    }
+}
+
+static void drain_wake(SDL_atomic_t *pending, int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    // must be cleared before looking at the queue again
+    SDL_AtomicSet(pending, 0);
+}
+
+static void io_send_packets(void)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    netqueue_t *q = &io_send_queue;
+    netpacket_t *p;
+    qsocket_t s;
+    int head, tail;
+
+    head = SDL_AtomicGet(&q->head);
+    for (tail = SDL_AtomicGet(&q->tail); tail != head; tail++) {
+        p = &q->packets[tail & NET_QUEUE_MASK];
+        s = io_sockets[p->address.type == NA_IP6];
+        addrlen = NET_NetadrToSockadr(&p->address, &addr);
+        if (s == -1 || sendto(s, p->data, p->len, 0,
+                              (struct sockaddr *)&addr, addrlen) == -1) {
+            SDL_AtomicAdd(&io_send_errors, 1);
+        }
+        SDL_AtomicSet(&q->tail, tail + 1);
+    }
+}
+
+// returns qtrue if any packets were queued
+static qboolean io_recv_packets(int index)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    netqueue_t *q = &io_recv_queue;
+    netpacket_t *p;
+    ssize_t ret;
+    int head, count = 0;
+
+    head = SDL_AtomicGet(&q->head);
+    while (head - SDL_AtomicGet(&q->tail) < NET_QUEUE_SIZE) {
+        p = &q->packets[head & NET_QUEUE_MASK];
+        memset(&addr, 0, sizeof(addr));
+        addrlen = sizeof(addr);
+        ret = recvfrom(io_sockets[index], p->data, MAX_PACKETLEN, 0,
+                       (struct sockaddr *)&addr, &addrlen);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EWOULDBLOCK && errno != EAGAIN) {
+                // let main thread sort it out
+                SDL_AtomicSet(&io_errors[index], 1);
+            }
+            break;
+        }
+
+        NET_SockadrToNetadr(&addr, &p->address);
+        p->time = Sys_Milliseconds();
+        p->len = ret;
+        SDL_AtomicSet(&q->head, ++head);
+        count++;
+    }
+
+    return count > 0;
+}
+
+static int io_thread_func(void *arg)
+{
+    struct pollfd fds[3];
+    qboolean full, queued;
+    int i, n, ret;
+
+    while (!SDL_AtomicGet(&io_quit)) {
+        full = SDL_AtomicGet(&io_recv_queue.head) -
+               SDL_AtomicGet(&io_recv_queue.tail) >= NET_QUEUE_SIZE;
+
+        n = 0;
+        fds[n].fd = io_wake[0];
+        fds[n++].events = POLLIN;
+        for (i = 0; i < 2; i++) {
+            if (io_sockets[i] == -1 || full || SDL_AtomicGet(&io_errors[i])) {
+                continue;
+            }
+            fds[n].fd = io_sockets[i];
+            fds[n++].events = POLLIN;
+        }
+
+        // main thread is behind, leave packets in socket buffer for now
+        ret = poll(fds, n, full ? 1 : -1);
+        if (ret == -1 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            drain_wake(&io_wake_pending, io_wake[0]);
+        }
+
+        io_send_packets();
+
+        queued = qfalse;
+        for (i = 1; i < n; i++) {
+            if (fds[i].revents) {
+                queued |= io_recv_packets(fds[i].fd == io_sockets[1]);
+            }
+        }
+
+        if (queued) {
+            wake_thread(&main_wake_pending, main_wake[1]);
+        }
+    }
+
+    // flush anything left
+    io_send_packets();
+    return 0;
+}
+
+static qboolean open_pipe(int fds[2])
+{
+    int i;
+
+    if (pipe(fds) == -1) {
+        return qfalse;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (fcntl(fds[i], F_SETFL, O_NONBLOCK) == -1 ||
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC) == -1) {
+            return qfalse;
+        }
+    }
+
+    return qtrue;
+}
+
+static void io_cleanup(void)
+{
+    ioentry_t *e;
+    int i;
+
+    // sockets go back to the main thread
+    for (i = 0; i < 2; i++) {
+        if (io_sockets[i] != -1) {
+            e = os_get_io(io_sockets[i]);
+            e->wantread = qtrue;
+            io_sockets[i] = -1;
+        }
+    }
+
+    if (main_wake[0] != -1) {
+        NET_RemoveFd(main_wake[0]);
+    }
+    for (i = 0; i < 2; i++) {
+        if (io_wake[i] != -1) {
+            close(io_wake[i]);
+        }
+        if (main_wake[i] != -1) {
+            close(main_wake[i]);
+        }
+        io_wake[i] = main_wake[i] = -1;
+    }
+
+    Z_Free(io_recv_queue.packets);
+    Z_Free(io_send_queue.packets);
+    memset(&io_recv_queue, 0, sizeof(io_recv_queue));
+    memset(&io_send_queue, 0, sizeof(io_send_queue));
+}
+
+static void NET_StopIoThread(void)
+{
+    if (!io_thread) {
+        return;
+    }
+
+    if (io_thread_pid == getpid()) {
+        SDL_AtomicSet(&io_quit, 1);
+        wake_thread(&io_wake_pending, io_wake[1]);
+        SDL_WaitThread(io_thread, NULL);
+    }
+    io_thread = NULL;
+
+    io_cleanup();
+    Com_DPrintf("Stopped network thread\n");
+}
+
+static qboolean NET_StartIoThread(void)
+{
+    ioentry_t *e;
+    int i;
+
+    io_sockets[0] = udp_sockets[NS_SERVER];
+    io_sockets[1] = udp6_sockets[NS_SERVER];
+    if (io_sockets[0] == -1 && io_sockets[1] == -1) {
+        return qfalse;
+    }
+
+    if (!open_pipe(io_wake) || !open_pipe(main_wake)) {
+        Com_EPrintf("Couldn't create network thread: %s\n", strerror(errno));
+        io_cleanup();
+        return qfalse;
+    }
+
+    io_recv_queue.packets = Z_Malloc(sizeof(netpacket_t) * NET_QUEUE_SIZE);
+    io_send_queue.packets = Z_Malloc(sizeof(netpacket_t) * NET_QUEUE_SIZE);
+    SDL_AtomicSet(&io_quit, 0);
+    SDL_AtomicSet(&io_wake_pending, 0);
+    SDL_AtomicSet(&main_wake_pending, 0);
+    for (i = 0; i < 2; i++) {
+        SDL_AtomicSet(&io_errors[i], 0);
+    }
+
+    // main thread now waits for the wakeup pipe instead of sockets
+    e = NET_AddFd(main_wake[0]);
+    e->wantread = qtrue;
+    for (i = 0; i < 2; i++) {
+        if (io_sockets[i] != -1) {
+            e = os_get_io(io_sockets[i]);
+            e->wantread = qfalse;
+            e->canread = qfalse;
+        }
+    }
+
+    io_thread_pid = getpid();
+    io_thread = SDL_CreateThread(io_thread_func, "network", NULL);
+    if (!io_thread) {
+        Com_EPrintf("Couldn't create network thread: %s\n", SDL_GetError());
+        io_cleanup();
+        return qfalse;
+    }
+
+    Com_DPrintf("Started network thread\n");
+    return qtrue;
+}
+
+// returns qtrue if the network thread handles server sockets
+static qboolean NET_RunIoThread(void)
+{
+    if (!net_iothread->integer) {
+        NET_StopIoThread();
+        return qfalse;
+    }
+
+    // threads don't survive fork() into server instances
+    if (io_thread && io_thread_pid != getpid()) {
+        NET_StopIoThread();
+    }
+
+    if (!io_thread && !NET_StartIoThread()) {
+        Cvar_Set("net_iothread", "0");
+        return qfalse;
+    }
+
+    return qtrue;
+}
+
+static void NET_GetQueuedPackets(void (*packet_cb)(void))
+{
+    netqueue_t *q = &io_recv_queue;
+    netpacket_t *p;
+    ioentry_t *e;
+    unsigned delay;
+    int i, head, tail;
+
+    // read sockets the network thread gave up on
+    for (i = 0; i < 2; i++) {
+        if (SDL_AtomicGet(&io_errors[i])) {
+            e = os_get_io(io_sockets[i]);
+            e->canread = qtrue;
+            NET_GetUdpPackets(io_sockets[i], packet_cb);
+            e->canread = qfalse;
+            SDL_AtomicSet(&io_errors[i], 0);
+            wake_thread(&io_wake_pending, io_wake[1]);
+        }
+    }
+
+    drain_wake(&main_wake_pending, main_wake[0]);
+
+    head = SDL_AtomicGet(&q->head);
+    for (tail = SDL_AtomicGet(&q->tail); tail != head; tail++) {
+        p = &q->packets[tail & NET_QUEUE_MASK];
+
+#ifdef _DEBUG
+        if (net_log_enable->integer)
+            NET_LogPacket(&p->address, "UDP recv", p->data, p->len);
+#endif
+
+        net_rate_rcvd += p->len;
+        net_bytes_rcvd += p->len;
+        net_packets_rcvd++;
+
+        delay = Sys_Milliseconds() - p->time;
+        net_queue_delay += delay;
+        net_queue_delay_max = max(net_queue_delay_max, delay);
+        net_queue_count++;
+
+        memcpy(msg_read_buffer, p->data, p->len);
+        SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+        msg_read.cursize = p->len;
+        net_from = p->address;
+        net_rcvtime = p->time;
+
+        (*packet_cb)();
+
+        SDL_AtomicSet(&q->tail, tail + 1);
+    }
+
+    net_send_errors += SDL_AtomicSet(&io_send_errors, 0);
+}
+
+// returns qfalse if the queue is full
+static qboolean NET_QueuePacket(const void *data, size_t len, const netadr_t *to)
+{
+    netqueue_t *q = &io_send_queue;
+    netpacket_t *p;
+    int head;
+
+    head = SDL_AtomicGet(&q->head);
+    if (head - SDL_AtomicGet(&q->tail) >= NET_QUEUE_SIZE) {
+        return qfalse;
+    }
+
+    p = &q->packets[head & NET_QUEUE_MASK];
+    p->address = *to;
+    p->len = len;
+    memcpy(p->data, data, len);
+    SDL_AtomicSet(&q->head, head + 1);
+
+    wake_thread(&io_wake_pending, io_wake[1]);
+    return qtrue;
+}
+
+#endif // USE_NET_THREAD
+
 /*
 =============
 NET_GetPackets
 
 Fills msg_read_buffer with packet contents,
-net_from variable receives source address.
+net_from variable receives source address
+and net_rcvtime receives time of arrival.
 =============
 */
 void NET_GetPackets(netsrc_t sock, void (*packet_cb)(void))
 {
+#if USE_NET_THREAD
+    if (sock == NS_SERVER && NET_RunIoThread()) {
+        NET_GetQueuedPackets(packet_cb);
+        return;
+    }
+#endif
+
 #if USE_CLIENT
     memset(&net_from, 0, sizeof(net_from));
     net_from.type = NA_LOOPBACK;
+    net_rcvtime = com_eventTime;
 
     // process loopback packets
     NET_GetLoopPackets(sock, packet_cb);
@@ -951,6 +1454,19 @@ qboolean NET_SendPacket(netsrc_t sock, const void *data,
     if (s == -1)
         return qfalse;
 
+#if USE_NET_THREAD
+    if (sock == NS_SERVER && io_thread && NET_QueuePacket(data, len, to)) {
+#ifdef _DEBUG
+        if (net_log_enable->integer)
+            NET_LogPacket(to, "UDP send", data, len);
+#endif
+        net_rate_sent += len;
+        net_bytes_sent += len;
+        net_packets_sent++;
+        return qtrue;
+    }
+#endif
+
     ret = os_udp_send(s, data, len, to);
     if (ret == NET_AGAIN)
         return qfalse;
@@ -1317,6 +1833,11 @@ void NET_Config(netflag_t flag)
         return;
     }
 
+#if USE_NET_THREAD
+    // restarted on next NET_GetPackets
+    NET_StopIoThread();
+#endif
+
     if (flag == NET_NONE) {
         // shut down any existing sockets
         for (sock = 0; sock < NS_COUNT; sock++) {
@@ -1963,6 +2484,10 @@ void NET_Init(void)
     net_ignore_icmp = Cvar_Get("net_ignore_icmp", "0", 0);
 #endif
 
+#if USE_NET_THREAD
+    net_iothread = Cvar_Get("net_iothread", "0", 0);
+#endif
+
 #if _DEBUG
     net_log_enable_changed(net_log_enable);
 #endif
@@ -357,11 +357,197 @@ static int os_select(int nfds, fd_set *rfds, fd_set *wfds,
     return ret;
 }
 
+#if USE_EPOLL
+
+// epoll set mirroring io_entries, plus a timerfd armed at the absolute
+// wakeup time so that sleeping ends exactly on a millisecond boundary
+static int          epoll_fd = -1;
+static int          timer_fd = -1;
+static uint32_t     epoll_masks[FD_SETSIZE];
+
+#define EPOLL_MAX_EVENTS    64
+
+static void os_epoll_remove(qsocket_t fd)
+{
+    if (epoll_fd == -1)
+        return;
+
+    if (epoll_masks[fd]) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        epoll_masks[fd] = 0;
+    }
+}
+
+static void os_epoll_shutdown(void)
+{
+    if (timer_fd != -1) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    memset(epoll_masks, 0, sizeof(epoll_masks));
+}
+
+static void os_epoll_init(void)
+{
+    struct epoll_event ev;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        Com_DPrintf("%s: epoll_create1: %s\n", __func__, strerror(errno));
+        return;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        Com_DPrintf("%s: timerfd_create: %s\n", __func__, strerror(errno));
+        os_epoll_shutdown();
+        return;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) {
+        Com_DPrintf("%s: epoll_ctl: %s\n", __func__, strerror(errno));
+        os_epoll_shutdown();
+    }
+}
+
+// brings epoll registration of the descriptor in sync with its want* flags
+static qboolean os_epoll_sync(qsocket_t fd, ioentry_t *e)
+{
+    struct epoll_event ev;
+    uint32_t mask = 0;
+    int op;
+
+    if (e->wantread) mask |= EPOLLIN;
+    if (e->wantwrite) mask |= EPOLLOUT;
+    if (e->wantexcept) mask |= EPOLLPRI;
+
+    if (epoll_masks[fd] == mask)
+        return qtrue;
+
+    // epoll always reports hangups and errors, so descriptor with nothing
+    // wanted must be removed from the set to avoid busy waking
+    if (!mask) {
+        os_epoll_remove(fd);
+        return qtrue;
+    }
+
+    op = epoll_masks[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    ev.events = mask;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, op, fd, &ev) == -1) {
+        // descriptor might have been closed and reused behind our back
+        if (op == EPOLL_CTL_MOD && errno == ENOENT &&
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+            epoll_masks[fd] = mask;
+            return qtrue;
+        }
+        // regular files and such can't be polled
+        Com_DPrintf("%s: fd %d: %s\n", __func__, fd, strerror(errno));
+        return qfalse;
+    }
+
+    epoll_masks[fd] = mask;
+    return qtrue;
+}
+
+// sleeps until absolute time `deadline' (in Sys_Microseconds units) or
+// until some descriptor is ready. returns -2 if epoll can't be used.
+static int os_epoll_wait(uint64_t deadline, uint64_t now)
+{
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    struct itimerspec its;
+    ioentry_t *e;
+    qsocket_t fd;
+    uint64_t expirations;
+    int i, ret, timeout, count;
+
+    if (epoll_fd == -1)
+        return -2;
+
+    for (i = 0, e = io_entries; i < io_numfds; i++, e++) {
+        if (!e->inuse) {
+            continue;
+        }
+        e->canread = qfalse;
+        e->canwrite = qfalse;
+        e->canexcept = qfalse;
+        if (!os_epoll_sync(i, e)) {
+            // fall back to select() for good
+            os_epoll_shutdown();
+            return -2;
+        }
+    }
+
+    if (deadline > now) {
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = deadline / 1000000;
+        its.it_value.tv_nsec = (deadline % 1000000) * 1000;
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+            Com_EPrintf("%s: timerfd_settime: %s\n", __func__, strerror(errno));
+            os_epoll_shutdown();
+            return -2;
+        }
+        timeout = -1;
+    } else {
+        timeout = 0;
+    }
+
+    ret = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, timeout);
+    if (ret == -1) {
+        net_error = errno;
+        if (net_error == EINTR)
+            return 0;
+        return -1;
+    }
+
+    count = 0;
+    for (i = 0; i < ret; i++) {
+        fd = events[i].data.fd;
+        if (fd == timer_fd) {
+            // drain expiration counter
+            if (read(timer_fd, &expirations, sizeof(expirations)) == -1 &&
+                errno != EAGAIN) {
+                Com_DPrintf("%s: read: %s\n", __func__, strerror(errno));
+            }
+            continue;
+        }
+        e = &io_entries[fd];
+        if (!e->inuse) {
+            continue;
+        }
+        // hung up descriptor is both readable and writable for select()
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) e->canread = e->wantread;
+        if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) e->canwrite = e->wantwrite;
+        if (events[i].events & EPOLLPRI) e->canexcept = e->wantexcept;
+        // select() reports errors on every monitored set
+        if (events[i].events & EPOLLERR) e->canexcept = e->wantexcept;
+        if (e->canread || e->canwrite || e->canexcept) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+#endif // USE_EPOLL
+
 static void os_net_init(void)
 {
+#if USE_EPOLL
+    os_epoll_init();
+#endif
 }
 
 static void os_net_shutdown(void)
 {
+#if USE_EPOLL
+    os_epoll_shutdown();
+#endif
 }
 
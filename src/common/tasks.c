@@ -0,0 +1,328 @@
+/*
+Copyright (C) 2026 Quake II RTX contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// tasks.c -- worker thread pool
+//
+// Workers are started on first use, so that dedicated server instances
+// forked at startup each get their own pool. The calling thread takes
+// part in the work and returns only when every index has been processed.
+// Idle workers pick up background tasks, parallel loops take precedence.
+//
+
+#include "shared/shared.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/tasks.h"
+
+#include <SDL_atomic.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+static cvar_t       *com_workers;
+
+static SDL_Thread   *task_threads[MAX_WORKERS];
+static int          task_numthreads;
+static qboolean     task_started;
+
+static SDL_mutex    *task_mutex;    // protects everything below
+static SDL_cond     *task_wake;
+static SDL_cond     *task_done;
+static unsigned     task_sequence;
+static int          task_busy;
+static qboolean     task_quit;
+static LIST_DECL(task_queue);
+
+static taskfunc_t   task_func;
+static void         *task_data;
+static int          task_count;
+static SDL_atomic_t task_next;
+
+static SDL_mutex    *task_lock;
+
+static void run_tasks(void)
+{
+    int i;
+
+    while ((i = SDL_AtomicAdd(&task_next, 1)) < task_count) {
+        task_func(task_data, i);
+    }
+}
+
+static void run_queued_task(void)
+{
+    task_t *task = LIST_FIRST(task_t, &task_queue, entry);
+
+    List_Remove(&task->entry);
+    task->state = TASK_RUNNING;
+    SDL_UnlockMutex(task_mutex);
+
+    task->func(task->data, 0);
+
+    SDL_LockMutex(task_mutex);
+    task->state = TASK_IDLE;
+    SDL_CondBroadcast(task_done);
+}
+
+static int worker_thread(void *arg)
+{
+    unsigned sequence = 0;  // workers are started with task_sequence at 0
+
+    SDL_LockMutex(task_mutex);
+    while (1) {
+        while (!task_quit && sequence == task_sequence && LIST_EMPTY(&task_queue)) {
+            SDL_CondWait(task_wake, task_mutex);
+        }
+        if (task_quit) {
+            break;
+        }
+        if (sequence == task_sequence) {
+            run_queued_task();
+            continue;
+        }
+        sequence = task_sequence;
+        SDL_UnlockMutex(task_mutex);
+
+        run_tasks();
+
+        SDL_LockMutex(task_mutex);
+        if (--task_busy == 0) {
+            SDL_CondBroadcast(task_done);
+        }
+    }
+    SDL_UnlockMutex(task_mutex);
+
+    return 0;
+}
+
+static void start_workers(void)
+{
+    int i, count;
+
+    task_started = qtrue;
+
+    count = com_workers->integer;
+    if (count < 0) {
+        count = SDL_GetCPUCount() - 1;
+    }
+    clamp(count, 0, MAX_WORKERS);
+    if (!count) {
+        return;
+    }
+
+    task_mutex = SDL_CreateMutex();
+    task_wake = SDL_CreateCond();
+    task_done = SDL_CreateCond();
+    task_quit = qfalse;
+
+    for (i = 0; i < count; i++) {
+        task_threads[i] = SDL_CreateThread(worker_thread, "worker", NULL);
+        if (!task_threads[i]) {
+            Com_WPrintf("Couldn't create worker thread: %s\n", SDL_GetError());
+            break;
+        }
+    }
+
+    task_numthreads = i;
+    Com_DPrintf("Started %d worker threads\n", task_numthreads);
+}
+
+static void stop_workers(void)
+{
+    task_t *task, *next;
+    int i;
+
+    if (task_numthreads) {
+        SDL_LockMutex(task_mutex);
+        task_quit = qtrue;
+        SDL_CondBroadcast(task_wake);
+        SDL_UnlockMutex(task_mutex);
+
+        for (i = 0; i < task_numthreads; i++) {
+            SDL_WaitThread(task_threads[i], NULL);
+            task_threads[i] = NULL;
+        }
+        task_numthreads = 0;
+    }
+
+    // finish what the workers left behind
+    LIST_FOR_EACH_SAFE(task_t, task, next, &task_queue, entry) {
+        List_Remove(&task->entry);
+        task->func(task->data, 0);
+        task->state = TASK_IDLE;
+    }
+
+    // new workers start waiting for sequence 1
+    task_sequence = 0;
+
+    if (task_mutex) {
+        SDL_DestroyCond(task_done);
+        SDL_DestroyCond(task_wake);
+        SDL_DestroyMutex(task_mutex);
+        task_done = task_wake = NULL;
+        task_mutex = NULL;
+    }
+
+    task_started = qfalse;
+}
+
+/*
+================
+Com_ParallelFor
+================
+*/
+void Com_ParallelFor(taskfunc_t func, void *data, int count)
+{
+    int i;
+
+    if (!task_started) {
+        start_workers();
+    }
+
+    if (count < 2 || !task_numthreads) {
+        for (i = 0; i < count; i++) {
+            func(data, i);
+        }
+        return;
+    }
+
+    SDL_LockMutex(task_mutex);
+    task_func = func;
+    task_data = data;
+    task_count = count;
+    SDL_AtomicSet(&task_next, 0);
+    task_busy = task_numthreads;
+    task_sequence++;
+    SDL_CondBroadcast(task_wake);
+    SDL_UnlockMutex(task_mutex);
+
+    run_tasks();
+
+    SDL_LockMutex(task_mutex);
+    while (task_busy) {
+        SDL_CondWait(task_done, task_mutex);
+    }
+    SDL_UnlockMutex(task_mutex);
+}
+
+/*
+================
+Com_QueueTask
+================
+*/
+void Com_QueueTask(task_t *task, taskfunc_t func, void *data)
+{
+    if (!task_started) {
+        start_workers();
+    }
+
+    task->func = func;
+    task->data = data;
+
+    if (!task_numthreads) {
+        task->state = TASK_IDLE;
+        func(data, 0);
+        return;
+    }
+
+    SDL_LockMutex(task_mutex);
+    task->state = TASK_QUEUED;
+    List_Append(&task_queue, &task->entry);
+    SDL_CondSignal(task_wake);
+    SDL_UnlockMutex(task_mutex);
+}
+
+/*
+================
+Com_TaskDone
+================
+*/
+qboolean Com_TaskDone(task_t *task)
+{
+    qboolean done;
+
+    if (!task_mutex) {
+        return task->state == TASK_IDLE;
+    }
+
+    SDL_LockMutex(task_mutex);
+    done = task->state == TASK_IDLE;
+    SDL_UnlockMutex(task_mutex);
+
+    return done;
+}
+
+/*
+================
+Com_WaitTask
+================
+*/
+void Com_WaitTask(task_t *task)
+{
+    if (!task_mutex) {
+        return;
+    }
+
+    SDL_LockMutex(task_mutex);
+    if (task->state == TASK_QUEUED) {
+        List_Remove(&task->entry);
+        SDL_UnlockMutex(task_mutex);
+        task->func(task->data, 0);
+        task->state = TASK_IDLE;
+        return;
+    }
+    while (task->state == TASK_RUNNING) {
+        SDL_CondWait(task_done, task_mutex);
+    }
+    SDL_UnlockMutex(task_mutex);
+}
+
+void Com_TaskLock(void)
+{
+    SDL_LockMutex(task_lock);
+}
+
+void Com_TaskUnlock(void)
+{
+    SDL_UnlockMutex(task_lock);
+}
+
+int Com_NumWorkers(void)
+{
+    return task_numthreads;
+}
+
+static void com_workers_changed(cvar_t *self)
+{
+    // restarted on next use
+    stop_workers();
+}
+
+void Com_InitTasks(void)
+{
+    com_workers = Cvar_Get("com_workers", "-1", 0);
+    com_workers->changed = com_workers_changed;
+
+    task_lock = SDL_CreateMutex();
+}
+
+void Com_ShutdownTasks(void)
+{
+    stop_workers();
+}
@@ -21,10 +21,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/cmd.h"
 #include "common/common.h"
 #include "common/files.h"
+#include "common/msg.h"
+#include "common/protocol.h"
 #include "common/tests.h"
 #include "refresh/refresh.h"
 #include "system/system.h"
 
+#if USE_SERVER
+#include "../server/server.h"
+#endif
+
+#if USE_CLIENT && USE_SNDDMA
+#include "../client/sound/sound.h"
+#endif
+
 // test error shutdown procedures
 static void Com_Error_f(void)
 {
@@ -492,6 +502,628 @@ static void Com_TestSnprintf_f(void)
     Com_Printf("%d failures, %d strings tested\n", errors, num_snprintf_tests * 2);
 }
 
+// scalar MSG_WriteDeltaEntity as it was before vectorization, kept here as
+// the reference the optimized encoder must match byte for byte
+static void ref_WriteDeltaEntity(const entity_packed_t *from,
+                                 const entity_packed_t *to,
+                                 msgEsFlags_t          flags)
+{
+    uint32_t    bits, mask;
+
+    if (!to) {
+        if (!from)
+            Com_Error(ERR_DROP, "%s: NULL", __func__);
+
+        if (from->number < 1 || from->number >= MAX_EDICTS)
+            Com_Error(ERR_DROP, "%s: bad number: %d", __func__, from->number);
+
+        bits = U_REMOVE;
+        if (from->number & 0xff00)
+            bits |= U_NUMBER16 | U_MOREBITS1;
+
+        MSG_WriteByte(bits & 255);
+        if (bits & 0x0000ff00)
+            MSG_WriteByte((bits >> 8) & 255);
+
+        if (bits & U_NUMBER16)
+            MSG_WriteShort(from->number);
+        else
+            MSG_WriteByte(from->number);
+
+        return; // remove entity
+    }
+
+    if (to->number < 1 || to->number >= MAX_EDICTS)
+        Com_Error(ERR_DROP, "%s: bad number: %d", __func__, to->number);
+
+    if (!from)
+        from = &nullEntityState;
+
+// send an update
+    bits = 0;
+
+    if (!(flags & MSG_ES_FIRSTPERSON)) {
+        if (to->origin[0] != from->origin[0])
+            bits |= U_ORIGIN1;
+        if (to->origin[1] != from->origin[1])
+            bits |= U_ORIGIN2;
+        if (to->origin[2] != from->origin[2])
+            bits |= U_ORIGIN3;
+
+        if (flags & MSG_ES_SHORTANGLES) {
+            if (to->angles[0] != from->angles[0])
+                bits |= U_ANGLE1 | U_ANGLE16;
+            if (to->angles[1] != from->angles[1])
+                bits |= U_ANGLE2 | U_ANGLE16;
+            if (to->angles[2] != from->angles[2])
+                bits |= U_ANGLE3 | U_ANGLE16;
+        } else {
+            if (to->angles[0] != from->angles[0])
+                bits |= U_ANGLE1;
+            if (to->angles[1] != from->angles[1])
+                bits |= U_ANGLE2;
+            if (to->angles[2] != from->angles[2])
+                bits |= U_ANGLE3;
+        }
+
+        if (flags & MSG_ES_NEWENTITY) {
+            if (to->old_origin[0] != from->origin[0] ||
+                to->old_origin[1] != from->origin[1] ||
+                to->old_origin[2] != from->origin[2])
+                bits |= U_OLDORIGIN;
+        }
+    }
+
+    if (flags & MSG_ES_UMASK)
+        mask = 0xffff0000;
+    else
+        mask = 0xffff8000;  // don't confuse old clients
+
+    if (to->skinnum != from->skinnum) {
+        if (to->skinnum & mask)
+            bits |= U_SKIN8 | U_SKIN16;
+        else if (to->skinnum & 0x0000ff00)
+            bits |= U_SKIN16;
+        else
+            bits |= U_SKIN8;
+    }
+
+    if (to->frame != from->frame) {
+        if (to->frame & 0xff00)
+            bits |= U_FRAME16;
+        else
+            bits |= U_FRAME8;
+    }
+
+    if (to->effects != from->effects) {
+        if (to->effects & mask)
+            bits |= U_EFFECTS8 | U_EFFECTS16;
+        else if (to->effects & 0x0000ff00)
+            bits |= U_EFFECTS16;
+        else
+            bits |= U_EFFECTS8;
+    }
+
+    if (to->renderfx != from->renderfx) {
+        if (to->renderfx & mask)
+            bits |= U_RENDERFX8 | U_RENDERFX16;
+        else if (to->renderfx & 0x0000ff00)
+            bits |= U_RENDERFX16;
+        else
+            bits |= U_RENDERFX8;
+    }
+
+    if (to->solid != from->solid)
+        bits |= U_SOLID;
+
+    // event is not delta compressed, just 0 compressed
+    if (to->event)
+        bits |= U_EVENT;
+
+    if (to->modelindex != from->modelindex)
+        bits |= U_MODEL;
+    if (to->modelindex2 != from->modelindex2)
+        bits |= U_MODEL2;
+    if (to->modelindex3 != from->modelindex3)
+        bits |= U_MODEL3;
+    if (to->modelindex4 != from->modelindex4)
+        bits |= U_MODEL4;
+
+    if (to->sound != from->sound)
+        bits |= U_SOUND;
+
+    if (to->renderfx & RF_FRAMELERP) {
+        bits |= U_OLDORIGIN;
+    } else if (to->renderfx & RF_BEAM) {
+        if (flags & MSG_ES_BEAMORIGIN) {
+            if (to->old_origin[0] != from->old_origin[0] ||
+                to->old_origin[1] != from->old_origin[1] ||
+                to->old_origin[2] != from->old_origin[2])
+                bits |= U_OLDORIGIN;
+        } else {
+            bits |= U_OLDORIGIN;
+        }
+    }
+
+    //
+    // write the message
+    //
+    if (!bits && !(flags & MSG_ES_FORCE))
+        return;     // nothing to send!
+
+    if (flags & MSG_ES_REMOVE)
+        bits |= U_REMOVE; // used for MVD stream only
+
+    //----------
+
+    if (to->number & 0xff00)
+        bits |= U_NUMBER16;     // number8 is implicit otherwise
+
+    if (bits & 0xff000000)
+        bits |= U_MOREBITS3 | U_MOREBITS2 | U_MOREBITS1;
+    else if (bits & 0x00ff0000)
+        bits |= U_MOREBITS2 | U_MOREBITS1;
+    else if (bits & 0x0000ff00)
+        bits |= U_MOREBITS1;
+
+    MSG_WriteByte(bits & 255);
+
+    if (bits & 0xff000000) {
+        MSG_WriteByte((bits >> 8) & 255);
+        MSG_WriteByte((bits >> 16) & 255);
+        MSG_WriteByte((bits >> 24) & 255);
+    } else if (bits & 0x00ff0000) {
+        MSG_WriteByte((bits >> 8) & 255);
+        MSG_WriteByte((bits >> 16) & 255);
+    } else if (bits & 0x0000ff00) {
+        MSG_WriteByte((bits >> 8) & 255);
+    }
+
+    //----------
+
+    if (bits & U_NUMBER16)
+        MSG_WriteShort(to->number);
+    else
+        MSG_WriteByte(to->number);
+
+    if (bits & U_MODEL)
+        MSG_WriteByte(to->modelindex);
+    if (bits & U_MODEL2)
+        MSG_WriteByte(to->modelindex2);
+    if (bits & U_MODEL3)
+        MSG_WriteByte(to->modelindex3);
+    if (bits & U_MODEL4)
+        MSG_WriteByte(to->modelindex4);
+
+    if (bits & U_FRAME8)
+        MSG_WriteByte(to->frame);
+    else if (bits & U_FRAME16)
+        MSG_WriteShort(to->frame);
+
+    if ((bits & (U_SKIN8 | U_SKIN16)) == (U_SKIN8 | U_SKIN16))  //used for laser colors
+        MSG_WriteLong(to->skinnum);
+    else if (bits & U_SKIN8)
+        MSG_WriteByte(to->skinnum);
+    else if (bits & U_SKIN16)
+        MSG_WriteShort(to->skinnum);
+
+    if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
+        MSG_WriteLong(to->effects);
+    else if (bits & U_EFFECTS8)
+        MSG_WriteByte(to->effects);
+    else if (bits & U_EFFECTS16)
+        MSG_WriteShort(to->effects);
+
+    if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
+        MSG_WriteLong(to->renderfx);
+    else if (bits & U_RENDERFX8)
+        MSG_WriteByte(to->renderfx);
+    else if (bits & U_RENDERFX16)
+        MSG_WriteShort(to->renderfx);
+
+    if (bits & U_ORIGIN1)
+        MSG_WriteShort(to->origin[0]);
+    if (bits & U_ORIGIN2)
+        MSG_WriteShort(to->origin[1]);
+    if (bits & U_ORIGIN3)
+        MSG_WriteShort(to->origin[2]);
+
+    if ((flags & MSG_ES_SHORTANGLES) && (bits & U_ANGLE16)) {
+        if (bits & U_ANGLE1)
+            MSG_WriteShort(to->angles[0]);
+        if (bits & U_ANGLE2)
+            MSG_WriteShort(to->angles[1]);
+        if (bits & U_ANGLE3)
+            MSG_WriteShort(to->angles[2]);
+    } else {
+        if (bits & U_ANGLE1)
+            MSG_WriteByte(to->angles[0] >> 8);
+        if (bits & U_ANGLE2)
+            MSG_WriteByte(to->angles[1] >> 8);
+        if (bits & U_ANGLE3)
+            MSG_WriteByte(to->angles[2] >> 8);
+    }
+
+    if (bits & U_OLDORIGIN) {
+        MSG_WriteShort(to->old_origin[0]);
+        MSG_WriteShort(to->old_origin[1]);
+        MSG_WriteShort(to->old_origin[2]);
+    }
+
+    if (bits & U_SOUND)
+        MSG_WriteByte(to->sound);
+    if (bits & U_EVENT)
+        MSG_WriteByte(to->event);
+    if (bits & U_SOLID) {
+        if (flags & MSG_ES_LONGSOLID)
+            MSG_WriteLong(to->solid);
+        else
+            MSG_WriteShort(to->solid);
+    }
+}
+
+static uint32_t delta_random(uint32_t old)
+{
+    switch (rand() & 7) {
+    case 0:
+        return rand() & 0xff;
+    case 1:
+        return rand() & 0xffff;
+    case 2:
+        return ((uint32_t)rand() << 16) ^ rand();
+    case 3:
+        return -(rand() & 0xff);
+    case 4:
+        return 0;
+    default:
+        return old;     // unchanged fields are the common case
+    }
+}
+
+static void delta_randomize(entity_packed_t *to, const entity_packed_t *from)
+{
+    int i;
+
+    to->number = 1 + rand() % (MAX_EDICTS - 1);
+    for (i = 0; i < 3; i++) {
+        to->origin[i] = delta_random(from->origin[i]);
+        to->angles[i] = delta_random(from->angles[i]);
+        to->old_origin[i] = delta_random(from->old_origin[i]);
+    }
+    to->modelindex = delta_random(from->modelindex);
+    to->modelindex2 = delta_random(from->modelindex2);
+    to->modelindex3 = delta_random(from->modelindex3);
+    to->modelindex4 = delta_random(from->modelindex4);
+    to->skinnum = delta_random(from->skinnum);
+    to->effects = delta_random(from->effects);
+    to->renderfx = delta_random(from->renderfx);
+    to->solid = delta_random(from->solid);
+    to->frame = delta_random(from->frame);
+    to->sound = delta_random(from->sound);
+    to->event = delta_random(from->event);
+}
+
+static qboolean delta_compare(const entity_packed_t *from,
+                              const entity_packed_t *to, int flags)
+{
+    byte expected[MAX_ENTITY_DELTA];
+    size_t len;
+
+    SZ_Clear(&msg_write);
+    ref_WriteDeltaEntity(from, to, flags);
+    len = msg_write.cursize;
+    if (len > sizeof(expected)) {
+        SZ_Clear(&msg_write);
+        return qfalse;
+    }
+    memcpy(expected, msg_write.data, len);
+
+    SZ_Clear(&msg_write);
+    MSG_WriteDeltaEntity(from, to, flags);
+    if (msg_write.cursize != len || memcmp(msg_write.data, expected, len)) {
+        Com_EPrintf("entity %d, flags %#x: %"PRIz" bytes, expected %"PRIz"\n",
+                    to ? to->number : from->number, flags, msg_write.cursize, len);
+        SZ_Clear(&msg_write);
+        return qfalse;
+    }
+
+    SZ_Clear(&msg_write);
+    return qtrue;
+}
+
+// check that MSG_WriteDeltaEntity output is identical to the scalar encoder
+// for random entity pairs under every combination of protocol flags
+static void Com_TestDelta_f(void)
+{
+    entity_packed_t from, to;
+    int i, flags, count, errors, tested;
+    unsigned start, end;
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 10000;
+
+    start = Sys_Milliseconds();
+
+    errors = tested = 0;
+    memset(&from, 0, sizeof(from));
+    for (i = 0; i < count; i++) {
+        delta_randomize(&to, &from);
+        for (flags = 0; flags < 256; flags++) {
+            errors += !delta_compare(&from, &to, flags);
+            errors += !delta_compare(NULL, &to, flags);
+        }
+        errors += !delta_compare(&to, NULL, 0);
+        tested += 513;
+        from = to;
+    }
+
+    end = Sys_Milliseconds();
+
+    Com_Printf("%d msec, %d failures, %d deltas tested\n",
+               end - start, errors, tested);
+}
+
+#if USE_SERVER
+
+#define DCTEST_STATES   64
+
+static const msgEsFlags_t dctest_flags[] = {
+    0, MSG_ES_SHORTANGLES, MSG_ES_LONGSOLID | MSG_ES_UMASK, MSG_ES_FORCE
+};
+
+// check that updates copied from the shared delta cache are identical to
+// freshly encoded ones. Deltas between a small set of states repeat often
+// enough to hit, and unchanged entities must be neither cached nor counted.
+static void Com_TestDeltaCache_f(void)
+{
+    entity_packed_t *states;
+    const entity_packed_t *from, *to;
+    byte expected[MAX_ENTITY_DELTA];
+    uint64_t saved_hits, saved_misses, saved_bytes, lookups;
+    int i, count, errors, enabled;
+    msgEsFlags_t flags;
+    qboolean allocated;
+    unsigned start, end;
+    size_t len;
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 100000;
+
+    states = Z_Malloc(sizeof(*states) * DCTEST_STATES);
+    delta_randomize(&states[0], &nullEntityState);
+    for (i = 1; i < DCTEST_STATES; i++) {
+        delta_randomize(&states[i], &states[i - 1]);
+    }
+
+    saved_hits = svs.delta_hits;
+    saved_misses = svs.delta_misses;
+    saved_bytes = svs.delta_bytes;
+    svs.delta_hits = svs.delta_misses = svs.delta_bytes = 0;
+
+    enabled = sv_delta_cache->integer;
+    Cvar_SetInteger(sv_delta_cache, 1, FROM_CODE);
+    allocated = !svs.delta_cache;
+
+    start = Sys_Milliseconds();
+    errors = 0;
+
+    for (i = 0; i < count; i++) {
+        from = &states[rand() % DCTEST_STATES];
+        to = (rand() & 7) ? &states[rand() % DCTEST_STATES] : from;
+        flags = dctest_flags[rand() % q_countof(dctest_flags)];
+
+        SZ_Clear(&msg_write);
+        MSG_WriteDeltaEntity(from, to, flags);
+        len = msg_write.cursize;
+        memcpy(expected, msg_write.data, len);
+
+        SZ_Clear(&msg_write);
+        lookups = svs.delta_hits + svs.delta_misses;
+        SV_WriteDeltaEntity(from, to, flags);
+        if (msg_write.cursize != len || memcmp(msg_write.data, expected, len)) {
+            Com_EPrintf("entity %d, flags %#x: %"PRIz" bytes, expected %"PRIz"\n",
+                        to->number, flags, msg_write.cursize, len);
+            errors++;
+        } else if (!len && svs.delta_hits + svs.delta_misses != lookups) {
+            Com_EPrintf("entity %d, flags %#x: empty delta counted\n",
+                        to->number, flags);
+            errors++;
+        }
+    }
+
+    SZ_Clear(&msg_write);
+
+    end = Sys_Milliseconds();
+
+    if (count >= 10000 && !svs.delta_hits) {
+        Com_EPrintf("No cache hits\n");
+        errors++;
+    }
+
+    Com_Printf("%d msec, %d failures, %d deltas tested, "
+               "%"PRIu64" hits, %"PRIu64" misses\n", end - start, errors,
+               count, svs.delta_hits, svs.delta_misses);
+
+    svs.delta_hits = saved_hits;
+    svs.delta_misses = saved_misses;
+    svs.delta_bytes = saved_bytes;
+
+    Cvar_SetInteger(sv_delta_cache, enabled, FROM_CODE);
+    if (allocated) {
+        Z_Free(svs.delta_cache);
+        svs.delta_cache = NULL;
+    }
+
+    Z_Free(states);
+}
+
+#endif
+
+#if USE_CLIENT || USE_MVD_CLIENT
+
+static const msgEsFlags_t parsetest_flags[] = {
+    0, MSG_ES_SHORTANGLES, MSG_ES_LONGSOLID, MSG_ES_SHORTANGLES | MSG_ES_LONGSOLID
+};
+
+// parses an entity record at the given offset with the checked reference
+// parser and with the cursor based one, returns qfalse if results differ
+static qboolean parse_compare(const byte *data, size_t len, size_t offset,
+                              const entity_state_t *from, msgEsFlags_t flags)
+{
+    entity_state_t expected, actual;
+    int number, bits, expected_number, expected_bits;
+    size_t expected_readcount;
+    byte *cursor;
+
+    memcpy(msg_read_buffer, data, len);
+    msg_read.cursize = len;
+    msg_read.allowunderflow = qtrue;
+
+    msg_read.readcount = offset;
+    expected_number = MSG_ParseEntityBits(&expected_bits);
+    if (expected_number > 0 && expected_number < MAX_EDICTS)
+        MSG_ParseDeltaEntity(from, &expected, expected_number, expected_bits, flags);
+    expected_readcount = msg_read.readcount;
+
+    msg_read.readcount = offset;
+    number = MSG_ReadEntityBits(&bits, &cursor);
+    if (number > 0 && number < MAX_EDICTS)
+        MSG_ReadDeltaEntity(cursor, from, &actual, number, bits, flags);
+
+    if (number != expected_number || bits != expected_bits ||
+        msg_read.readcount != expected_readcount) {
+        Com_EPrintf("offset %"PRIz", flags %#x: entity %d bits %#x read %"PRIz", "
+                    "expected entity %d bits %#x read %"PRIz"\n", offset, flags,
+                    number, bits, msg_read.readcount,
+                    expected_number, expected_bits, expected_readcount);
+        return qfalse;
+    }
+
+    if (number > 0 && number < MAX_EDICTS && memcmp(&actual, &expected, sizeof(actual))) {
+        Com_EPrintf("offset %"PRIz", flags %#x: entity %d state differs\n",
+                    offset, flags, number);
+        return qfalse;
+    }
+
+    return qtrue;
+}
+
+static int parse_compare_all(const byte *data, size_t len, size_t offset,
+                             const entity_state_t *from, int *tested)
+{
+    int i, errors = 0;
+
+    for (i = 0; i < q_countof(parsetest_flags); i++) {
+        errors += !parse_compare(data, len, offset, from, parsetest_flags[i]);
+    }
+    *tested += q_countof(parsetest_flags);
+
+    return errors;
+}
+
+static void parse_randomize(entity_state_t *from)
+{
+    byte *p = (byte *)from;
+    int i;
+
+    for (i = 0; i < sizeof(*from); i++) {
+        p[i] = rand();
+    }
+    for (i = 0; i < 3; i++) {
+        from->origin[i] = (rand() - RAND_MAX / 2) * 0.125f;
+        from->angles[i] = rand() % 360;
+        from->old_origin[i] = (rand() - RAND_MAX / 2) * 0.125f;
+    }
+}
+
+// check that the cursor based entity parser gives the same results as the
+// checked one. Without arguments, random entity records are written and
+// then mangled. With a .dm2 demo, a record is parsed from every byte offset
+// of every demo message, which covers real records as well as junk.
+static void Com_TestParse_f(void)
+{
+    entity_packed_t pfrom, pto;
+    entity_state_t from;
+    byte data[MAX_ENTITY_DELTA * 4];
+    byte *demo, *p, *end;
+    sizebuf_t saved;
+    int i, j, count, errors, tested;
+    size_t len, k;
+    ssize_t ret;
+    unsigned start, finish;
+    char *s;
+
+    count = 10000;
+    demo = NULL;
+    ret = 0;
+    if (Cmd_Argc() > 1) {
+        s = Cmd_Argv(1);
+        if (Q_isdigit(*s)) {
+            count = atoi(s);
+        } else {
+            ret = FS_LoadFile(s, (void **)&demo);
+            if (!demo) {
+                Com_Printf("Couldn't load %s: %s\n", s, Q_ErrorString(ret));
+                return;
+            }
+        }
+    }
+
+    saved = msg_read;
+    start = Sys_Milliseconds();
+    errors = tested = 0;
+    parse_randomize(&from);
+
+    if (demo) {
+        p = demo;
+        end = demo + ret;
+        while (end - p >= 4) {
+            len = LittleLongMem(p);
+            p += 4;
+            if (len > MAX_MSGLEN || len > end - p)
+                break;
+            for (k = 0; k < len; k++) {
+                errors += parse_compare_all(p, len, k, &from, &tested);
+            }
+            p += len;
+        }
+        FS_FreeFile(demo);
+    } else {
+        memset(&pfrom, 0, sizeof(pfrom));
+        memset(&pto, 0, sizeof(pto));
+        for (i = 0; i < count; i++) {
+            delta_randomize(&pto, &pfrom);
+            SZ_Clear(&msg_write);
+            MSG_WriteDeltaEntity(&pfrom, &pto, parsetest_flags[i & 3] | MSG_ES_FORCE);
+            len = min(msg_write.cursize, sizeof(data));
+            memcpy(data, msg_write.data, len);
+            SZ_Clear(&msg_write);
+            pfrom = pto;
+
+            // intact record, cut short, then with random bytes flipped
+            errors += parse_compare_all(data, len, 0, &from, &tested);
+            errors += parse_compare_all(data, rand() % (len + 1), 0, &from, &tested);
+            for (j = 0; j < 4; j++) {
+                data[rand() % len] = rand();
+            }
+            errors += parse_compare_all(data, len, 0, &from, &tested);
+
+            // record followed by plenty of junk, so that the fast path is taken
+            for (k = len; k < sizeof(data); k++) {
+                data[k] = rand();
+            }
+            errors += parse_compare_all(data, sizeof(data), 0, &from, &tested);
+            errors += parse_compare_all(data, sizeof(data), rand() % len, &from, &tested);
+        }
+    }
+
+    finish = Sys_Milliseconds();
+    msg_read = saved;
+
+    Com_Printf("%d msec, %d failures, %d records tested\n",
+               finish - start, errors, tested);
+}
+
+#endif
+
 #if USE_REF
 static void Com_TestModels_f(void)
 {
@@ -524,6 +1156,199 @@ static void Com_TestModels_f(void)
 }
 #endif
 
+#if USE_CLIENT && USE_SNDDMA
+
+typedef struct {
+    int     width;
+    int     length;
+    int     loopstart;
+    int     amplitude;
+    int     leftvol;
+    int     rightvol;
+    int     start;      // rounded down to MIXTEST_STEP
+    qboolean    autosound;
+} mixtest_t;
+
+// covers both sample widths, loops, autosounds, sounds shorter than one
+// SIMD step, volumes above 255 and enough loud channels to clip
+static const mixtest_t mixtests[] = {
+    { 2, 5000,  -1,   8000, 255, 128,     0 },
+    { 2, 3001,  100,  32767, 255, 255,   17 },
+    { 2, 3001,  100,  32767, 255, 255,   33 },
+    { 2, 3001,  100,  32767, 255, 255,   61 },
+    { 2, 3001,  100,  32767, 255, 255,  100 },
+    { 2, 4000,  -1,   32767, 300, 40,  1500 },
+    { 2, 4000,  -1,   32767, 40, 300,  1501 },
+    { 2, 5,     -1,   20000, 200, 200,  777 },
+    { 1, 3001,  -1,   127, 255, 0,        3 },
+    { 1, 1999,  0,    127, 0, 255,      250 },
+    { 1, 37,    -1,   100, 180, 90,       0, qtrue },
+    { 2, 41,    -1,   30000, 90, 180,     0, qtrue },
+    { 1, 4000,  -1,   127, 400, 17,    2047 },
+};
+
+#define MIXTEST_START   (S_MAX_RAW_SAMPLES - 1000)  // raw samples wrap
+#define MIXTEST_LENGTH  30000     // DMA buffer wraps
+#define MIXTEST_RAW     5000
+#define MIXTEST_STEP    1111
+
+static sfx_t        mixtest_sfx[q_countof(mixtests)];
+static samplepair_t mixtest_raw[MIXTEST_RAW];
+
+static void mixtest_init(void)
+{
+    const mixtest_t *t;
+    sfxcache_t *sc;
+    int i, j, val;
+
+    for (i = 0; i < q_countof(mixtests); i++) {
+        t = &mixtests[i];
+        sc = Z_Malloc(sizeof(*sc) + t->length * t->width);
+        sc->length = t->length;
+        sc->loopstart = t->loopstart;
+        sc->width = t->width;
+        for (j = 0; j < t->length; j++) {
+            val = (rand() % (t->amplitude * 2 + 1)) - t->amplitude;
+            if (t->width == 1)
+                sc->data[j] = val + 128;
+            else
+                ((int16_t *)sc->data)[j] = val;
+        }
+        Q_snprintf(mixtest_sfx[i].name, MAX_QPATH, "mixtest%d", i);
+        mixtest_sfx[i].cache = sc;
+    }
+
+    for (i = 0; i < MIXTEST_RAW; i++) {
+        mixtest_raw[i].left = (rand() % 65536 - 32768) * 256;
+        mixtest_raw[i].right = (rand() % 65536 - 32768) * 256;
+    }
+}
+
+static void mixtest_shutdown(void)
+{
+    int i;
+
+    for (i = 0; i < q_countof(mixtests); i++) {
+        Z_Free(mixtest_sfx[i].cache);
+        memset(&mixtest_sfx[i], 0, sizeof(mixtest_sfx[i]));
+    }
+}
+
+// runs the mixer over the whole script, in steps like S_Update would
+static void mixtest_run(int16_t *out)
+{
+    const mixtest_t *t;
+    channel_t *ch;
+    int i, time;
+
+    memset(channels, 0, sizeof(channels));
+    memset(out, 0, dma.samples * 2);
+    paintedtime = MIXTEST_START;
+
+    for (i = 0; i < MIXTEST_RAW; i++)
+        s_rawsamples[(MIXTEST_START + i) & (S_MAX_RAW_SAMPLES - 1)] = mixtest_raw[i];
+    s_rawend = MIXTEST_START + MIXTEST_RAW;
+
+    for (time = 0; time < MIXTEST_LENGTH; time += MIXTEST_STEP) {
+        // start channels scheduled for this step
+        for (i = 0; i < q_countof(mixtests); i++) {
+            t = &mixtests[i];
+            if (t->start < time || t->start >= time + MIXTEST_STEP)
+                continue;
+            ch = &channels[i];
+            ch->sfx = &mixtest_sfx[i];
+            ch->leftvol = t->leftvol;
+            ch->rightvol = t->rightvol;
+            ch->autosound = t->autosound;
+            ch->pos = 0;
+            ch->end = paintedtime + t->length;
+        }
+        S_PaintChannels(MIXTEST_START + time + MIXTEST_STEP);
+    }
+
+    S_FlushMixer();
+}
+
+// mixes a scripted set of channels into a memory buffer with scalar and
+// SIMD kernels, inline and on the mixer thread, and checks that all
+// outputs are identical. Needs no sound device, but sound must be stopped.
+static void Com_TestMixer_f(void)
+{
+    int16_t *expected, *actual;
+    dma_t saved_dma;
+    int i, errors, size;
+    unsigned start, end;
+
+    if (s_started) {
+        Com_Printf("Sound must be stopped (s_enable 0; snd_restart).\n");
+        return;
+    }
+
+    s_volume = Cvar_Get("s_volume", "0.7", CVAR_ARCHIVE);
+    s_testsound = Cvar_Get("s_testsound", "0", 0);
+
+    saved_dma = dma;
+    dma.channels = 2;
+    dma.samples = 0x8000 * 2;
+    dma.samplebits = 16;
+    dma.speed = 44100;
+    dma.submission_chunk = 1;
+    dma.samplepos = 0;
+
+    size = dma.samples * 2;
+    expected = Z_Malloc(size);
+    actual = Z_Malloc(size);
+
+    s_pendingplays.next = s_pendingplays.prev = &s_pendingplays;
+    s_numchannels = MAX_CHANNELS;
+    S_InitScaletable();
+    mixtest_init();
+
+    start = Sys_Milliseconds();
+    errors = 0;
+
+    // reference scalar output
+#if USE_SSE2
+    s_mixsimd = qfalse;
+#endif
+    dma.buffer = (byte *)expected;
+    S_InitMixer(qfalse);
+    mixtest_run(expected);
+#if USE_SSE2
+    s_mixsimd = qtrue;
+#endif
+
+    for (i = 0; i < 2; i++) {
+        dma.buffer = (byte *)actual;
+        S_InitMixer(i);
+        mixtest_run(actual);
+        if (S_MixerThreaded() != i) {
+            Com_EPrintf("Couldn't start mixer thread\n");
+            errors++;
+        }
+        S_ShutdownMixer();
+        if (memcmp(actual, expected, size)) {
+            Com_EPrintf("%s mixer output differs from scalar\n", i ? "Threaded" : "Inline");
+            errors++;
+        }
+    }
+
+    end = Sys_Milliseconds();
+
+    mixtest_shutdown();
+    memset(channels, 0, sizeof(channels));
+    s_numchannels = 0;
+    paintedtime = 0;
+    s_rawend = 0;
+    dma = saved_dma;
+    Z_Free(expected);
+    Z_Free(actual);
+
+    Com_Printf("%d msec, %d failures, %d channels mixed\n",
+               end - start, errors, (int)q_countof(mixtests));
+}
+#endif
+
 void TST_Init(void)
 {
     Cmd_AddCommand("error", Com_Error_f);
@@ -536,6 +1361,16 @@ void TST_Init(void)
     Cmd_AddCommand("normtest", Com_TestNorm_f);
     Cmd_AddCommand("infotest", Com_TestInfo_f);
     Cmd_AddCommand("snprintftest", Com_TestSnprintf_f);
+    Cmd_AddCommand("deltatest", Com_TestDelta_f);
+#if USE_SERVER
+    Cmd_AddCommand("deltacachetest", Com_TestDeltaCache_f);
+#endif
+#if USE_CLIENT || USE_MVD_CLIENT
+    Cmd_AddCommand("parsetest", Com_TestParse_f);
+#endif
+#if USE_CLIENT && USE_SNDDMA
+    Cmd_AddCommand("mixtest", Com_TestMixer_f);
+#endif
 #if USE_REF
     Cmd_AddCommand("modeltest", Com_TestModels_f);
 #endif
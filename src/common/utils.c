@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "shared/shared.h"
 #include "common/utils.h"
+#include "common/zone.h"
 
 /*
 ==============================================================================
@@ -498,3 +499,128 @@ size_t Com_FormatSizeLong(char *dest, size_t destsize, off_t bytes)
 }
 
 
+
+/*
+==============================================================================
+
+                        CONFIGSTRINGS
+
+Configstring tables hold interned strings, so unchanged slots can be found
+by comparing pointers. Each slot stores the whole string, but writes into
+the middle of a long string still splice it, like they did when tables
+were flat arrays of MAX_QPATH sized slots.
+
+==============================================================================
+*/
+
+/*
+================
+Com_ClearConfigstrings
+
+Releases all strings and fills the table with empty ones. Cleared tables
+never have NULL slots.
+================
+*/
+void Com_ClearConfigstrings(const char **table)
+{
+    const char *empty = Z_InternStringLen("", 0);
+    int i;
+
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        Z_ReleaseString(table[i]);
+        table[i] = empty;
+    }
+}
+
+/*
+================
+Com_CopyConfigstrings
+================
+*/
+void Com_CopyConfigstrings(const char **dst, const char **src)
+{
+    const char *old;
+    int i;
+
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        old = dst[i];
+        dst[i] = Z_RetainString(src[i]);
+        Z_ReleaseString(old);
+    }
+}
+
+/*
+================
+Com_ConfigstringSlot
+
+Returns what the slot would contain if the table was flat: either the string
+stored in it, or the tail of a long string covering it. Gamestates are still
+written slot by slot from this, so that older clients can parse them.
+================
+*/
+const char *Com_ConfigstringSlot(const char **table, int index)
+{
+    const char *s = table[index];
+    size_t ofs;
+    int i;
+
+    if (!*s && index > CS_STATUSBAR && index < CS_AIRACCEL) {
+        for (i = index - 1; i > CS_STATUSBAR && !*table[i]; i--)
+            ;
+        ofs = (index - i) * MAX_QPATH;
+        if (strlen(table[i]) > ofs) {
+            s = table[i] + ofs;
+        }
+    }
+
+    return s;
+}
+
+/*
+================
+Com_SetConfigstring
+
+Stores interned copy of the string, truncated to CS_SIZE. A write into the
+slot covered by the previous long string is appended to that string at the
+slot offset. This is how chunked statusbar strings from older gamestates
+and savegames are joined back. Returns qfalse if nothing changed.
+================
+*/
+qboolean Com_SetConfigstring(const char **table, int index, const char *s, size_t len)
+{
+    char buffer[CS_MAXSIZE];
+    const char *old, *string;
+    size_t maxlen, ofs;
+    int i;
+
+    maxlen = CS_SIZE(index);
+    if (len >= maxlen) {
+        len = maxlen - 1;
+    }
+
+    if (index > CS_STATUSBAR && index < CS_AIRACCEL) {
+        for (i = index - 1; i > CS_STATUSBAR && !*table[i]; i--)
+            ;
+        ofs = (index - i) * MAX_QPATH;
+        if (strlen(table[i]) >= ofs) {
+            memcpy(buffer, table[i], ofs);
+            memcpy(buffer + ofs, s, len);
+            s = buffer;
+            len += ofs;
+            index = i;
+        }
+    }
+
+    string = Z_InternStringLen(s, len);
+    old = table[index];
+    table[index] = string;
+    Z_ReleaseString(old);
+
+    // slots covered by the string are kept empty
+    for (i = index + 1; i <= index + len / MAX_QPATH; i++) {
+        Z_ReleaseString(table[i]);
+        table[i] = Z_InternStringLen("", 0);
+    }
+
+    return string != old;
+}
@@ -79,6 +79,9 @@ typedef struct {
 } zstats_t;
 
 static zstats_t z_stats[TAG_MAX];
+static zstats_t z_total;    // cumulative, never decremented
+
+static void Z_InternStats(void);
 
 static const char z_tagnames[TAG_MAX][8] = {
     "game",
@@ -92,7 +95,8 @@ static const char z_tagnames[TAG_MAX][8] = {
     "server",
     "mvd",
     "sound",
-    "cmodel"
+    "cmodel",
+    "string"
 };
 
 static inline void Z_Validate(zhead_t *z, const char *func)
@@ -216,6 +220,9 @@ void *Z_Realloc(void *ptr, size_t size)
 
     s->bytes += size;
 
+    z_total.count++;
+    z_total.bytes += size;
+
     Z_TAIL_F(z) = Z_TAIL;
 
     return z + 1;
@@ -247,6 +254,8 @@ void Z_Stats_f(void)
     Com_Printf("--------- ------ -------\n"
                "%9"PRIz" %6"PRIz" total\n",
                bytes, count);
+
+    Z_InternStats();
 }
 
 /*
@@ -267,6 +276,19 @@ void Z_FreeTags(memtag_t tag)
     }
 }
 
+/*
+========================
+Z_GetAllocStats
+
+Returns total number and size of allocations made so far.
+========================
+*/
+void Z_GetAllocStats(size_t *count, size_t *bytes)
+{
+    *count = z_total.count;
+    *bytes = z_total.bytes;
+}
+
 /*
 ========================
 Z_TagMalloc
@@ -324,6 +346,9 @@ void *Z_TagMalloc(size_t size, memtag_t tag)
     s->count++;
     s->bytes += size;
 
+    z_total.count++;
+    z_total.bytes += size;
+
     return z + 1;
 }
 
@@ -445,3 +470,158 @@ char *Z_CvarCopyString(const char *in)
 }
 
 
+
+/*
+==============================================================================
+
+STRING INTERNING
+
+Identical strings share one refcounted copy, so handles can be compared
+by pointer. Handles stay valid until the last reference is released.
+
+==============================================================================
+*/
+
+#define Z_STRING_HASH   4096
+
+typedef struct zstring_s {
+    struct zstring_s    *next;
+    unsigned            hash;
+    unsigned            refcount;
+    size_t              len;
+    char                string[1];
+} zstring_t;
+
+static zstring_t    *z_strings[Z_STRING_HASH];
+
+static struct {
+    size_t  lookups, hits;
+    size_t  count, bytes;
+} z_intern;
+
+#define Z_STRING(s) \
+    ((zstring_t *)((char *)(s) - q_offsetof(zstring_t, string)))
+
+#define Z_EMPTY_STRING  z_static[10].data
+
+/*
+================
+Z_InternStringLen
+================
+*/
+const char *Z_InternStringLen(const char *in, size_t len)
+{
+    zstring_t *z;
+    unsigned hash;
+
+    if (!in) {
+        return NULL;
+    }
+
+    // empty strings are not pooled
+    if (!len) {
+        return Z_EMPTY_STRING;
+    }
+
+    z_intern.lookups++;
+
+    hash = Com_HashStringLen(in, len, Z_STRING_HASH);
+    for (z = z_strings[hash]; z; z = z->next) {
+        if (z->len == len && !memcmp(z->string, in, len)) {
+            z->refcount++;
+            z_intern.hits++;
+            return z->string;
+        }
+    }
+
+    z = Z_TagMalloc(sizeof(*z) + len, TAG_STRING);
+    z->hash = hash;
+    z->refcount = 1;
+    z->len = len;
+    memcpy(z->string, in, len);
+    z->string[len] = 0;
+    z->next = z_strings[hash];
+    z_strings[hash] = z;
+
+    z_intern.count++;
+    z_intern.bytes += len + 1;
+
+    return z->string;
+}
+
+const char *Z_InternString(const char *in)
+{
+    if (!in) {
+        return NULL;
+    }
+    return Z_InternStringLen(in, strlen(in));
+}
+
+/*
+================
+Z_RetainString
+
+Adds a reference to already interned string.
+================
+*/
+const char *Z_RetainString(const char *in)
+{
+    if (in && in != Z_EMPTY_STRING) {
+        Z_STRING(in)->refcount++;
+    }
+    return in;
+}
+
+/*
+================
+Z_ReleaseString
+================
+*/
+void Z_ReleaseString(const char *in)
+{
+    zstring_t *z, **next_p;
+
+    if (!in || in == Z_EMPTY_STRING) {
+        return;
+    }
+
+    z = Z_STRING(in);
+    if (!z->refcount) {
+        Com_Error(ERR_FATAL, "%s: bad refcount", __func__);
+    }
+    if (--z->refcount) {
+        return;
+    }
+
+    for (next_p = &z_strings[z->hash]; *next_p; next_p = &(*next_p)->next) {
+        if (*next_p == z) {
+            *next_p = z->next;
+            break;
+        }
+    }
+
+    z_intern.count--;
+    z_intern.bytes -= z->len + 1;
+
+    Z_Free(z);
+}
+
+static void Z_InternStats(void)
+{
+    size_t saved = 0;
+    zstring_t *z;
+    int i;
+
+    for (i = 0; i < Z_STRING_HASH; i++) {
+        for (z = z_strings[i]; z; z = z->next) {
+            saved += (z->refcount - 1) * (z->len + 1);
+        }
+    }
+
+    Com_Printf("%"PRIz" interned strings, %"PRIz" bytes, %"PRIz" bytes shared\n",
+               z_intern.count, z_intern.bytes, saved);
+    if (z_intern.lookups) {
+        Com_Printf("%"PRIz" lookups, %.1f%% hit rate\n", z_intern.lookups,
+                   z_intern.hits * 100.0 / z_intern.lookups);
+    }
+}
@@ -26,12 +26,18 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/files.h"
+#include "system/system.h"
 #include "refresh/images.h"
 #include "format/pcx.h"
 #include "format/wal.h"
 #include "stb_image.h"
 #include "stb_image_write.h"
 
+#include <SDL_atomic.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
 #define R_COLORMAP_PCX    "pics/colormap.pcx"
 
 #define IMG_LOAD(x) \
@@ -405,13 +411,185 @@ IMG_SAVE(PNG)
 
 SCREEN SHOTS
 
+Pixels are read back on the main thread, then encoded and written out by a
+background thread, so that taking a screenshot doesn't stall the game. Jobs
+go through a small ring; pixel buffers travel with the job and are freed
+by the main thread once the file is closed. When all slots are busy, the
+main thread waits for the encoder.
+
 =========================================================
 */
 
+typedef qerror_t (*saveimage_t)(qhandle_t, const char *, byte *, int, int, int, int);
+
+#define SHOT_QUEUE_SIZE 4   // must be a power of 2
+#define SHOT_QUEUE_MASK (SHOT_QUEUE_SIZE - 1)
+
+typedef struct {
+    char        name[MAX_OSPATH];
+    qhandle_t   f;
+    saveimage_t save;
+    byte        *pixels;
+    int         width, height, rowbytes, param;
+    qerror_t    ret;
+    qboolean    quiet;      // don't report success
+} shotjob_t;
+
+static shotjob_t    shot_queue[SHOT_QUEUE_SIZE];
+static SDL_atomic_t shot_head;      // next job to queue, written by main thread
+static SDL_atomic_t shot_tail;      // next job to encode, written by encoder
+static int          shot_done;      // next job to finish on main thread
+static SDL_atomic_t shot_quit;
+static SDL_sem      *shot_wake;
+static SDL_Thread   *shot_thread;
+static qboolean     shot_failed;    // don't retry creating the thread
+
+static unsigned     shot_stalls;    // times main thread waited for a slot
+static unsigned     shot_stalltime; // milliseconds spent waiting
+
+static struct {
+    int         fps;        // 0 if not dumping
+    unsigned    start;
+    unsigned    frames;     // frames written
+    unsigned    skipped;    // intervals missed because game ran slower
+    const char  *ext;
+    saveimage_t save;
+    int         param;
+} framedump;
+
 static cvar_t *r_screenshot_format;
 static cvar_t *r_screenshot_quality;
 static cvar_t* r_screenshot_compression;
 static cvar_t* r_screenshot_message;
+static cvar_t *r_screenshot_async;
+
+static int IMG_EncoderThread(void *arg)
+{
+    shotjob_t *job;
+    int tail;
+
+    while (!SDL_AtomicGet(&shot_quit)) {
+        SDL_SemWait(shot_wake);
+
+        for (tail = SDL_AtomicGet(&shot_tail); tail != SDL_AtomicGet(&shot_head); tail++) {
+            job = &shot_queue[tail & SHOT_QUEUE_MASK];
+            job->ret = job->save(job->f, job->name, job->pixels, job->width,
+                                 job->height, job->rowbytes, job->param);
+            SDL_AtomicSet(&shot_tail, tail + 1);
+        }
+    }
+
+    return 0;
+}
+
+static qboolean start_encoder(void)
+{
+    if (shot_thread) {
+        return qtrue;
+    }
+
+    if (shot_failed || !r_screenshot_async->integer) {
+        return qfalse;
+    }
+
+    SDL_AtomicSet(&shot_head, 0);
+    SDL_AtomicSet(&shot_tail, 0);
+    SDL_AtomicSet(&shot_quit, 0);
+    shot_done = 0;
+
+    shot_wake = SDL_CreateSemaphore(0);
+    if (!shot_wake) {
+        Com_WPrintf("Couldn't create encoder semaphore: %s\n", SDL_GetError());
+        shot_failed = qtrue;
+        return qfalse;
+    }
+
+    shot_thread = SDL_CreateThread(IMG_EncoderThread, "encoder", NULL);
+    if (!shot_thread) {
+        Com_WPrintf("Couldn't create encoder thread: %s\n", SDL_GetError());
+        SDL_DestroySemaphore(shot_wake);
+        shot_wake = NULL;
+        shot_failed = qtrue;
+        return qfalse;
+    }
+
+    Com_DPrintf("Started screenshot encoder thread\n");
+    return qtrue;
+}
+
+static void finish_screenshot(shotjob_t *job)
+{
+    FS_FreeTempMem(job->pixels);
+    FS_FCloseFile(job->f);
+
+    if (job->ret < 0) {
+        Com_EPrintf("Couldn't write %s: %s\n", job->name, Q_ErrorString(job->ret));
+    } else if (!job->quiet && r_screenshot_message->integer) {
+        Com_Printf("Wrote %s\n", job->name);
+    }
+}
+
+// finishes encoded jobs, waiting until no more than `pending' are left
+static void finish_screenshots(int pending)
+{
+    int tail;
+
+    if (!shot_thread) {
+        return;
+    }
+
+    while (1) {
+        tail = SDL_AtomicGet(&shot_tail);
+        while (shot_done != tail) {
+            finish_screenshot(&shot_queue[shot_done++ & SHOT_QUEUE_MASK]);
+        }
+        if (SDL_AtomicGet(&shot_head) - shot_done <= pending) {
+            break;
+        }
+        SDL_Delay(1);
+    }
+}
+
+static void stop_encoder(void)
+{
+    if (!shot_thread) {
+        return;
+    }
+
+    finish_screenshots(0);
+
+    SDL_AtomicSet(&shot_quit, 1);
+    SDL_SemPost(shot_wake);
+    SDL_WaitThread(shot_thread, NULL);
+    SDL_DestroySemaphore(shot_wake);
+    shot_thread = NULL;
+    shot_wake = NULL;
+}
+
+static void queue_screenshot(shotjob_t *job)
+{
+    unsigned start;
+    int head;
+
+    if (!start_encoder()) {
+        job->ret = job->save(job->f, job->name, job->pixels, job->width,
+                             job->height, job->rowbytes, job->param);
+        finish_screenshot(job);
+        return;
+    }
+
+    head = SDL_AtomicGet(&shot_head);
+    if (head - shot_done >= SHOT_QUEUE_SIZE) {
+        start = Sys_Milliseconds();
+        finish_screenshots(SHOT_QUEUE_SIZE - 1);
+        shot_stalltime += Sys_Milliseconds() - start;
+        shot_stalls++;
+    }
+
+    shot_queue[head & SHOT_QUEUE_MASK] = *job;
+    SDL_AtomicSet(&shot_head, head + 1);
+    SDL_SemPost(shot_wake);
+}
 
 static qhandle_t create_screenshot(char *buffer, size_t size,
                                    const char *name, const char *ext)
@@ -445,31 +623,147 @@ static qhandle_t create_screenshot(char *buffer, size_t size,
 }
 
 static void make_screenshot(const char *name, const char *ext,
-                            qerror_t (*save)(qhandle_t, const char *, byte *, int, int, int, int),
-                            int param)
+                            saveimage_t save, int param, qboolean quiet)
 {
-    char        buffer[MAX_OSPATH];
-    byte        *pixels;
-    qerror_t    ret;
-    qhandle_t   f;
-    int         w, h, rowbytes;
+    shotjob_t   job;
 
-    f = create_screenshot(buffer, sizeof(buffer), name, ext);
-    if (!f) {
+    job.f = create_screenshot(job.name, sizeof(job.name), name, ext);
+    if (!job.f) {
         return;
     }
 
-    pixels = IMG_ReadPixels(&w, &h, &rowbytes);
-    ret = save(f, buffer, pixels, w, h, rowbytes, param);
-    FS_FreeTempMem(pixels);
+    job.pixels = IMG_ReadPixels(&job.width, &job.height, &job.rowbytes);
+    if (!job.pixels) {
+        FS_FCloseFile(job.f);
+        return;
+    }
 
-    FS_FCloseFile(f);
+    job.save = save;
+    job.param = param;
+    job.ret = Q_ERR_SUCCESS;
+    job.quiet = quiet;
 
-    if (ret < 0) {
-        Com_EPrintf("Couldn't write %s: %s\n", buffer, Q_ErrorString(ret));
-    } else if(r_screenshot_message->integer) {
-        Com_Printf("Wrote %s\n", buffer);
+    queue_screenshot(&job);
+}
+
+static void get_screenshot_format(const char *s, const char **ext,
+                                  saveimage_t *save, int *param)
+{
+    if (*s == 'j') {
+        *ext = ".jpg";
+        *save = IMG_SaveJPG;
+        *param = r_screenshot_quality->integer;
+    } else if (*s == 'p') {
+        *ext = ".png";
+        *save = IMG_SavePNG;
+        *param = r_screenshot_compression->integer;
+    } else {
+        *ext = ".tga";
+        *save = IMG_SaveTGA;
+        *param = 0;
+    }
+}
+
+static void framedump_stats(void)
+{
+    Com_Printf("%u frames written, %u intervals skipped, "
+               "waited for encoder %u times (%u ms).\n",
+               framedump.frames, framedump.skipped,
+               shot_stalls, shot_stalltime);
+}
+
+static void framedump_stop(void)
+{
+    if (!framedump.fps) {
+        return;
+    }
+
+    framedump.fps = 0;
+    finish_screenshots(0);
+
+    Com_Printf("Stopped frame dump.\n");
+    framedump_stats();
+}
+
+/*
+==================
+IMG_RunScreenshots
+
+Called after each frame is drawn. Reports finished screenshots and writes
+the next frame dump image when it is due.
+==================
+*/
+void IMG_RunScreenshots(void)
+{
+    char        name[MAX_QPATH];
+    unsigned    next;
+
+    finish_screenshots(SHOT_QUEUE_SIZE);
+
+    if (!framedump.fps) {
+        return;
+    }
+
+    next = (uint64_t)(Sys_Milliseconds() - framedump.start) * framedump.fps / 1000;
+    if (next < framedump.frames + framedump.skipped) {
+        return;
+    }
+
+    framedump.skipped = next - framedump.frames;
+
+    Q_snprintf(name, sizeof(name), "frame%06u", framedump.frames);
+    make_screenshot(name, framedump.ext, framedump.save, framedump.param, qtrue);
+    framedump.frames++;
+}
+
+/*
+==================
+IMG_FrameDump_f
+
+Starts writing numbered screenshots at the given rate, for making videos.
+==================
+*/
+static void IMG_FrameDump_f(void)
+{
+    int fps;
+
+    if (Cmd_Argc() < 2) {
+        if (framedump.fps) {
+            Com_Printf("Dumping frames at %d fps: ", framedump.fps);
+            framedump_stats();
+        } else {
+            Com_Printf("Usage: %s <fps|stop> [format]\n", Cmd_Argv(0));
+        }
+        return;
+    }
+
+    if (!strcmp(Cmd_Argv(1), "stop")) {
+        if (!framedump.fps) {
+            Com_Printf("Not dumping frames.\n");
+        }
+        framedump_stop();
+        return;
+    }
+
+    fps = atoi(Cmd_Argv(1));
+    if (fps < 1 || fps > 1000) {
+        Com_Printf("Frame rate must be between 1 and 1000.\n");
+        return;
     }
+
+    framedump_stop();
+
+    get_screenshot_format(Cmd_Argc() > 2 ? Cmd_Argv(2) : r_screenshot_format->string,
+                          &framedump.ext, &framedump.save, &framedump.param);
+    framedump.fps = fps;
+    framedump.start = Sys_Milliseconds();
+    framedump.frames = 0;
+    framedump.skipped = 0;
+    shot_stalls = 0;
+    shot_stalltime = 0;
+
+    Com_Printf("Dumping frames at %d fps into screenshots/frameNNNNNN%s.\n",
+               fps, framedump.ext);
 }
 
 /*
@@ -484,7 +778,9 @@ if no formats are available.
 */
 static void IMG_ScreenShot_f(void)
 {
-    const char *s;
+    const char *s, *ext;
+    saveimage_t save;
+    int param;
 
     if (Cmd_Argc() > 2) {
         Com_Printf("Usage: %s [format]\n", Cmd_Argv(0));
@@ -497,19 +793,8 @@ static void IMG_ScreenShot_f(void)
         s = r_screenshot_format->string;
     }
 
-    if (*s == 'j') {
-        make_screenshot(NULL, ".jpg", IMG_SaveJPG,
-                        r_screenshot_quality->integer);
-        return;
-    }
-
-    if (*s == 'p') {
-        make_screenshot(NULL, ".png", IMG_SavePNG,
-                        r_screenshot_compression->integer);
-        return;
-    }
-
-    make_screenshot(NULL, ".tga", IMG_SaveTGA, 0);
+    get_screenshot_format(s, &ext, &save, &param);
+    make_screenshot(NULL, ext, save, param, qfalse);
 }
 
 /*
@@ -528,7 +813,7 @@ static void IMG_ScreenShotTGA_f(void)
         return;
     }
 
-    make_screenshot(Cmd_Argv(1), ".tga", IMG_SaveTGA, 0);
+    make_screenshot(Cmd_Argv(1), ".tga", IMG_SaveTGA, 0, qfalse);
 }
 
 static void IMG_ScreenShotJPG_f(void)
@@ -546,7 +831,7 @@ static void IMG_ScreenShotJPG_f(void)
         quality = r_screenshot_quality->integer;
     }
 
-    make_screenshot(Cmd_Argv(1), ".jpg", IMG_SaveJPG, quality);
+    make_screenshot(Cmd_Argv(1), ".jpg", IMG_SaveJPG, quality, qfalse);
 }
 
 static void IMG_ScreenShotPNG_f(void)
@@ -564,7 +849,7 @@ static void IMG_ScreenShotPNG_f(void)
         compression = r_screenshot_compression->integer;
     }
 
-    make_screenshot(Cmd_Argv(1), ".png", IMG_SavePNG, compression);
+    make_screenshot(Cmd_Argv(1), ".png", IMG_SavePNG, compression, qfalse);
 }
 
 /*
@@ -1414,6 +1699,7 @@ static const cmdreg_t img_cmd[] = {
     { "screenshottga", IMG_ScreenShotTGA_f },
     { "screenshotjpg", IMG_ScreenShotJPG_f },
     { "screenshotpng", IMG_ScreenShotPNG_f },
+    { "framedump", IMG_FrameDump_f },
     { NULL }
 };
 
@@ -1436,6 +1722,7 @@ void IMG_Init(void)
     r_screenshot_quality = Cvar_Get("gl_screenshot_quality", "100", CVAR_ARCHIVE);
     r_screenshot_compression = Cvar_Get("gl_screenshot_compression", "6", CVAR_ARCHIVE);
     r_screenshot_message = Cvar_Get("gl_screenshot_message", "0", CVAR_ARCHIVE);
+    r_screenshot_async = Cvar_Get("gl_screenshot_async", "1", 0);
 
     Cmd_Register(img_cmd);
 
@@ -1449,6 +1736,8 @@ void IMG_Init(void)
 
 void IMG_Shutdown(void)
 {
+    framedump_stop();
+    stop_encoder();
     Cmd_Deregister(img_cmd);
     r_numImages = 0;
 }
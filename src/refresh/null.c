@@ -0,0 +1,252 @@
+/*
+Copyright (C) 2026 Quake II RTX contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+ * null.c -- renderer that draws nothing
+ *
+ * Doesn't create a window and needs no GPU. Images and models are still
+ * loaded and registered, so the client runs its complete frame pipeline
+ * (used for headless timedemo benchmarks).
+ */
+
+#include "shared/shared.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/files.h"
+#include "client/video.h"
+#include "client/client.h"
+#include "refresh/refresh.h"
+#include "refresh/images.h"
+#include "refresh/models.h"
+#include "format/md2.h"
+#if USE_MD3
+#include "format/md3.h"
+#endif
+
+static qboolean R_Init_Null(qboolean total)
+{
+    vrect_t rc;
+
+    Com_DPrintf("R_Init_Null( %i )\n", total);
+
+    if (total) {
+        VID_GetGeometry(&rc);
+        r_config.width = rc.width;
+        r_config.height = rc.height;
+        r_config.flags = 0;
+        Com_Printf("Using null renderer (%dx%d)\n", r_config.width, r_config.height);
+    }
+
+    registration_sequence = 1;
+
+    IMG_Init();
+    IMG_GetPalette();
+    MOD_Init();
+
+    return qtrue;
+}
+
+static void R_Shutdown_Null(qboolean total)
+{
+    Com_DPrintf("R_Shutdown_Null( %i )\n", total);
+
+    IMG_FreeAll();
+    IMG_Shutdown();
+    MOD_Shutdown();
+
+    if (total) {
+        memset(&r_config, 0, sizeof(r_config));
+    }
+}
+
+static void R_BeginRegistration_Null(const char *name)
+{
+    registration_sequence++;
+}
+
+static void R_EndRegistration_Null(void)
+{
+    IMG_FreeUnused();
+    MOD_FreeUnused();
+}
+
+static void R_SetSky_Null(const char *name, float rotate, vec3_t axis) {}
+static void R_RenderFrame_Null(refdef_t *fd) {}
+
+static void R_LightPoint_Null(vec3_t origin, vec3_t light)
+{
+    VectorSet(light, 1, 1, 1);
+}
+
+static void R_ClearColor_Null(void) {}
+static void R_SetAlpha_Null(float alpha) {}
+static void R_SetAlphaScale_Null(float alpha) {}
+static void R_SetColor_Null(uint32_t color) {}
+static void R_SetClipRect_Null(const clipRect_t *clip) {}
+static void R_SetScale_Null(float scale) {}
+static void R_DrawChar_Null(int x, int y, int flags, int ch, qhandle_t font) {}
+
+static int R_DrawString_Null(int x, int y, int flags, size_t maxlen, const char *s, qhandle_t font)
+{
+    while (maxlen-- && *s++) {
+        x += CHAR_WIDTH;
+    }
+    return x;
+}
+
+static void R_DrawPic_Null(int x, int y, qhandle_t pic) {}
+static void R_DrawStretchPic_Null(int x, int y, int w, int h, qhandle_t pic) {}
+static void R_TileClear_Null(int x, int y, int w, int h, qhandle_t pic) {}
+static void R_DrawFill8_Null(int x, int y, int w, int h, int c) {}
+static void R_DrawFill32_Null(int x, int y, int w, int h, uint32_t color) {}
+static void R_BeginFrame_Null(void) {}
+static void R_EndFrame_Null(void) {}
+
+static void R_ModeChanged_Null(int width, int height, int flags, int rowbytes, void *pixels)
+{
+    r_config.width = width;
+    r_config.height = height;
+    r_config.flags = flags;
+}
+
+static void R_AddDecal_Null(decal_t *d) {}
+static qboolean R_InterceptKey_Null(unsigned key, qboolean down) { return qfalse; }
+
+static void IMG_Load_Null(image_t *image, byte *pic)
+{
+    // nothing to upload pixels to
+    Z_Free(pic);
+}
+
+static void IMG_Unload_Null(image_t *image) {}
+
+static byte *IMG_ReadPixels_Null(int *width, int *height, int *rowbytes)
+{
+    return NULL;
+}
+
+// only frame counts are kept, client code never looks at the geometry
+static qerror_t MOD_LoadMD2_Null(model_t *model, const void *rawdata, size_t length)
+{
+    dmd2header_t    header;
+    qerror_t        ret;
+    int             i;
+
+    if (length < sizeof(header)) {
+        return Q_ERR_FILE_TOO_SMALL;
+    }
+
+    // byte swap the header
+    header = *(dmd2header_t *)rawdata;
+    for (i = 0; i < sizeof(header) / 4; i++) {
+        ((uint32_t *)&header)[i] = LittleLong(((uint32_t *)&header)[i]);
+    }
+
+    ret = MOD_ValidateMD2(&header, length);
+    if (ret) {
+        if (ret == Q_ERR_TOO_FEW) {
+            // empty models draw nothing
+            model->type = MOD_EMPTY;
+            return Q_ERR_SUCCESS;
+        }
+        return ret;
+    }
+
+    model->type = MOD_ALIAS;
+    model->numframes = header.num_frames;
+    return Q_ERR_SUCCESS;
+}
+
+#if USE_MD3
+static qerror_t MOD_LoadMD3_Null(model_t *model, const void *rawdata, size_t length)
+{
+    dmd3header_t    header;
+    int             i;
+
+    if (length < sizeof(header))
+        return Q_ERR_FILE_TOO_SMALL;
+
+    // byte swap the header
+    header = *(dmd3header_t *)rawdata;
+    for (i = 0; i < sizeof(header) / 4; i++)
+        ((uint32_t *)&header)[i] = LittleLong(((uint32_t *)&header)[i]);
+
+    if (header.ident != MD3_IDENT)
+        return Q_ERR_UNKNOWN_FORMAT;
+    if (header.version != MD3_VERSION)
+        return Q_ERR_UNKNOWN_FORMAT;
+    if (header.num_frames < 1)
+        return Q_ERR_TOO_FEW;
+    if (header.num_frames > MD3_MAX_FRAMES)
+        return Q_ERR_TOO_MANY;
+
+    model->type = MOD_ALIAS;
+    model->numframes = header.num_frames;
+    return Q_ERR_SUCCESS;
+}
+#endif
+
+static void MOD_Reference_Null(model_t *model)
+{
+    int i;
+
+    if (model->type == MOD_SPRITE) {
+        for (i = 0; i < model->numframes; i++) {
+            model->spriteframes[i].image->registration_sequence = registration_sequence;
+        }
+    }
+
+    model->registration_sequence = registration_sequence;
+}
+
+void R_RegisterFunctionsNull(void)
+{
+    R_Init = R_Init_Null;
+    R_Shutdown = R_Shutdown_Null;
+    R_BeginRegistration = R_BeginRegistration_Null;
+    R_EndRegistration = R_EndRegistration_Null;
+    R_SetSky = R_SetSky_Null;
+    R_RenderFrame = R_RenderFrame_Null;
+    R_LightPoint = R_LightPoint_Null;
+    R_ClearColor = R_ClearColor_Null;
+    R_SetAlpha = R_SetAlpha_Null;
+    R_SetAlphaScale = R_SetAlphaScale_Null;
+    R_SetColor = R_SetColor_Null;
+    R_SetClipRect = R_SetClipRect_Null;
+    R_SetScale = R_SetScale_Null;
+    R_DrawChar = R_DrawChar_Null;
+    R_DrawString = R_DrawString_Null;
+    R_DrawPic = R_DrawPic_Null;
+    R_DrawStretchPic = R_DrawStretchPic_Null;
+    R_TileClear = R_TileClear_Null;
+    R_DrawFill8 = R_DrawFill8_Null;
+    R_DrawFill32 = R_DrawFill32_Null;
+    R_BeginFrame = R_BeginFrame_Null;
+    R_EndFrame = R_EndFrame_Null;
+    R_ModeChanged = R_ModeChanged_Null;
+    R_AddDecal = R_AddDecal_Null;
+    R_InterceptKey = R_InterceptKey_Null;
+    IMG_Load = IMG_Load_Null;
+    IMG_Unload = IMG_Unload_Null;
+    IMG_ReadPixels = IMG_ReadPixels_Null;
+    MOD_LoadMD2 = MOD_LoadMD2_Null;
+#if USE_MD3
+    MOD_LoadMD3 = MOD_LoadMD3_Null;
+#endif
+    MOD_Reference = MOD_Reference_Null;
+}
@@ -433,26 +433,6 @@ static void make_pvs_symmetric(bsp_t* bsp)
 	}
 }
 
-static void build_pvs2(bsp_t* bsp)
-{
-	size_t matrix_size = bsp->visrowsize * bsp->vis->numclusters;
-
-	bsp->pvs2_matrix = Z_Mallocz(matrix_size);
-
-	for (int cluster = 0; cluster < bsp->vis->numclusters; cluster++)
-	{
-		char* pvs = BSP_GetPvs(bsp, cluster);
-		char* dest_pvs = BSP_GetPvs2(bsp, cluster);
-		memcpy(dest_pvs, pvs, bsp->visrowsize);
-
-		FOREACH_BIT_BEGIN(pvs, bsp->visrowsize, vis_cluster)
-			char* pvs2 = BSP_GetPvs(bsp, vis_cluster);
-			merge_pvs_rows(bsp, pvs2, dest_pvs);
-		FOREACH_BIT_END
-	}
-
-}
-
 static void
 collect_surfaces(int *idx_ctr, bsp_mesh_t *wm, bsp_t *bsp, int model_idx, int (*filter)(int))
 {
@@ -1692,12 +1672,15 @@ bsp_mesh_create_from_bsp(bsp_mesh_t *wm, bsp_t *bsp, const char* map_name)
 
 	if (!bsp->pvs_patched)
 	{
-		build_pvs2(bsp);
+		BSP_BuildPvs2Matrix(bsp);
 
 		if (!BSP_SavePatchedPVS(bsp))
 		{
 			Com_EPrintf("Couldn't save patched PVS for %s.\n", bsp->name);
 		}
+
+		// the shared bsp_t may outlive this mesh, don't patch it twice
+		bsp->pvs_patched = qtrue;
 	}
 
     wm->num_indices = idx_ctr;
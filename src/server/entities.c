@@ -31,6 +31,122 @@ Encode a client frame onto the network channel
 #define Q2PRO_OPTIMIZE(c) \
     ((c)->protocol == PROTOCOL_VERSION_Q2PRO && !(c)->settings[CLS_RECORDING])
 
+/*
+=============================================================================
+
+Shared delta cache
+
+Spectators and players in the same area delta the same entity from the same
+state, so the encoded update is remembered and copied to later clients
+instead of being encoded again. Entries are looked up by a hash of both
+states and the protocol flags, and verified by comparing the full states,
+so a stale entry left over from an earlier frame can only miss.
+
+=============================================================================
+*/
+
+static uint32_t delta_hash(const entity_packed_t *from,
+                           const entity_packed_t *to,
+                           msgEsFlags_t flags)
+{
+    const byte *a = (const byte *)from;
+    const byte *b = (const byte *)to;
+    uint32_t h = flags, w;
+    size_t i;
+
+    for (i = 0; i < sizeof(entity_packed_t); i += 4) {
+        memcpy(&w, a + i, 4);
+        h = (h ^ w) * 0x9e3779b1;
+        h ^= h >> 15;
+        memcpy(&w, b + i, 4);
+        h = (h ^ w) * 0x9e3779b1;
+        h ^= h >> 15;
+    }
+
+    return h;
+}
+
+void SV_WriteDeltaEntity(const entity_packed_t *from,
+                         const entity_packed_t *to,
+                         msgEsFlags_t flags)
+{
+    delta_cache_t *entry;
+    uint32_t hash;
+    size_t start, size;
+
+    if (!sv_delta_cache->integer) {
+        MSG_WriteDeltaEntity(from, to, flags);
+        return;
+    }
+
+    if (!svs.delta_cache) {
+        svs.delta_cache = SV_Mallocz(sizeof(svs.delta_cache[0]) * DELTA_CACHE_SIZE);
+    }
+
+    hash = delta_hash(from, to, flags);
+    entry = &svs.delta_cache[hash & (DELTA_CACHE_SIZE - 1)];
+
+    if (entry->hash == hash && entry->flags == flags &&
+        !memcmp(&entry->to, to, sizeof(*to)) &&
+        !memcmp(&entry->from, from, sizeof(*from))) {
+        MSG_WriteData(entry->data, entry->size);
+        svs.delta_hits++;
+        svs.delta_bytes += entry->size;
+        return;
+    }
+
+    start = msg_write.cursize;
+    MSG_WriteDeltaEntity(from, to, flags);
+
+    // don't remember anything if message overflowed
+    if (msg_write.overflowed || msg_write.cursize < start) {
+        return;
+    }
+
+    // unchanged entities encode to nothing, don't let them evict useful
+    // entries or count towards the hit rate
+    size = msg_write.cursize - start;
+    if (!size || size > MAX_ENTITY_DELTA) {
+        return;
+    }
+
+    svs.delta_misses++;
+
+    entry->hash = hash;
+    entry->flags = flags;
+    entry->size = size;
+    entry->from = *from;
+    entry->to = *to;
+    memcpy(entry->data, msg_write.data + start, size);
+}
+
+void SV_DeltaStats_f(void)
+{
+    uint64_t total;
+    char buffer[16];
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "clear")) {
+        svs.delta_hits = svs.delta_misses = svs.delta_bytes = 0;
+        Com_Printf("Cleared delta cache statistics.\n");
+        return;
+    }
+
+    total = svs.delta_hits + svs.delta_misses;
+
+    if (svs.delta_cache) {
+        Com_FormatSizeLong(buffer, sizeof(buffer), sizeof(svs.delta_cache[0]) * DELTA_CACHE_SIZE);
+    } else {
+        strcpy(buffer, "nothing");
+    }
+
+    Com_Printf("Delta cache is %s, %s allocated\n",
+               sv_delta_cache->integer ? "enabled" : "disabled", buffer);
+    Com_Printf("%"PRIu64" lookups, %"PRIu64" hits (%.1f%%), %"PRIu64" bytes reused\n",
+               total, svs.delta_hits,
+               total ? svs.delta_hits * 100.0 / total : 0.0,
+               svs.delta_bytes);
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -92,7 +208,7 @@ static void SV_EmitPacketEntities(client_t         *client,
             if (Q2PRO_SHORTANGLES(client, newnum)) {
                 flags |= MSG_ES_SHORTANGLES;
             }
-            MSG_WriteDeltaEntity(oldent, newent, flags);
+            SV_WriteDeltaEntity(oldent, newent, flags);
             oldindex++;
             newindex++;
             continue;
@@ -115,7 +231,7 @@ static void SV_EmitPacketEntities(client_t         *client,
             if (Q2PRO_SHORTANGLES(client, newnum)) {
                 flags |= MSG_ES_SHORTANGLES;
             }
-            MSG_WriteDeltaEntity(oldent, newent, flags);
+            SV_WriteDeltaEntity(oldent, newent, flags);
             newindex++;
             continue;
         }
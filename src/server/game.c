@@ -31,21 +31,26 @@ PF_FindIndex
 */
 static int PF_FindIndex(const char *name, int start, int max)
 {
-    char *string;
+    const char *string;
     int i;
 
     if (!name || !name[0])
         return 0;
 
+    // configstrings are interned, compare by pointer
+    string = Z_InternString(name);
     for (i = 1; i < max; i++) {
-        string = sv.configstrings[start + i];
-        if (!string[0]) {
+        if (!sv.configstrings[start + i][0]) {
             break;
         }
-        if (!strcmp(string, name)) {
-            return i;
+        if (sv.configstrings[start + i] == string) {
+            break;
         }
     }
+    Z_ReleaseString(string);
+
+    if (i < max && sv.configstrings[start + i][0])
+        return i;
 
     if (i == max)
         Com_Error(ERR_DROP, "PF_FindIndex: overflow");
@@ -357,7 +362,6 @@ static void PF_configstring(int index, const char *val)
 {
     size_t len, maxlen;
     client_t *client;
-    char *dst;
 
     if (index < 0 || index >= MAX_CONFIGSTRINGS)
         Com_Error(ERR_DROP, "%s: bad index: %d", __func__, index);
@@ -388,15 +392,11 @@ static void PF_configstring(int index, const char *val)
         len = maxlen - 1;
     }
 
-    dst = sv.configstrings[index];
-    if (!strncmp(dst, val, len)) {
+    // change the string in sv
+    if (!Com_SetConfigstring(sv.configstrings, index, val, len)) {
         return;
     }
 
-    // change the string in sv
-    memcpy(dst, val, len);
-    dst[len] = 0;
-
     if (sv.state == ss_loading) {
         return;
     }
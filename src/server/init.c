@@ -37,6 +37,33 @@ void SV_ClientReset(client_t *client)
     memset(&client->lastcmd, 0, sizeof(client->lastcmd));
 }
 
+/*
+================
+SV_ClearState
+
+Wipes the entire per-level structure.
+================
+*/
+void SV_ClearState(void)
+{
+    Com_ClearConfigstrings(sv.configstrings);
+    memset(&sv, 0, sizeof(sv));
+    Com_ClearConfigstrings(sv.configstrings);
+}
+
+static void set_configstring(int index, const char *fmt, ...)
+{
+    char buffer[MAX_QPATH];
+    va_list argptr;
+    size_t len;
+
+    va_start(argptr, fmt);
+    len = Q_vscnprintf(buffer, sizeof(buffer), fmt, argptr);
+    va_end(argptr);
+
+    Com_SetConfigstring(sv.configstrings, index, buffer, len);
+}
+
 static void set_frame_time(void)
 {
 #if USE_FPS
@@ -169,9 +196,10 @@ void SV_SpawnServer(mapcmd_t *cmd)
     // free current level
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entitystring);
+    SV_FlushGamestates();
 
     // wipe the entire per-level structure
-    memset(&sv, 0, sizeof(sv));
+    SV_ClearState();
     sv.spawncount = (rand() | (rand() << 16)) ^ Sys_Milliseconds();
     sv.spawncount &= 0x7FFFFFFF;
 
@@ -187,14 +215,14 @@ void SV_SpawnServer(mapcmd_t *cmd)
     set_frame_time();
 
     // save name for levels that don't set message
-    Q_strlcpy(sv.configstrings[CS_NAME], cmd->server, MAX_QPATH);
+    set_configstring(CS_NAME, "%s", cmd->server);
     Q_strlcpy(sv.name, cmd->server, sizeof(sv.name));
     Q_strlcpy(sv.mapcmd, cmd->buffer, sizeof(sv.mapcmd));
 
     if (Cvar_VariableInteger("deathmatch")) {
-        sprintf(sv.configstrings[CS_AIRACCEL], "%d", sv_airaccelerate->integer);
+        set_configstring(CS_AIRACCEL, "%d", sv_airaccelerate->integer);
     } else {
-        strcpy(sv.configstrings[CS_AIRACCEL], "0");
+        set_configstring(CS_AIRACCEL, "0");
     }
 
     resolve_masters();
@@ -203,18 +231,18 @@ void SV_SpawnServer(mapcmd_t *cmd)
         override_entity_string(cmd->server);
 
         sv.cm = cmd->cm;
-        sprintf(sv.configstrings[CS_MAPCHECKSUM], "%d", (int)sv.cm.cache->checksum);
+        set_configstring(CS_MAPCHECKSUM, "%d", (int)sv.cm.cache->checksum);
 
         // set inline model names
-        Q_concat(sv.configstrings[CS_MODELS + 1], MAX_QPATH, "maps/", cmd->server, ".bsp", NULL);
+        set_configstring(CS_MODELS + 1, "maps/%s.bsp", cmd->server);
         for (i = 1; i < sv.cm.cache->nummodels; i++) {
-            sprintf(sv.configstrings[CS_MODELS + 1 + i], "*%d", i);
+            set_configstring(CS_MODELS + 1 + i, "*%d", i);
         }
 
         entitystring = sv.entitystring ? sv.entitystring : sv.cm.cache->entitystring;
     } else {
         // no real map
-        strcpy(sv.configstrings[CS_MAPCHECKSUM], "0");
+        set_configstring(CS_MAPCHECKSUM, "0");
         entitystring = "";
     }
 
@@ -244,7 +272,7 @@ void SV_SpawnServer(mapcmd_t *cmd)
     X86_POP_FPCW;
 
     // make sure maxclients string is correct
-    sprintf(sv.configstrings[CS_MAXCLIENTS], "%d", sv_maxclients->integer);
+    set_configstring(CS_MAXCLIENTS, "%d", sv_maxclients->integer);
 
     // check for a savegame
     SV_CheckForSavegame(cmd);
@@ -374,7 +402,7 @@ void SV_InitGame(unsigned mvd_spawn)
 
         CM_FreeMap(&sv.cm);
         SV_FreeFile(sv.entitystring);
-        memset(&sv, 0, sizeof(sv));
+        SV_ClearState();
 
 #if USE_FPS
         // set up default frametime for main loop
@@ -469,6 +497,7 @@ void SV_InitGame(unsigned mvd_spawn)
         ent->s.number = entnum;
         client->edict = ent;
         client->number = i;
+        client->name = Z_InternString("");
     }
 
     AC_Connect(mvd_spawn);
@@ -54,12 +54,14 @@ cvar_t  *sv_show_name_changes;
 cvar_t  *sv_airaccelerate;
 cvar_t  *sv_qwmod;              // atu QW Physics modificator
 cvar_t  *sv_novis;
+cvar_t  *sv_delta_cache;
 
 cvar_t  *sv_maxclients;
 cvar_t  *sv_reserved_slots;
 cvar_t  *sv_showclamp;
 cvar_t  *sv_locked;
 cvar_t  *sv_downloadserver;
+cvar_t  *sv_download_cache;
 cvar_t  *sv_redirect_address;
 
 cvar_t  *sv_hostname;
@@ -129,7 +131,8 @@ void SV_RemoveClient(client_t *client)
     Com_DPrintf("Going from cs_zombie to cs_free for %s\n", client->name);
 
     client->state = cs_free;    // can now be reused
-    client->name[0] = 0;
+    Z_ReleaseString(client->name);
+    client->name = Z_InternString("");
 }
 
 void SV_CleanClient(client_t *client)
@@ -149,7 +152,7 @@ void SV_CleanClient(client_t *client)
     SV_CloseDownload(client);
 
     if (client->version_string) {
-        Z_Free(client->version_string);
+        Z_ReleaseString(client->version_string);
         client->version_string = NULL;
     }
 
@@ -1090,7 +1093,9 @@ static void SVC_DirectConnect(void)
     // build a new connection
     // accept the new client
     // this is the only place a client_t is ever initialized
+    Z_ReleaseString(newcl->name);
     memset(newcl, 0, sizeof(*newcl));
+    newcl->name = Z_InternString("");
     newcl->number = newcl->slot = number;
     newcl->challenge = params.challenge; // save challenge for checksumming
     newcl->protocol = params.protocol;
@@ -1099,7 +1104,7 @@ static void SVC_DirectConnect(void)
     newcl->edict = EDICT_NUM(number + 1);
     newcl->gamedir = fs_game->string;
     newcl->mapname = sv.name;
-    newcl->configstrings = (char *)sv.configstrings;
+    newcl->configstrings = sv.configstrings;
     newcl->pool = (edict_pool_t *)&ge->edicts;
     newcl->cm = &sv.cm;
     newcl->spawncount = sv.spawncount;
@@ -1928,6 +1933,7 @@ void SV_UserinfoChanged(client_t *cl)
 {
     char    name[MAX_CLIENT_NAME];
     char    *val;
+    const char  *string;
     size_t  len;
     int     i;
 
@@ -1943,7 +1949,11 @@ void SV_UserinfoChanged(client_t *cl)
     // mask off high bit
     for (i = 0; i < len; i++)
         name[i] &= 127;
-    if (cl->name[0] && strcmp(cl->name, name)) {
+    name[len] = 0;
+
+    // names are interned, unchanged one is the same pointer
+    string = Z_InternStringLen(name, len);
+    if (cl->name[0] && cl->name != string) {
         if (COM_DEDICATED) {
             Com_Printf("%s[%s] changed name to %s\n", cl->name,
                        NET_AdrToString(&cl->netchan->remote_address), name);
@@ -1958,7 +1968,8 @@ void SV_UserinfoChanged(client_t *cl)
                                    cl->name, name);
             }
     }
-    memcpy(cl->name, name, len + 1);
+    Z_ReleaseString(cl->name);
+    cl->name = string;
 
     // rate command
     val = Info_ValueForKey(cl->userinfo, "rate");
@@ -2063,6 +2074,8 @@ Only called at quake2.exe startup, not for each game
 */
 void SV_Init(void)
 {
+    SV_ClearState();
+
     SV_InitOperatorCommands();
 
     SV_MvdRegister();
@@ -2111,7 +2124,9 @@ void SV_Init(void)
     sv_reserved_password = Cvar_Get("sv_reserved_password", "", CVAR_PRIVATE);
     sv_locked = Cvar_Get("sv_locked", "0", 0);
     sv_novis = Cvar_Get("sv_novis", "0", 0);
+    sv_delta_cache = Cvar_Get("sv_delta_cache", "1", 0);
     sv_downloadserver = Cvar_Get("sv_downloadserver", "", 0);
+    sv_download_cache = Cvar_Get("sv_download_cache", "64", 0);
     sv_redirect_address = Cvar_Get("sv_redirect_address", "", 0);
 
 #ifdef _DEBUG
@@ -2251,6 +2266,8 @@ Should be safe to call even if server is not fully initalized yet.
 */
 void SV_Shutdown(const char *finalmsg, error_type_t type)
 {
+    int i;
+
     if (!sv_registered)
         return;
 
@@ -2274,11 +2291,17 @@ void SV_Shutdown(const char *finalmsg, error_type_t type)
     // free current level
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entitystring);
-    memset(&sv, 0, sizeof(sv));
+    SV_ClearState();
 
     // free server static data
+    for (i = 0; i < sv_maxclients->integer && svs.client_pool; i++) {
+        Z_ReleaseString(svs.client_pool[i].name);
+    }
     Z_Free(svs.client_pool);
     Z_Free(svs.entities);
+    Z_Free(svs.delta_cache);
+    SV_ShutdownDownloads();
+    SV_FlushGamestates();
 #if USE_ZLIB
     deflateEnd(&svs.z);
 #endif
@@ -35,7 +35,10 @@ typedef struct {
     clstate_t   state;
     netstream_t stream;
 #if USE_ZLIB
-    z_stream    z;
+    z_stream    z;          // private compressor, unless shared
+    uLong       adler;      // checksum of everything deflated so far
+    qboolean    shared;     // receiving shared deflate stream
+    qboolean    pong;       // ping reply pending
 #endif
     unsigned    msglen;
     unsigned    lastmessage;
@@ -74,8 +77,26 @@ typedef struct {
     int             numlevels; // stop after that many levels
     int             numframes; // stop after that many frames
 
+    // keyframe index of local recording
+    qhandle_t       index;
+    off_t           mapstart;  // demo offset after the last gamestate
+    int             framenum;  // frames recorded since the last gamestate
+    int             keyframe;  // frame of the last keyframe
+    byte            dcs[CS_BITMAP_BYTES]; // changed since the last gamestate
+
     // TCP client pool
     gtv_client_t    *clients; // [sv_mvd_maxclients]
+
+#if USE_ZLIB
+    // deflate stream shared by all compressed clients
+    z_stream        z;
+    byte            *z_buf;     // [MAX_GTS_MSGLEN]
+    unsigned        z_clients;  // number of clients sharing the stream
+    unsigned        z_bufcount;
+    unsigned        z_maxbuf;
+    unsigned        z_jointime; // last time clients joined the stream
+    qboolean        z_pong;     // ping replies pending
+#endif
 } mvd_server_t;
 
 static mvd_server_t     mvd;
@@ -97,6 +118,7 @@ static cvar_t   *sv_mvd_nomsgs;
 static cvar_t   *sv_mvd_maxsize;
 static cvar_t   *sv_mvd_maxtime;
 static cvar_t   *sv_mvd_maxmaps;
+static cvar_t   *sv_mvd_keyframes;
 static cvar_t   *sv_mvd_begincmd;
 static cvar_t   *sv_mvd_scorecmd;
 static cvar_t   *sv_mvd_autorecord;
@@ -105,6 +127,9 @@ static cvar_t   *sv_mvd_disconnect_time;
 static cvar_t   *sv_mvd_suspend_time;
 static cvar_t   *sv_mvd_allow_stufftext;
 static cvar_t   *sv_mvd_spawn_dummy;
+#if USE_ZLIB
+static cvar_t   *sv_mvd_sharestream;
+#endif
 
 static qboolean mvd_enable(void);
 static void     mvd_disable(void);
@@ -113,13 +138,19 @@ static void     mvd_error(const char *reason);
 static void     write_stream(gtv_client_t *client, void *data, size_t len);
 static void     write_message(gtv_client_t *client, gtv_serverop_t op);
 #if USE_ZLIB
-static void     flush_stream(gtv_client_t *client, int flush);
+static qboolean flush_stream(gtv_client_t *client, int flush);
 #endif
+static void     drop_client(gtv_client_t *client, const char *error);
+static void     broadcast_begin(void);
+static void     broadcast_stream(void *data, size_t len);
+static void     broadcast_message(gtv_serverop_t op);
+static void     broadcast_end(qboolean flush);
 
 static void     rec_stop(void);
 static qboolean rec_allowed(void);
-static void     rec_start(qhandle_t demofile);
+static void     rec_start(qhandle_t demofile, const char *path);
 static void     rec_write(void);
+static void     rec_keyframe(void);
 
 
 /*
@@ -194,7 +225,7 @@ static void dummy_record_f(void)
 
     Com_Printf("Auto-recording local MVD to %s\n", buffer);
 
-    rec_start(f);
+    rec_start(f, buffer);
 }
 
 static void dummy_stop_f(void)
@@ -368,7 +399,9 @@ static int dummy_create(void)
         return -1;
     }
 
+    Z_ReleaseString(newcl->name);
     memset(newcl, 0, sizeof(*newcl));
+    newcl->name = Z_InternString("");
     number = newcl - svs.client_pool;
     newcl->number = newcl->slot = number;
     newcl->protocol = -1;
@@ -590,58 +623,16 @@ static void build_gamestate(void)
     }
 }
 
-// Writes a single giant message with all the startup info,
-// followed by an uncompressed (baseline) frame.
-static void emit_gamestate(void)
+// Writes all player and entity states from the delta compressor buffers
+// as an uncompressed frame.
+static void emit_base_frame(void)
 {
-    char        *string;
     int         i, j;
     player_packed_t *ps;
     entity_packed_t *es;
-    size_t      length;
     int         flags, extra, portalbytes;
     byte        portalbits[MAX_MAP_PORTAL_BYTES];
 
-    // don't bother writing if there are no active MVD clients
-    if (!mvd.recording && LIST_EMPTY(&gtv_active_list)) {
-        return;
-    }
-
-    // pack MVD stream flags into extra bits
-    extra = 0;
-    if (sv_mvd_nomsgs->integer && mvd.dummy) {
-        extra |= MVF_NOMSGS << SVCMD_BITS;
-    }
-
-    // send the serverdata
-    MSG_WriteByte(mvd_serverdata | extra);
-    MSG_WriteLong(PROTOCOL_VERSION_MVD);
-    MSG_WriteShort(PROTOCOL_VERSION_MVD_CURRENT);
-    MSG_WriteLong(sv.spawncount);
-    MSG_WriteString(fs_game->string);
-    if (mvd.dummy)
-        MSG_WriteShort(mvd.dummy->number);
-    else
-        MSG_WriteShort(-1);
-
-    // send configstrings
-    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        string = sv.configstrings[i];
-        if (!string[0]) {
-            continue;
-        }
-        length = strlen(string);
-        if (length > MAX_QPATH) {
-            length = MAX_QPATH;
-        }
-
-        MSG_WriteShort(i);
-        MSG_WriteData(string, length);
-        MSG_WriteByte(0);
-    }
-    MSG_WriteShort(MAX_CONFIGSTRINGS);
-
-    // send baseline frame
     portalbytes = CM_WritePortalBits(&sv.cm, portalbits);
     MSG_WriteByte(portalbytes);
     MSG_WriteData(portalbits, portalbytes);
@@ -683,6 +674,57 @@ static void emit_gamestate(void)
     MSG_WriteShort(0);
 }
 
+// Writes a single giant message with all the startup info,
+// followed by an uncompressed (baseline) frame.
+static void emit_gamestate(void)
+{
+    const char  *string;
+    int         i, extra;
+    size_t      length;
+
+    // don't bother writing if there are no active MVD clients
+    if (!mvd.recording && LIST_EMPTY(&gtv_active_list)) {
+        return;
+    }
+
+    // pack MVD stream flags into extra bits
+    extra = 0;
+    if (sv_mvd_nomsgs->integer && mvd.dummy) {
+        extra |= MVF_NOMSGS << SVCMD_BITS;
+    }
+
+    // send the serverdata
+    MSG_WriteByte(mvd_serverdata | extra);
+    MSG_WriteLong(PROTOCOL_VERSION_MVD);
+    MSG_WriteShort(PROTOCOL_VERSION_MVD_CURRENT);
+    MSG_WriteLong(sv.spawncount);
+    MSG_WriteString(fs_game->string);
+    if (mvd.dummy)
+        MSG_WriteShort(mvd.dummy->number);
+    else
+        MSG_WriteShort(-1);
+
+    // send configstrings
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        string = Com_ConfigstringSlot(sv.configstrings, i);
+        if (!string[0]) {
+            continue;
+        }
+        length = strlen(string);
+        if (length > MAX_QPATH) {
+            length = MAX_QPATH;
+        }
+
+        MSG_WriteShort(i);
+        MSG_WriteData(string, length);
+        MSG_WriteByte(0);
+    }
+    MSG_WriteShort(MAX_CONFIGSTRINGS);
+
+    // send baseline frame
+    emit_base_frame();
+}
+
 static void copy_entity_state(entity_packed_t *dst, const entity_packed_t *src, int flags)
 {
     if (!(flags & MSG_ES_FIRSTPERSON)) {
@@ -818,16 +860,10 @@ static void emit_frame(void)
 
 static void suspend_streams(void)
 {
-    gtv_client_t *client;
-
-    FOR_EACH_ACTIVE_GTV(client) {
-        // send stream suspend marker
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    // send stream suspend marker
+    broadcast_begin();
+    broadcast_message(GTS_STREAM_DATA);
+    broadcast_end(qtrue);
 
     Com_DPrintf("Suspending MVD streams.\n");
     mvd.active = qfalse;
@@ -835,20 +871,14 @@ static void suspend_streams(void)
 
 static void resume_streams(void)
 {
-    gtv_client_t *client;
-
     // build and emit gamestate
     build_gamestate();
     emit_gamestate();
 
-    FOR_EACH_ACTIVE_GTV(client) {
-        // send gamestate
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    // send gamestate
+    broadcast_begin();
+    broadcast_message(GTS_STREAM_DATA);
+    broadcast_end(qtrue);
 
     // write it to demofile
     if (mvd.recording) {
@@ -980,6 +1010,8 @@ static void rec_frame(size_t total)
     if (ret != mvd.datagram.cursize)
         goto fail;
 
+    mvd.framenum++;
+
     if (sv_mvd_maxsize->value > 0 &&
         FS_Tell(mvd.recording) > sv_mvd_maxsize->value * 1000) {
         Com_Printf("Stopping MVD recording, maximum size reached.\n");
@@ -1022,7 +1054,6 @@ SV_MvdEndFrame
 */
 void SV_MvdEndFrame(void)
 {
-    gtv_client_t *client;
     size_t total;
     byte header[3];
 
@@ -1075,18 +1106,12 @@ void SV_MvdEndFrame(void)
     header[2] = GTS_STREAM_DATA;
 
     // send frame to clients
-    FOR_EACH_ACTIVE_GTV(client) {
-        write_stream(client, header, sizeof(header));
-        write_stream(client, mvd.message.data, mvd.message.cursize);
-        write_stream(client, msg_write.data, msg_write.cursize);
-        write_stream(client, mvd.datagram.data, mvd.datagram.cursize);
-#if USE_ZLIB
-        if (++client->bufcount > client->maxbuf) {
-            flush_stream(client, Z_SYNC_FLUSH);
-        }
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    broadcast_begin();
+    broadcast_stream(header, sizeof(header));
+    broadcast_stream(mvd.message.data, mvd.message.cursize);
+    broadcast_stream(msg_write.data, msg_write.cursize);
+    broadcast_stream(mvd.datagram.data, mvd.datagram.cursize);
+    broadcast_end(qfalse);
 
     // write frame to demofile
     if (mvd.recording) {
@@ -1096,6 +1121,11 @@ void SV_MvdEndFrame(void)
     // clear frame
     SZ_Clear(&msg_write);
 
+    // write keyframe to demo index
+    if (mvd.index) {
+        rec_keyframe();
+    }
+
     // clear datagrams
     SZ_Clear(&mvd.datagram);
     SZ_Clear(&mvd.message);
@@ -1230,6 +1260,7 @@ void SV_MvdConfigstring(int index, const char *string, size_t len)
         SZ_WriteShort(&mvd.message, index);
         SZ_Write(&mvd.message, string, len);
         SZ_WriteByte(&mvd.message, 0);
+        Q_SetBit(mvd.dcs, index);
     }
 }
 
@@ -1311,7 +1342,29 @@ static void remove_client(gtv_client_t *client)
 }
 
 #if USE_ZLIB
-static void flush_stream(gtv_client_t *client, int flush)
+// Compressed clients get raw deflate data, with zlib header and trailer
+// written manually. This allows switching a client between its private
+// compressor and the shared one at flush points.
+static qboolean deflate_init(z_streamp z)
+{
+    z->zalloc = SV_zalloc;
+    z->zfree = SV_zfree;
+    return deflateInit2(z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+static void write_trailer(gtv_client_t *client)
+{
+    byte trailer[4];
+
+    trailer[0] = (client->adler >> 24) & 255;
+    trailer[1] = (client->adler >> 16) & 255;
+    trailer[2] = (client->adler >> 8) & 255;
+    trailer[3] = client->adler & 255;
+    FIFO_Write(&client->stream.send, trailer, sizeof(trailer));
+}
+
+static qboolean flush_stream(gtv_client_t *client, int flush)
 {
     fifo_t *fifo = &client->stream.send;
     z_streamp z = &client->z;
@@ -1320,10 +1373,10 @@ static void flush_stream(gtv_client_t *client, int flush)
     int ret;
 
     if (client->state <= cs_zombie) {
-        return;
+        return qfalse;
     }
     if (!z->state) {
-        return;
+        return qfalse;
     }
 
     z->next_in = NULL;
@@ -1333,7 +1386,7 @@ static void flush_stream(gtv_client_t *client, int flush)
         data = FIFO_Reserve(fifo, &len);
         if (!len) {
             // FIXME: this is not an error when flushing
-            return;
+            return qfalse;
         }
 
         z->next_out = data;
@@ -1347,6 +1400,228 @@ static void flush_stream(gtv_client_t *client, int flush)
             client->bufcount = 0;
         }
     } while (ret == Z_OK);
+
+    if (ret == Z_STREAM_END) {
+        write_trailer(client);
+    }
+
+    return qtrue;
+}
+
+// sends deflated data to everyone sharing the stream
+static void commit_shared(byte *data, size_t len)
+{
+    gtv_client_t *client;
+
+    FOR_EACH_GTV(client) {
+        if (!client->shared) {
+            continue;
+        }
+        if (FIFO_Write(&client->stream.send, data, len) != len) {
+            client->shared = qfalse;
+            mvd.z_clients--;
+            drop_client(client, "overflowed");
+        }
+    }
+
+    mvd.z_bufcount = 0;
+}
+
+static void write_shared(void *data, size_t len, int flush)
+{
+    gtv_client_t *client;
+    z_streamp z = &mvd.z;
+    uLong adler;
+    int ret;
+
+    if (!mvd.z_clients) {
+        return;
+    }
+
+    if (len) {
+        adler = adler32(adler32(0L, Z_NULL, 0), data, (uInt)len);
+        FOR_EACH_GTV(client) {
+            if (client->shared) {
+                client->adler = adler32_combine(client->adler, adler, len);
+            }
+        }
+    }
+
+    z->next_in = data;
+    z->avail_in = (uInt)len;
+
+    do {
+        z->next_out = mvd.z_buf;
+        z->avail_out = MAX_GTS_MSGLEN;
+
+        ret = deflate(z, flush);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            FOR_EACH_GTV(client) {
+                if (client->shared) {
+                    client->shared = qfalse;
+                    drop_client(client, "deflate() failed");
+                }
+            }
+            mvd.z_clients = 0;
+            return;
+        }
+
+        len = MAX_GTS_MSGLEN - z->avail_out;
+        if (len) {
+            commit_shared(mvd.z_buf, len);
+        }
+    } while (z->avail_in || !z->avail_out);
+}
+
+static void write_shared_message(gtv_serverop_t op)
+{
+    byte header[3];
+    size_t len = msg_write.cursize + 1;
+
+    header[0] = len & 255;
+    header[1] = (len >> 8) & 255;
+    header[2] = op;
+    write_shared(header, sizeof(header), Z_NO_FLUSH);
+
+    write_shared(msg_write.data, msg_write.cursize, Z_NO_FLUSH);
+}
+
+// moves compressed clients that are not yet sharing the stream onto it
+static void join_shared(void)
+{
+    gtv_client_t *client;
+    qboolean joining = qfalse;
+
+    // each join costs a full flush of the shared stream, so clients that
+    // (re)start streaming close together are moved over at once
+    if (mvd.z_clients && svs.realtime - mvd.z_jointime < 1000) {
+        return;
+    }
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (client->z.state) {
+            joining = qtrue;
+            break;
+        }
+    }
+
+    if (!joining) {
+        return;
+    }
+
+    mvd.z_jointime = svs.realtime;
+
+    if (!mvd.z_buf) {
+        if (!deflate_init(&mvd.z)) {
+            Com_EPrintf("Couldn't initialize shared MVD stream\n");
+            Cvar_Set("sv_mvd_sharestream", "0");
+            return;
+        }
+        mvd.z_buf = SV_Malloc(MAX_GTS_MSGLEN);
+    } else if (!mvd.z_clients) {
+        deflateReset(&mvd.z);
+    } else {
+        // make following data independent of the history
+        write_shared(NULL, 0, Z_FULL_FLUSH);
+    }
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (!client->z.state) {
+            continue;
+        }
+
+        // private stream must end on byte boundary with nothing pending
+        if (!flush_stream(client, Z_SYNC_FLUSH)) {
+            continue;
+        }
+
+        deflateEnd(&client->z);
+        client->shared = qtrue;
+
+        if (!mvd.z_clients++ || client->maxbuf < mvd.z_maxbuf) {
+            mvd.z_maxbuf = client->maxbuf;
+        }
+    }
+}
+
+/*
+Sends ping replies. Clients sharing the stream get theirs as a stored deflate
+block inserted into their copy of the stream. The shared stream is fully
+flushed first, so that data deflated later doesn't reference history that
+inserted bytes have shifted.
+*/
+static void send_pongs(void)
+{
+    static const byte pong[3] = { 1, 0, GTS_PONG };
+    gtv_client_t *client;
+    byte block[5 + sizeof(pong)];
+
+    write_shared(NULL, 0, Z_FULL_FLUSH);
+
+    // non-final stored block
+    block[0] = 0x00;
+    block[1] = sizeof(pong);
+    block[2] = 0;
+    block[3] = ~sizeof(pong) & 255;
+    block[4] = 255;
+    memcpy(block + 5, pong, sizeof(pong));
+
+    FOR_EACH_GTV(client) {
+        if (client->pong) {
+            client->pong = qfalse;
+            if (client->shared) {
+                client->adler = adler32(client->adler, pong, sizeof(pong));
+                if (FIFO_Write(&client->stream.send, block, sizeof(block)) != sizeof(block)) {
+                    drop_client(client, "overflowed");
+                    continue;
+                }
+            } else if (client->state >= cs_primed) {
+                write_stream(client, (void *)pong, sizeof(pong));
+                flush_stream(client, Z_SYNC_FLUSH);
+            }
+        }
+        if (client->shared || client->state >= cs_primed) {
+            NET_UpdateStream(&client->stream);
+        }
+    }
+}
+
+// gives client a private compressor to send it something not everyone gets
+static qboolean leave_shared(gtv_client_t *client)
+{
+    // everything deflated so far must reach the client
+    write_shared(NULL, 0, Z_SYNC_FLUSH);
+    if (!client->shared) {
+        return qfalse;
+    }
+
+    client->shared = qfalse;
+    mvd.z_clients--;
+
+    if (!deflate_init(&client->z)) {
+        drop_client(client, "deflateInit2() failed");
+        return qfalse;
+    }
+
+    return qtrue;
+}
+
+// ends shared stream for the client without allocating a compressor
+static void finish_shared(gtv_client_t *client)
+{
+    static const byte empty_block[2] = { 0x03, 0x00 };
+
+    write_shared(NULL, 0, Z_SYNC_FLUSH);
+    if (!client->shared) {
+        return;
+    }
+
+    client->shared = qfalse;
+    mvd.z_clients--;
+
+    // final empty block
+    FIFO_Write(&client->stream.send, empty_block, sizeof(empty_block));
+    write_trailer(client);
 }
 #endif
 
@@ -1363,7 +1638,12 @@ static void drop_client(gtv_client_t *client, const char *error)
     }
 
 #if USE_ZLIB
-    if (client->z.state) {
+    if (client->shared) {
+        finish_shared(client);
+        if (client->state <= cs_zombie) {
+            return; // overflowed while flushing
+        }
+    } else if (client->z.state) {
         // finish zlib stream
         flush_stream(client, Z_FINISH);
         deflateEnd(&client->z);
@@ -1389,9 +1669,15 @@ static void write_stream(gtv_client_t *client, void *data, size_t len)
     }
 
 #if USE_ZLIB
+    if (client->shared && !leave_shared(client)) {
+        return;
+    }
+
     if (client->z.state) {
         z_streamp z = &client->z;
 
+        client->adler = adler32(client->adler, data, (uInt)len);
+
         z->next_in = data;
         z->avail_in = (uInt)len;
 
@@ -1437,6 +1723,71 @@ static void write_message(gtv_client_t *client, gtv_serverop_t op)
     write_stream(client, msg_write.data, msg_write.cursize);
 }
 
+/*
+Data common to all active clients goes through these. Compressed clients
+are moved onto the shared stream when sv_mvd_sharestream is enabled, so the
+data is deflated only once no matter how many clients there are.
+*/
+static void broadcast_begin(void)
+{
+#if USE_ZLIB
+    if (sv_mvd_sharestream->integer) {
+        join_shared();
+    }
+#endif
+}
+
+static void broadcast_stream(void *data, size_t len)
+{
+    gtv_client_t *client;
+
+#if USE_ZLIB
+    write_shared(data, len, Z_NO_FLUSH);
+#endif
+
+    FOR_EACH_ACTIVE_GTV(client) {
+#if USE_ZLIB
+        if (client->shared) {
+            continue;
+        }
+#endif
+        write_stream(client, data, len);
+    }
+}
+
+static void broadcast_message(gtv_serverop_t op)
+{
+    byte header[3];
+    size_t len = msg_write.cursize + 1;
+
+    header[0] = len & 255;
+    header[1] = (len >> 8) & 255;
+    header[2] = op;
+    broadcast_stream(header, sizeof(header));
+
+    broadcast_stream(msg_write.data, msg_write.cursize);
+}
+
+static void broadcast_end(qboolean flush)
+{
+    gtv_client_t *client;
+
+#if USE_ZLIB
+    if (flush || ++mvd.z_bufcount > mvd.z_maxbuf) {
+        write_shared(NULL, 0, Z_SYNC_FLUSH);
+    }
+#endif
+
+    FOR_EACH_ACTIVE_GTV(client) {
+#if USE_ZLIB
+        if (!client->shared && (flush || ++client->bufcount > client->maxbuf)) {
+            flush_stream(client, Z_SYNC_FLUSH);
+        }
+#endif
+        NET_UpdateStream(&client->stream);
+    }
+}
+
 static qboolean auth_client(gtv_client_t *client, const char *password)
 {
     if (SV_MatchAddress(&gtv_white_list, &client->stream.address))
@@ -1517,12 +1868,14 @@ static void parse_hello(gtv_client_t *client)
 #if USE_ZLIB
     // the rest of the stream will be deflated
     if (flags & GTF_DEFLATE) {
-        client->z.zalloc = SV_zalloc;
-        client->z.zfree = SV_zfree;
-        if (deflateInit(&client->z, Z_DEFAULT_COMPRESSION) != Z_OK) {
-            drop_client(client, "deflateInit failed");
+        static const byte zlib_header[2] = { 0x78, 0x9c };
+
+        if (!deflate_init(&client->z)) {
+            drop_client(client, "deflateInit2() failed");
             return;
         }
+        FIFO_Write(&client->stream.send, zlib_header, sizeof(zlib_header));
+        client->adler = adler32(0L, Z_NULL, 0);
     }
 #endif
 
@@ -1536,6 +1889,15 @@ static void parse_ping(gtv_client_t *client)
         return;
     }
 
+#if USE_ZLIB
+    // replies to clients on the shared stream are sent together
+    if (client->shared) {
+        client->pong = qtrue;
+        mvd.z_pong = qtrue;
+        return;
+    }
+#endif
+
     // send ping reply
     write_message(client, GTS_PONG);
 
@@ -1852,6 +2214,14 @@ void SV_MvdRunClients(void)
             break;
         }
     }
+
+#if USE_ZLIB
+    // send ping replies to clients on the shared stream
+    if (mvd.z_pong) {
+        mvd.z_pong = qfalse;
+        send_pongs();
+    }
+#endif
 }
 
 static void dump_clients(void)
@@ -1860,11 +2230,11 @@ static void dump_clients(void)
     int count;
 
     Com_Printf(
-        "num name             buf lastmsg address               state\n"
-        "--- ---------------- --- ------- --------------------- -----\n");
+        "num name             backlog lastmsg address               state\n"
+        "--- ---------------- ------- ------- --------------------- -----\n");
     count = 0;
     FOR_EACH_GTV(client) {
-        Com_Printf("%3d %-16.16s %3"PRIz" %7u %-21s ",
+        Com_Printf("%3d %-16.16s %7"PRIz" %7u %-21s ",
                    count, client->name, FIFO_Usage(&client->stream.send),
                    svs.realtime - client->lastmessage,
                    NET_AdrToString(&client->stream.address));
@@ -1883,6 +2253,12 @@ static void dump_clients(void)
             Com_Printf("PRIM ");
             break;
         default:
+#if USE_ZLIB
+            if (client->shared) {
+                Com_Printf("SHRD ");
+                break;
+            }
+#endif
             Com_Printf("SEND ");
             break;
         }
@@ -1890,6 +2266,13 @@ static void dump_clients(void)
 
         count++;
     }
+
+#if USE_ZLIB
+    if (mvd.z_clients) {
+        Com_Printf("%u client%s sharing deflate stream\n",
+                   mvd.z_clients, mvd.z_clients == 1 ? "" : "s");
+    }
+#endif
 }
 
 static void dump_versions(void)
@@ -1927,11 +2310,24 @@ static void mvd_drop(gtv_serverop_t op)
 {
     gtv_client_t *client;
 
+#if USE_ZLIB
+    // send the message once to clients sharing the stream
+    write_shared_message(op);
+#endif
+
     // drop GTV clients
     FOR_EACH_GTV(client) {
         switch (client->state) {
         case cs_spawned:
         case cs_primed:
+#if USE_ZLIB
+            if (client->shared) {
+                // message has already been deflated
+                drop_client(client, NULL);
+                NET_UpdateStream(&client->stream);
+                break;
+            }
+#endif
             write_message(client, op);
             drop_client(client, NULL);
             NET_UpdateStream(&client->stream);
@@ -1989,7 +2385,6 @@ Server has just changed the map, spawn the MVD dummy and go!
 */
 void SV_MvdMapChanged(void)
 {
-    gtv_client_t *client;
     int ret;
 
     if (!mvd.entities) {
@@ -2016,10 +2411,9 @@ void SV_MvdMapChanged(void)
         emit_gamestate();
 
         // send gamestate to all MVD clients
-        FOR_EACH_ACTIVE_GTV(client) {
-            write_message(client, GTS_STREAM_DATA);
-            NET_UpdateStream(&client->stream);
-        }
+        broadcast_begin();
+        broadcast_message(GTS_STREAM_DATA);
+        broadcast_end(qfalse);
     }
 
     if (mvd.recording) {
@@ -2135,6 +2529,13 @@ void SV_MvdShutdown(error_type_t type)
     Z_Free(mvd.message.data);
     Z_Free(mvd.clients);
 
+#if USE_ZLIB
+    if (mvd.z_buf) {
+        deflateEnd(&mvd.z);
+        Z_Free(mvd.z_buf);
+    }
+#endif
+
     // close server TCP socket
     NET_Listen(qfalse);
 
@@ -2163,8 +2564,15 @@ static void rec_write(void)
     if (ret != 2)
         goto fail;
     ret = FS_Write(msg_write.data, msg_write.cursize, mvd.recording);
-    if (ret == msg_write.cursize)
-        return;
+    if (ret != msg_write.cursize)
+        goto fail;
+
+    // keyframes are relative to the last gamestate
+    mvd.mapstart = FS_Tell(mvd.recording);
+    mvd.framenum = 1;
+    mvd.keyframe = 1;
+    memset(mvd.dcs, 0, sizeof(mvd.dcs));
+    return;
 
 fail:
     Com_EPrintf("Couldn't write local MVD: %s\n", Q_ErrorString(ret));
@@ -2172,6 +2580,77 @@ fail:
 }
 
 // Stops server local MVD recording.
+static qboolean rec_index_entry(uint32_t framenum, uint32_t filepos,
+                                uint32_t mapstart, uint32_t msglen)
+{
+    uint32_t header[4];
+    ssize_t ret;
+
+    header[0] = LittleLong(mapstart);
+    header[1] = LittleLong(framenum);
+    header[2] = LittleLong(filepos);
+    header[3] = LittleLong(msglen);
+    ret = FS_Write(header, sizeof(header), mvd.index);
+    if (ret != sizeof(header))
+        goto fail;
+    ret = FS_Write(msg_write.data, msglen, mvd.index);
+    if (ret == msglen)
+        return qtrue;
+
+fail:
+    Com_EPrintf("Couldn't write MVD index: %s\n", Q_ErrorString(ret));
+    FS_FCloseFile(mvd.index);
+    mvd.index = 0;
+    return qfalse;
+}
+
+/*
+Periodically writes a keyframe to the index: an uncompressed frame followed
+by configstrings changed since the last gamestate. MVD player parses it to
+restore delta compression state and configstrings when seeking.
+*/
+static void rec_keyframe(void)
+{
+    const char *string;
+    size_t length;
+    off_t pos;
+    int i;
+
+    if (!mvd.mapstart)
+        return;
+
+    // MVD frames are sent at 10 Hz
+    if (sv_mvd_keyframes->integer <= 0 ||
+        mvd.framenum < mvd.keyframe + sv_mvd_keyframes->integer * 10)
+        return;
+
+    pos = FS_Tell(mvd.recording);
+    if (pos < 0)
+        return;
+
+    MSG_WriteByte(mvd_frame);
+    emit_base_frame();
+
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        if (!Q_IsBitSet(mvd.dcs, i))
+            continue;
+
+        string = Com_ConfigstringSlot(sv.configstrings, i);
+        length = strlen(string);
+
+        MSG_WriteByte(mvd_configstring);
+        MSG_WriteShort(i);
+        MSG_WriteData(string, length);
+        MSG_WriteByte(0);
+    }
+
+    if (!msg_write.overflowed)
+        rec_index_entry(mvd.framenum, pos, mvd.mapstart, msg_write.cursize);
+
+    SZ_Clear(&msg_write);
+    mvd.keyframe = mvd.framenum;
+}
+
 static void rec_stop(void)
 {
     uint16_t msglen;
@@ -2184,6 +2663,13 @@ static void rec_stop(void)
     msglen = 0;
     FS_Write(&msglen, 2, mvd.recording);
 
+    // finish index with demo size, so that player can validate it
+    if (mvd.index) {
+        rec_index_entry(0, FS_Tell(mvd.recording), 0, 0);
+        FS_FCloseFile(mvd.index);
+        mvd.index = 0;
+    }
+
     FS_FCloseFile(mvd.recording);
     mvd.recording = 0;
 }
@@ -2203,18 +2689,34 @@ static qboolean rec_allowed(void)
     return qtrue;
 }
 
-static void rec_start(qhandle_t demofile)
+static void rec_start(qhandle_t demofile, const char *path)
 {
+    char buffer[MAX_OSPATH + 4];
     uint32_t magic;
 
     mvd.recording = demofile;
     mvd.numlevels = 0;
     mvd.numframes = 0;
+    mvd.mapstart = 0;
     mvd.clients_active = svs.realtime;
 
     magic = MVD_MAGIC;
     FS_Write(&magic, 4, demofile);
 
+    // compressed demos can't be seeked efficiently, don't index them
+    if (sv_mvd_keyframes->integer > 0 && COM_CompareExtension(path, ".gz")) {
+        Q_concat(buffer, sizeof(buffer), path, ".idx", NULL);
+        FS_FOpenFile(buffer, &mvd.index, FS_MODE_WRITE);
+        if (mvd.index) {
+            magic = LittleLong(MVD_INDEX_MAGIC);
+            FS_Write(&magic, 4, mvd.index);
+            magic = LittleLong(MVD_INDEX_VERSION);
+            FS_Write(&magic, 4, mvd.index);
+        } else {
+            Com_WPrintf("Couldn't open %s for writing\n", buffer);
+        }
+    }
+
     if (mvd.active) {
         emit_gamestate();
         rec_write();
@@ -2283,7 +2785,7 @@ void SV_MvdRecord_f(void)
 
     Com_Printf("Recording local MVD to %s\n", buffer);
 
-    rec_start(f);
+    rec_start(f, buffer);
 }
 
 
@@ -2366,10 +2868,14 @@ void SV_MvdRegister(void)
     sv_mvd_enable = Cvar_Get("sv_mvd_enable", "0", CVAR_LATCH);
     sv_mvd_maxclients = Cvar_Get("sv_mvd_maxclients", "8", CVAR_LATCH);
     sv_mvd_bufsize = Cvar_Get("sv_mvd_bufsize", "2", CVAR_LATCH);
+#if USE_ZLIB
+    sv_mvd_sharestream = Cvar_Get("sv_mvd_sharestream", "0", 0);
+#endif
     sv_mvd_password = Cvar_Get("sv_mvd_password", "", CVAR_PRIVATE);
     sv_mvd_maxsize = Cvar_Get("sv_mvd_maxsize", "0", 0);
     sv_mvd_maxtime = Cvar_Get("sv_mvd_maxtime", "0", 0);
     sv_mvd_maxmaps = Cvar_Get("sv_mvd_maxmaps", "1", 0);
+    sv_mvd_keyframes = Cvar_Get("sv_mvd_keyframes", "10", 0);
     sv_mvd_noblend = Cvar_Get("sv_mvd_noblend", "0", CVAR_LATCH);
     sv_mvd_nogun = Cvar_Get("sv_mvd_nogun", "1", CVAR_LATCH);
     sv_mvd_nomsgs = Cvar_Get("sv_mvd_nomsgs", "1", CVAR_LATCH);
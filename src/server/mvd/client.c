@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "client.h"
 #include "server/mvd/protocol.h"
+#include "common/tasks.h"
 
 #define FOR_EACH_GTV(gtv) \
     LIST_FOR_EACH(gtv_t, gtv, &mvd_gtv_list, entry)
@@ -31,6 +32,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define GTV_PING_INTERVAL   (60 * 1000)     // 1 minute
 
+// room for several messages, so that most of the data received
+// in a frame can be inflated ahead of parsing
+#define GTV_INFLATE_SIZE    (MAX_GTS_MSGLEN * 4)
+
 typedef enum {
     GTV_DISCONNECTED, // disconnected
     GTV_CONNECTING, // connect() in progress
@@ -62,10 +67,12 @@ typedef struct gtv_s {
     byte        *data;
     size_t      msglen;
     unsigned    flags;
+    neterr_t    recv_ret; // result of NET_RunStream this frame
 #if USE_ZLIB
     qboolean    z_act; // true when actively inflating
     z_stream    z_str;
     fifo_t      z_buf;
+    int         z_ret; // result of inflate on worker thread
 #endif
     unsigned    last_rcvd;
     unsigned    last_sent;
@@ -138,12 +145,9 @@ void MVD_StopRecord(mvd_t *mvd)
 
 static void MVD_Free(mvd_t *mvd)
 {
-    mvd_snap_t *snap, *next;
     int i;
 
-    LIST_FOR_EACH_SAFE(mvd_snap_t, snap, next, &mvd->snapshots, entry) {
-        Z_Free(snap);
-    }
+    MVD_FreeSnapshots(mvd);
 
     // stop demo recording
     if (mvd->demorecording) {
@@ -155,6 +159,11 @@ static void MVD_Free(mvd_t *mvd)
     }
 
     Z_Free(mvd->players);
+    Z_Free(mvd->edicts);
+    Com_ClearConfigstrings(mvd->configstrings);
+    Z_Free(mvd->configstrings);
+
+    MVD_FreeBaseConfigstrings(mvd);
 
     CM_FreeMap(&mvd->cm);
 
@@ -323,12 +332,11 @@ static mvd_t *create_channel(gtv_t *gtv)
     mvd->gtv = gtv;
     mvd->id = gtv->id;
     Q_strlcpy(mvd->name, gtv->name, sizeof(mvd->name));
-    mvd->pool.edicts = mvd->edicts;
+    mvd->configstrings = MVD_Mallocz(sizeof(mvd->configstrings[0]) * MAX_CONFIGSTRINGS);
+    Com_ClearConfigstrings(mvd->configstrings);
     mvd->pool.edict_size = sizeof(edict_t);
-    mvd->pool.max_edicts = MAX_EDICTS;
     mvd->pm_type = PM_SPECTATOR;
     mvd->min_packets = mvd_wait_delay->value * 10;
-    List_Init(&mvd->snapshots);
     List_Init(&mvd->clients);
     List_Init(&mvd->entry);
 
@@ -396,6 +404,11 @@ static void set_mvd_active(void)
     }
 }
 
+static void recv_stream(gtv_t *gtv);
+#if USE_ZLIB
+static void inflate_task(void *data, int index);
+#endif
+
 /*
 ==============
 MVD_Frame
@@ -407,11 +420,38 @@ int MVD_Frame(void)
 {
     gtv_t *gtv, *next;
     int connections = 0;
+#if USE_ZLIB
+    gtv_t *batch[64];
+    int count = 0;
+#endif
 
     if (sv.state == ss_broadcast) {
         set_mvd_active();
     }
 
+    // receive data on all connected streams. decompression is independent
+    // per connection and runs in parallel, parsing stays on this thread
+    // since it works on the global message buffers
+    FOR_EACH_GTV(gtv) {
+        if (gtv->stream.state != NS_CONNECTED) {
+            continue;
+        }
+        recv_stream(gtv);
+#if USE_ZLIB
+        if (gtv->recv_ret == NET_OK && gtv->z_act) {
+            batch[count++] = gtv;
+            if (count == q_countof(batch)) {
+                Com_ParallelFor(inflate_task, batch, count);
+                count = 0;
+            }
+        }
+#endif
+    }
+
+#if USE_ZLIB
+    Com_ParallelFor(inflate_task, batch, count);
+#endif
+
     // run all GTV connections (but not demos)
     LIST_FOR_EACH_SAFE(gtv_t, gtv, next, &mvd_gtv_list, entry) {
         if (setjmp(mvd_jmpbuf)) {
@@ -558,6 +598,24 @@ static ssize_t demo_read_first(qhandle_t f)
     return read ? read : Q_ERR_UNEXPECTED_EOF;
 }
 
+static mvd_snap_t *demo_alloc_snapshot(mvd_t *mvd, int framenum, off_t filepos, size_t msglen)
+{
+    mvd_snap_t *snap;
+
+    snap = MVD_Malloc(sizeof(*snap) + msglen - 1);
+    snap->framenum = framenum;
+    snap->filepos = filepos;
+    snap->msglen = msglen;
+
+    if (!(mvd->numsnapshots & 63)) {
+        mvd->snapshots = Z_Realloc(mvd->snapshots,
+            sizeof(mvd->snapshots[0]) * (mvd->numsnapshots + 64));
+    }
+    mvd->snapshots[mvd->numsnapshots++] = snap;
+
+    return snap;
+}
+
 // periodically builds a fake demo packet used to reconstruct delta compression
 // state, configstrings and layouts at the given server frame.
 static void demo_emit_snapshot(mvd_t *mvd)
@@ -565,7 +623,7 @@ static void demo_emit_snapshot(mvd_t *mvd)
     mvd_snap_t *snap;
     gtv_t *gtv;
     off_t pos;
-    char *from, *to;
+    const char *to;
     size_t len;
     int i;
 
@@ -592,15 +650,11 @@ static void demo_emit_snapshot(mvd_t *mvd)
 
     // write configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        from = mvd->baseconfigstrings[i];
-        to = mvd->configstrings[i];
-
-        if (!strcmp(from, to))
+        if (MVD_BASE_CS(mvd, i) == mvd->configstrings[i])
             continue;
 
+        to = Com_ConfigstringSlot(mvd->configstrings, i);
         len = strlen(to);
-        if (len > MAX_QPATH)
-            len = MAX_QPATH;
 
         MSG_WriteByte(mvd_configstring);
         MSG_WriteShort(i);
@@ -610,12 +664,8 @@ static void demo_emit_snapshot(mvd_t *mvd)
 
     // TODO: write private layouts/configstrings
 
-    snap = MVD_Malloc(sizeof(*snap) + msg_write.cursize - 1);
-    snap->framenum = mvd->framenum;
-    snap->filepos = pos;
-    snap->msglen = msg_write.cursize;
+    snap = demo_alloc_snapshot(mvd, mvd->framenum, pos, msg_write.cursize);
     memcpy(snap->data, msg_write.data, msg_write.cursize);
-    List_Append(&mvd->snapshots, &snap->entry);
 
     Com_DPrintf("[%d] snaplen %"PRIz"\n", mvd->framenum, msg_write.cursize);
 
@@ -624,22 +674,126 @@ static void demo_emit_snapshot(mvd_t *mvd)
     mvd->last_snapshot = mvd->framenum;
 }
 
+// returns the last snapshot at or before the given frame, or the first one
 static mvd_snap_t *demo_find_snapshot(mvd_t *mvd, int framenum)
 {
-    mvd_snap_t *snap, *prev;
+    int lo, hi, mid;
 
-    if (LIST_EMPTY(&mvd->snapshots))
+    if (!mvd->numsnapshots)
         return NULL;
 
-    prev = LIST_FIRST(mvd_snap_t, &mvd->snapshots, entry);
+    lo = 0;
+    hi = mvd->numsnapshots - 1;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (mvd->snapshots[mid]->framenum > framenum)
+            hi = mid - 1;
+        else
+            lo = mid;
+    }
+
+    return mvd->snapshots[lo];
+}
 
-    LIST_FOR_EACH(mvd_snap_t, snap, &mvd->snapshots, entry) {
-        if (snap->framenum > framenum)
+void MVD_FreeSnapshots(mvd_t *mvd)
+{
+    int i;
+
+    for (i = 0; i < mvd->numsnapshots; i++) {
+        Z_Free(mvd->snapshots[i]);
+    }
+
+    Z_Free(mvd->snapshots);
+    mvd->snapshots = NULL;
+    mvd->numsnapshots = 0;
+}
+
+/*
+Loads keyframes written by the server recorder for the map that was just
+started. Index entries are tied to the demo offset right after the gamestate,
+and the index is only used if its trailer matches the demo size.
+*/
+static void demo_load_index(gtv_t *gtv)
+{
+    mvd_t *mvd = gtv->mvd;
+    char path[MAX_OSPATH + 4];
+    uint32_t header[4];
+    mvd_snap_t *snap;
+    off_t mapstart;
+    qhandle_t f;
+    int i, count, last;
+
+    if (!gtv->demosize)
+        return;
+
+    mapstart = FS_Tell(gtv->demoplayback);
+    if (mapstart <= 0)
+        return;
+
+    Q_concat(path, sizeof(path), gtv->demoentry->string, ".idx", NULL);
+    FS_FOpenFile(path, &f, FS_MODE_READ);
+    if (!f)
+        return;
+
+    count = mvd->numsnapshots;
+    last = count ? mvd->snapshots[count - 1]->framenum : INT_MIN;
+
+    if (FS_Read(header, 8, f) != 8)
+        goto fail;
+    if (LittleLong(header[0]) != MVD_INDEX_MAGIC ||
+        LittleLong(header[1]) != MVD_INDEX_VERSION)
+        goto fail;
+
+    while (1) {
+        if (FS_Read(header, sizeof(header), f) != sizeof(header))
+            goto fail;
+        for (i = 0; i < 4; i++)
+            header[i] = LittleLong(header[i]);
+
+        // trailer holds the demo size
+        if (!header[3]) {
+            if (header[2] != gtv->demosize) {
+                Com_DPrintf("%s doesn't match demo, ignored\n", path);
+                goto discard;
+            }
             break;
-        prev = snap;
+        }
+
+        if (header[3] > MAX_MSGLEN)
+            goto fail;
+
+        // skip keyframes of other maps
+        if (header[0] != mapstart || (int)header[1] <= last) {
+            if (FS_Seek(f, FS_Tell(f) + header[3]) < 0)
+                goto fail;
+            continue;
+        }
+
+        if (header[2] < mapstart || header[2] > gtv->demosize)
+            goto fail;
+
+        snap = demo_alloc_snapshot(mvd, header[1], header[2], header[3]);
+        if (FS_Read(snap->data, header[3], f) != header[3])
+            goto fail;
+
+        last = header[1];
     }
 
-    return prev;
+    // don't emit snapshots already covered by index
+    if (mvd->numsnapshots > count)
+        mvd->last_snapshot = last;
+
+    Com_DPrintf("Loaded %d keyframes from %s\n", mvd->numsnapshots - count, path);
+    goto done;
+
+fail:
+    Com_WPrintf("%s is corrupted, ignored\n", path);
+discard:
+    for (i = count; i < mvd->numsnapshots; i++)
+        Z_Free(mvd->snapshots[i]);
+    mvd->numsnapshots = count;
+done:
+    FS_FCloseFile(f);
 }
 
 static void demo_update(gtv_t *gtv)
@@ -663,6 +817,7 @@ static qboolean demo_read_frame(mvd_t *mvd)
     gtv_t *gtv = mvd->gtv;
     int count;
     ssize_t ret;
+    qboolean gamestate;
 
     if (mvd->state == MVD_WAITING) {
         return qfalse; // paused by user
@@ -697,8 +852,10 @@ static qboolean demo_read_frame(mvd_t *mvd)
 
     demo_update(gtv);
 
-    MVD_ParseMessage(mvd);
+    gamestate = MVD_ParseMessage(mvd);
     demo_emit_snapshot(mvd);
+    if (gamestate)
+        demo_load_index(gtv);
     return qtrue;
 
 next:
@@ -771,6 +928,7 @@ static void demo_play_next(gtv_t *gtv, string_entry_t *entry)
     }
 
     demo_emit_snapshot(gtv->mvd);
+    demo_load_index(gtv);
 }
 
 static void demo_free_playlist(gtv_t *gtv)
@@ -1070,14 +1228,23 @@ static void send_stream_stop(gtv_t *gtv)
 
 
 #if USE_ZLIB
+// inflate allocates its window lazily, possibly on a worker thread
 static voidpf gtv_zalloc(voidpf opaque, uInt items, uInt size)
 {
-    return MVD_Malloc(items * size);
+    voidpf ptr;
+
+    Com_TaskLock();
+    ptr = MVD_Malloc(items * size);
+    Com_TaskUnlock();
+
+    return ptr;
 }
 
 static void gtv_zfree(voidpf opaque, voidpf address)
 {
+    Com_TaskLock();
     Z_Free(address);
+    Com_TaskUnlock();
 }
 #endif
 
@@ -1102,8 +1269,8 @@ static void parse_hello(gtv_t *gtv)
             }
         }
         if (!gtv->z_buf.data) {
-            gtv->z_buf.data = MVD_Malloc(MAX_GTS_MSGLEN);
-            gtv->z_buf.size = MAX_GTS_MSGLEN;
+            gtv->z_buf.data = MVD_Malloc(GTV_INFLATE_SIZE);
+            gtv->z_buf.size = GTV_INFLATE_SIZE;
         }
         gtv->z_act = qtrue; // remaining data is deflated
 #else
@@ -1366,10 +1533,8 @@ static int inflate_stream(fifo_t *dst, fifo_t *src, z_streamp z)
     return ret;
 }
 
-static void inflate_more(gtv_t *gtv)
+static void inflate_done(gtv_t *gtv, int ret)
 {
-    int ret = inflate_stream(&gtv->z_buf, &gtv->stream.recv, &gtv->z_str);
-
     switch (ret) {
     case Z_BUF_ERROR:
     case Z_OK:
@@ -1382,6 +1547,19 @@ static void inflate_more(gtv_t *gtv)
         gtv_destroyf(gtv, "inflate() failed: %s", gtv->z_str.msg);
     }
 }
+
+static void inflate_more(gtv_t *gtv)
+{
+    inflate_done(gtv, inflate_stream(&gtv->z_buf, &gtv->stream.recv, &gtv->z_str));
+}
+
+// runs on worker threads, may only touch the connection itself
+static void inflate_task(void *data, int index)
+{
+    gtv_t *gtv = ((gtv_t **)data)[index];
+
+    gtv->z_ret = inflate_stream(&gtv->z_buf, &gtv->stream.recv, &gtv->z_str);
+}
 #endif
 
 static neterr_t run_connect(gtv_t *gtv)
@@ -1415,26 +1593,30 @@ static neterr_t run_connect(gtv_t *gtv)
     return NET_OK;
 }
 
-static neterr_t run_stream(gtv_t *gtv)
+static void recv_stream(gtv_t *gtv)
+{
+    gtv->recv_ret = NET_RunStream(&gtv->stream);
+#if USE_ZLIB
+    gtv->z_ret = Z_OK;
+#endif
+}
+
+static void run_stream(gtv_t *gtv)
 {
-    neterr_t ret;
 #ifdef _DEBUG
     int count;
     size_t usage;
-#endif
 
-    // run network stream
-    if ((ret = NET_RunStream(&gtv->stream)) != NET_OK) {
-        return ret;
-    }
-
-#ifdef _DEBUG
     count = 0;
     usage = FIFO_Usage(&gtv->stream.recv);
 #endif
 
 #if USE_ZLIB
     if (gtv->z_act) {
+        // pick up the result of inflating on worker threads
+        inflate_done(gtv, gtv->z_ret);
+        gtv->z_ret = Z_OK;
+
         while (1) {
             // decompress more data
             if (gtv->z_act) {
@@ -1463,8 +1645,6 @@ static neterr_t run_stream(gtv_t *gtv)
                    gtv->name, total, count);
     }
 #endif
-
-    return NET_OK;
 }
 
 static void check_timeouts(gtv_t *gtv)
@@ -1541,9 +1721,17 @@ static void gtv_run(gtv_t *gtv)
         if (ret == NET_AGAIN) {
             return;
         }
+        if (ret != NET_OK) {
+            break;
+        }
+        recv_stream(gtv);
+        // fall through
+    case NS_CONNECTED:
+        // data has been received by MVD_Frame
+        ret = gtv->recv_ret;
+        gtv->recv_ret = NET_AGAIN;
         if (ret == NET_OK) {
-        case NS_CONNECTED:
-            ret = run_stream(gtv);
+            run_stream(gtv);
         }
         break;
     default:
@@ -1729,6 +1917,79 @@ static void list_recordings(void)
     }
 }
 
+static size_t player_memory(mvd_t *mvd)
+{
+    mvd_player_t *player;
+    mvd_cs_t *cs;
+    size_t total;
+    int i;
+
+    total = sizeof(*player) * mvd->maxclients;
+    for (i = 0, player = mvd->players; i < mvd->maxclients; i++, player++) {
+        // strings themselves are interned and not counted
+        for (cs = player->configstrings; cs; cs = cs->next) {
+            total += sizeof(*cs);
+        }
+    }
+
+    return total;
+}
+
+static size_t snapshot_memory(mvd_t *mvd)
+{
+    size_t total;
+    int i;
+
+    total = sizeof(mvd->snapshots[0]) * ((mvd->numsnapshots + 63) & ~63);
+    for (i = 0; i < mvd->numsnapshots; i++) {
+        total += sizeof(mvd_snap_t) + mvd->snapshots[i]->msglen - 1;
+    }
+
+    return total;
+}
+
+// map data is shared through the collision model cache and not included
+static void list_memory(void)
+{
+    mvd_t *mvd;
+    size_t strings, edicts, players, base, snaps, total, grand;
+    int count;
+
+    Com_Printf(
+        "id name         strings  edicts players base/shr    snaps  delay    total\n"
+        "-- ------------ ------- ------- ------- -------- ------- ------ --------\n");
+
+    grand = 0;
+    count = 0;
+    FOR_EACH_MVD(mvd) {
+        // strings themselves are interned and not counted
+        strings = sizeof(mvd->configstrings[0]) * MAX_CONFIGSTRINGS;
+        edicts = sizeof(edict_t) * mvd->pool.max_edicts;
+        players = player_memory(mvd);
+        base = 0;
+        count = 0;
+        if (mvd->basecs) {
+            base = sizeof(*mvd->basecs);
+            count = mvd->basecs->refcount;
+        }
+        snaps = snapshot_memory(mvd);
+
+        // shared base is split evenly between users
+        total = sizeof(*mvd) + strings + edicts + players + snaps + mvd->delay.size;
+        if (count) {
+            total += base / count;
+        }
+        grand += total;
+
+        Com_Printf("%2d %-12.12s %7"PRIz" %7"PRIz" %7"PRIz" %5"PRIz"/%-2d %7"PRIz" %6"PRIz" %8"PRIz"\n",
+                   mvd->id, mvd->name, strings, edicts, players, base, count,
+                   snaps, mvd->delay.size, total);
+    }
+
+    Com_Printf("Total %"PRIz" bytes (%"PRIz" bytes per channel structure)\n",
+               grand, sizeof(mvd_t));
+}
+
 static void MVD_ListChannels_f(void)
 {
     char *s;
@@ -1741,6 +2002,8 @@ static void MVD_ListChannels_f(void)
     s = Cmd_Argv(1);
     if (*s == 'r') {
         list_recordings();
+    } else if (*s == 'm') {
+        list_memory();
     } else {
         list_generic();
     }
@@ -1842,7 +2105,7 @@ static void emit_base_frame(mvd_t *mvd)
     MSG_WriteByte(CLIENTNUM_NONE);
 
     // send base entity states
-    for (i = 1; i < MAX_EDICTS; i++) {
+    for (i = 1; i < mvd->pool.max_edicts; i++) {
         ent = &mvd->edicts[i];
         if (!(ent->svflags & SVF_MONSTER))
             continue;   // entity never seen
@@ -1856,7 +2119,7 @@ static void emit_base_frame(mvd_t *mvd)
 static void emit_gamestate(mvd_t *mvd)
 {
     int         i, extra;
-    char        *s;
+    const char  *s;
     size_t      len;
 
     // pack MVD stream flags into extra bits
@@ -1872,7 +2135,7 @@ static void emit_gamestate(mvd_t *mvd)
 
     // send configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        s = mvd->configstrings[i];
+        s = Com_ConfigstringSlot(mvd->configstrings, i);
         if (!*s)
             continue;
 
@@ -2161,7 +2424,8 @@ static void MVD_Seek_f(void)
     gtv_t *gtv;
     mvd_snap_t *snap;
     int i, j, ret, index, frames, dest;
-    char *from, *to;
+    const char *from;
+    char *to;
     edict_t *ent;
     qboolean gamestate;
 
@@ -2222,9 +2486,12 @@ static void MVD_Seek_f(void)
 
     Com_DPrintf("[%d] seeking to %d\n", mvd->framenum, dest);
 
-    // seek to the previous most recent snapshot
+    // seek to the previous most recent snapshot, unless current position
+    // is already closer to destination
     if (frames < 0 || mvd->last_snapshot > mvd->framenum) {
         snap = demo_find_snapshot(mvd, dest);
+        if (snap && frames > 0 && snap->framenum <= mvd->framenum)
+            snap = NULL;
 
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->framenum);
@@ -2239,14 +2506,13 @@ static void MVD_Seek_f(void)
 
             // reset configstrings
             for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-                from = mvd->baseconfigstrings[i];
-                to = mvd->configstrings[i];
-
-                if (!strcmp(from, to))
+                from = MVD_BASE_CS(mvd, i);
+                if (from == mvd->configstrings[i])
                     continue;
 
+                Z_ReleaseString(mvd->configstrings[i]);
+                mvd->configstrings[i] = Z_RetainString(from);
                 Q_SetBit(mvd->dcs, i);
-                strcpy(to, from);
             }
 
             // set player names
@@ -2278,6 +2544,7 @@ static void MVD_Seek_f(void)
         if (gamestate) {
             // got a gamestate, abort seek
             Com_DPrintf("got gamestate while seeking!\n");
+            demo_load_index(gtv);
             goto done;
         }
     }
@@ -2305,7 +2572,7 @@ static void MVD_Seek_f(void)
     ent->inuse = qtrue;
 
     // relink all seen entities, reset old origins and events
-    for (i = 1; i < MAX_EDICTS; i++) {
+    for (i = 1; i < mvd->pool.max_edicts; i++) {
         ent = &mvd->edicts[i];
 
         if (ent->svflags & SVF_MONSTER)
@@ -2550,6 +2817,12 @@ void MVD_Shutdown(void)
     Z_Free(mvd_clients);
     mvd_clients = NULL;
 
+    if (mvd_waitingRoom.configstrings) {
+        Com_ClearConfigstrings(mvd_waitingRoom.configstrings);
+        Z_Free(mvd_waitingRoom.configstrings);
+        mvd_waitingRoom.configstrings = NULL;
+    }
+
     mvd_chanid = 0;
 
     mvd_active = qfalse;
@@ -56,7 +56,7 @@ typedef enum {
 typedef struct mvd_cs_s {
     struct mvd_cs_s *next;
     int index;
-    char string[1];
+    const char *string;     // interned
 } mvd_cs_t;
 
 typedef struct {
@@ -113,17 +113,27 @@ typedef enum {
 } mvd_state_t;
 
 typedef struct {
-    list_t entry;
     int framenum;
     off_t filepos;
     size_t msglen;
     byte data[1];
 } mvd_snap_t;
 
+// configstrings at the time gamestate was received, shared between
+// channels playing the same map and mod
+typedef struct mvd_csbase_s {
+    list_t      entry;
+    int         refcount;
+    unsigned    hash;
+    const char  *strings[MAX_CONFIGSTRINGS];    // interned
+} mvd_csbase_t;
+
+#define MVD_BASE_CS(mvd, n) ((mvd)->basecs->strings[n])
+
+#define MVD_EDICTS_CHUNK    64
+
 struct gtv_s;
 
-// FIXME: entire struct is > 500 kB in size!
-// need to eliminate those large static arrays below...
 typedef struct mvd_s {
     list_t      entry;
 
@@ -139,7 +149,8 @@ typedef struct mvd_s {
     char        *demoname;
     qboolean    demoseeking;
     int         last_snapshot;
-    list_t      snapshots;
+    mvd_snap_t  **snapshots;    // sorted by frame number
+    int         numsnapshots;
 
     // delay buffer
     fifo_t      delay;
@@ -159,9 +170,9 @@ typedef struct mvd_s {
     vec3_t  spawnAngles;
     int     pm_type;
     byte            dcs[CS_BITMAP_BYTES];
-    char            baseconfigstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
-    char            configstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
-    edict_t         edicts[MAX_EDICTS];
+    mvd_csbase_t    *basecs;
+    const char      **configstrings;    // [MAX_CONFIGSTRINGS], interned
+    edict_t         *edicts;    // [pool.max_edicts], grown as needed
     mvd_player_t    *players; // [maxclients]
     mvd_player_t    *dummy; // &players[clientNum]
     int             numplayers; // number of active players in frame
@@ -198,6 +209,7 @@ void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...) q_noreturn q_printf(2, 3);
 void MVD_Shutdown(void);
 
 mvd_t *MVD_SetChannel(int arg);
+void MVD_FreeSnapshots(mvd_t *mvd);
 
 void MVD_File_g(genctx_t *ctx);
 
@@ -218,6 +230,8 @@ int MVD_Frame(void);
 qboolean MVD_ParseMessage(mvd_t *mvd);
 void MVD_ParseEntityString(mvd_t *mvd, const char *data);
 void MVD_ClearState(mvd_t *mvd, qboolean full);
+void MVD_GrowEdicts(mvd_t *mvd, int count);
+void MVD_FreeBaseConfigstrings(mvd_t *mvd);
 
 //
 // mvd_game.c
@@ -432,13 +432,49 @@ CHASE CAMERA
 ==============================================================================
 */
 
-static void write_cs_list(mvd_client_t *client, mvd_cs_t *cs)
+static void write_cs(mvd_client_t *client, int index, const char *string)
+{
+    MSG_WriteByte(svc_configstring);
+    MSG_WriteShort(index);
+    MSG_WriteString(string);
+    SV_ClientAddMessage(client->cl, MSG_RELIABLE | MSG_CLEAR);
+}
+
+static mvd_cs_t *cs_list(mvd_player_t *player)
+{
+    return player ? player->configstrings : NULL;
+}
+
+static const char *find_cs(mvd_cs_t *cs, int index)
 {
     for (; cs; cs = cs->next) {
-        MSG_WriteByte(svc_configstring);
-        MSG_WriteShort(cs->index);
-        MSG_WriteString(cs->string);
-        SV_ClientAddMessage(client->cl, MSG_RELIABLE | MSG_CLEAR);
+        if (cs->index == index) {
+            return cs->string;
+        }
+    }
+    return NULL;
+}
+
+/*
+Sends unicast configstrings of the new view that differ from the old one,
+and restores global strings the old view had overridden. Strings are
+interned and compared by pointer.
+*/
+static void write_cs_delta(mvd_client_t *client, mvd_cs_t *from, mvd_cs_t *to)
+{
+    const char **global = client->mvd->configstrings;
+    mvd_cs_t *cs;
+
+    for (cs = to; cs; cs = cs->next) {
+        if (find_cs(from, cs->index) != cs->string) {
+            write_cs(client, cs->index, cs->string);
+        }
+    }
+
+    for (cs = from; cs; cs = cs->next) {
+        if (!find_cs(to, cs->index) && cs->string != global[cs->index]) {
+            write_cs(client, cs->index, global[cs->index]);
+        }
     }
 }
 
@@ -463,8 +499,7 @@ static void MVD_FollowStop(mvd_client_t *client)
     client->ps.fov = client->fov;
 
     // send delta configstrings
-    if (mvd->dummy)
-        write_cs_list(client, mvd->dummy->configstrings);
+    write_cs_delta(client, cs_list(client->target), cs_list(mvd->dummy));
 
     client->clientNum = mvd->clientNum;
     client->oldtarget = client->target;
@@ -487,7 +522,7 @@ static void MVD_FollowStart(mvd_client_t *client, mvd_player_t *target)
     client->target = target;
 
     // send delta configstrings
-    write_cs_list(client, target->configstrings);
+    write_cs_delta(client, cs_list(client->oldtarget), target->configstrings);
 
     SV_ClientPrintf(client->cl, PRINT_LOW, "[MVD] Chasing %s.\n", target->name);
 
@@ -754,7 +789,7 @@ static void MVD_SetServerState(client_t *cl, mvd_t *mvd)
 {
     cl->gamedir = mvd->gamedir;
     cl->mapname = mvd->mapname;
-    cl->configstrings = (char *)mvd->configstrings;
+    cl->configstrings = mvd->configstrings;
     cl->slot = mvd->clientNum;
     cl->cm = &mvd->cm;
     cl->pool = &mvd->pool;
@@ -1543,6 +1578,7 @@ void MVD_FreePlayer(mvd_player_t *player)
 
     for (cs = player->configstrings; cs; cs = next) {
         next = cs->next;
+        Z_ReleaseString(cs->string);
         Z_Free(cs);
     }
     player->configstrings = NULL;
@@ -1561,6 +1597,7 @@ static void reset_unicast_strings(mvd_t *mvd, int index)
             if (cs->index == index) {
                 Com_DPrintf("%s: reset %d on %d\n", __func__, index, i);
                 *next_p = cs->next;
+                Z_ReleaseString(cs->string);
                 Z_Free(cs);
                 break;
             }
@@ -1572,7 +1609,8 @@ static void reset_unicast_strings(mvd_t *mvd, int index)
 static void set_player_name(mvd_t *mvd, int index)
 {
     mvd_player_t *player;
-    char *string, *p;
+    const char *string;
+    char *p;
 
     string = mvd->configstrings[CS_PLAYERSKINS + index];
     player = &mvd->players[index];
@@ -1615,7 +1653,7 @@ void MVD_SetPlayerNames(mvd_t *mvd)
 
 void MVD_UpdateConfigstring(mvd_t *mvd, int index)
 {
-    char *s = mvd->configstrings[index];
+    const char *s = Com_ConfigstringSlot(mvd->configstrings, index);
     mvd_client_t *client;
 
     if (index >= CS_PLAYERSKINS && index < CS_PLAYERSKINS + mvd->maxclients) {
@@ -1693,6 +1731,11 @@ void MVD_RemoveClient(client_t *client)
     cl->cl = client;
 }
 
+static void set_configstring(mvd_t *mvd, int index, const char *s)
+{
+    Com_SetConfigstring(mvd->configstrings, index, s, strlen(s));
+}
+
 static void MVD_GameInit(void)
 {
     mvd_t *mvd = &mvd_waitingRoom;
@@ -1762,12 +1805,14 @@ static void MVD_GameInit(void)
     Q_strlcpy(mvd->mapname, mvd_default_map->string, sizeof(mvd->mapname));
     List_Init(&mvd->clients);
 
-    strcpy(mvd->configstrings[CS_NAME], "Waiting Room");
-    strcpy(mvd->configstrings[CS_SKY], "unit1_");
-    strcpy(mvd->configstrings[CS_MAXCLIENTS], "8");
-    sprintf(mvd->configstrings[CS_MAPCHECKSUM], "%d", checksum);
-    strcpy(mvd->configstrings[CS_MODELS + 1], buffer);
-    strcpy(mvd->configstrings[CS_LIGHTS], "m");
+    mvd->configstrings = MVD_Mallocz(sizeof(mvd->configstrings[0]) * MAX_CONFIGSTRINGS);
+    Com_ClearConfigstrings(mvd->configstrings);
+    set_configstring(mvd, CS_NAME, "Waiting Room");
+    set_configstring(mvd, CS_SKY, "unit1_");
+    set_configstring(mvd, CS_MAXCLIENTS, "8");
+    set_configstring(mvd, CS_MODELS + 1, buffer);
+    set_configstring(mvd, CS_LIGHTS, "m");
+    set_configstring(mvd, CS_MAPCHECKSUM, va("%d", checksum));
 
     mvd->dummy = &mvd_dummy;
     mvd->pm_type = PM_FREEZE;
@@ -1880,6 +1925,7 @@ static void MVD_GameClientBegin(edict_t *ent)
 
     if (mvd->intermission) {
         // force them to chase dummy MVD client
+        write_cs_delta(client, NULL, cs_list(mvd->dummy));
         client->target = mvd->dummy;
         MVD_SetFollowLayout(client);
         MVD_UpdateClient(client);
@@ -2110,6 +2156,7 @@ static void MVD_IntermissionStart(mvd_t *mvd)
         if (client->cl->state != cs_spawned) {
             continue;
         }
+        write_cs_delta(client, cs_list(client->target), cs_list(mvd->dummy));
         client->oldtarget = client->target;
         client->target = mvd->dummy;
         if (client->layout_type < LAYOUT_SCORES) {
@@ -2222,6 +2269,10 @@ static void MVD_GameRunFrame(void)
     mvd_t *mvd, *next;
     int numplayers = 0;
 
+    // channels are parsed one at a time: parsing reads the global msg_read,
+    // sends effects to spectators through msg_write, allocates from the zone
+    // and reports errors by longjmp to mvd_jmpbuf. Only decompression of GTV
+    // streams runs on worker threads (see MVD_Frame).
     LIST_FOR_EACH_SAFE(mvd_t, mvd, next, &mvd_channel_list, entry) {
         if (setjmp(mvd_jmpbuf)) {
             continue;
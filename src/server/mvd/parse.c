@@ -325,13 +325,16 @@ static void MVD_UnicastString(mvd_t *mvd, qboolean reliable, mvd_player_t *playe
         }
     }
     if (!cs) {
-        cs = MVD_Malloc(sizeof(*cs) + MAX_QPATH - 1);
+        cs = MVD_Malloc(sizeof(*cs));
         cs->index = index;
+        cs->string = NULL;
         cs->next = player->configstrings;
         player->configstrings = cs;
     }
 
-    memcpy(cs->string, string, length + 1);
+    // players usually get the same strings, share them
+    Z_ReleaseString(cs->string);
+    cs->string = Z_InternStringLen(string, length);
 
     if (mvd->demoseeking)
         return;
@@ -518,12 +521,13 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
         MVD_Destroyf(mvd, "%s: bad entnum: %d", __func__, entnum);
     }
 
-    entity = &mvd->edicts[entnum];
-    if (!entity->inuse) {
+    if (entnum >= mvd->pool.max_edicts || !mvd->edicts[entnum].inuse) {
         Com_DPrintf("%s: entnum not in use: %d\n", __func__, entnum);
         return;
     }
 
+    entity = &mvd->edicts[entnum];
+
     if (mvd->demoseeking)
         return;
 
@@ -620,20 +624,24 @@ static void MVD_ParseConfigstring(mvd_t *mvd)
 {
     int index;
     size_t len, maxlen;
-    char *s;
+    char string[CS_MAXSIZE];
 
     index = MSG_ReadShort();
     if (index < 0 || index >= MAX_CONFIGSTRINGS) {
         MVD_Destroyf(mvd, "%s: bad index: %d", __func__, index);
     }
 
-    s = mvd->configstrings[index];
     maxlen = CS_SIZE(index);
-    len = MSG_ReadString(s, maxlen);
+    len = MSG_ReadString(string, maxlen);
     if (len >= maxlen) {
         MVD_Destroyf(mvd, "%s: index %d overflowed", __func__, index);
     }
 
+    // unchanged strings are not rebroadcast
+    if (!Com_SetConfigstring(mvd->configstrings, index, string, len)) {
+        return;
+    }
+
     if (mvd->demoseeking) {
         Q_SetBit(mvd->dcs, index);
         return;
@@ -721,6 +729,10 @@ static void MVD_ParsePacketEntities(mvd_t *mvd)
             break;
         }
 
+        if (number >= mvd->pool.max_edicts) {
+            MVD_GrowEdicts(mvd, number + 1);
+        }
+
         ent = &mvd->edicts[number];
 
 #ifdef _DEBUG
@@ -853,15 +865,115 @@ static void MVD_ParseFrame(mvd_t *mvd)
     mvd->framenum++;
 }
 
+/*
+==================
+MVD_GrowEdicts
+
+Edict array is sized to the highest entity number the stream uses so far.
+Nothing keeps pointers to edicts between frames, so it can be moved.
+==================
+*/
+void MVD_GrowEdicts(mvd_t *mvd, int count)
+{
+    int oldcount = mvd->pool.max_edicts;
+
+    if (count <= oldcount) {
+        return;
+    }
+
+    count = (count + MVD_EDICTS_CHUNK - 1) & ~(MVD_EDICTS_CHUNK - 1);
+    if (count > MAX_EDICTS) {
+        count = MAX_EDICTS;
+    }
+
+    if (mvd->edicts) {
+        mvd->edicts = Z_Realloc(mvd->edicts, sizeof(edict_t) * count);
+    } else {
+        mvd->edicts = MVD_Malloc(sizeof(edict_t) * count);
+    }
+    memset(mvd->edicts + oldcount, 0, sizeof(edict_t) * (count - oldcount));
+    mvd->pool.edicts = mvd->edicts;
+    mvd->pool.max_edicts = count;
+}
+
+/*
+==================
+Base configstrings
+
+Saved when gamestate is received, used to build snapshots and to reset
+configstrings when seeking. Channels with identical gamestates share them.
+Strings are interned, so identical tables hold identical pointers.
+==================
+*/
+static LIST_DECL(mvd_csbase_list);
+
+static unsigned hash_base_configstrings(const char **strings)
+{
+    const byte *data = (const byte *)strings;
+    const byte *end = (const byte *)(strings + MAX_CONFIGSTRINGS);
+    unsigned hash = 2166136261U;
+
+    while (data < end) {
+        hash = (hash ^ *data++) * 16777619U;
+    }
+
+    return hash;
+}
+
+static void save_base_configstrings(mvd_t *mvd)
+{
+    mvd_csbase_t *base;
+    unsigned hash;
+
+    MVD_FreeBaseConfigstrings(mvd);
+
+    hash = hash_base_configstrings(mvd->configstrings);
+    LIST_FOR_EACH(mvd_csbase_t, base, &mvd_csbase_list, entry) {
+        if (base->hash == hash &&
+            !memcmp(base->strings, mvd->configstrings, sizeof(base->strings))) {
+            base->refcount++;
+            mvd->basecs = base;
+            return;
+        }
+    }
+
+    base = MVD_Mallocz(sizeof(*base));
+    base->refcount = 1;
+    base->hash = hash;
+    Com_CopyConfigstrings(base->strings, mvd->configstrings);
+
+    List_Append(&mvd_csbase_list, &base->entry);
+    mvd->basecs = base;
+}
+
+void MVD_FreeBaseConfigstrings(mvd_t *mvd)
+{
+    mvd_csbase_t *base = mvd->basecs;
+
+    if (!base) {
+        return;
+    }
+
+    mvd->basecs = NULL;
+    if (--base->refcount > 0) {
+        return;
+    }
+
+    List_Remove(&base->entry);
+    Com_ClearConfigstrings(base->strings);
+    Z_Free(base);
+}
+
 void MVD_ClearState(mvd_t *mvd, qboolean full)
 {
     mvd_player_t *player;
-    mvd_snap_t *snap, *next;
     int i;
 
     // clear all entities, don't trust num_edicts as it is possible
     // to miscount removed but seen entities
-    memset(mvd->edicts, 0, sizeof(mvd->edicts));
+    if (mvd->edicts) {
+        memset(mvd->edicts, 0, sizeof(edict_t) * mvd->pool.max_edicts);
+    }
     mvd->pool.num_edicts = 0;
 
     // clear all players
@@ -877,11 +989,7 @@ void MVD_ClearState(mvd_t *mvd, qboolean full)
         return;
 
     // free all snapshots
-    LIST_FOR_EACH_SAFE(mvd_snap_t, snap, next, &mvd->snapshots, entry) {
-        Z_Free(snap);
-    }
-
-    List_Init(&mvd->snapshots);
+    MVD_FreeSnapshots(mvd);
 
     // free current map
     CM_FreeMap(&mvd->cm);
@@ -891,7 +999,15 @@ void MVD_ClearState(mvd_t *mvd, qboolean full)
         //strcpy(mvd->oldscores, mvd->layout);
     }
 
-    memset(mvd->configstrings, 0, sizeof(mvd->configstrings));
+    // next level may use less entities
+    Z_Free(mvd->edicts);
+    mvd->edicts = NULL;
+    mvd->pool.edicts = NULL;
+    mvd->pool.max_edicts = 0;
+
+    MVD_FreeBaseConfigstrings(mvd);
+
+    Com_ClearConfigstrings(mvd->configstrings);
     mvd->layout[0] = 0;
 
     mvd->framenum = 0;
@@ -937,7 +1053,8 @@ static void MVD_ParseServerData(mvd_t *mvd, int extrabits)
 {
     int protocol;
     size_t len, maxlen;
-    char *string;
+    char string[CS_MAXSIZE];
+    const char *model;
     int index;
     qerror_t ret;
     edict_t *ent;
@@ -982,13 +1099,14 @@ static void MVD_ParseServerData(mvd_t *mvd, int extrabits)
             MVD_Destroyf(mvd, "Bad configstring index: %d", index);
         }
 
-        string = mvd->configstrings[index];
         maxlen = CS_SIZE(index);
         len = MSG_ReadString(string, maxlen);
         if (len >= maxlen) {
             MVD_Destroyf(mvd, "Configstring %d overflowed", index);
         }
 
+        Com_SetConfigstring(mvd->configstrings, index, string, len);
+
         if (msg_read.readcount > msg_read.cursize) {
             MVD_Destroyf(mvd, "Read past end of message");
         }
@@ -1022,6 +1140,9 @@ static void MVD_ParseServerData(mvd_t *mvd, int extrabits)
         }
     }
 
+    // player entities are always present
+    MVD_GrowEdicts(mvd, mvd->maxclients + 1);
+
     if (mvd->clientNum == -1) {
         mvd->dummy = NULL;
     } else {
@@ -1033,19 +1154,19 @@ static void MVD_ParseServerData(mvd_t *mvd, int extrabits)
     }
 
     // parse world model
-    string = mvd->configstrings[CS_MODELS + 1];
-    len = strlen(string);
+    model = mvd->configstrings[CS_MODELS + 1];
+    len = strlen(model);
     if (len <= 9) {
-        MVD_Destroyf(mvd, "Bad world model: %s", string);
+        MVD_Destroyf(mvd, "Bad world model: %s", model);
     }
-    memcpy(mvd->mapname, string + 5, len - 9);   // skip "maps/"
+    memcpy(mvd->mapname, model + 5, len - 9);   // skip "maps/"
     mvd->mapname[len - 9] = 0; // cut off ".bsp"
 
     // load the world model (we are only interesed in visibility info)
-    Com_Printf("[%s] -=- Loading %s...\n", mvd->name, string);
-    ret = CM_LoadMap(&mvd->cm, string);
+    Com_Printf("[%s] -=- Loading %s...\n", mvd->name, model);
+    ret = CM_LoadMap(&mvd->cm, model);
     if (ret) {
-        Com_EPrintf("[%s] =!= Couldn't load %s: %s\n", mvd->name, string, Q_ErrorString(ret));
+        Com_EPrintf("[%s] =!= Couldn't load %s: %s\n", mvd->name, model, Q_ErrorString(ret));
         // continue with null visibility
     }
 #if USE_MAPCHECKSUM
@@ -1072,7 +1193,7 @@ static void MVD_ParseServerData(mvd_t *mvd, int extrabits)
     MVD_ParseFrame(mvd);
 
     // save base configstrings
-    memcpy(mvd->baseconfigstrings, mvd->configstrings, sizeof(mvd->baseconfigstrings));
+    save_base_configstrings(mvd);
 
     // force inital snapshot
     mvd->last_snapshot = INT_MIN;
@@ -86,7 +86,7 @@ static int write_level_file(void)
 {
     char        name[MAX_OSPATH];
     int         i;
-    char        *s;
+    const char  *s;
     size_t      len;
     byte        portalbits[MAX_MAP_PORTAL_BYTES];
     qerror_t    ret;
@@ -97,7 +97,7 @@ static int write_level_file(void)
 
     // write configstrings
     for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        s = sv.configstrings[i];
+        s = Com_ConfigstringSlot(sv.configstrings, i);
         if (!s[0])
             continue;
 
@@ -403,6 +403,7 @@ static int read_server_file(void)
 static int read_level_file(void)
 {
     char    name[MAX_OSPATH];
+    char    string[CS_MAXSIZE];
     size_t  len, maxlen;
     int     index;
 
@@ -434,9 +435,11 @@ static int read_level_file(void)
             Com_Error(ERR_DROP, "Bad savegame configstring index");
 
         maxlen = CS_SIZE(index);
-        len = MSG_ReadString(sv.configstrings[index], maxlen);
+        len = MSG_ReadString(string, maxlen);
         if (len >= maxlen)
             Com_Error(ERR_DROP, "Savegame configstring too long");
+
+        Com_SetConfigstring(sv.configstrings, index, string, len);
     }
 
     len = MSG_ReadByte();
@@ -161,7 +161,7 @@ typedef struct {
     cm_t        cm;
     char        *entitystring;
 
-    char        configstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
+    const char  *configstrings[MAX_CONFIGSTRINGS];  // interned
 
     server_entity_t entities[MAX_EDICTS];
 
@@ -273,13 +273,13 @@ typedef struct client_s {
 
     // userinfo
     char            userinfo[MAX_INFO_STRING];  // name, etc
-    char            name[MAX_CLIENT_NAME];      // extracted from userinfo, high bits masked
+    const char      *name;      // extracted from userinfo, high bits masked, interned
     int             messagelevel;               // for filtering printed messages
     size_t          rate;
     ratelimit_t     ratelimit_namechange;       // for suppressing "foo changed name" flood
 
     // console var probes
-    char            *version_string;
+    const char      *version_string;    // interned
     char            reconnect_var[16];
     char            reconnect_val[16];
     int             console_queries;
@@ -312,6 +312,7 @@ typedef struct client_s {
     unsigned        send_time, send_delta;          // used to rate drop async packets
 
     // current download
+    struct sv_download_s    *downloadfile;  // shared file contents
     byte            *download;      // file being downloaded
     int             downloadsize;   // total bytes (can't use EOF because of paks)
     int             downloadcount;  // bytes sent
@@ -340,7 +341,7 @@ typedef struct client_s {
     entity_packed_t *baselines[SV_BASELINES_CHUNKS];
 
     // server state pointers (hack for MVD channels implementation)
-    char            *configstrings;
+    const char      **configstrings;
     char            *gamedir, *mapname;
     edict_pool_t    *pool;
     cm_t            *cm;
@@ -449,6 +450,19 @@ typedef struct {
 #define FOR_EACH_MASTER_SAFE(m, n) \
     LIST_FOR_EACH_SAFE(master_t, m, n, &sv_masterlist, entry)
 
+// number of encoded entity deltas remembered for reuse across clients,
+// must be power of two
+#define DELTA_CACHE_SIZE    4096
+
+typedef struct {
+    uint32_t        hash;
+    msgEsFlags_t    flags;
+    unsigned        size;
+    entity_packed_t from;
+    entity_packed_t to;
+    byte            data[MAX_ENTITY_DELTA];
+} delta_cache_t;
+
 typedef struct server_static_s {
     qboolean    initialized;        // sv_init has completed
     unsigned    realtime;           // always increasing, no clamping, etc
@@ -459,6 +473,11 @@ typedef struct server_static_s {
     unsigned        next_entity;    // next state to use
     entity_packed_t *entities;      // [num_entities]
 
+    delta_cache_t   *delta_cache;   // [DELTA_CACHE_SIZE], allocated on demand
+    uint64_t        delta_hits;
+    uint64_t        delta_misses;
+    uint64_t        delta_bytes;    // bytes copied from cache
+
 #if USE_ZLIB
     z_stream        z;  // for compressing messages at once
 #endif
@@ -505,6 +524,8 @@ extern cvar_t       *sv_debug;
 extern cvar_t       *sv_pad_packets;
 #endif
 extern cvar_t       *sv_novis;
+extern cvar_t       *sv_delta_cache;
+extern cvar_t       *sv_download_cache;
 extern cvar_t       *sv_lan_force_rate;
 extern cvar_t       *sv_calcpings_method;
 extern cvar_t       *sv_changemapcmd;
@@ -570,6 +591,7 @@ void SV_zfree(voidpf opaque, voidpf address);
 //
 // sv_init.c
 //
+void SV_ClearState(void);
 void SV_ClientReset(client_t *client);
 void SV_SpawnServer(mapcmd_t *cmd);
 qboolean SV_ParseMapCmd(mapcmd_t *cmd);
@@ -692,6 +714,13 @@ void SV_New_f(void);
 void SV_Begin_f(void);
 void SV_ExecuteClientMessage(client_t *cl);
 void SV_CloseDownload(client_t *client);
+void SV_ShutdownDownloads(void);
+#if USE_ZLIB
+void SV_FlushGamestates(void);
+#else
+#define SV_FlushGamestates()    (void)0
+#endif
+void SV_DownloadStats_f(void);
 #if USE_FPS
 void SV_AlignKeyFrames(client_t *client);
 #else
@@ -720,6 +749,10 @@ void SV_PrintMiscInfo(void);
 
 void SV_BuildProxyClientFrame(client_t *client);
 void SV_BuildClientFrame(client_t *client);
+void SV_WriteDeltaEntity(const entity_packed_t *from,
+                         const entity_packed_t *to,
+                         msgEsFlags_t flags);
+void SV_DeltaStats_f(void);
 void SV_WriteFrameToClient_Default(client_t *client);
 void SV_WriteFrameToClient_Enhanced(client_t *client);
 
@@ -89,12 +89,12 @@ static void create_baselines(void)
 static void write_plain_configstrings(void)
 {
     int     i;
-    char    *string;
+    const char  *string;
     size_t  length;
 
     // write a packet full of data
-    string = sv_client->configstrings;
-    for (i = 0; i < MAX_CONFIGSTRINGS; i++, string += MAX_QPATH) {
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        string = Com_ConfigstringSlot(sv_client->configstrings, i);
         if (!string[0]) {
             continue;
         }
@@ -157,20 +157,201 @@ static void write_plain_baselines(void)
 
 #if USE_ZLIB
 
+/*
+=============================================================================
+
+Compressed gamestate cache
+
+When a map changes every client reconnects at once and receives the same
+configstrings and baselines, so compressed output is remembered and copied
+to later clients instead of running deflate again. An entry is used only if
+the client would have compressed exactly the same input: baselines are
+compared in full, along with the entity flags each baseline is written with,
+which capture any protocol differences. Configstrings are interned, so the
+entry keeps a table of references and compares it by pointer.
+
+=============================================================================
+*/
+
+#define MAX_GAMESTATES  4
+
+typedef enum {
+    GS_GAMESTATE,       // single svc_gamestate zpacket
+    GS_CONFIGSTRINGS    // series of svc_configstring zpackets
+} gamestate_type_t;
+
+typedef struct {
+    entity_packed_t base;
+    msgEsFlags_t    flags;
+} gamestate_baseline_t;
+
+typedef struct {
+    list_t          entry;
+    gamestate_type_t type;
+    size_t          maxpacketlen;
+    int             num_baselines;
+    gamestate_baseline_t *baselines;
+    const char      *configstrings[MAX_CONFIGSTRINGS];
+    unsigned        hits;
+    size_t          size;
+    byte            *data;
+} gamestate_t;
+
+static LIST_DECL(sv_gamestates);    // most recently used first
+static int      sv_num_gamestates;
+
+static gamestate_baseline_t gs_baselines[MAX_EDICTS];
+static int      gs_num_baselines;
+
+// compressed output being recorded for the cache
+static byte     *gs_record;
+static size_t   gs_record_size;
+static size_t   gs_record_maxsize;
+
+static void free_gamestate(gamestate_t *gs)
+{
+    List_Remove(&gs->entry);
+    sv_num_gamestates--;
+    Com_ClearConfigstrings(gs->configstrings);
+    Z_Free(gs->baselines);
+    Z_Free(gs->data);
+    Z_Free(gs);
+}
+
+void SV_FlushGamestates(void)
+{
+    gamestate_t *gs, *next;
+
+    LIST_FOR_EACH_SAFE(gamestate_t, gs, next, &sv_gamestates, entry) {
+        free_gamestate(gs);
+    }
+
+    Z_Free(gs_record);
+    gs_record = NULL;
+    gs_record_size = gs_record_maxsize = 0;
+}
+
+static void collect_baselines(void)
+{
+    gamestate_baseline_t *gb = gs_baselines;
+    entity_packed_t *base;
+    int i, j;
+
+    for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
+        base = sv_client->baselines[i];
+        if (!base) {
+            continue;
+        }
+        for (j = 0; j < SV_BASELINES_PER_CHUNK; j++) {
+            if (base->number) {
+                gb->base = *base;
+                gb->flags = sv_client->esFlags | MSG_ES_FORCE;
+                if (Q2PRO_SHORTANGLES(sv_client, base->number)) {
+                    gb->flags |= MSG_ES_SHORTANGLES;
+                }
+                gb++;
+            }
+            base++;
+        }
+    }
+
+    gs_num_baselines = gb - gs_baselines;
+}
+
+static gamestate_t *find_gamestate(gamestate_type_t type, size_t maxpacketlen)
+{
+    gamestate_t *gs;
+
+    LIST_FOR_EACH(gamestate_t, gs, &sv_gamestates, entry) {
+        if (gs->type != type)
+            continue;
+        if (gs->maxpacketlen != maxpacketlen)
+            continue;
+        if (gs->num_baselines != gs_num_baselines)
+            continue;
+        if (memcmp(gs->baselines, gs_baselines, sizeof(gs_baselines[0]) * gs_num_baselines))
+            continue;
+        if (memcmp(gs->configstrings, sv_client->configstrings, sizeof(gs->configstrings)))
+            continue;
+
+        // move to the front of LRU list
+        List_Remove(&gs->entry);
+        List_Insert(&sv_gamestates, &gs->entry);
+
+        gs->hits++;
+        SV_DPrintf(0, "%s: cached gamestate, %"PRIz" bytes, %u hits\n",
+                   sv_client->name, gs->size, gs->hits);
+        return gs;
+    }
+
+    return NULL;
+}
+
+static void record_gamestate(const void *data, size_t len)
+{
+    if (gs_record_size + len > gs_record_maxsize) {
+        gs_record_maxsize = gs_record_size + len + MAX_MSGLEN;
+        gs_record = Z_Realloc(gs_record, gs_record_maxsize);
+    }
+
+    memcpy(gs_record + gs_record_size, data, len);
+    gs_record_size += len;
+}
+
+static void cache_gamestate(gamestate_type_t type, size_t maxpacketlen)
+{
+    gamestate_t *gs;
+
+    if (!gs_record_size) {
+        return;
+    }
+
+    if (sv_num_gamestates >= MAX_GAMESTATES) {
+        gs = LIST_LAST(gamestate_t, &sv_gamestates, entry);
+        free_gamestate(gs);
+    }
+
+    gs = SV_Mallocz(sizeof(*gs));
+    gs->type = type;
+    gs->maxpacketlen = maxpacketlen;
+    gs->num_baselines = gs_num_baselines;
+    gs->baselines = SV_Malloc(sizeof(gs_baselines[0]) * gs_num_baselines + 1);
+    memcpy(gs->baselines, gs_baselines, sizeof(gs_baselines[0]) * gs_num_baselines);
+    Com_CopyConfigstrings(gs->configstrings, sv_client->configstrings);
+    gs->hits = 0;
+    gs->size = gs_record_size;
+    gs->data = SV_Malloc(gs_record_size);
+    memcpy(gs->data, gs_record, gs_record_size);
+
+    List_Insert(&sv_gamestates, &gs->entry);
+    sv_num_gamestates++;
+
+    gs_record_size = 0;
+}
+
 static void write_compressed_gamestate(void)
 {
     sizebuf_t   *buf = &sv_client->netchan->message;
-    entity_packed_t  *base;
-    int         i, j;
-    size_t      length;
+    gamestate_baseline_t *gb;
+    gamestate_t *gs;
+    int         i;
+    size_t      length, start;
     uint8_t     *patch;
-    char        *string;
+    const char  *string;
+
+    collect_baselines();
+
+    gs = find_gamestate(GS_GAMESTATE, 0);
+    if (gs && gs->size <= buf->maxsize - buf->cursize) {
+        SZ_Write(buf, gs->data, gs->size);
+        return;
+    }
 
     MSG_WriteByte(svc_gamestate);
 
     // write configstrings
-    string = sv_client->configstrings;
-    for (i = 0; i < MAX_CONFIGSTRINGS; i++, string += MAX_QPATH) {
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        string = Com_ConfigstringSlot(sv_client->configstrings, i);
         if (!string[0]) {
             continue;
         }
@@ -186,20 +367,13 @@ static void write_compressed_gamestate(void)
     MSG_WriteShort(MAX_CONFIGSTRINGS);   // end of configstrings
 
     // write baselines
-    for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
-        base = sv_client->baselines[i];
-        if (!base) {
-            continue;
-        }
-        for (j = 0; j < SV_BASELINES_PER_CHUNK; j++) {
-            if (base->number) {
-                write_baseline(base);
-            }
-            base++;
-        }
+    for (i = 0, gb = gs_baselines; i < gs_num_baselines; i++, gb++) {
+        MSG_WriteDeltaEntity(NULL, &gb->base, gb->flags);
     }
     MSG_WriteShort(0);   // end of baselines
 
+    gs_record_size = 0;
+    start = buf->cursize;
     SZ_WriteByte(buf, svc_zpacket);
     patch = SZ_GetSpace(buf, 2);
     SZ_WriteShort(buf, msg_write.cursize);
@@ -222,10 +396,14 @@ static void write_compressed_gamestate(void)
     patch[0] = svs.z.total_out & 255;
     patch[1] = (svs.z.total_out >> 8) & 255;
     buf->cursize += svs.z.total_out;
+
+    record_gamestate(buf->data + start, buf->cursize - start);
+    cache_gamestate(GS_GAMESTATE, 0);
 }
 
 static inline int z_flush(byte *buffer)
 {
+    byte length[2];
     int ret;
 
     ret = deflate(&svs.z, Z_FINISH);
@@ -241,6 +419,12 @@ static inline int z_flush(byte *buffer)
     MSG_WriteShort(svs.z.total_in);
     MSG_WriteData(buffer, svs.z.total_out);
 
+    // remember each packet prefixed with its length
+    length[0] = msg_write.cursize & 255;
+    length[1] = (msg_write.cursize >> 8) & 255;
+    record_gamestate(length, 2);
+    record_gamestate(msg_write.data, msg_write.cursize);
+
     SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
 
     return ret;
@@ -253,18 +437,42 @@ static inline void z_reset(byte *buffer)
     svs.z.avail_out = (uInt)(sv_client->netchan->maxpacketlen - 5);
 }
 
+static void write_cached_configstrings(const gamestate_t *gs)
+{
+    const byte *data = gs->data;
+    size_t len;
+
+    while (data < gs->data + gs->size) {
+        len = data[0] | (data[1] << 8);
+        MSG_WriteData(data + 2, len);
+        SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
+        data += 2 + len;
+    }
+}
+
 static void write_compressed_configstrings(void)
 {
     int     i;
     size_t  length;
     byte    buffer[MAX_PACKETLEN_WRITABLE];
-    char    *string;
+    const char  *string;
+    gamestate_t *gs;
+
+    // baselines are sent uncompressed
+    gs_num_baselines = 0;
 
+    gs = find_gamestate(GS_CONFIGSTRINGS, sv_client->netchan->maxpacketlen);
+    if (gs) {
+        write_cached_configstrings(gs);
+        return;
+    }
+
+    gs_record_size = 0;
     z_reset(buffer);
 
     // write a packet full of data
-    string = sv_client->configstrings;
-    for (i = 0; i < MAX_CONFIGSTRINGS; i++, string += MAX_QPATH) {
+    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
+        string = Com_ConfigstringSlot(sv_client->configstrings, i);
         if (!string[0]) {
             continue;
         }
@@ -300,7 +508,11 @@ static void write_compressed_configstrings(void)
     if (z_flush(buffer) != Z_STREAM_END) {
 fail:
         SV_DropClient(sv_client, "deflate() failed on configstrings");
+        gs_record_size = 0;
+        return;
     }
+
+    cache_gamestate(GS_CONFIGSTRINGS, sv_client->netchan->maxpacketlen);
 }
 
 #endif // USE_ZLIB
@@ -408,7 +620,7 @@ void SV_New_f(void)
         MSG_WriteShort(-1);
     else
         MSG_WriteShort(sv_client->slot);
-    MSG_WriteString(&sv_client->configstrings[CS_NAME * MAX_QPATH]);
+    MSG_WriteString(sv_client->configstrings[CS_NAME]);
 
     // send protocol specific stuff
     switch (sv_client->protocol) {
@@ -542,12 +754,145 @@ void SV_Begin_f(void)
 
 //=============================================================================
 
+/*
+=============================================================================
+
+Download cache
+
+Every file being downloaded is loaded once and shared by all clients
+downloading it, keyed by path and transfer mode (raw or deflated). Cached
+contents are reused only while size and modification times of the file
+(or the pack containing it) stay the same. Files
+nobody downloads anymore are kept around for the next client until total
+size exceeds sv_download_cache megabytes, then least recently used files
+are freed first.
+
+=============================================================================
+*/
+
+typedef struct sv_download_s {
+    list_t      entry;
+    unsigned    refcount;
+    int         cmd;        // svc_(z)download
+    size_t      size;
+    time_t      mtime;
+    time_t      ctime;
+    byte        *data;
+    unsigned    hits;
+    char        name[1];
+} sv_download_t;
+
+static LIST_DECL(sv_downloads);     // least recently used first
+static size_t   sv_downloads_size;
+static unsigned sv_downloads_hits;
+static unsigned sv_downloads_misses;
+static size_t   sv_downloads_saved;
+
+static void free_download(sv_download_t *d)
+{
+    List_Remove(&d->entry);
+    sv_downloads_size -= d->size;
+    Z_Free(d->data);
+    Z_Free(d);
+}
+
+static void evict_downloads(void)
+{
+    sv_download_t *d, *next;
+    size_t limit;
+
+    limit = (size_t)Cvar_ClampInteger(sv_download_cache, 0, 4096) << 20;
+
+    LIST_FOR_EACH_SAFE(sv_download_t, d, next, &sv_downloads, entry) {
+        if (sv_downloads_size <= limit)
+            break;
+        if (!d->refcount)
+            free_download(d);
+    }
+}
+
+static sv_download_t *find_download(const char *name, int cmd, const file_info_t *info)
+{
+    sv_download_t *d, *next;
+
+    LIST_FOR_EACH_SAFE(sv_download_t, d, next, &sv_downloads, entry) {
+        if (d->cmd != cmd || FS_pathcmp(d->name, name))
+            continue;
+
+        // file changed on disk since it was cached. replacing a file with
+        // rename() changes ctime even if mtime was preserved.
+        if (d->size != info->size || d->mtime != info->mtime || d->ctime != info->ctime) {
+            if (!d->refcount)
+                free_download(d);
+            continue;
+        }
+
+        // move to the end of LRU list
+        List_Remove(&d->entry);
+        List_Append(&sv_downloads, &d->entry);
+        return d;
+    }
+
+    return NULL;
+}
+
+static sv_download_t *load_download(const char *name, int cmd, size_t size, qhandle_t f)
+{
+    sv_download_t *d;
+    file_info_t info;
+    size_t len;
+    ssize_t result;
+
+    // don't share contents if it can't be told whether they are current
+    if (FS_FileInfo(f, &info)) {
+        info.mtime = info.ctime = -1;
+        d = NULL;
+    } else {
+        info.size = size;
+        d = find_download(name, cmd, &info);
+    }
+
+    if (d) {
+        d->hits++;
+        sv_downloads_hits++;
+        sv_downloads_saved += size;
+        d->refcount++;
+        return d;
+    }
+
+    len = strlen(name);
+    d = SV_Malloc(sizeof(*d) + len);
+    memcpy(d->name, name, len + 1);
+    d->data = SV_Malloc(size);
+    result = FS_Read(d->data, size, f);
+    if (result != size) {
+        Z_Free(d->data);
+        Z_Free(d);
+        return NULL;
+    }
+
+    d->refcount = 1;
+    d->cmd = cmd;
+    d->size = size;
+    d->mtime = info.mtime;
+    d->ctime = info.ctime;
+    d->hits = 0;
+    List_Append(&sv_downloads, &d->entry);
+    sv_downloads_size += size;
+    sv_downloads_misses++;
+
+    evict_downloads();
+    return d;
+}
+
 void SV_CloseDownload(client_t *client)
 {
-    if (client->download) {
-        Z_Free(client->download);
-        client->download = NULL;
+    if (client->downloadfile) {
+        client->downloadfile->refcount--;
+        client->downloadfile = NULL;
+        evict_downloads();
     }
+    client->download = NULL;
     if (client->downloadname) {
         Z_Free(client->downloadname);
         client->downloadname = NULL;
@@ -558,6 +903,39 @@ void SV_CloseDownload(client_t *client)
     client->downloadpending = qfalse;
 }
 
+void SV_ShutdownDownloads(void)
+{
+    sv_download_t *d, *next;
+
+    LIST_FOR_EACH_SAFE(sv_download_t, d, next, &sv_downloads, entry) {
+        free_download(d);
+    }
+}
+
+void SV_DownloadStats_f(void)
+{
+    sv_download_t *d;
+    char buffer[16];
+
+    if (LIST_EMPTY(&sv_downloads)) {
+        Com_Printf("No files in download cache.\n");
+    } else {
+        Com_Printf("refs hits  size   mode name\n"
+                   "---- ---- ------- ---- --------------------\n");
+        LIST_FOR_EACH(sv_download_t, d, &sv_downloads, entry) {
+            Com_FormatSize(buffer, sizeof(buffer), d->size);
+            Com_Printf("%4u %4u %7s %-4s %s\n", d->refcount, d->hits, buffer,
+                       d->cmd == svc_zdownload ? "zlib" : "raw", d->name);
+        }
+    }
+
+    Com_FormatSizeLong(buffer, sizeof(buffer), sv_downloads_size);
+    Com_Printf("%s cached, %u loads, %u shared", buffer,
+               sv_downloads_misses, sv_downloads_hits);
+    Com_FormatSizeLong(buffer, sizeof(buffer), sv_downloads_saved);
+    Com_Printf(" (%s not reloaded)\n", buffer);
+}
+
 /*
 ==================
 SV_NextDownload_f
@@ -579,9 +957,9 @@ SV_BeginDownload_f
 static void SV_BeginDownload_f(void)
 {
     char    name[MAX_QPATH];
-    byte    *download;
+    sv_download_t   *download;
     int     downloadcmd;
-    ssize_t downloadsize, maxdownloadsize, result;
+    ssize_t downloadsize, maxdownloadsize;
     int     offset = 0;
     cvar_t  *allow;
     size_t  len;
@@ -710,16 +1088,16 @@ static void SV_BeginDownload_f(void)
         return;
     }
 
-    download = SV_Malloc(downloadsize);
-    result = FS_Read(download, downloadsize, f);
-    if (result != downloadsize) {
+    download = load_download(name, downloadcmd, downloadsize, f);
+    if (!download) {
         Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
-        goto fail3;
+        goto fail2;
     }
 
     FS_FCloseFile(f);
 
-    sv_client->download = download;
+    sv_client->downloadfile = download;
+    sv_client->download = download->data;
     sv_client->downloadsize = downloadsize;
     sv_client->downloadcount = offset;
     sv_client->downloadname = SV_CopyString(name);
@@ -729,8 +1107,6 @@ static void SV_BeginDownload_f(void)
     Com_DPrintf("Downloading %s to %s\n", name, sv_client->name);
     return;
 
-fail3:
-    Z_Free(download);
 fail2:
     FS_FCloseFile(f);
 fail1:
@@ -883,7 +1259,7 @@ static void SV_CvarResult_f(void)
                 Com_Printf("%s[%s]: %s\n", sv_client->name,
                            NET_AdrToString(&sv_client->netchan->remote_address), v);
             }
-            sv_client->version_string = SV_CopyString(v);
+            sv_client->version_string = Z_InternString(v);
         }
     } else if (!strcmp(c, "connect")) {
         if (sv_client->reconnect_var[0]) {
@@ -1079,9 +1455,10 @@ static void SV_SetLastFrame(int lastframe)
             frame = &sv_client->frames[lastframe & UPDATE_MASK];
 
             if (frame->number == lastframe) {
-                // save time for ping calc
-                if (frame->sentTime <= com_eventTime)
-                    frame->latency = com_eventTime - frame->sentTime;
+                // save time for ping calc, using time of packet arrival
+                // rather than time of processing
+                if (frame->sentTime <= net_rcvtime)
+                    frame->latency = net_rcvtime - frame->sentTime;
             }
         }
 
@@ -705,6 +705,20 @@ char *Q_strcasestr(const char *s1, const char *s2)
     return NULL;
 }
 
+/*
+===============
+Q_strnlen
+
+Returns length of the string, but no more than maxlen.
+===============
+*/
+size_t Q_strnlen(const char *s, size_t maxlen)
+{
+    const char *p = memchr(s, 0, maxlen);
+
+    return p ? p - s : maxlen;
+}
+
 /*
 ===============
 Q_strlcpy
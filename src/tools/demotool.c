@@ -0,0 +1,1317 @@
+/*
+Copyright (C) 2026 Quake II RTX contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// demotool.c -- offline .dm2/.mvd2 analysis
+//
+// Decodes demos without the client or server, using the same delta
+// decoders as the engine (common/msg.c). Demo files are mapped into
+// memory and parsed in place, and each demo is handled by a separate
+// worker process so that batches scale across cores.
+//
+// Output is one tab separated file per field group and demo, named
+// <demo>.<group>.tsv, each starting with a header line of column names:
+//
+// names    frame client name                   player name change
+// players  frame client x y z frags health     player position
+// events   frame entity event                  entity event
+// tents    frame type x y z                    temp entity
+// flashes  frame entity weapon                 muzzle flash
+// sounds   frame entity sound                  sound
+//
+// Frags and health are only known for players whose player_state_t is
+// present in the demo (all players for MVD, POV player for client
+// demos), '-' is written for the rest.
+//
+
+#include "shared/shared.h"
+#include "common/msg.h"
+#include "common/protocol.h"
+#include "common/sizebuf.h"
+
+#include <setjmp.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    qboolean        valid;
+    int             number;
+    int             delta;
+    int             firstEntity;
+    int             numEntities;
+    player_state_t  ps;
+} dframe_t;
+
+typedef struct {
+    const char      *path;
+
+    int             protocol;
+    int             clientNum;
+    int             maxclients;
+    int             framenum;
+    int             numframes;
+
+    char            configstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
+
+    // client demos
+    entity_state_t  baselines[MAX_EDICTS];
+    entity_state_t  entityStates[MAX_PARSE_ENTITIES];
+    int             numEntityStates;
+    dframe_t        frames[UPDATE_BACKUP];
+    dframe_t        frame;
+
+    // MVD demos
+    entity_state_t  edicts[MAX_EDICTS];
+    qboolean        inuse[MAX_EDICTS];
+    int             numedicts;
+    player_state_t  players[MAX_CLIENTS];
+    qboolean        playerinuse[MAX_CLIENTS];
+} demo_t;
+
+static demo_t   demo;
+
+static jmp_buf  demo_abort;
+static char     demo_error[MAX_STRING_CHARS];
+
+/*
+==============================================================================
+
+ENGINE STUBS
+
+==============================================================================
+*/
+
+void Com_LPrintf(print_type_t type, const char *fmt, ...)
+{
+    va_list argptr;
+
+    if (type == PRINT_DEVELOPER)
+        return;
+
+    va_start(argptr, fmt);
+    vfprintf(stderr, fmt, argptr);
+    va_end(argptr);
+}
+
+// errors raised by msg.c or the parser abort the current demo only
+void Com_Error(error_type_t code, const char *fmt, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, fmt);
+    Q_vsnprintf(demo_error, sizeof(demo_error), fmt, argptr);
+    va_end(argptr);
+
+    longjmp(demo_abort, 1);
+}
+
+/*
+==============================================================================
+
+OUTPUT
+
+==============================================================================
+*/
+
+// each field group goes into its own file, so that columns have a fixed
+// meaning and can be loaded without splitting records by type
+typedef enum {
+    OUT_NAMES,
+    OUT_PLAYERS,
+    OUT_EVENTS,
+    OUT_TENTS,
+    OUT_FLASHES,
+    OUT_SOUNDS,
+
+    OUT_TOTAL
+} outgroup_t;
+
+// records are formatted by hand into a flat buffer, stdio formatting
+// costs several times more than decoding the demo itself
+typedef struct {
+    const char  *name;
+    const char  *columns;
+    FILE        *fp;
+    size_t      len;
+    char        buf[0x10000];
+} output_t;
+
+static output_t outputs[OUT_TOTAL] = {
+    { "names",   "frame\tclient\tname" },
+    { "players", "frame\tclient\tx\ty\tz\tfrags\thealth" },
+    { "events",  "frame\tentity\tevent" },
+    { "tents",   "frame\ttype\tx\ty\tz" },
+    { "flashes", "frame\tentity\tweapon" },
+    { "sounds",  "frame\tentity\tsound" },
+};
+
+static void out_flush(output_t *out)
+{
+    fwrite(out->buf, 1, out->len, out->fp);
+    out->len = 0;
+}
+
+static void out_printf(output_t *out, const char *fmt, ...)
+{
+    va_list argptr;
+
+    if (out->len > sizeof(out->buf) - MAX_STRING_CHARS)
+        out_flush(out);
+
+    va_start(argptr, fmt);
+    out->len += Q_vscnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, argptr);
+    va_end(argptr);
+}
+
+static char *out_uint(char *p, unsigned v)
+{
+    char tmp[16];
+    int n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+    } while (v /= 10);
+
+    while (n)
+        *p++ = tmp[--n];
+
+    return p;
+}
+
+static char *out_int(char *p, int v)
+{
+    *p++ = '\t';
+    if (v < 0) {
+        *p++ = '-';
+        return out_uint(p, -(unsigned)v);
+    }
+    return out_uint(p, v);
+}
+
+// coordinates are always multiples of 1/8 on the wire
+static char *out_coord(char *p, int v)
+{
+    static const char frac[8][5] = {
+        "", ".125", ".25", ".375", ".5", ".625", ".75", ".875"
+    };
+    unsigned u = v;
+    const char *s;
+
+    *p++ = '\t';
+    if (v < 0) {
+        *p++ = '-';
+        u = -(unsigned)v;
+    }
+    p = out_uint(p, u >> 3);
+    for (s = frac[u & 7]; *s; s++)
+        *p++ = *s;
+
+    return p;
+}
+
+static char *out_begin(output_t *out)
+{
+    if (out->len > sizeof(out->buf) - MAX_STRING_CHARS)
+        out_flush(out);
+
+    return out_uint(out->buf + out->len, demo.framenum);
+}
+
+static void out_end(output_t *out, char *p)
+{
+    *p++ = '\n';
+    out->len = p - out->buf;
+}
+
+static void emit_player(int client, const player_state_t *ps, const vec3_t origin)
+{
+    output_t *out = &outputs[OUT_PLAYERS];
+    char *p = out_begin(out);
+
+    p = out_int(p, client);
+    if (ps) {
+        p = out_coord(p, ps->pmove.origin[0]);
+        p = out_coord(p, ps->pmove.origin[1]);
+        p = out_coord(p, ps->pmove.origin[2]);
+        p = out_int(p, ps->stats[STAT_FRAGS]);
+        p = out_int(p, ps->stats[STAT_HEALTH]);
+    } else {
+        p = out_coord(p, Q_rint(origin[0] * 8));
+        p = out_coord(p, Q_rint(origin[1] * 8));
+        p = out_coord(p, Q_rint(origin[2] * 8));
+        memcpy(p, "\t-\t-", 4);
+        p += 4;
+    }
+    out_end(out, p);
+}
+
+static void emit_event(const entity_state_t *ent)
+{
+    output_t *out = &outputs[OUT_EVENTS];
+    char *p;
+
+    if (!ent->event)
+        return;
+
+    p = out_begin(out);
+    p = out_int(p, ent->number);
+    p = out_int(p, ent->event);
+    out_end(out, p);
+}
+
+static void emit_pos(int type, const vec3_t pos)
+{
+    output_t *out = &outputs[OUT_TENTS];
+    char *p = out_begin(out);
+
+    p = out_int(p, type);
+    p = out_coord(p, Q_rint(pos[0] * 8));
+    p = out_coord(p, Q_rint(pos[1] * 8));
+    p = out_coord(p, Q_rint(pos[2] * 8));
+    out_end(out, p);
+}
+
+static void emit_entity(outgroup_t group, int entity, int value)
+{
+    output_t *out = &outputs[group];
+    char *p = out_begin(out);
+
+    p = out_int(p, entity);
+    p = out_int(p, value);
+    out_end(out, p);
+}
+
+static void update_configstring(int index)
+{
+    char *s, *p;
+
+    if (index < CS_PLAYERSKINS || index >= CS_PLAYERSKINS + MAX_CLIENTS)
+        return;
+
+    s = demo.configstrings[index];
+    p = strchr(s, '\\');
+    out_printf(&outputs[OUT_NAMES], "%d\t%d\t%.*s\n", demo.framenum,
+               index - CS_PLAYERSKINS, p ? (int)(p - s) : (int)strlen(s), s);
+}
+
+static void parse_configstring(int index)
+{
+    size_t len, maxlen;
+
+    if (index < 0 || index >= MAX_CONFIGSTRINGS) {
+        Com_Error(ERR_DROP, "%s: bad index: %d", __func__, index);
+    }
+
+    maxlen = CS_SIZE(index);
+    len = MSG_ReadString(demo.configstrings[index], maxlen);
+    if (len >= maxlen) {
+        Com_Error(ERR_DROP, "%s: index %d overflowed", __func__, index);
+    }
+
+    update_configstring(index);
+}
+
+static void parse_maxclients(void)
+{
+    demo.maxclients = atoi(demo.configstrings[CS_MAXCLIENTS]);
+    if (demo.maxclients < 1 || demo.maxclients > MAX_CLIENTS) {
+        Com_Error(ERR_DROP, "Invalid maxclients");
+    }
+}
+
+static void print_header(void)
+{
+    const char *s = demo.configstrings[CS_MODELS + 1];
+    size_t len = strlen(s);
+    int i;
+
+    // strip "maps/" and ".bsp"
+    if (len > 9) {
+        s += 5;
+        len -= 9;
+    }
+
+    for (i = 0; i < OUT_TOTAL; i++) {
+        out_printf(&outputs[i], "# protocol %d map %.*s maxclients %d\n",
+                   demo.protocol, (int)len, s, demo.maxclients);
+    }
+}
+
+/*
+==============================================================================
+
+EVENTS
+
+Shared by client demos and MVD multicast payloads.
+==============================================================================
+*/
+
+static void parse_temp_entity(void)
+{
+    tent_params_t te;
+
+    MSG_ParseTempEntity(&te);
+
+    emit_pos(te.type, te.pos1);
+}
+
+static void parse_muzzleflash(int mask)
+{
+    mz_params_t mz;
+
+    MSG_ParseMuzzleFlash(&mz, mask);
+
+    emit_entity(OUT_FLASHES, mz.entity, mz.weapon);
+}
+
+static void parse_sound(void)
+{
+    snd_params_t snd;
+
+    MSG_ParseStartSound(&snd);
+
+    emit_entity(OUT_SOUNDS, snd.entity, snd.index);
+}
+
+/*
+==============================================================================
+
+CLIENT DEMOS
+
+Mirrors CL_ParseServerMessage for protocol 34 demos, which is what all
+clients record regardless of the protocol used to connect.
+==============================================================================
+*/
+
+static void parse_client_delta(dframe_t *frame, int newnum, const entity_state_t *old, int bits)
+{
+    entity_state_t *state;
+
+    if (frame->numEntities >= MAX_EDICTS) {
+        Com_Error(ERR_DROP, "%s: MAX_EDICTS exceeded", __func__);
+    }
+
+    state = &demo.entityStates[demo.numEntityStates & PARSE_ENTITIES_MASK];
+    demo.numEntityStates++;
+    frame->numEntities++;
+
+    MSG_ParseDeltaEntity(old, state, newnum, bits, 0);
+}
+
+static const entity_state_t *next_old_entity(const dframe_t *oldframe, int oldindex, int *oldnum)
+{
+    const entity_state_t *oldstate;
+
+    if (!oldframe || oldindex >= oldframe->numEntities) {
+        *oldnum = 99999;
+        return NULL;
+    }
+
+    oldstate = &demo.entityStates[(oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK];
+    *oldnum = oldstate->number;
+    return oldstate;
+}
+
+static void parse_client_entities(const dframe_t *oldframe, dframe_t *frame)
+{
+    const entity_state_t *oldstate;
+    int newnum, bits, oldindex, oldnum;
+
+    frame->firstEntity = demo.numEntityStates;
+    frame->numEntities = 0;
+
+    oldindex = 0;
+    oldstate = next_old_entity(oldframe, oldindex, &oldnum);
+
+    while (1) {
+        newnum = MSG_ParseEntityBits(&bits);
+        if (newnum < 0 || newnum >= MAX_EDICTS) {
+            Com_Error(ERR_DROP, "%s: bad number: %d", __func__, newnum);
+        }
+
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+        }
+
+        if (!newnum) {
+            break;
+        }
+
+        while (oldnum < newnum) {
+            // one or more entities from the old packet are unchanged
+            parse_client_delta(frame, oldnum, oldstate, 0);
+            oldstate = next_old_entity(oldframe, ++oldindex, &oldnum);
+        }
+
+        if (bits & U_REMOVE) {
+            // the entity present in oldframe is not in the current frame
+            if (!oldframe) {
+                Com_Error(ERR_DROP, "%s: U_REMOVE with NULL oldframe", __func__);
+            }
+            oldstate = next_old_entity(oldframe, ++oldindex, &oldnum);
+            continue;
+        }
+
+        if (oldnum == newnum) {
+            // delta from previous state
+            parse_client_delta(frame, newnum, oldstate, bits);
+            oldstate = next_old_entity(oldframe, ++oldindex, &oldnum);
+            continue;
+        }
+
+        // delta from baseline
+        parse_client_delta(frame, newnum, &demo.baselines[newnum], bits);
+    }
+
+    // any remaining entities in the old frame are copied over
+    while (oldnum != 99999) {
+        parse_client_delta(frame, oldnum, oldstate, 0);
+        oldstate = next_old_entity(oldframe, ++oldindex, &oldnum);
+    }
+}
+
+static void emit_client_frame(const dframe_t *frame)
+{
+    const entity_state_t *ent;
+    int i;
+
+    emit_player(demo.clientNum, &frame->ps, NULL);
+
+    for (i = 0; i < frame->numEntities; i++) {
+        ent = &demo.entityStates[(frame->firstEntity + i) & PARSE_ENTITIES_MASK];
+        if (ent->number <= demo.maxclients && ent->number != demo.clientNum + 1 && ent->modelindex) {
+            emit_player(ent->number - 1, NULL, ent->origin);
+        }
+        emit_event(ent);
+    }
+}
+
+static void parse_client_frame(void)
+{
+    dframe_t    frame, *oldframe;
+    int         bits, length;
+
+    memset(&frame, 0, sizeof(frame));
+
+    frame.number = MSG_ReadLong();
+    frame.delta = MSG_ReadLong();
+
+    // BIG HACK to let old demos continue to work
+    if (demo.protocol != PROTOCOL_VERSION_OLD) {
+        MSG_ReadByte();
+    }
+
+    if (frame.delta > 0) {
+        oldframe = &demo.frames[frame.delta & UPDATE_MASK];
+        if (frame.delta != frame.number && oldframe->number == frame.delta && oldframe->valid &&
+            demo.numEntityStates - oldframe->firstEntity <= MAX_PARSE_ENTITIES - MAX_PACKET_ENTITIES) {
+            frame.valid = qtrue;
+        } else if (demo.frame.valid) {
+            // recover broken demo the same way client does
+            oldframe = &demo.frame;
+            frame.valid = qtrue;
+        }
+    } else {
+        oldframe = NULL;
+        frame.valid = qtrue;
+    }
+
+    // skip areabits
+    length = MSG_ReadByte();
+    if (length < 0 || msg_read.readcount + length > msg_read.cursize) {
+        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+    }
+    msg_read.readcount += length;
+
+    if (MSG_ReadByte() != svc_playerinfo) {
+        Com_Error(ERR_DROP, "%s: not playerinfo", __func__);
+    }
+
+    bits = MSG_ReadShort();
+    MSG_ParseDeltaPlayerstate_Default(oldframe ? &oldframe->ps : NULL, &frame.ps, bits);
+
+    if (MSG_ReadByte() != svc_packetentities) {
+        Com_Error(ERR_DROP, "%s: not packetentities", __func__);
+    }
+
+    parse_client_entities(oldframe, &frame);
+
+    demo.frames[frame.number & UPDATE_MASK] = frame;
+
+    if (!frame.valid) {
+        demo.frame.valid = qfalse;
+        return;
+    }
+
+    demo.frame = frame;
+    demo.framenum = frame.number;
+    demo.numframes++;
+
+    emit_client_frame(&frame);
+}
+
+static void parse_client_serverdata(void)
+{
+    char    levelname[MAX_QPATH];
+    int     protocol;
+
+    protocol = MSG_ReadLong();
+    if (protocol < PROTOCOL_VERSION_OLD || protocol > PROTOCOL_VERSION_DEFAULT) {
+        Com_Error(ERR_DROP, "Demo uses unsupported protocol version %d.", protocol);
+    }
+
+    memset(demo.configstrings, 0, sizeof(demo.configstrings));
+    memset(demo.baselines, 0, sizeof(demo.baselines));
+    memset(demo.frames, 0, sizeof(demo.frames));
+    demo.frame.valid = qfalse;
+    demo.protocol = protocol;
+
+    MSG_ReadLong();     // servercount
+    MSG_ReadByte();     // attractloop
+    MSG_ReadString(NULL, 0);    // gamedir
+    demo.clientNum = MSG_ReadShort();
+    MSG_ReadString(levelname, sizeof(levelname));
+}
+
+static void parse_client_message(void)
+{
+    int cmd, index, bits;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "%s: read past end of server message", __func__);
+        }
+
+        if ((cmd = MSG_ReadByte()) == -1) {
+            break;
+        }
+
+        switch (cmd) {
+        default:
+            Com_Error(ERR_DROP, "%s: illegible server message: %d", __func__, cmd);
+            break;
+
+        case svc_nop:
+        case svc_disconnect:
+        case svc_reconnect:
+            break;
+
+        case svc_print:
+            MSG_ReadByte();
+            // fall through
+        case svc_centerprint:
+        case svc_stufftext:
+        case svc_layout:
+            MSG_ReadString(NULL, 0);
+            break;
+
+        case svc_serverdata:
+            parse_client_serverdata();
+            break;
+
+        case svc_configstring:
+            index = MSG_ReadShort();
+            parse_configstring(index);
+            if (index == CS_MAXCLIENTS) {
+                parse_maxclients();
+            }
+            break;
+
+        case svc_sound:
+            parse_sound();
+            break;
+
+        case svc_spawnbaseline:
+            index = MSG_ParseEntityBits(&bits);
+            if (index < 1 || index >= MAX_EDICTS) {
+                Com_Error(ERR_DROP, "%s: bad baseline index: %d", __func__, index);
+            }
+            MSG_ParseDeltaEntity(NULL, &demo.baselines[index], index, bits, 0);
+            break;
+
+        case svc_temp_entity:
+            parse_temp_entity();
+            break;
+
+        case svc_muzzleflash:
+            parse_muzzleflash(MZ_SILENCED);
+            break;
+
+        case svc_muzzleflash2:
+            parse_muzzleflash(0);
+            break;
+
+        case svc_frame:
+            if (!demo.numframes) {
+                print_header();
+            }
+            parse_client_frame();
+            break;
+
+        case svc_inventory:
+            for (index = 0; index < MAX_ITEMS; index++) {
+                MSG_ReadShort();
+            }
+            break;
+        }
+    }
+}
+
+static void parse_client_demo(const byte *data, size_t size)
+{
+    size_t      pos;
+    uint32_t    msglen;
+
+    demo.maxclients = 1;
+
+    for (pos = 0; ; pos += msglen) {
+        if (pos + 4 > size) {
+            Com_Error(ERR_DROP, "Unexpected end of file");
+        }
+
+        msglen = (uint32_t)LittleLongMem(data + pos);
+        pos += 4;
+
+        // check for EOF packet
+        if (msglen == (uint32_t)-1) {
+            break;
+        }
+
+        if (msglen > MAX_MSGLEN || pos + msglen > size) {
+            Com_Error(ERR_DROP, "Bad message length: %u", msglen);
+        }
+
+        SZ_Init(&msg_read, (byte *)data + pos, msglen);
+        msg_read.cursize = msglen;
+
+        parse_client_message();
+    }
+}
+
+/*
+==============================================================================
+
+MVD DEMOS
+
+Mirrors MVD_ParseMessage.
+==============================================================================
+*/
+
+static void parse_mvd_entities(void)
+{
+    entity_state_t *ent;
+    int number, bits;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+        }
+
+        number = MSG_ParseEntityBits(&bits);
+        if (number < 0 || number >= MAX_EDICTS) {
+            Com_Error(ERR_DROP, "%s: bad number: %d", __func__, number);
+        }
+
+        if (!number) {
+            break;
+        }
+
+        ent = &demo.edicts[number];
+        MSG_ParseDeltaEntity(ent, ent, number, bits, 0);
+        demo.inuse[number] = !(bits & U_REMOVE);
+        if (number >= demo.numedicts) {
+            demo.numedicts = number + 1;
+        }
+    }
+}
+
+static void parse_mvd_players(void)
+{
+    int number, bits;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+        }
+
+        number = MSG_ReadByte();
+        if (number == CLIENTNUM_NONE) {
+            break;
+        }
+
+        if (number < 0 || number >= demo.maxclients) {
+            Com_Error(ERR_DROP, "%s: bad number: %d", __func__, number);
+        }
+
+        bits = MSG_ReadShort();
+        MSG_ParseDeltaPlayerstate_Packet(&demo.players[number], &demo.players[number], bits);
+        demo.playerinuse[number] = !(bits & PPS_REMOVE);
+    }
+}
+
+static void parse_mvd_frame(void)
+{
+    entity_state_t *ent;
+    int i, length;
+
+    // skip portalbits
+    length = MSG_ReadByte();
+    if (length < 0 || msg_read.readcount + length > msg_read.cursize) {
+        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+    }
+    msg_read.readcount += length;
+
+    parse_mvd_players();
+    parse_mvd_entities();
+
+    // effects that follow belong to this frame
+    demo.framenum = demo.numframes++;
+
+    for (i = 0; i < demo.maxclients; i++) {
+        if (demo.playerinuse[i] && i != demo.clientNum) {
+            emit_player(i, &demo.players[i], NULL);
+        }
+    }
+
+    for (i = 1, ent = demo.edicts + 1; i < demo.numedicts; i++, ent++) {
+        if (demo.inuse[i]) {
+            emit_event(ent);
+        }
+        // events are not delta compressed, unchanged entities are not
+        // transmitted and would keep the stale event otherwise
+        ent->event = 0;
+    }
+}
+
+static void parse_mvd_serverdata(void)
+{
+    int protocol, index;
+
+    protocol = MSG_ReadLong();
+    if (protocol != PROTOCOL_VERSION_MVD) {
+        Com_Error(ERR_DROP, "Unsupported protocol: %d", protocol);
+    }
+
+    protocol = MSG_ReadShort();
+    if (!MVD_SUPPORTED(protocol)) {
+        Com_Error(ERR_DROP, "Unsupported MVD protocol version: %d", protocol);
+    }
+
+    memset(demo.configstrings, 0, sizeof(demo.configstrings));
+    memset(demo.edicts, 0, sizeof(demo.edicts));
+    memset(demo.inuse, 0, sizeof(demo.inuse));
+    demo.numedicts = 0;
+    memset(demo.players, 0, sizeof(demo.players));
+    memset(demo.playerinuse, 0, sizeof(demo.playerinuse));
+    demo.protocol = PROTOCOL_VERSION_MVD;
+
+    MSG_ReadLong();     // servercount
+    MSG_ReadString(NULL, 0);    // gamedir
+    demo.clientNum = MSG_ReadShort();
+
+    while (1) {
+        index = MSG_ReadShort();
+        if (index == MAX_CONFIGSTRINGS) {
+            break;
+        }
+        parse_configstring(index);
+
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "Read past end of message");
+        }
+    }
+
+    parse_maxclients();
+    if (demo.clientNum != -1 && (demo.clientNum < 0 || demo.clientNum >= demo.maxclients)) {
+        Com_Error(ERR_DROP, "Invalid client num: %d", demo.clientNum);
+    }
+
+    print_header();
+
+    // parse baseline frame
+    parse_mvd_frame();
+}
+
+// multicast payload is a sequence of regular svc_* messages, decode
+// the ones we are interested in and skip the rest
+static void parse_mvd_multicast(mvd_ops_t op, int extrabits)
+{
+    size_t  length, last, cursize;
+    int     cmd;
+
+    length = MSG_ReadByte();
+    length |= extrabits << 8;
+
+    if (op != mvd_multicast_all && op != mvd_multicast_all_r) {
+        MSG_ReadWord();     // leafnum
+    }
+
+    last = msg_read.readcount + length;
+    if (last > msg_read.cursize) {
+        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+    }
+
+    cursize = msg_read.cursize;
+    msg_read.cursize = last;
+
+    while (msg_read.readcount < last) {
+        cmd = MSG_ReadByte();
+        if (cmd == svc_temp_entity) {
+            parse_temp_entity();
+        } else if (cmd == svc_muzzleflash) {
+            parse_muzzleflash(MZ_SILENCED);
+        } else if (cmd == svc_muzzleflash2) {
+            parse_muzzleflash(0);
+        } else {
+            break;
+        }
+    }
+
+    if (msg_read.readcount > last) {
+        Com_Error(ERR_DROP, "%s: read past end of multicast", __func__);
+    }
+
+    msg_read.readcount = last;
+    msg_read.cursize = cursize;
+}
+
+static void parse_mvd_unicast(int extrabits)
+{
+    size_t length;
+
+    length = MSG_ReadByte();
+    length |= extrabits << 8;
+    MSG_ReadByte();     // clientNum
+
+    if (msg_read.readcount + length > msg_read.cursize) {
+        Com_Error(ERR_DROP, "%s: read past end of message", __func__);
+    }
+    msg_read.readcount += length;
+}
+
+static void parse_mvd_sound(void)
+{
+    int flags, index, entity;
+
+    flags = MSG_ReadByte();
+    index = MSG_ReadByte();
+
+    if (flags & SND_VOLUME)
+        MSG_ReadByte();
+    if (flags & SND_ATTENUATION)
+        MSG_ReadByte();
+    if (flags & SND_OFFSET)
+        MSG_ReadByte();
+
+    entity = MSG_ReadShort() >> 3;
+    if (entity < 0 || entity >= MAX_EDICTS) {
+        Com_Error(ERR_DROP, "%s: bad entnum: %d", __func__, entity);
+    }
+
+    emit_entity(OUT_SOUNDS, entity, index);
+}
+
+static void parse_mvd_message(void)
+{
+    int cmd, extrabits;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            Com_Error(ERR_DROP, "Read past end of message");
+        }
+        if (msg_read.readcount == msg_read.cursize) {
+            break;
+        }
+
+        cmd = MSG_ReadByte();
+        extrabits = cmd >> SVCMD_BITS;
+        cmd &= SVCMD_MASK;
+
+        switch (cmd) {
+        case mvd_serverdata:
+            parse_mvd_serverdata();
+            break;
+        case mvd_multicast_all:
+        case mvd_multicast_pvs:
+        case mvd_multicast_phs:
+        case mvd_multicast_all_r:
+        case mvd_multicast_pvs_r:
+        case mvd_multicast_phs_r:
+            parse_mvd_multicast(cmd, extrabits);
+            break;
+        case mvd_unicast:
+        case mvd_unicast_r:
+            parse_mvd_unicast(extrabits);
+            break;
+        case mvd_configstring:
+            parse_configstring(MSG_ReadShort());
+            break;
+        case mvd_frame:
+            parse_mvd_frame();
+            break;
+        case mvd_sound:
+            parse_mvd_sound();
+            break;
+        case mvd_print:
+            MSG_ReadByte();
+            MSG_ReadString(NULL, 0);
+            break;
+        case mvd_nop:
+            break;
+        default:
+            Com_Error(ERR_DROP, "Illegible command at %"PRIz": %d",
+                      msg_read.readcount - 1, cmd);
+        }
+    }
+}
+
+static void parse_mvd_demo(const byte *data, size_t size)
+{
+    size_t  pos;
+    int     msglen;
+
+    for (pos = 4; ; pos += msglen) {
+        if (pos + 2 > size) {
+            Com_Error(ERR_DROP, "Unexpected end of file");
+        }
+
+        msglen = LittleShortMem(data + pos);
+        pos += 2;
+
+        if (!msglen) {
+            break;
+        }
+
+        if (msglen > MAX_MSGLEN || pos + msglen > size) {
+            Com_Error(ERR_DROP, "Bad message length: %d", msglen);
+        }
+
+        SZ_Init(&msg_read, (byte *)data + pos, msglen);
+        msg_read.cursize = msglen;
+
+        parse_mvd_message();
+    }
+}
+
+/*
+==============================================================================
+
+DRIVER
+
+==============================================================================
+*/
+
+typedef struct {
+    byte    *data;
+    size_t  size;
+#ifndef _WIN32
+    int     fd;
+#endif
+} demofile_t;
+
+static qboolean map_file(const char *path, demofile_t *f)
+{
+#ifdef _WIN32
+    FILE *fp;
+    long len;
+
+    if (!(fp = fopen(path, "rb")))
+        goto fail;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (len <= 0) {
+        fclose(fp);
+        errno = EINVAL;
+        goto fail;
+    }
+
+    f->size = len;
+    f->data = malloc(f->size);
+    if (!f->data || fread(f->data, 1, f->size, fp) != f->size) {
+        free(f->data);
+        fclose(fp);
+        goto fail;
+    }
+
+    fclose(fp);
+    return qtrue;
+#else
+    struct stat st;
+    void *p;
+
+    if ((f->fd = open(path, O_RDONLY)) == -1)
+        goto fail;
+
+    if (fstat(f->fd, &st) == -1) {
+        close(f->fd);
+        goto fail;
+    }
+
+    if (st.st_size <= 0) {
+        close(f->fd);
+        errno = EINVAL;
+        goto fail;
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+    if (p == MAP_FAILED) {
+        close(f->fd);
+        goto fail;
+    }
+
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    f->data = p;
+    f->size = st.st_size;
+    return qtrue;
+#endif
+
+fail:
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return qfalse;
+}
+
+static void unmap_file(demofile_t *f)
+{
+#ifdef _WIN32
+    free(f->data);
+#else
+    munmap(f->data, f->size);
+    close(f->fd);
+#endif
+}
+
+static unsigned get_msec(void)
+{
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static void close_outputs(qboolean tostdout)
+{
+    output_t *out;
+    char buffer[0x10000];
+    size_t len;
+    int i;
+
+    for (i = 0, out = outputs; i < OUT_TOTAL; i++, out++) {
+        if (!out->fp)
+            continue;
+
+        out_flush(out);
+
+        // concatenate temporary files into column blocks
+        if (tostdout) {
+            printf("# %s\n", out->name);
+            rewind(out->fp);
+            while ((len = fread(buffer, 1, sizeof(buffer), out->fp)) > 0)
+                fwrite(buffer, 1, len, stdout);
+        }
+
+        fclose(out->fp);
+        out->fp = NULL;
+    }
+
+    if (tostdout)
+        fflush(stdout);
+}
+
+static qboolean open_outputs(const char *path, const char *outdir, qboolean tostdout)
+{
+    char buffer[MAX_OSPATH];
+    const char *base;
+    output_t *out;
+    int i;
+
+    if (outdir) {
+        base = strrchr(path, '/');
+#ifdef _WIN32
+        if (!base)
+            base = strrchr(path, '\\');
+#endif
+        base = base ? base + 1 : path;
+    }
+
+    for (i = 0, out = outputs; i < OUT_TOTAL; i++, out++) {
+        if (tostdout) {
+            Q_strlcpy(buffer, "temporary file", sizeof(buffer));
+            out->fp = tmpfile();
+        } else {
+            if (outdir)
+                Q_snprintf(buffer, sizeof(buffer), "%s/%s.%s.tsv", outdir, base, out->name);
+            else
+                Q_snprintf(buffer, sizeof(buffer), "%s.%s.tsv", path, out->name);
+            out->fp = fopen(buffer, "w");
+        }
+
+        if (!out->fp) {
+            fprintf(stderr, "%s: %s\n", buffer, strerror(errno));
+            close_outputs(qfalse);
+            return qfalse;
+        }
+
+        out->len = 0;
+        out_printf(out, "# %s\n", path);
+        out_printf(out, "%s\n", out->columns);
+    }
+
+    return qtrue;
+}
+
+static qboolean process_demo(const char *path, const char *outdir)
+{
+    demofile_t  f;
+    unsigned    start, msec;
+    uint32_t    magic = 0;
+    qboolean    ret, tostdout;
+
+    if (!map_file(path, &f)) {
+        return qfalse;
+    }
+
+    memset(&demo, 0, sizeof(demo));
+    demo.path = path;
+
+    tostdout = outdir && !strcmp(outdir, "-");
+    if (!open_outputs(path, tostdout ? NULL : outdir, tostdout)) {
+        unmap_file(&f);
+        return qfalse;
+    }
+
+    start = get_msec();
+
+    if (setjmp(demo_abort)) {
+        fprintf(stderr, "%s: %s\n", path, demo_error);
+        ret = qfalse;
+    } else if (f.size >= 2 && f.data[0] == 0x1f && f.data[1] == 0x8b) {
+        Com_Error(ERR_DROP, "Compressed demos are not supported");
+    } else {
+        if (f.size >= 4)
+            memcpy(&magic, f.data, 4);
+        if (magic == MVD_MAGIC) {
+            parse_mvd_demo(f.data, f.size);
+        } else {
+            parse_client_demo(f.data, f.size);
+        }
+        ret = qtrue;
+    }
+
+    msec = get_msec() - start;
+    fprintf(stderr, "%s: %d frames, %"PRIz" bytes in %u ms (%.1f MB/s)\n",
+            path, demo.numframes, f.size, msec,
+            msec ? f.size / (msec * 1000.0) : 0.0);
+
+    close_outputs(tostdout);
+    unmap_file(&f);
+    return ret;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: demotool [-j jobs] [-o outdir] demo [...]\n"
+            "Decodes .dm2 and .mvd2 demos into <demo>.<group>.tsv files.\n"
+            "  -j jobs      number of demos to process in parallel\n"
+            "  -o outdir    write output files into outdir ('-' for stdout)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char  *outdir = NULL;
+    int         i, jobs = 1, failed = 0;
+#ifndef _WIN32
+    int         running = 0, status;
+#endif
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            outdir = argv[++i];
+        } else {
+            usage();
+        }
+    }
+
+    if (i == argc) {
+        usage();
+    }
+
+    // output to stdout can't be interleaved
+    if (jobs < 1 || (outdir && !strcmp(outdir, "-"))) {
+        jobs = 1;
+    }
+
+#ifndef _WIN32
+    if (jobs > 1) {
+        // msg_read is global, so use one process per demo
+        for (; i < argc || running; ) {
+            if (i < argc && running < jobs) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    exit(process_demo(argv[i], outdir) ? 0 : 1);
+                }
+                if (pid == -1) {
+                    perror("fork");
+                    failed++;
+                } else {
+                    running++;
+                }
+                i++;
+                continue;
+            }
+            if (wait(&status) == -1) {
+                break;
+            }
+            if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+                failed++;
+            }
+            running--;
+        }
+        return failed ? 1 : 0;
+    }
+#endif
+
+    for (; i < argc; i++) {
+        if (!process_demo(argv[i], outdir)) {
+            failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
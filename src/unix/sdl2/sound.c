@@ -155,4 +155,5 @@ void WAVE_FillAPI(snddmaAPI_t *api)
     api->BeginPainting = BeginPainting;
     api->Submit = Submit;
     api->Activate = Activate;
+    api->threaded = qtrue;
 }
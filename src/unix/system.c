@@ -66,14 +66,19 @@ void Sys_DebugBreak(void)
     raise(SIGTRAP);
 }
 
-unsigned Sys_Milliseconds(void)
+uint64_t Sys_Microseconds(void)
 {
-    struct timeval tp;
-    unsigned time;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-    gettimeofday(&tp, NULL);
-    time = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-    return time;
+// must be derived from Sys_Microseconds for NET_SleepUntil to
+// wake up exactly on millisecond boundaries
+unsigned Sys_Milliseconds(void)
+{
+    return Sys_Microseconds() / 1000;
 }
 
 /*